@@ -338,6 +338,7 @@ LOCAL_SRC_FILES := \
 	bluez/monitor/display.c \
 	bluez/monitor/hcidump.c \
 	bluez/monitor/control.c \
+	bluez/monitor/batch.c \
 	bluez/monitor/packet.c \
 	bluez/monitor/l2cap.c \
 	bluez/monitor/avctp.c \
@@ -37,6 +37,9 @@
 
 #define G_OBEX_HDR_ENC(id)	((id) & 0xc0)
 
+#define HEADER_INLINE_SIZE	32
+#define HEADER_POOL_SIZE	64
+
 struct _GObexHeader {
 	guint8 id;
 	gboolean extdata;
@@ -49,8 +52,49 @@ struct _GObexHeader {
 		guint8 u8;
 		guint32 u32;
 	} v;
+	guint8 buf[HEADER_INLINE_SIZE];	/* Storage for small byte arrays */
 };
 
+/* Freed headers are kept for reuse since several are allocated and freed
+ * for every packet sent or received.
+ */
+static GObexHeader *header_pool[HEADER_POOL_SIZE];
+static guint header_pool_len = 0;
+
+static GObexHeader *header_new(void)
+{
+	GObexHeader *header;
+
+	if (header_pool_len == 0)
+		return g_new0(GObexHeader, 1);
+
+	header = header_pool[--header_pool_len];
+	memset(header, 0, sizeof(*header));
+
+	return header;
+}
+
+static void header_release(GObexHeader *header)
+{
+	if (header_pool_len < HEADER_POOL_SIZE) {
+		header_pool[header_pool_len++] = header;
+		return;
+	}
+
+	g_free(header);
+}
+
+static guint8 *header_dup_data(GObexHeader *header, const void *data,
+								gsize len)
+{
+	if (len > sizeof(header->buf))
+		return g_memdup(data, len);
+
+	memcpy(header->buf, data, len);
+
+	return header->buf;
+}
+
 static glong utf8_to_utf16(gunichar2 **utf16, const char *utf8) {
 	glong utf16_len;
 	int i;
@@ -154,7 +198,7 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 		return NULL;
 	}
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	ptr = get_bytes(&header->id, ptr, sizeof(header->id));
 
@@ -235,7 +279,8 @@ GObexHeader *g_obex_header_decode(const void *data, gsize len,
 
 		switch (data_policy) {
 		case G_OBEX_DATA_COPY:
-			header->v.data = g_memdup(ptr, header->vlen);
+			header->v.data = header_dup_data(header, ptr,
+								header->vlen);
 			break;
 		case G_OBEX_DATA_REF:
 			header->extdata = TRUE;
@@ -294,7 +339,7 @@ void g_obex_header_free(GObexHeader *header)
 		g_free(header->v.string);
 		break;
 	case G_OBEX_HDR_ENC_BYTES:
-		if (!header->extdata)
+		if (!header->extdata && header->v.data != header->buf)
 			g_free(header->v.data);
 		break;
 	case G_OBEX_HDR_ENC_UINT8:
@@ -304,7 +349,7 @@ void g_obex_header_free(GObexHeader *header)
 		g_assert_not_reached();
 	}
 
-	g_free(header);
+	header_release(header);
 }
 
 gboolean g_obex_header_get_unicode(GObexHeader *header, const char **str)
@@ -394,7 +439,7 @@ GObexHeader *g_obex_header_new_unicode(guint8 id, const char *str)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UNICODE)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 
@@ -418,12 +463,12 @@ GObexHeader *g_obex_header_new_bytes(guint8 id, const void *data, gsize len)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_BYTES)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = len;
 	header->hlen = len + 3;
-	header->v.data = g_memdup(data, len);
+	header->v.data = header_dup_data(header, data, len);
 
 	return header;
 }
@@ -454,7 +499,7 @@ GObexHeader *g_obex_header_new_uint8(guint8 id, guint8 val)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UINT8)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = 1;
@@ -475,7 +520,7 @@ GObexHeader *g_obex_header_new_uint32(guint8 id, guint32 val)
 	if (G_OBEX_HDR_ENC(id) != G_OBEX_HDR_ENC_UINT32)
 		return NULL;
 
-	header = g_new0(GObexHeader, 1);
+	header = header_new();
 
 	header->id = id;
 	header->vlen = 4;
@@ -503,49 +548,58 @@ guint16 g_obex_header_get_length(GObexHeader *header)
 	return header->hlen;
 }
 
+GObexHeader *g_obex_header_new_valist(guint8 id, va_list *args)
+{
+	const char *str;
+	const void *bytes;
+	unsigned int val;
+	gsize len;
+
+	switch (G_OBEX_HDR_ENC(id)) {
+	case G_OBEX_HDR_ENC_UNICODE:
+		str = va_arg(*args, const char *);
+		return g_obex_header_new_unicode(id, str);
+	case G_OBEX_HDR_ENC_BYTES:
+		bytes = va_arg(*args, void *);
+		len = va_arg(*args, gsize);
+		return g_obex_header_new_bytes(id, bytes, len);
+	case G_OBEX_HDR_ENC_UINT8:
+		val = va_arg(*args, unsigned int);
+		return g_obex_header_new_uint8(id, val);
+	case G_OBEX_HDR_ENC_UINT32:
+		val = va_arg(*args, unsigned int);
+		return g_obex_header_new_uint32(id, val);
+	default:
+		g_assert_not_reached();
+	}
+
+	return NULL;
+}
+
 GSList *g_obex_header_create_list(guint8 first_hdr_id, va_list args,
 							gsize *total_len)
 {
 	unsigned int id = first_hdr_id;
 	GSList *l = NULL;
+	va_list aq;
 
 	g_obex_debug(G_OBEX_DEBUG_HEADER, "");
 
 	*total_len = 0;
 
+	va_copy(aq, args);
+
 	while (id != G_OBEX_HDR_INVALID) {
 		GObexHeader *hdr;
-		const char *str;
-		const void *bytes;
-		unsigned int val;
-		gsize len;
-
-		switch (G_OBEX_HDR_ENC(id)) {
-		case G_OBEX_HDR_ENC_UNICODE:
-			str = va_arg(args, const char *);
-			hdr = g_obex_header_new_unicode(id, str);
-			break;
-		case G_OBEX_HDR_ENC_BYTES:
-			bytes = va_arg(args, void *);
-			len = va_arg(args, gsize);
-			hdr = g_obex_header_new_bytes(id, bytes, len);
-			break;
-		case G_OBEX_HDR_ENC_UINT8:
-			val = va_arg(args, unsigned int);
-			hdr = g_obex_header_new_uint8(id, val);
-			break;
-		case G_OBEX_HDR_ENC_UINT32:
-			val = va_arg(args, unsigned int);
-			hdr = g_obex_header_new_uint32(id, val);
-			break;
-		default:
-			g_assert_not_reached();
-		}
+
+		hdr = g_obex_header_new_valist(id, &aq);
 
 		l = g_slist_append(l, hdr);
 		*total_len += hdr->hlen;
-		id = va_arg(args, int);
+		id = va_arg(aq, int);
 	}
 
+	va_end(aq);
+
 	return l;
 }
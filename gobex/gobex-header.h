@@ -23,6 +23,7 @@
 #ifndef __GOBEX_HEADER_H
 #define __GOBEX_HEADER_H
 
+#include <stdarg.h>
 #include <glib.h>
 
 #include "gobex/gobex-defs.h"
@@ -88,6 +89,8 @@ GObexHeader *g_obex_header_new_uint32(guint8 id, guint32 val);
 GObexHeader *g_obex_header_new_tag(guint8 id, GObexApparam *apparam);
 GObexHeader *g_obex_header_new_apparam(GObexApparam *apparam);
 
+GObexHeader *g_obex_header_new_valist(guint8 id, va_list *args);
+
 GSList *g_obex_header_create_list(guint8 first_hdr_id, va_list args,
 							gsize *total_len);
 
@@ -26,6 +26,7 @@
 
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "gobex-defs.h"
 #include "gobex-packet.h"
@@ -33,6 +34,9 @@
 
 #define FINAL_BIT 0x80
 
+#define PACKET_INLINE_HEADERS	8
+#define PACKET_POOL_SIZE	16
+
 struct _GObexPacket {
 	guint8 opcode;
 	gboolean final;
@@ -46,20 +50,87 @@ struct _GObexPacket {
 	gsize data_len;
 
 	gsize hlen;		/* Length of all encoded headers */
-	GSList *headers;
+	GObexHeader **headers;
+	guint n_headers;
+	guint max_headers;
+	GObexHeader *inline_headers[PACKET_INLINE_HEADERS];
 
 	GObexDataProducer get_body;
+	GObexFdProducer get_body_fd;
 	gpointer get_body_data;
+	int body_fd;
 };
 
+/* A packet is allocated for every request and response, so freed packets
+ * are recycled instead of going back to the allocator each time.
+ */
+static GObexPacket *packet_pool[PACKET_POOL_SIZE];
+static guint packet_pool_len = 0;
+
+static GObexPacket *packet_alloc(void)
+{
+	GObexPacket *pkt;
+
+	if (packet_pool_len == 0)
+		pkt = g_new0(GObexPacket, 1);
+	else {
+		pkt = packet_pool[--packet_pool_len];
+		memset(pkt, 0, sizeof(*pkt));
+	}
+
+	pkt->headers = pkt->inline_headers;
+	pkt->max_headers = PACKET_INLINE_HEADERS;
+
+	return pkt;
+}
+
+static void packet_release(GObexPacket *pkt)
+{
+	if (pkt->headers != pkt->inline_headers)
+		g_free(pkt->headers);
+
+	if (packet_pool_len < PACKET_POOL_SIZE) {
+		packet_pool[packet_pool_len++] = pkt;
+		return;
+	}
+
+	g_free(pkt);
+}
+
+static void packet_insert_header(GObexPacket *pkt, guint index,
+							GObexHeader *header)
+{
+	if (pkt->n_headers == pkt->max_headers) {
+		guint max = pkt->max_headers * 2;
+
+		if (pkt->headers == pkt->inline_headers) {
+			pkt->headers = g_new(GObexHeader *, max);
+			memcpy(pkt->headers, pkt->inline_headers,
+						sizeof(pkt->inline_headers));
+		} else
+			pkt->headers = g_renew(GObexHeader *, pkt->headers,
+									max);
+
+		pkt->max_headers = max;
+	}
+
+	if (index < pkt->n_headers)
+		memmove(&pkt->headers[index + 1], &pkt->headers[index],
+			(pkt->n_headers - index) * sizeof(GObexHeader *));
+
+	pkt->headers[index] = header;
+	pkt->n_headers++;
+	pkt->hlen += g_obex_header_get_length(header);
+}
+
 GObexHeader *g_obex_packet_get_header(GObexPacket *pkt, guint8 id)
 {
-	GSList *l;
+	guint i;
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	for (l = pkt->headers; l != NULL; l = g_slist_next(l)) {
-		GObexHeader *hdr = l->data;
+	for (i = 0; i < pkt->n_headers; i++) {
+		GObexHeader *hdr = pkt->headers[i];
 
 		if (g_obex_header_get_id(hdr) == id)
 			return hdr;
@@ -95,8 +166,7 @@ gboolean g_obex_packet_prepend_header(GObexPacket *pkt, GObexHeader *header)
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	pkt->headers = g_slist_prepend(pkt->headers, header);
-	pkt->hlen += g_obex_header_get_length(header);
+	packet_insert_header(pkt, 0, header);
 
 	return TRUE;
 }
@@ -105,8 +175,7 @@ gboolean g_obex_packet_add_header(GObexPacket *pkt, GObexHeader *header)
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	pkt->headers = g_slist_append(pkt->headers, header);
-	pkt->hlen += g_obex_header_get_length(header);
+	packet_insert_header(pkt, pkt->n_headers, header);
 
 	return TRUE;
 }
@@ -116,7 +185,7 @@ gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
-	if (pkt->get_body != NULL)
+	if (pkt->get_body != NULL || pkt->get_body_fd != NULL)
 		return FALSE;
 
 	pkt->get_body = func;
@@ -125,6 +194,22 @@ gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 	return TRUE;
 }
 
+gboolean g_obex_packet_add_body_fd(GObexPacket *pkt, int fd,
+					GObexFdProducer func,
+					gpointer user_data)
+{
+	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
+
+	if (pkt->get_body != NULL || pkt->get_body_fd != NULL || fd < 0)
+		return FALSE;
+
+	pkt->get_body_fd = func;
+	pkt->get_body_data = user_data;
+	pkt->body_fd = fd;
+
+	return TRUE;
+}
+
 gboolean g_obex_packet_add_unicode(GObexPacket *pkt, guint8 id,
 							const char *str)
 {
@@ -230,18 +315,29 @@ gboolean g_obex_packet_set_data(GObexPacket *pkt, const void *data, gsize len,
 GObexPacket *g_obex_packet_new_valist(guint8 opcode, gboolean final,
 					guint first_hdr_id, va_list args)
 {
+	unsigned int id = first_hdr_id;
 	GObexPacket *pkt;
+	va_list aq;
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", opcode);
 
-	pkt = g_new0(GObexPacket, 1);
+	pkt = packet_alloc();
 
 	pkt->opcode = opcode;
 	pkt->final = final;
-	pkt->headers = g_obex_header_create_list(first_hdr_id, args,
-								&pkt->hlen);
 	pkt->data_policy = G_OBEX_DATA_COPY;
 
+	va_copy(aq, args);
+
+	while (id != G_OBEX_HDR_INVALID) {
+		GObexHeader *hdr = g_obex_header_new_valist(id, &aq);
+
+		packet_insert_header(pkt, pkt->n_headers, hdr);
+		id = va_arg(aq, int);
+	}
+
+	va_end(aq);
+
 	return pkt;
 }
 
@@ -260,11 +356,6 @@ GObexPacket *g_obex_packet_new(guint8 opcode, gboolean final,
 	return pkt;
 }
 
-static void header_free(void *data, void *user_data)
-{
-	g_obex_header_free(data);
-}
-
 void g_obex_packet_free(GObexPacket *pkt)
 {
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
@@ -278,9 +369,10 @@ void g_obex_packet_free(GObexPacket *pkt)
 		break;
 	}
 
-	g_slist_foreach(pkt->headers, header_free, NULL);
-	g_slist_free(pkt->headers);
-	g_free(pkt);
+	while (pkt->n_headers > 0)
+		g_obex_header_free(pkt->headers[--pkt->n_headers]);
+
+	packet_release(pkt);
 }
 
 static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
@@ -300,8 +392,7 @@ static gboolean parse_headers(GObexPacket *pkt, const void *data, gsize len,
 		if (header == NULL)
 			return FALSE;
 
-		pkt->headers = g_slist_append(pkt->headers, header);
-		pkt->hlen += parsed;
+		packet_insert_header(pkt, pkt->n_headers, header);
 
 		len -= parsed;
 		buf += parsed;
@@ -409,15 +500,91 @@ static gssize get_body(GObexPacket *pkt, guint8 *buf, gsize len)
 	return ret;
 }
 
+static gssize read_body_fd(int fd, guint8 *buf, gsize len)
+{
+	gsize count = 0;
+	ssize_t ret;
+
+	while (count < len) {
+		ret = read(fd, buf + count, len - count);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		/* File is shorter than what the producer announced */
+		if (ret == 0)
+			return -EIO;
+
+		count += ret;
+	}
+
+	return count;
+}
+
+static gssize get_body_fd(GObexPacket *pkt, guint8 *buf, gsize len,
+							gsize *splice_len)
+{
+	guint16 u16;
+	gssize ret, err;
+
+	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
+
+	if (len < 3)
+		return -ENOBUFS;
+
+	ret = pkt->get_body_fd(len - 3, pkt->get_body_data);
+	if (ret < 0)
+		return ret;
+
+	if ((gsize) ret > len - 3)
+		return -ENOBUFS;
+
+	/* Without splice support copy the data in the packet buffer */
+	if (splice_len != NULL)
+		*splice_len = ret;
+	else if (ret > 0) {
+		err = read_body_fd(pkt->body_fd, buf + 3, ret);
+		if (err < 0)
+			return err;
+	}
+
+	if (ret > 0)
+		buf[0] = G_OBEX_HDR_BODY;
+	else
+		buf[0] = G_OBEX_HDR_BODY_END;
+
+	u16 = g_htons(ret + 3);
+	memcpy(&buf[1], &u16, sizeof(u16));
+
+	return ret;
+}
+
 gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len)
+{
+	return g_obex_packet_encode_splice(pkt, buf, len, NULL, NULL);
+}
+
+/*
+ * Encode the packet, leaving the body data of a packet added with
+ * g_obex_packet_add_body_fd in the file so it can be sent straight from
+ * splice_fd. The returned length includes the splice_len bytes which are
+ * not present in buf.
+ */
+gssize g_obex_packet_encode_splice(GObexPacket *pkt, guint8 *buf, gsize len,
+					int *splice_fd, gsize *splice_len)
 {
 	gssize ret;
 	gsize count;
 	guint16 u16;
-	GSList *l;
+	guint i;
 
 	g_obex_debug(G_OBEX_DEBUG_PACKET, "opcode 0x%02x", pkt->opcode);
 
+	if (splice_len)
+		*splice_len = 0;
+
 	if (3 + pkt->data_len + pkt->hlen > len)
 		return -ENOBUFS;
 
@@ -434,8 +601,8 @@ gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len)
 
 	count = 3 + pkt->data_len;
 
-	for (l = pkt->headers; l != NULL; l = g_slist_next(l)) {
-		GObexHeader *hdr = l->data;
+	for (i = 0; i < pkt->n_headers; i++) {
+		GObexHeader *hdr = pkt->headers[i];
 
 		if (count >= len)
 			return -ENOBUFS;
@@ -447,8 +614,14 @@ gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len)
 		count += ret;
 	}
 
-	if (pkt->get_body) {
-		ret = get_body(pkt, buf + count, len - count);
+	if (pkt->get_body || pkt->get_body_fd) {
+		if (pkt->get_body_fd) {
+			ret = get_body_fd(pkt, buf + count, len - count,
+								splice_len);
+			if (splice_fd)
+				*splice_fd = pkt->body_fd;
+		} else
+			ret = get_body(pkt, buf + count, len - count);
 		if (ret < 0)
 			return ret;
 		if (ret == 0) {
@@ -88,6 +88,9 @@ gboolean g_obex_packet_prepend_header(GObexPacket *pkt, GObexHeader *header);
 gboolean g_obex_packet_add_header(GObexPacket *pkt, GObexHeader *header);
 gboolean g_obex_packet_add_body(GObexPacket *pkt, GObexDataProducer func,
 							gpointer user_data);
+gboolean g_obex_packet_add_body_fd(GObexPacket *pkt, int fd,
+					GObexFdProducer func,
+					gpointer user_data);
 gboolean g_obex_packet_add_unicode(GObexPacket *pkt, guint8 id,
 							const char *str);
 gboolean g_obex_packet_add_bytes(GObexPacket *pkt, guint8 id,
@@ -108,5 +111,7 @@ GObexPacket *g_obex_packet_decode(const void *data, gsize len,
 						GObexDataPolicy data_policy,
 						GError **err);
 gssize g_obex_packet_encode(GObexPacket *pkt, guint8 *buf, gsize len);
+gssize g_obex_packet_encode_splice(GObexPacket *pkt, guint8 *buf, gsize len,
+					int *splice_fd, gsize *splice_len);
 
 #endif /* __GOBEX_PACKET_H */
@@ -50,9 +50,12 @@ struct transfer {
 	guint abort_id;
 
 	GObexDataProducer data_producer;
+	GObexFdProducer fd_producer;
 	GObexDataConsumer data_consumer;
 	GObexFunc complete_func;
 
+	int fd;
+
 	gpointer user_data;
 };
 
@@ -131,14 +134,23 @@ static void transfer_abort_response(GObex *obex, GError *err, GObexPacket *rsp,
 }
 
 
-static gssize put_get_data(void *buf, gsize len, gpointer user_data)
+static gssize put_get_data(void *buf, gsize len, gpointer user_data);
+static gssize put_get_fd_data(gsize len, gpointer user_data);
+
+static void transfer_add_put_body(struct transfer *transfer, GObexPacket *req)
+{
+	if (transfer->fd_producer)
+		g_obex_packet_add_body_fd(req, transfer->fd, put_get_fd_data,
+								transfer);
+	else
+		g_obex_packet_add_body(req, put_get_data, transfer);
+}
+
+static gssize put_get_next(struct transfer *transfer, gssize ret)
 {
-	struct transfer *transfer = user_data;
 	GObexPacket *req;
 	GError *err = NULL;
-	gssize ret;
 
-	ret = transfer->data_producer(buf, len, transfer->user_data);
 	if (ret == 0 || ret == -EAGAIN)
 		return ret;
 
@@ -150,7 +162,7 @@ static gssize put_get_data(void *buf, gsize len, gpointer user_data)
 		/* Generate next packet */
 		req = g_obex_packet_new(transfer->opcode, FALSE,
 							G_OBEX_HDR_INVALID);
-		g_obex_packet_add_body(req, put_get_data, transfer);
+		transfer_add_put_body(transfer, req);
 		transfer->req_id = g_obex_send_req(transfer->obex, req, -1,
 						transfer_response, transfer,
 						&err);
@@ -168,6 +180,26 @@ done:
 	return ret;
 }
 
+static gssize put_get_data(void *buf, gsize len, gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	ret = transfer->data_producer(buf, len, transfer->user_data);
+
+	return put_get_next(transfer, ret);
+}
+
+static gssize put_get_fd_data(gsize len, gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	ret = transfer->fd_producer(len, transfer->user_data);
+
+	return put_get_next(transfer, ret);
+}
+
 static gboolean handle_get_body(struct transfer *transfer, GObexPacket *rsp,
 								GError **err)
 {
@@ -230,7 +262,7 @@ static void transfer_response(GObex *obex, GError *err, GObexPacket *rsp,
 	if (transfer->opcode == G_OBEX_OP_PUT) {
 		req = g_obex_packet_new(transfer->opcode, FALSE,
 							G_OBEX_HDR_INVALID);
-		g_obex_packet_add_body(req, put_get_data, transfer);
+		transfer_add_put_body(transfer, req);
 	} else if (!g_obex_srm_active(transfer->obex)) {
 		req = g_obex_packet_new(transfer->opcode, TRUE,
 							G_OBEX_HDR_INVALID);
@@ -262,6 +294,7 @@ static struct transfer *transfer_new(GObex *obex, guint8 opcode,
 
 	transfer->id = next_id++;
 	transfer->opcode = opcode;
+	transfer->fd = -1;
 	transfer->obex = g_obex_ref(obex);
 	transfer->complete_func = complete_func;
 	transfer->user_data = user_data;
@@ -271,6 +304,24 @@ static struct transfer *transfer_new(GObex *obex, guint8 opcode,
 	return transfer;
 }
 
+static guint transfer_put_req_start(struct transfer *transfer,
+					GObexPacket *req, GError **err)
+{
+	transfer_add_put_body(transfer, req);
+
+	transfer->req_id = g_obex_send_req(transfer->obex, req,
+					FIRST_PACKET_TIMEOUT,
+					transfer_response, transfer, err);
+	if (transfer->req_id == 0) {
+		transfer_free(transfer);
+		return 0;
+	}
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+
+	return transfer->id;
+}
+
 guint g_obex_put_req_pkt(GObex *obex, GObexPacket *req,
 			GObexDataProducer data_func, GObexFunc complete_func,
 			gpointer user_data, GError **err)
@@ -285,18 +336,31 @@ guint g_obex_put_req_pkt(GObex *obex, GObexPacket *req,
 	transfer = transfer_new(obex, G_OBEX_OP_PUT, complete_func, user_data);
 	transfer->data_producer = data_func;
 
-	g_obex_packet_add_body(req, put_get_data, transfer);
+	return transfer_put_req_start(transfer, req, err);
+}
 
-	transfer->req_id = g_obex_send_req(obex, req, FIRST_PACKET_TIMEOUT,
-					transfer_response, transfer, err);
-	if (transfer->req_id == 0) {
-		transfer_free(transfer);
+/*
+ * Body data is taken from the current offset of fd, data_func only returns
+ * how many bytes of it go into the next packet. On stream transports the
+ * data is sent from the file to the socket without passing through the
+ * packet buffer.
+ */
+guint g_obex_put_req_pkt_fd(GObex *obex, GObexPacket *req, int fd,
+			GObexFdProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err)
+{
+	struct transfer *transfer;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p fd %d", obex, fd);
+
+	if (g_obex_packet_get_operation(req, NULL) != G_OBEX_OP_PUT || fd < 0)
 		return 0;
-	}
 
-	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+	transfer = transfer_new(obex, G_OBEX_OP_PUT, complete_func, user_data);
+	transfer->fd_producer = data_func;
+	transfer->fd = fd;
 
-	return transfer->id;
+	return transfer_put_req_start(transfer, req, err);
 }
 
 guint g_obex_put_req(GObex *obex, GObexDataProducer data_func,
@@ -504,17 +568,24 @@ guint g_obex_get_req(GObex *obex, GObexDataConsumer data_func,
 	return transfer->id;
 }
 
-static gssize get_get_data(void *buf, gsize len, gpointer user_data)
+static gssize get_get_data(void *buf, gsize len, gpointer user_data);
+static gssize get_get_fd_data(gsize len, gpointer user_data);
+
+static void transfer_add_get_body(struct transfer *transfer, GObexPacket *rsp)
+{
+	if (transfer->fd_producer)
+		g_obex_packet_add_body_fd(rsp, transfer->fd, get_get_fd_data,
+								transfer);
+	else
+		g_obex_packet_add_body(rsp, get_get_data, transfer);
+}
+
+static gssize get_get_next(struct transfer *transfer, gssize ret)
 {
-	struct transfer *transfer = user_data;
 	GObexPacket *req, *rsp;
 	GError *err = NULL;
-	gssize ret;
 	guint8 op;
 
-	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
-
-	ret = transfer->data_producer(buf, len, transfer->user_data);
 	if (ret > 0) {
 		if (!g_obex_srm_active(transfer->obex))
 			return ret;
@@ -522,7 +593,7 @@ static gssize get_get_data(void *buf, gsize len, gpointer user_data)
 		/* Generate next response */
 		rsp = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE,
 							G_OBEX_HDR_INVALID);
-		g_obex_packet_add_body(rsp, get_get_data, transfer);
+		transfer_add_get_body(transfer, rsp);
 
 		if (!g_obex_send(transfer->obex, rsp, &err)) {
 			transfer_complete(transfer, err);
@@ -554,6 +625,30 @@ static gssize get_get_data(void *buf, gsize len, gpointer user_data)
 	return ret;
 }
 
+static gssize get_get_data(void *buf, gsize len, gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+
+	ret = transfer->data_producer(buf, len, transfer->user_data);
+
+	return get_get_next(transfer, ret);
+}
+
+static gssize get_get_fd_data(gsize len, gpointer user_data)
+{
+	struct transfer *transfer = user_data;
+	gssize ret;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
+
+	ret = transfer->fd_producer(len, transfer->user_data);
+
+	return get_get_next(transfer, ret);
+}
+
 static gboolean transfer_get_req_first(struct transfer *transfer,
 							GObexPacket *rsp)
 {
@@ -561,7 +656,7 @@ static gboolean transfer_get_req_first(struct transfer *transfer,
 
 	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
 
-	g_obex_packet_add_body(rsp, get_get_data, transfer);
+	transfer_add_get_body(transfer, rsp);
 
 	if (!g_obex_send(transfer->obex, rsp, &err)) {
 		transfer_complete(transfer, err);
@@ -581,7 +676,7 @@ static void transfer_get_req(GObex *obex, GObexPacket *req, gpointer user_data)
 	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "transfer %u", transfer->id);
 
 	rsp = g_obex_packet_new(G_OBEX_RSP_CONTINUE, TRUE, G_OBEX_HDR_INVALID);
-	g_obex_packet_add_body(rsp, get_get_data, transfer);
+	transfer_add_get_body(transfer, rsp);
 
 	if (!g_obex_send(obex, rsp, &err)) {
 		transfer_complete(transfer, err);
@@ -589,29 +684,22 @@ static void transfer_get_req(GObex *obex, GObexPacket *req, gpointer user_data)
 	}
 }
 
-guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
-			GObexDataProducer data_func, GObexFunc complete_func,
-			gpointer user_data, GError **err)
+static guint transfer_get_rsp_start(struct transfer *transfer,
+							GObexPacket *rsp)
 {
-	struct transfer *transfer;
 	guint id;
 
-	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p", obex);
-
-	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
-	transfer->data_producer = data_func;
-
 	if (!transfer_get_req_first(transfer, rsp))
 		return 0;
 
 	if (!g_slist_find(transfers, transfer))
 		return 0;
 
-	id = g_obex_add_request_function(obex, G_OBEX_OP_GET, transfer_get_req,
-								transfer);
+	id = g_obex_add_request_function(transfer->obex, G_OBEX_OP_GET,
+						transfer_get_req, transfer);
 	transfer->get_id = id;
 
-	id = g_obex_add_request_function(obex, G_OBEX_OP_ABORT,
+	id = g_obex_add_request_function(transfer->obex, G_OBEX_OP_ABORT,
 						transfer_abort_req, transfer);
 	transfer->abort_id = id;
 
@@ -620,6 +708,38 @@ guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
 	return transfer->id;
 }
 
+guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
+			GObexDataProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err)
+{
+	struct transfer *transfer;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p", obex);
+
+	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
+	transfer->data_producer = data_func;
+
+	return transfer_get_rsp_start(transfer, rsp);
+}
+
+guint g_obex_get_rsp_pkt_fd(GObex *obex, GObexPacket *rsp, int fd,
+			GObexFdProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err)
+{
+	struct transfer *transfer;
+
+	g_obex_debug(G_OBEX_DEBUG_TRANSFER, "obex %p fd %d", obex, fd);
+
+	if (fd < 0)
+		return 0;
+
+	transfer = transfer_new(obex, G_OBEX_OP_GET, complete_func, user_data);
+	transfer->fd_producer = data_func;
+	transfer->fd = fd;
+
+	return transfer_get_rsp_start(transfer, rsp);
+}
+
 guint g_obex_get_rsp(GObex *obex, GObexDataProducer data_func,
 			GObexFunc complete_func, gpointer user_data,
 			GError **err, guint first_hdr_id, ...)
@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 
 #include "gobex.h"
 #include "gobex-debug.h"
@@ -35,6 +37,8 @@
 #define G_OBEX_MINIMUM_MTU	255
 #define G_OBEX_MAXIMUM_MTU	65535
 
+#define G_OBEX_DEFAULT_DEPTH	8
+
 #define G_OBEX_DEFAULT_TIMEOUT	10
 #define G_OBEX_ABORT_TIMEOUT	5
 
@@ -78,10 +82,15 @@ struct _GObex {
 	size_t tx_data;
 	size_t tx_sent;
 
+	gboolean use_splice;
+	int tx_splice_fd;
+	size_t tx_splice_len;
+
 	gboolean suspended;
 	gboolean use_srm;
 
 	struct srm_config *srm;
+	guint srm_depth;
 
 	guint write_source;
 
@@ -276,6 +285,9 @@ static gboolean write_stream(GObex *obex, GError **err)
 	buf = (char *) &obex->tx_buf[obex->tx_sent];
 	status = g_io_channel_write_chars(obex->io, buf, obex->tx_data,
 							&bytes_written, err);
+	if (status == G_IO_STATUS_AGAIN)
+		return TRUE;
+
 	if (status != G_IO_STATUS_NORMAL)
 		return FALSE;
 
@@ -296,6 +308,9 @@ static gboolean write_packet(GObex *obex, GError **err)
 	buf = (char *) &obex->tx_buf[obex->tx_sent];
 	status = g_io_channel_write_chars(obex->io, buf, obex->tx_data,
 							&bytes_written, err);
+	if (status == G_IO_STATUS_AGAIN)
+		return TRUE;
+
 	if (status != G_IO_STATUS_NORMAL)
 		return FALSE;
 
@@ -310,6 +325,35 @@ static gboolean write_packet(GObex *obex, GError **err)
 	return TRUE;
 }
 
+static gboolean write_splice(GObex *obex)
+{
+	int fd = g_io_channel_unix_get_fd(obex->io);
+	ssize_t ret;
+
+	ret = sendfile(fd, obex->tx_splice_fd, NULL, obex->tx_splice_len);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return TRUE;
+
+		g_obex_debug(G_OBEX_DEBUG_ERROR, "sendfile: %s (%d)",
+						strerror(errno), errno);
+		return FALSE;
+	}
+
+	if (ret == 0) {
+		g_obex_debug(G_OBEX_DEBUG_ERROR,
+				"sendfile: %zu bytes missing from body file",
+				obex->tx_splice_len);
+		return FALSE;
+	}
+
+	g_obex_debug(G_OBEX_DEBUG_DATA, "< spliced %zd bytes", ret);
+
+	obex->tx_splice_len -= ret;
+
+	return TRUE;
+}
+
 static void set_srmp(GObex *obex, guint8 srmp, gboolean outgoing)
 {
 	struct srm_config *config = obex->srm;
@@ -432,6 +476,7 @@ static gboolean write_data(GIOChannel *io, GIOCondition cond,
 							gpointer user_data)
 {
 	GObex *obex = user_data;
+	guint depth = 0;
 
 	if (cond & G_IO_NVAL)
 		return FALSE;
@@ -439,7 +484,8 @@ static gboolean write_data(GIOChannel *io, GIOCondition cond,
 	if (cond & (G_IO_HUP | G_IO_ERR))
 		goto stop_tx;
 
-	if (obex->tx_data == 0) {
+next:
+	if (obex->tx_data == 0 && obex->tx_splice_len == 0) {
 		struct pending_pkt *p = g_queue_pop_head(obex->tx_queue);
 		ssize_t len;
 
@@ -458,7 +504,14 @@ static gboolean write_data(GIOChannel *io, GIOCondition cond,
 		}
 
 encode:
-		len = g_obex_packet_encode(p->pkt, obex->tx_buf, obex->tx_mtu);
+		if (obex->use_splice)
+			len = g_obex_packet_encode_splice(p->pkt, obex->tx_buf,
+							obex->tx_mtu,
+							&obex->tx_splice_fd,
+							&obex->tx_splice_len);
+		else
+			len = g_obex_packet_encode(p->pkt, obex->tx_buf,
+								obex->tx_mtu);
 		if (len == -EAGAIN) {
 			g_queue_push_head(obex->tx_queue, p);
 			g_obex_suspend(obex);
@@ -484,7 +537,8 @@ encode:
 			pending_pkt_free(p);
 		}
 
-		obex->tx_data = len;
+		/* Spliced body data is sent after the encoded part */
+		obex->tx_data = len - obex->tx_splice_len;
 		obex->tx_sent = 0;
 	}
 
@@ -493,16 +547,40 @@ encode:
 		return FALSE;
 	}
 
-	if (!obex->write(obex, NULL))
+	if (obex->tx_data > 0 && !obex->write(obex, NULL))
 		goto stop_tx;
 
+	if (obex->tx_data == 0 && obex->tx_splice_len > 0 &&
+						!write_splice(obex)) {
+		/*
+		 * The packet header announcing the full body is already out,
+		 * so the peer can't find the next packet anymore. Shut the
+		 * transport down and let incoming_data report the disconnect.
+		 */
+		shutdown(g_io_channel_unix_get_fd(obex->io), SHUT_RDWR);
+		goto stop_tx;
+	}
+
+	/*
+	 * With SRM the peer doesn't answer each packet, so keep writing
+	 * while the socket accepts data, up to srm_depth packets per
+	 * wakeup so that an incoming SRMP wait is still noticed in time.
+	 */
+	if (obex->tx_data == 0 && obex->tx_splice_len == 0 &&
+				++depth < obex->srm_depth &&
+				g_queue_get_length(obex->tx_queue) > 0 &&
+				g_obex_srm_active(obex))
+		goto next;
+
 done:
-	if (obex->tx_data > 0 || g_queue_get_length(obex->tx_queue) > 0)
+	if (obex->tx_data > 0 || obex->tx_splice_len > 0 ||
+				g_queue_get_length(obex->tx_queue) > 0)
 		return TRUE;
 
 stop_tx:
 	obex->rx_last_op = G_OBEX_OP_NONE;
 	obex->tx_data = 0;
+	obex->tx_splice_len = 0;
 	obex->write_source = 0;
 	return FALSE;
 }
@@ -875,6 +953,23 @@ gboolean g_obex_send_rsp(GObex *obex, guint8 rspcode, GError **err,
 	return g_obex_send(obex, rsp, err);
 }
 
+void g_obex_set_srm_depth(GObex *obex, guint depth)
+{
+	g_obex_debug(G_OBEX_DEBUG_COMMAND, "depth %u", depth);
+
+	obex->srm_depth = depth > 0 ? depth : 1;
+}
+
+guint16 g_obex_get_rx_mtu(GObex *obex)
+{
+	return obex->rx_mtu;
+}
+
+guint16 g_obex_get_tx_mtu(GObex *obex)
+{
+	return obex->tx_mtu;
+}
+
 void g_obex_set_disconnect_function(GObex *obex, GObexFunc func,
 							gpointer user_data)
 {
@@ -1005,7 +1100,8 @@ void g_obex_resume(GObex *obex)
 		g_obex_srm_resume(obex);
 
 done:
-	if (g_queue_get_length(obex->tx_queue) > 0 || obex->tx_data > 0)
+	if (g_queue_get_length(obex->tx_queue) > 0 || obex->tx_data > 0 ||
+						obex->tx_splice_len > 0)
 		enable_tx(obex);
 }
 
@@ -1476,6 +1572,7 @@ GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
 		obex->rx_mtu = io_rx_mtu;
 
 	obex->tx_mtu = G_OBEX_MINIMUM_MTU;
+	obex->srm_depth = G_OBEX_DEFAULT_DEPTH;
 
 	obex->tx_queue = g_queue_new();
 	obex->rx_buf = g_malloc(obex->rx_mtu);
@@ -1483,6 +1580,10 @@ GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
 
 	switch (transport_type) {
 	case G_OBEX_TRANSPORT_STREAM:
+		/* Body data from files can only be sent directly to the
+		 * socket when the packet doesn't need a single write.
+		 */
+		obex->use_splice = TRUE;
 		obex->read = read_stream;
 		obex->write = write_stream;
 		break;
@@ -63,6 +63,9 @@ gboolean g_obex_remove_request_function(GObex *obex, guint id);
 void g_obex_suspend(GObex *obex);
 void g_obex_resume(GObex *obex);
 gboolean g_obex_srm_active(GObex *obex);
+void g_obex_set_srm_depth(GObex *obex, guint depth);
+guint16 g_obex_get_rx_mtu(GObex *obex);
+guint16 g_obex_get_tx_mtu(GObex *obex);
 void g_obex_drop_tx_queue(GObex *obex);
 
 GObex *g_obex_new(GIOChannel *io, GObexTransportType transport_type,
@@ -109,6 +112,10 @@ guint g_obex_put_req_pkt(GObex *obex, GObexPacket *req,
 			GObexDataProducer data_func, GObexFunc complete_func,
 			gpointer user_data, GError **err);
 
+guint g_obex_put_req_pkt_fd(GObex *obex, GObexPacket *req, int fd,
+			GObexFdProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err);
+
 guint g_obex_get_req(GObex *obex, GObexDataConsumer data_func,
 			GObexFunc complete_func, gpointer user_data,
 			GError **err, guint first_hdr_id, ...);
@@ -130,6 +137,10 @@ guint g_obex_get_rsp_pkt(GObex *obex, GObexPacket *rsp,
 			GObexDataProducer data_func, GObexFunc complete_func,
 			gpointer user_data, GError **err);
 
+guint g_obex_get_rsp_pkt_fd(GObex *obex, GObexPacket *rsp, int fd,
+			GObexFdProducer data_func, GObexFunc complete_func,
+			gpointer user_data, GError **err);
+
 gboolean g_obex_cancel_transfer(guint id, GObexFunc complete_func,
 							gpointer user_data);
 
@@ -0,0 +1,187 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#include "src/shared/util.h"
+#include "src/shared/btsnoop.h"
+
+#include "batch.h"
+
+#define BATCH_CONTROL_SIZE (CMSG_SPACE(sizeof(struct timeval)) + \
+					CMSG_SPACE(sizeof(struct ucred)) + \
+					CMSG_SPACE(sizeof(uint32_t)))
+
+struct batch_hdr {
+	uint16_t opcode;
+	uint16_t index;
+	uint16_t len;
+} __attribute__((packed));
+
+struct batch {
+	struct mmsghdr msgs[BATCH_SIZE];
+	struct iovec iov[BATCH_SIZE][2];
+	struct batch_hdr hdr[BATCH_SIZE];
+	unsigned char control[BATCH_SIZE][BATCH_CONTROL_SIZE];
+	unsigned char buf[BATCH_SIZE][BTSNOOP_MAX_PACKET_SIZE];
+	struct timeval tv;
+	struct ucred cred;
+	uint32_t ovfl;
+	bool single;
+};
+
+struct batch *batch_new(void)
+{
+	struct batch *batch;
+	unsigned int i;
+
+	batch = malloc(sizeof(*batch));
+	if (!batch)
+		return NULL;
+
+	memset(batch, 0, sizeof(*batch));
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		struct msghdr *msg = &batch->msgs[i].msg_hdr;
+
+		batch->iov[i][0].iov_base = &batch->hdr[i];
+		batch->iov[i][0].iov_len = sizeof(struct batch_hdr);
+		batch->iov[i][1].iov_base = batch->buf[i];
+		batch->iov[i][1].iov_len = BTSNOOP_MAX_PACKET_SIZE;
+
+		msg->msg_iov = batch->iov[i];
+		msg->msg_iovlen = 2;
+		msg->msg_control = batch->control[i];
+	}
+
+	return batch;
+}
+
+void batch_free(struct batch *batch)
+{
+	free(batch);
+}
+
+static int read_error(void)
+{
+	if (errno == EAGAIN || errno == EINTR)
+		return 0;
+
+	return -errno;
+}
+
+/*
+ * Returns the number of packets received, 0 when there is nothing left
+ * to read and a negative error otherwise.
+ */
+int batch_read(struct batch *batch, int fd)
+{
+	unsigned int i;
+	ssize_t len;
+	int count;
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		batch->msgs[i].msg_hdr.msg_controllen = BATCH_CONTROL_SIZE;
+		batch->msgs[i].msg_len = 0;
+	}
+
+	if (!batch->single) {
+		count = recvmmsg(fd, batch->msgs, BATCH_SIZE, MSG_DONTWAIT,
+									NULL);
+		if (count >= 0)
+			return count;
+
+		if (errno != ENOSYS && errno != EINVAL)
+			return read_error();
+
+		/* Kernels without recvmmsg support receive one at a time */
+		batch->single = true;
+	}
+
+	len = recvmsg(fd, &batch->msgs[0].msg_hdr, MSG_DONTWAIT);
+	if (len < 0)
+		return read_error();
+
+	batch->msgs[0].msg_len = len;
+
+	return 1;
+}
+
+bool batch_get(struct batch *batch, unsigned int i, struct batch_packet *pkt)
+{
+	struct msghdr *msg;
+	struct cmsghdr *cmsg;
+	uint32_t ovfl;
+
+	if (i >= BATCH_SIZE)
+		return false;
+
+	if (batch->msgs[i].msg_len < sizeof(struct batch_hdr))
+		return false;
+
+	memset(pkt, 0, sizeof(*pkt));
+
+	msg = &batch->msgs[i].msg_hdr;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+					cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+
+		switch (cmsg->cmsg_type) {
+		case SCM_TIMESTAMP:
+			memcpy(&batch->tv, CMSG_DATA(cmsg), sizeof(batch->tv));
+			pkt->tv = &batch->tv;
+			break;
+		case SCM_CREDENTIALS:
+			memcpy(&batch->cred, CMSG_DATA(cmsg),
+							sizeof(batch->cred));
+			pkt->cred = &batch->cred;
+			break;
+		case SO_RXQ_OVFL:
+			memcpy(&ovfl, CMSG_DATA(cmsg), sizeof(ovfl));
+			pkt->drops = ovfl - batch->ovfl;
+			batch->ovfl = ovfl;
+			break;
+		}
+	}
+
+	pkt->opcode = le16_to_cpu(batch->hdr[i].opcode);
+	pkt->index = le16_to_cpu(batch->hdr[i].index);
+	pkt->len = le16_to_cpu(batch->hdr[i].len);
+	pkt->data = batch->buf[i];
+
+	if (pkt->len > batch->msgs[i].msg_len - sizeof(struct batch_hdr))
+		return false;
+
+	return true;
+}
@@ -0,0 +1,53 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct timeval;
+struct ucred;
+
+/*
+ * Batched receive for HCI monitor and control channel sockets. Packets
+ * are read with recvmmsg(), or one at a time with recvmsg() when the
+ * kernel doesn't support it.
+ */
+#define BATCH_SIZE 32
+
+struct batch;
+
+struct batch_packet {
+	struct timeval *tv;
+	struct ucred *cred;
+	uint32_t drops;
+	uint16_t opcode;
+	uint16_t index;
+	uint16_t len;
+	const void *data;
+};
+
+struct batch *batch_new(void);
+void batch_free(struct batch *batch);
+
+int batch_read(struct batch *batch, int fd);
+bool batch_get(struct batch *batch, unsigned int i, struct batch_packet *pkt);
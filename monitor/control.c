@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -48,6 +49,7 @@
 #include "lib/mgmt.h"
 
 #include "src/shared/util.h"
+#include "src/shared/queue.h"
 #include "src/shared/btsnoop.h"
 #include "src/shared/mainloop.h"
 
@@ -58,6 +60,7 @@
 #include "tty.h"
 #include "control.h"
 #include "jlink.h"
+#include "batch.h"
 
 static struct btsnoop *btsnoop_file = NULL;
 static bool hcidump_fallback = false;
@@ -69,14 +72,23 @@ struct control_data {
 	int fd;
 	unsigned char buf[BTSNOOP_MAX_PACKET_SIZE];
 	uint16_t offset;
+	struct batch *batch;
 };
 
+static struct {
+	uint64_t packets;
+	uint64_t batches;
+	unsigned int max_batch;
+	uint64_t drops;
+} monitor_stats;
+
 static void free_data(void *user_data)
 {
 	struct control_data *data = user_data;
 
 	close(data->fd);
 
+	batch_free(data->batch);
 	free(data);
 }
 
@@ -913,80 +925,553 @@ void control_message(uint16_t opcode, const void *data, uint16_t size)
 	}
 }
 
+#define FILTER_TYPE(opcode)	(1U << (opcode))
+
+#define FILTER_DATA_TYPES	(FILTER_TYPE(BTSNOOP_OPCODE_COMMAND_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_EVENT_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_ACL_TX_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_ACL_RX_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_SCO_TX_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_SCO_RX_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_ISO_TX_PKT) | \
+				FILTER_TYPE(BTSNOOP_OPCODE_ISO_RX_PKT))
+
+static struct {
+	uint32_t types;
+	bool handle;
+	uint16_t handle_val;
+	bool opcode;
+	uint16_t opcode_min;
+	uint16_t opcode_max;
+	bool cid;
+	uint16_t cid_val;
+	bool kernel;
+} data_filter = {
+	.types = FILTER_DATA_TYPES,
+};
+
+/* L2CAP channel ids are only present in the first fragment of a frame,
+ * so remember per connection handle whether the frame currently being
+ * reassembled matched.
+ */
+struct cid_match {
+	uint16_t index;
+	uint8_t handles[4096 / 8];
+};
+
+static struct queue *cid_matches;
+
+static const struct {
+	const char *str;
+	uint32_t types;
+} filter_type_table[] = {
+	{ "cmd", FILTER_TYPE(BTSNOOP_OPCODE_COMMAND_PKT)		},
+	{ "evt", FILTER_TYPE(BTSNOOP_OPCODE_EVENT_PKT)			},
+	{ "acl", FILTER_TYPE(BTSNOOP_OPCODE_ACL_TX_PKT) |
+			FILTER_TYPE(BTSNOOP_OPCODE_ACL_RX_PKT)		},
+	{ "sco", FILTER_TYPE(BTSNOOP_OPCODE_SCO_TX_PKT) |
+			FILTER_TYPE(BTSNOOP_OPCODE_SCO_RX_PKT)		},
+	{ "iso", FILTER_TYPE(BTSNOOP_OPCODE_ISO_TX_PKT) |
+			FILTER_TYPE(BTSNOOP_OPCODE_ISO_RX_PKT)		},
+	{ }
+};
+
+static bool parse_filter_value(const char *str, uint16_t *val)
+{
+	unsigned long tmp;
+	char *end;
+
+	tmp = strtoul(str, &end, 0);
+	if (end == str || (*end != '\0' && *end != '-') || tmp > 0xffff)
+		return false;
+
+	*val = tmp;
+
+	return true;
+}
+
+static bool parse_filter_term(const char *term, uint32_t *show,
+							uint32_t *hide)
+{
+	const char *str;
+	bool negate = false;
+	int i;
+
+	if (!strncmp(term, "handle=", 7)) {
+		if (!parse_filter_value(term + 7, &data_filter.handle_val) ||
+				data_filter.handle_val > 0x0fff)
+			return false;
+
+		data_filter.handle = true;
+		return true;
+	}
+
+	if (!strncmp(term, "opcode=", 7)) {
+		str = term + 7;
+
+		if (!parse_filter_value(str, &data_filter.opcode_min))
+			return false;
+
+		str = strchr(str, '-');
+		if (str) {
+			if (!parse_filter_value(str + 1,
+						&data_filter.opcode_max))
+				return false;
+		} else
+			data_filter.opcode_max = data_filter.opcode_min;
+
+		if (data_filter.opcode_min > data_filter.opcode_max)
+			return false;
+
+		data_filter.opcode = true;
+		return true;
+	}
+
+	if (!strncmp(term, "cid=", 4)) {
+		if (!parse_filter_value(term + 4, &data_filter.cid_val))
+			return false;
+
+		data_filter.cid = true;
+		return true;
+	}
+
+	if (term[0] == '!') {
+		negate = true;
+		term++;
+	}
+
+	for (i = 0; filter_type_table[i].str; i++) {
+		if (strcmp(filter_type_table[i].str, term))
+			continue;
+
+		if (negate)
+			*hide |= filter_type_table[i].types;
+		else
+			*show |= filter_type_table[i].types;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool control_filter_expr(const char *expr)
+{
+	uint32_t show = 0, hide = 0;
+	char *str, *term, *saveptr = NULL;
+	bool result = true;
+
+	str = strdup(expr);
+	if (!str)
+		return false;
+
+	for (term = strtok_r(str, ",", &saveptr); term;
+				term = strtok_r(NULL, ",", &saveptr)) {
+		if (!parse_filter_term(term, &show, &hide)) {
+			fprintf(stderr, "Invalid filter term: %s\n", term);
+			result = false;
+			break;
+		}
+	}
+
+	free(str);
+
+	if (!result)
+		return false;
+
+	data_filter.types = (show ? show : FILTER_DATA_TYPES) & ~hide;
+
+	return true;
+}
+
+static bool filter_active(void)
+{
+	return data_filter.types != FILTER_DATA_TYPES || data_filter.handle ||
+					data_filter.opcode || data_filter.cid;
+}
+
+static bool match_cid_index(const void *data, const void *user_data)
+{
+	const struct cid_match *cid = data;
+
+	return cid->index == PTR_TO_UINT(user_data);
+}
+
+static bool filter_match_cid(uint16_t index, const uint8_t *data,
+								uint16_t size)
+{
+	struct cid_match *cid;
+	uint16_t handle, flags;
+	uint8_t *match;
+
+	if (size < 2)
+		return true;
+
+	cid = queue_find(cid_matches, match_cid_index, UINT_TO_PTR(index));
+	if (!cid) {
+		if (!cid_matches)
+			cid_matches = queue_new();
+
+		cid = new0(struct cid_match, 1);
+		cid->index = index;
+		queue_push_tail(cid_matches, cid);
+	}
+
+	handle = acl_handle(get_le16(data));
+	flags = acl_flags(get_le16(data)) & 0x03;
+	match = &cid->handles[handle / 8];
+
+	/* Continuation fragment follows the fate of its first fragment */
+	if (flags == 0x01)
+		return *match & (1 << (handle % 8));
+
+	if (size < 8 || get_le16(data + 6) != data_filter.cid_val) {
+		*match &= ~(1 << (handle % 8));
+		return false;
+	}
+
+	*match |= 1 << (handle % 8);
+
+	return true;
+}
+
+static bool filter_match(uint16_t index, uint16_t opcode,
+					const uint8_t *data, uint16_t size)
+{
+	uint16_t val;
+
+	if (opcode >= 32 || !(FILTER_DATA_TYPES & FILTER_TYPE(opcode)))
+		return true;
+
+	if (data_filter.cid && (opcode == BTSNOOP_OPCODE_ACL_TX_PKT ||
+				opcode == BTSNOOP_OPCODE_ACL_RX_PKT) &&
+				!filter_match_cid(index, data, size))
+		return false;
+
+	/* The remaining predicates have already been applied by the socket
+	 * filter when it could be attached.
+	 */
+	if (data_filter.kernel)
+		return true;
+
+	if (!(data_filter.types & FILTER_TYPE(opcode)))
+		return false;
+
+	if (data_filter.handle && opcode >= BTSNOOP_OPCODE_ACL_TX_PKT &&
+				opcode <= BTSNOOP_OPCODE_SCO_RX_PKT) {
+		if (size < 2)
+			return false;
+
+		if (acl_handle(get_le16(data)) != data_filter.handle_val)
+			return false;
+	}
+
+	if (!data_filter.opcode)
+		return true;
+
+	switch (opcode) {
+	case BTSNOOP_OPCODE_COMMAND_PKT:
+		if (size < 2)
+			return false;
+		val = get_le16(data);
+		break;
+	case BTSNOOP_OPCODE_EVENT_PKT:
+		if (size >= 5 && data[0] == EVT_CMD_COMPLETE)
+			val = get_le16(data + 3);
+		else if (size >= 6 && data[0] == EVT_CMD_STATUS)
+			val = get_le16(data + 4);
+		else
+			return true;
+		break;
+	default:
+		return true;
+	}
+
+	return val >= data_filter.opcode_min && val <= data_filter.opcode_max;
+}
+
+#define MAX_FILTER_INSNS	64
+
+enum {
+	LABEL_ACCEPT,
+	LABEL_REJECT,
+	LABEL_HANDLE_NEXT,
+	LABEL_OPCODE_NEXT,
+	LABEL_EVENT,
+	LABEL_CMD_COMPLETE,
+	LABEL_CMD_STATUS,
+	LABEL_COMMAND,
+	LABEL_CHECK,
+	LABEL_MAX,
+};
+
+#define LABEL_NONE	0xff
+
+struct filter_prog {
+	struct sock_filter insns[MAX_FILTER_INSNS];
+	uint8_t jt_label[MAX_FILTER_INSNS];
+	uint8_t jf_label[MAX_FILTER_INSNS];
+	int label[LABEL_MAX];
+	unsigned int len;
+	bool overflow;
+};
+
+static void prog_emit(struct filter_prog *prog, uint16_t code, uint32_t k,
+						uint8_t jt, uint8_t jf)
+{
+	struct sock_filter insn = BPF_JUMP(code, k, 0, 0);
+
+	if (prog->len >= MAX_FILTER_INSNS) {
+		prog->overflow = true;
+		return;
+	}
+
+	prog->insns[prog->len] = insn;
+	prog->jt_label[prog->len] = jt;
+	prog->jf_label[prog->len] = jf;
+	prog->len++;
+}
+
+#define prog_stmt(prog, code, k) \
+	prog_emit(prog, code, k, LABEL_NONE, LABEL_NONE)
+
+static void prog_label(struct filter_prog *prog, int label)
+{
+	prog->label[label] = prog->len;
+}
+
+static bool prog_resolve(struct filter_prog *prog)
+{
+	unsigned int i;
+
+	if (prog->overflow)
+		return false;
+
+	for (i = 0; i < prog->len; i++) {
+		struct sock_filter *insn = &prog->insns[i];
+		int target;
+
+		if (insn->code == (BPF_JMP | BPF_JA)) {
+			target = prog->label[prog->jt_label[i]];
+			insn->k = target - (i + 1);
+			continue;
+		}
+
+		if (prog->jt_label[i] != LABEL_NONE) {
+			target = prog->label[prog->jt_label[i]] - (i + 1);
+			if (target < 0 || target > 0xff)
+				return false;
+			insn->jt = target;
+		}
+
+		if (prog->jf_label[i] != LABEL_NONE) {
+			target = prog->label[prog->jf_label[i]] - (i + 1);
+			if (target < 0 || target > 0xff)
+				return false;
+			insn->jf = target;
+		}
+	}
+
+	return true;
+}
+
+/* Load the 16-bit little endian value at offset X + k into A */
+static void prog_load_le16(struct filter_prog *prog, uint32_t k)
+{
+	prog_stmt(prog, BPF_LD | BPF_B | BPF_IND, k + 1);
+	prog_stmt(prog, BPF_ALU | BPF_LSH | BPF_K, 8);
+	prog_stmt(prog, BPF_ST, 1);
+	prog_stmt(prog, BPF_LD | BPF_B | BPF_IND, k);
+	prog_stmt(prog, BPF_LDX | BPF_W | BPF_MEM, 1);
+	prog_stmt(prog, BPF_ALU | BPF_OR | BPF_X, 0);
+}
+
+static void build_opcode_filter(struct filter_prog *prog)
+{
+	const uint32_t hdr = MGMT_HDR_SIZE;
+
+	prog_stmt(prog, BPF_LD | BPF_W | BPF_MEM, 0);
+	prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, BTSNOOP_OPCODE_COMMAND_PKT,
+						LABEL_COMMAND, LABEL_EVENT);
+
+	/* Command Complete and Command Status carry the command opcode */
+	prog_label(prog, LABEL_EVENT);
+	prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, BTSNOOP_OPCODE_EVENT_PKT,
+						LABEL_NONE, LABEL_OPCODE_NEXT);
+	prog_stmt(prog, BPF_LD | BPF_B | BPF_ABS, hdr);
+	prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, EVT_CMD_COMPLETE,
+					LABEL_CMD_COMPLETE, LABEL_NONE);
+	prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, EVT_CMD_STATUS,
+					LABEL_CMD_STATUS, LABEL_OPCODE_NEXT);
+
+	prog_label(prog, LABEL_CMD_COMPLETE);
+	prog_stmt(prog, BPF_LDX | BPF_W | BPF_IMM, hdr + 3);
+	prog_emit(prog, BPF_JMP | BPF_JA, 0, LABEL_CHECK, LABEL_NONE);
+
+	prog_label(prog, LABEL_CMD_STATUS);
+	prog_stmt(prog, BPF_LDX | BPF_W | BPF_IMM, hdr + 4);
+	prog_emit(prog, BPF_JMP | BPF_JA, 0, LABEL_CHECK, LABEL_NONE);
+
+	prog_label(prog, LABEL_COMMAND);
+	prog_stmt(prog, BPF_LDX | BPF_W | BPF_IMM, hdr);
+
+	prog_label(prog, LABEL_CHECK);
+	prog_load_le16(prog, 0);
+	prog_emit(prog, BPF_JMP | BPF_JGE | BPF_K, data_filter.opcode_min,
+						LABEL_NONE, LABEL_REJECT);
+	prog_emit(prog, BPF_JMP | BPF_JGT | BPF_K, data_filter.opcode_max,
+						LABEL_REJECT, LABEL_OPCODE_NEXT);
+
+	prog_label(prog, LABEL_OPCODE_NEXT);
+}
+
+static bool build_filter(struct filter_prog *prog, uint16_t index)
+{
+	uint16_t handle;
+	int op;
+
+	memset(prog, 0, sizeof(*prog));
+
+	/* Packets not bound to a controller always pass, all others need
+	 * to match the selected index.
+	 */
+	if (index != HCI_DEV_NONE) {
+		prog_stmt(prog, BPF_LD | BPF_H | BPF_ABS,
+					offsetof(struct mgmt_hdr, index));
+		prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, HCI_DEV_NONE,
+						LABEL_ACCEPT, LABEL_NONE);
+		prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, bswap_16(index),
+						LABEL_NONE, LABEL_REJECT);
+	}
+
+	/* M[0] <- monitor opcode */
+	prog_stmt(prog, BPF_LDX | BPF_W | BPF_IMM, 0);
+	prog_load_le16(prog, offsetof(struct mgmt_hdr, opcode));
+	prog_stmt(prog, BPF_ST, 0);
+
+	for (op = 0; op < 32; op++) {
+		if (!(FILTER_DATA_TYPES & FILTER_TYPE(op)) ||
+					(data_filter.types & FILTER_TYPE(op)))
+			continue;
+
+		prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, op,
+						LABEL_REJECT, LABEL_NONE);
+	}
+
+	if (data_filter.handle) {
+		/* Halfword loads are big endian, so compare against the
+		 * byte swapped handle with the flags masked out.
+		 */
+		handle = bswap_16(data_filter.handle_val);
+
+		prog_emit(prog, BPF_JMP | BPF_JGE | BPF_K,
+					BTSNOOP_OPCODE_ACL_TX_PKT,
+					LABEL_NONE, LABEL_HANDLE_NEXT);
+		prog_emit(prog, BPF_JMP | BPF_JGT | BPF_K,
+					BTSNOOP_OPCODE_SCO_RX_PKT,
+					LABEL_HANDLE_NEXT, LABEL_NONE);
+		prog_stmt(prog, BPF_LD | BPF_H | BPF_ABS, MGMT_HDR_SIZE);
+		prog_stmt(prog, BPF_ALU | BPF_AND | BPF_K, 0xff0f);
+		prog_emit(prog, BPF_JMP | BPF_JEQ | BPF_K, handle,
+					LABEL_HANDLE_NEXT, LABEL_REJECT);
+		prog_label(prog, LABEL_HANDLE_NEXT);
+	}
+
+	if (data_filter.opcode)
+		build_opcode_filter(prog);
+
+	prog_label(prog, LABEL_ACCEPT);
+	prog_stmt(prog, BPF_RET | BPF_K, 0x0fffffff);
+	prog_label(prog, LABEL_REJECT);
+	prog_stmt(prog, BPF_RET | BPF_K, 0);
+
+	return prog_resolve(prog);
+}
+
+static void attach_filter(int fd, uint16_t index)
+{
+	struct filter_prog prog;
+	struct sock_fprog fprog;
+
+	if (!build_filter(&prog, index)) {
+		fprintf(stderr, "Failed to build socket filter\n");
+		return;
+	}
+
+	fprog.len = prog.len;
+	fprog.filter = prog.insns;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+							sizeof(fprog)) < 0) {
+		perror("Failed to attach socket filter");
+		return;
+	}
+
+	data_filter.kernel = true;
+}
+
 static void data_callback(int fd, uint32_t events, void *user_data)
 {
 	struct control_data *data = user_data;
-	unsigned char control[64];
-	struct mgmt_hdr hdr;
-	struct msghdr msg;
-	struct iovec iov[2];
+	struct batch_packet pkt;
+	int i, count;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		mainloop_remove_fd(data->fd);
 		return;
 	}
 
-	iov[0].iov_base = &hdr;
-	iov[0].iov_len = MGMT_HDR_SIZE;
-	iov[1].iov_base = data->buf;
-	iov[1].iov_len = sizeof(data->buf);
-
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
-	msg.msg_control = control;
-	msg.msg_controllen = sizeof(control);
-
 	while (1) {
-		struct cmsghdr *cmsg;
-		struct timeval *tv = NULL;
-		struct timeval ctv;
-		struct ucred *cred = NULL;
-		struct ucred ccred;
-		uint16_t opcode, index, pktlen;
-		ssize_t len;
+		count = batch_read(data->batch, data->fd);
+		if (count < 0) {
+			fprintf(stderr, "Failed to read channel: %s\n",
+							strerror(-count));
+			mainloop_remove_fd(data->fd);
+			return;
+		}
 
-		len = recvmsg(data->fd, &msg, MSG_DONTWAIT);
-		if (len < 0)
+		if (!count)
 			break;
 
-		if (len < MGMT_HDR_SIZE)
-			break;
+		if (data->channel == HCI_CHANNEL_MONITOR) {
+			monitor_stats.batches++;
+			monitor_stats.packets += count;
+			if ((unsigned int) count > monitor_stats.max_batch)
+				monitor_stats.max_batch = count;
+		}
 
-		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
-					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-			if (cmsg->cmsg_level != SOL_SOCKET)
+		for (i = 0; i < count; i++) {
+			if (!batch_get(data->batch, i, &pkt))
 				continue;
 
-			if (cmsg->cmsg_type == SCM_TIMESTAMP) {
-				memcpy(&ctv, CMSG_DATA(cmsg), sizeof(ctv));
-				tv = &ctv;
-			}
-
-			if (cmsg->cmsg_type == SCM_CREDENTIALS) {
-				memcpy(&ccred, CMSG_DATA(cmsg), sizeof(ccred));
-				cred = &ccred;
+			switch (data->channel) {
+			case HCI_CHANNEL_CONTROL:
+				packet_control(pkt.tv, pkt.cred, pkt.index,
+						pkt.opcode, pkt.data, pkt.len);
+				break;
+			case HCI_CHANNEL_MONITOR:
+				if (pkt.drops) {
+					monitor_stats.drops += pkt.drops;
+					printf("* Drops: %u\n", pkt.drops);
+				}
+
+				if (!filter_match(pkt.index, pkt.opcode,
+							pkt.data, pkt.len))
+					break;
+
+				btsnoop_write_hci(btsnoop_file, pkt.tv,
+						pkt.index, pkt.opcode,
+						pkt.drops, pkt.data, pkt.len);
+				ellisys_inject_hci(pkt.tv, pkt.index,
+						pkt.opcode, pkt.data, pkt.len);
+				packet_monitor(pkt.tv, pkt.cred, pkt.index,
+						pkt.opcode, pkt.data, pkt.len);
+				break;
 			}
 		}
 
-		opcode = le16_to_cpu(hdr.opcode);
-		index  = le16_to_cpu(hdr.index);
-		pktlen = le16_to_cpu(hdr.len);
-
-		switch (data->channel) {
-		case HCI_CHANNEL_CONTROL:
-			packet_control(tv, cred, index, opcode,
-							data->buf, pktlen);
+		if (count < BATCH_SIZE)
 			break;
-		case HCI_CHANNEL_MONITOR:
-			btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0,
-							data->buf, pktlen);
-			ellisys_inject_hci(tv, index, opcode,
-							data->buf, pktlen);
-			packet_monitor(tv, cred, index, opcode,
-							data->buf, pktlen);
-			break;
-		}
 	}
 }
 
@@ -1030,38 +1515,10 @@ static int open_socket(uint16_t channel)
 		return -1;
 	}
 
-	return fd;
-}
+	/* Kernel drop counter is optional */
+	setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
 
-static void attach_index_filter(int fd, uint16_t index)
-{
-	struct sock_filter filters[] = {
-		/* Load MGMT index:
-		 * A <- MGMT index
-		 */
-		BPF_STMT(BPF_LD + BPF_B + BPF_ABS,
-					offsetof(struct mgmt_hdr, index)),
-		/* Accept if index is HCI_DEV_NONE:
-		 * A == HCI_DEV_NONE
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, HCI_DEV_NONE, 0, 1),
-		/* return */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		/* Accept if index match:
-		 * A == index
-		 */
-		BPF_JUMP(BPF_JMP + BPF_JEQ + BPF_K, index, 0, 1),
-		/* returns */
-		BPF_STMT(BPF_RET|BPF_K, 0x0fffffff), /* pass */
-		BPF_STMT(BPF_RET|BPF_K, 0), /* reject */
-	};
-	struct sock_fprog fprog = {
-		.len = sizeof(filters) / sizeof(filters[0]),
-		/* casting const away: */
-		.filter = filters,
-	};
-
-	setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+	return fd;
 }
 
 static int open_channel(uint16_t channel)
@@ -1075,14 +1532,22 @@ static int open_channel(uint16_t channel)
 	memset(data, 0, sizeof(*data));
 	data->channel = channel;
 
+	data->batch = batch_new();
+	if (!data->batch) {
+		free(data);
+		return -1;
+	}
+
 	data->fd = open_socket(channel);
 	if (data->fd < 0) {
+		batch_free(data->batch);
 		free(data);
 		return -1;
 	}
 
-	if (filter_index != HCI_DEV_NONE)
-		attach_index_filter(data->fd, filter_index);
+	if (channel == HCI_CHANNEL_MONITOR &&
+			(filter_index != HCI_DEV_NONE || filter_active()))
+		attach_filter(data->fd, filter_index);
 
 	mainloop_add_fd(data->fd, EPOLLIN, data_callback, data, free_data);
 
@@ -1560,6 +2025,18 @@ int control_tracing(void)
 	return 0;
 }
 
+void control_print_stats(void)
+{
+	if (!monitor_stats.batches)
+		return;
+
+	printf("* Monitor: %" PRIu64 " packets in %" PRIu64 " reads "
+			"(avg %.1f max %u per read), %" PRIu64 " dropped\n",
+			monitor_stats.packets, monitor_stats.batches,
+			(double) monitor_stats.packets / monitor_stats.batches,
+			monitor_stats.max_batch, monitor_stats.drops);
+}
+
 void control_disable_decoding(void)
 {
 	decode_control = false;
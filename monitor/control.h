@@ -30,7 +30,9 @@ void control_server(const char *path);
 int control_tty(const char *path, unsigned int speed);
 int control_rtt(char *jlink, char *rtt);
 int control_tracing(void);
+void control_print_stats(void);
 void control_disable_decoding(void);
 void control_filter_index(uint16_t index);
+bool control_filter_expr(const char *expr);
 
 void control_message(uint16_t opcode, const void *data, uint16_t size);
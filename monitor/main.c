@@ -66,6 +66,9 @@ static void usage(void)
 		"\t-s, --server <socket>  Start monitor server socket\n"
 		"\t-p, --priority <level> Show only priority or lower\n"
 		"\t-i, --index <num>      Show only specified controller\n"
+		"\t-F, --filter <expr>    Filter packets in the kernel\n"
+		"\t                       [!]cmd|evt|acl|sco|iso, handle=<num>,\n"
+		"\t                       opcode=<num>[-<num>], cid=<num>\n"
 		"\t-d, --tty <tty>        Read data from TTY\n"
 		"\t-B, --tty-speed <rate> Set TTY speed (default 115200)\n"
 		"\t-V, --vendor <compid>  Set default company identifier\n"
@@ -90,6 +93,7 @@ static const struct option main_options[] = {
 	{ "server",    required_argument, NULL, 's' },
 	{ "priority",  required_argument, NULL, 'p' },
 	{ "index",     required_argument, NULL, 'i' },
+	{ "filter",    required_argument, NULL, 'F' },
 	{ "tty",       required_argument, NULL, 'd' },
 	{ "tty-speed", required_argument, NULL, 'B' },
 	{ "vendor",    required_argument, NULL, 'V' },
@@ -113,6 +117,7 @@ int main(int argc, char *argv[])
 	unsigned long filter_mask = 0;
 	bool use_pager = true;
 	const char *reader_path = NULL;
+	bool filter_expr = false;
 	const char *writer_path = NULL;
 	const char *analyze_path = NULL;
 	const char *ellisys_server = NULL;
@@ -132,7 +137,7 @@ int main(int argc, char *argv[])
 		int opt;
 		struct sockaddr_un addr;
 
-		opt = getopt_long(argc, argv, "r:w:a:s:p:i:d:B:V:MtTSAE:PJ:R:vh",
+		opt = getopt_long(argc, argv, "r:w:a:s:p:i:F:d:B:V:MtTSAE:PJ:R:vh",
 							main_options, NULL);
 		if (opt < 0)
 			break;
@@ -168,6 +173,13 @@ int main(int argc, char *argv[])
 			}
 			packet_select_index(atoi(str));
 			break;
+		case 'F':
+			if (!control_filter_expr(optarg)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			filter_expr = true;
+			break;
 		case 'd':
 			tty = optarg;
 			break;
@@ -238,6 +250,12 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	/* Filter expressions only apply to the live monitor socket */
+	if (filter_expr && (reader_path || analyze_path)) {
+		fprintf(stderr, "Filter can't be combined with read or analyze\n");
+		return EXIT_FAILURE;
+	}
+
 	printf("Bluetooth monitor ver %s\n", VERSION);
 
 	keys_setup();
@@ -276,6 +294,8 @@ int main(int argc, char *argv[])
 
 	exit_status = mainloop_run_with_signal(signal_callback, NULL);
 
+	control_print_stats();
+
 	keys_cleanup();
 
 	return exit_status;
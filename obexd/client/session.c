@@ -49,6 +49,8 @@
 #define ERROR_INTERFACE "org.bluez.obex.Error"
 #define SESSION_BASEPATH "/org/bluez/obex/client"
 
+#define SESSION_STREAM_MTU 32767
+
 #define OBEX_IO_ERROR obex_io_error_quark()
 #define OBEX_IO_ERROR_FIRST (0xff + 1)
 
@@ -381,10 +383,13 @@ static void transport_func(GIOChannel *io, GError *err, gpointer user_data)
 	if (transport->getpacketopt &&
 			transport->getpacketopt(io, &tx_mtu, &rx_mtu) == 0)
 		type = G_OBEX_TRANSPORT_PACKET;
-	else
+	else {
+		/* Stream transports have no MTU of their own */
 		type = G_OBEX_TRANSPORT_STREAM;
+		rx_mtu = SESSION_STREAM_MTU;
+	}
 
-	obex = g_obex_new(io, type, tx_mtu, rx_mtu);
+	obex = g_obex_new(io, type, rx_mtu, tx_mtu);
 	if (obex == NULL)
 		goto done;
 
@@ -761,6 +761,31 @@ static gssize put_xfer_progress(void *buf, gsize len, gpointer user_data)
 	return size;
 }
 
+static gssize put_xfer_splice(gsize len, gpointer user_data)
+{
+	struct obc_transfer *transfer = user_data;
+	gssize size;
+
+	size = MIN((gint64) len, transfer->size - transfer->transferred);
+	if (size <= 0)
+		return 0;
+
+	transfer->transferred += size;
+
+	return size;
+}
+
+static gboolean transfer_can_splice(struct obc_transfer *transfer)
+{
+	struct stat st;
+
+	if (transfer->fd < 0 || fstat(transfer->fd, &st) < 0)
+		return FALSE;
+
+	/* Only the size of regular files is known upfront */
+	return S_ISREG(st.st_mode) && st.st_size == transfer->size;
+}
+
 gboolean obc_transfer_set_callback(struct obc_transfer *transfer,
 					transfer_callback_t func,
 					void *user_data)
@@ -874,7 +899,12 @@ static gboolean transfer_start_put(struct obc_transfer *transfer, GError **err)
 		g_obex_packet_add_header(req, hdr);
 	}
 
-	transfer->xfer = g_obex_put_req_pkt(transfer->obex, req,
+	if (transfer_can_splice(transfer))
+		transfer->xfer = g_obex_put_req_pkt_fd(transfer->obex, req,
+					transfer->fd, put_xfer_splice,
+					xfer_complete, transfer, err);
+	else
+		transfer->xfer = g_obex_put_req_pkt(transfer->obex, req,
 					put_xfer_progress, xfer_complete,
 					transfer, err);
 	if (transfer->xfer == 0)
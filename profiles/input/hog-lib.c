@@ -30,12 +30,14 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <glib.h>
 
@@ -78,7 +80,9 @@
 
 #define HOG_REPORT_MAP_MAX_SIZE        512
 #define HID_INFO_SIZE			4
-#define ATT_NOTIFICATION_HEADER_SIZE	3
+
+/* Number of input reports latency statistics are reported for */
+#define HOG_LATENCY_REPORTS		1000
 
 struct bt_hog {
 	int			ref_count;
@@ -108,6 +112,13 @@ struct bt_hog {
 	struct queue		*bas;
 	GSList			*instances;
 	struct queue		*gatt_op;
+	unsigned int		notify_id;
+	uint16_t		notify_start;
+	uint16_t		notify_count;
+	struct report		**notify_map;	/* Indexed by value handle */
+	unsigned int		latency_count;
+	uint64_t		latency_total;
+	uint64_t		latency_max;
 };
 
 struct report {
@@ -118,7 +129,6 @@ struct report {
 	uint16_t		value_handle;
 	uint8_t			properties;
 	uint16_t		ccc_handle;
-	guint			notifyid;
 	uint16_t		len;
 	uint8_t			*value;
 };
@@ -289,42 +299,127 @@ static void find_included(struct bt_hog *hog, GAttrib *attrib,
 	free(req);
 }
 
-static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
+static uint64_t get_usec(void)
 {
-	struct report *report = user_data;
-	struct bt_hog *hog = report->hog;
-	struct uhid_event ev;
-	uint8_t *buf;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void update_latency(struct bt_hog *hog, uint64_t start)
+{
+	uint64_t latency = get_usec() - start;
+
+	hog->latency_total += latency;
+	if (latency > hog->latency_max)
+		hog->latency_max = latency;
+
+	if (++hog->latency_count < HOG_LATENCY_REPORTS)
+		return;
+
+	DBG("%u input reports: %" PRIu64 " us average, %" PRIu64 " us max",
+			hog->latency_count,
+			hog->latency_total / hog->latency_count,
+			hog->latency_max);
+
+	hog->latency_count = 0;
+	hog->latency_total = 0;
+	hog->latency_max = 0;
+}
+
+static void report_notify_cb(struct bt_att_chan *chan, uint8_t opcode,
+					const void *pdu, uint16_t length,
+					void *user_data)
+{
+	struct bt_hog *hog = user_data;
+	struct report *report;
+	uint64_t start;
+	uint16_t index;
 	int err;
 
-	if (len < ATT_NOTIFICATION_HEADER_SIZE) {
+	if (length < 2) {
 		error("Malformed ATT notification");
 		return;
 	}
 
-	pdu += ATT_NOTIFICATION_HEADER_SIZE;
-	len -= ATT_NOTIFICATION_HEADER_SIZE;
+	start = get_usec();
 
-	memset(&ev, 0, sizeof(ev));
-	ev.type = UHID_INPUT;
-	buf = ev.u.input.data;
-
-	if (hog->has_report_id) {
-		buf[0] = report->id;
-		len = MIN(len, sizeof(ev.u.input.data) - 1);
-		memcpy(buf + 1, pdu, len);
-		ev.u.input.size = ++len;
-	} else {
-		len = MIN(len, sizeof(ev.u.input.data));
-		memcpy(buf, pdu, len);
-		ev.u.input.size = len;
-	}
+	index = get_le16(pdu) - hog->notify_start;
+	if (index >= hog->notify_count)
+		return;
 
-	err = bt_uhid_send(hog->uhid, &ev);
+	report = hog->notify_map[index];
+	if (!report)
+		return;
+
+	err = bt_uhid_input(hog->uhid, hog->has_report_id ? report->id : 0,
+						pdu + 2, length - 2);
 	if (err < 0) {
-		error("bt_uhid_send: %s (%d)", strerror(-err), -err);
+		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
 		return;
 	}
+
+	update_latency(hog, start);
+}
+
+static void report_notify_enable(struct report *report)
+{
+	struct bt_hog *hog = report->hog;
+	struct bt_att *att = g_attrib_get_att(hog->attrib);
+	uint16_t start, end;
+	struct report **map;
+
+	if (!hog->notify_id) {
+		hog->notify_id = bt_att_register(att, BT_ATT_OP_HANDLE_NFY,
+							report_notify_cb,
+							hog, NULL);
+		if (!hog->notify_id) {
+			error("Unable to register for notifications");
+			return;
+		}
+	}
+
+	start = report->value_handle;
+	end = report->value_handle;
+
+	if (hog->notify_count) {
+		start = MIN(start, hog->notify_start);
+		end = MAX(end, hog->notify_start + hog->notify_count - 1);
+	}
+
+	/* Grow the map to cover the handle range of all reports */
+	if (start != hog->notify_start ||
+				end - start + 1 != hog->notify_count) {
+		map = new0(struct report *, end - start + 1);
+
+		if (hog->notify_count)
+			memcpy(map + hog->notify_start - start,
+					hog->notify_map,
+					hog->notify_count * sizeof(*map));
+
+		free(hog->notify_map);
+		hog->notify_map = map;
+		hog->notify_start = start;
+		hog->notify_count = end - start + 1;
+	}
+
+	hog->notify_map[report->value_handle - start] = report;
+}
+
+static void report_notify_disable(struct bt_hog *hog)
+{
+	if (hog->notify_id) {
+		bt_att_unregister(g_attrib_get_att(hog->attrib),
+							hog->notify_id);
+		hog->notify_id = 0;
+	}
+
+	free(hog->notify_map);
+	hog->notify_map = NULL;
+	hog->notify_start = 0;
+	hog->notify_count = 0;
 }
 
 static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
@@ -332,7 +427,6 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 {
 	struct gatt_request *req = user_data;
 	struct report *report = req->user_data;
-	struct bt_hog *hog = report->hog;
 
 	destroy_gatt_req(req);
 
@@ -342,10 +436,7 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 		return;
 	}
 
-	report->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					report->value_handle,
-					report_value_cb, report, NULL);
+	report_notify_enable(report);
 
 	DBG("Report characteristic descriptor written: notifications enabled");
 }
@@ -1625,14 +1716,8 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 		return true;
 	}
 
-	for (l = hog->reports; l; l = l->next) {
-		struct report *r = l->data;
-
-		r->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					r->value_handle,
-					report_value_cb, r, NULL);
-	}
+	for (l = hog->reports; l; l = l->next)
+		report_notify_enable(l->data);
 
 	return true;
 }
@@ -1652,14 +1737,7 @@ void bt_hog_detach(struct bt_hog *hog)
 		bt_hog_detach(instance);
 	}
 
-	for (l = hog->reports; l; l = l->next) {
-		struct report *r = l->data;
-
-		if (r->notifyid > 0) {
-			g_attrib_unregister(hog->attrib, r->notifyid);
-			r->notifyid = 0;
-		}
-	}
+	report_notify_disable(hog);
 
 	if (hog->scpp)
 		bt_scpp_detach(hog->scpp);
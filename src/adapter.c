@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/file.h>
 #include <sys/stat.h>
@@ -87,6 +88,7 @@
 #define MODE_UNKNOWN		0xff
 
 #define CONN_SCAN_TIMEOUT (3)
+#define CONN_CANDIDATE_AGE (2000)
 #define IDLE_DISCOV_TIMEOUT (5)
 #define TEMP_DEV_TIMEOUT (3 * 60)
 #define BONDING_TIMEOUT (2 * 60)
@@ -265,8 +267,19 @@ struct btd_adapter {
 	bool pincode_requested;		/* PIN requested during last bonding */
 	GSList *connections;		/* Connected devices */
 	GSList *devices;		/* Devices structure pointers */
+	unsigned int devices_count;	/* Length of devices */
+	GQueue *temporary;		/* Temporary devices, oldest seen first */
+	GHashTable *temporary_links;	/* Device to its temporary link */
+	guint temporary_sweep_id;	/* Temporary devices expiry sweep */
+	unsigned int devices_peak;	/* Largest number of devices */
+	unsigned int temporary_evicted;	/* Temporary devices over the cap */
 	GSList *connect_list;		/* Devices to connect when found */
 	struct btd_device *connect_le;	/* LE device waiting to be connected */
+	struct btd_device *connecting_le; /* LE connection attempt in flight */
+	GSList *reconnects;		/* Devices waiting to reconnect */
+	int64_t reconnect_start;	/* First device of the current batch */
+	int64_t reconnect_max;		/* Slowest reconnect of the batch */
+	unsigned int reconnect_count;	/* Devices reconnected in the batch */
 	sdp_list_t *services;		/* Services associated to adapter */
 
 	struct btd_gatt_database *database;
@@ -1186,17 +1199,166 @@ void adapter_service_remove(struct btd_adapter *adapter, uint32_t handle)
 	remove_record_from_server(rec->handle);
 }
 
+static bool device_can_expire(struct btd_device *device)
+{
+	return device_get_temporary_seen(device) &&
+					!btd_device_is_connected(device);
+}
+
+static gboolean temporary_sweep(gpointer user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	gint64 now = g_get_monotonic_time(), next = 0;
+	gint64 tmpto = (gint64) main_opts.tmpto * G_USEC_PER_SEC;
+	unsigned int removed = 0;
+	GList *l, *tmp;
+
+	adapter->temporary_sweep_id = 0;
+
+	for (l = adapter->temporary->head; l; l = tmp) {
+		struct btd_device *device = l->data;
+		gint64 expire;
+
+		tmp = g_list_next(l);
+
+		if (!device_can_expire(device))
+			continue;
+
+		expire = device_get_temporary_seen(device) + tmpto;
+
+		/* Devices are ordered by last seen, the rest expire later */
+		if (expire > now) {
+			if (!next || expire < next)
+				next = expire;
+			break;
+		}
+
+		/* Bonding or connecting, check again once it had the time */
+		if (device_is_busy(device)) {
+			if (!next)
+				next = now + tmpto;
+			continue;
+		}
+
+		btd_adapter_remove_device(adapter, device);
+		removed++;
+	}
+
+	if (removed)
+		DBG("hci%u %u temporary devices expired", adapter->dev_id,
+								removed);
+
+	/* Round up so the next sweep doesn't fire just short of expiry */
+	if (next)
+		adapter->temporary_sweep_id = g_timeout_add_seconds(
+				(next - now + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC,
+				temporary_sweep, adapter);
+
+	return FALSE;
+}
+
+static void temporary_unlink(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	GList *link;
+
+	link = g_hash_table_lookup(adapter->temporary_links, device);
+	if (!link)
+		return;
+
+	g_queue_delete_link(adapter->temporary, link);
+	g_hash_table_remove(adapter->temporary_links, device);
+}
+
+void adapter_update_temporary_device(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	GList *link;
+
+	if (!device_get_temporary_seen(device)) {
+		temporary_unlink(adapter, device);
+		return;
+	}
+
+	/* Monotonic time only grows so the last seen device goes last */
+	link = g_hash_table_lookup(adapter->temporary_links, device);
+	if (link) {
+		g_queue_unlink(adapter->temporary, link);
+	} else {
+		link = g_list_alloc();
+		link->data = device;
+		g_hash_table_insert(adapter->temporary_links, device, link);
+	}
+
+	g_queue_push_tail_link(adapter->temporary, link);
+
+	/*
+	 * A pending sweep already fires at the earliest expiry, which is
+	 * never later than that of a device that has just been seen.
+	 */
+	if (adapter->temporary_sweep_id)
+		return;
+
+	adapter->temporary_sweep_id = g_timeout_add_seconds(main_opts.tmpto,
+							temporary_sweep, adapter);
+}
+
+static void evict_temporary_device(struct btd_adapter *adapter)
+{
+	struct btd_device *oldest = NULL;
+	GList *l;
+
+	/* Make room for the device about to be created */
+	if (g_queue_get_length(adapter->temporary) < main_opts.tmp_max)
+		return;
+
+	for (l = adapter->temporary->head; l; l = g_list_next(l)) {
+		struct btd_device *device = l->data;
+
+		/* Devices being bonded or connected are about to be used */
+		if (!device_can_expire(device) || device_is_busy(device))
+			continue;
+
+		oldest = device;
+		break;
+	}
+
+	if (!oldest)
+		return;
+
+	adapter->temporary_evicted++;
+
+	DBG("hci%u evicting %s (%u evicted, peak %u devices)",
+				adapter->dev_id, device_get_path(oldest),
+				adapter->temporary_evicted,
+				adapter->devices_peak);
+
+	btd_adapter_remove_device(adapter, oldest);
+}
+
+static void adapter_add_device(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	adapter->devices = g_slist_append(adapter->devices, device);
+
+	if (++adapter->devices_count > adapter->devices_peak)
+		adapter->devices_peak = adapter->devices_count;
+}
+
 static struct btd_device *adapter_create_device(struct btd_adapter *adapter,
 						const bdaddr_t *bdaddr,
 						uint8_t bdaddr_type)
 {
 	struct btd_device *device;
 
+	if (main_opts.tmp_max)
+		evict_temporary_device(adapter);
+
 	device = device_create(adapter, bdaddr, bdaddr_type);
 	if (!device)
 		return NULL;
 
-	adapter->devices = g_slist_append(adapter->devices, device);
+	adapter_add_device(adapter, device);
 
 	return device;
 }
@@ -1224,14 +1386,122 @@ static void service_auth_cancel(struct service_auth *auth)
 	g_free(auth);
 }
 
+struct reconnect {
+	struct btd_device *device;
+	int64_t start;			/* When the device went away */
+	int64_t seen;			/* Last connectable advertisement */
+	int8_t rssi;
+};
+
+static struct reconnect *reconnect_find(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	GSList *l;
+
+	for (l = adapter->reconnects; l; l = g_slist_next(l)) {
+		struct reconnect *r = l->data;
+
+		if (r->device == device)
+			return r;
+	}
+
+	return NULL;
+}
+
+/*
+ * Track how long each device of the connect list takes to come back, and
+ * how long the whole batch takes, e.g. after bluetoothd or the controller
+ * restarted.
+ */
+static void reconnect_start(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	struct reconnect *r;
+
+	if (btd_device_is_connected(device) ||
+					reconnect_find(adapter, device))
+		return;
+
+	r = g_new0(struct reconnect, 1);
+	r->device = device;
+	r->start = g_get_monotonic_time();
+	r->rssi = HCI_RSSI_INVALID;
+
+	if (!adapter->reconnects) {
+		adapter->reconnect_start = r->start;
+		adapter->reconnect_max = 0;
+		adapter->reconnect_count = 0;
+	}
+
+	adapter->reconnects = g_slist_prepend(adapter->reconnects, r);
+}
+
+static void reconnect_seen(struct btd_adapter *adapter,
+				struct btd_device *device, int8_t rssi)
+{
+	struct reconnect *r;
+
+	r = reconnect_find(adapter, device);
+	if (!r)
+		return;
+
+	r->seen = g_get_monotonic_time();
+	r->rssi = rssi;
+}
+
+static void reconnect_done(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	struct reconnect *r;
+	int64_t now, latency;
+
+	r = reconnect_find(adapter, device);
+	if (!r)
+		return;
+
+	adapter->reconnects = g_slist_remove(adapter->reconnects, r);
+
+	/* The ATT channel may be up before the connected event arrives */
+	if (btd_device_is_connected(device) ||
+				btd_device_get_gatt_client(device)) {
+		now = g_get_monotonic_time();
+		latency = (now - r->start) / 1000;
+
+		DBG("%s reconnected in %" PRId64 " ms",
+					device_get_path(device), latency);
+
+		adapter->reconnect_count++;
+		if (latency > adapter->reconnect_max)
+			adapter->reconnect_max = latency;
+
+		if (!adapter->reconnects)
+			btd_info(adapter->dev_id, "%u devices reconnected in "
+					"%" PRId64 " ms, slowest %" PRId64 " ms",
+					adapter->reconnect_count,
+					(now - adapter->reconnect_start) / 1000,
+					adapter->reconnect_max);
+	}
+
+	g_free(r);
+}
+
 void btd_adapter_remove_device(struct btd_adapter *adapter,
 				struct btd_device *dev)
 {
+	GSList *list;
 	GList *l;
 
 	adapter->connect_list = g_slist_remove(adapter->connect_list, dev);
 
-	adapter->devices = g_slist_remove(adapter->devices, dev);
+	reconnect_done(adapter, dev);
+
+	list = g_slist_find(adapter->devices, dev);
+	if (list) {
+		adapter->devices = g_slist_delete_link(adapter->devices, list);
+		adapter->devices_count--;
+	}
+
+	temporary_unlink(adapter, dev);
 
 	adapter->discovery_found = g_slist_remove(adapter->discovery_found,
 									dev);
@@ -1241,6 +1511,9 @@ void btd_adapter_remove_device(struct btd_adapter *adapter,
 	if (adapter->connect_le == dev)
 		adapter->connect_le = NULL;
 
+	if (adapter->connecting_le == dev)
+		adapter->connecting_le = NULL;
+
 	l = adapter->auths->head;
 	while (l != NULL) {
 		struct service_auth *auth = l->data;
@@ -1413,7 +1686,10 @@ static void stop_passive_scanning_complete(uint8_t status, uint16_t length,
 		btd_error(adapter->dev_id, "LE auto connection failed: %s (%d)",
 							strerror(-err), -err);
 		trigger_passive_scanning(adapter);
+		return;
 	}
+
+	adapter->connecting_le = dev;
 }
 
 static void stop_passive_scanning(struct btd_adapter *adapter)
@@ -1437,6 +1713,111 @@ static void stop_passive_scanning(struct btd_adapter *adapter)
 			stop_passive_scanning_complete, adapter, NULL);
 }
 
+struct reconnect_pick {
+	struct btd_adapter *adapter;
+	int64_t now;
+	struct reconnect *best;
+	int best_score;
+};
+
+static void pick_reconnect(gpointer data, gpointer user_data)
+{
+	struct reconnect *r = data;
+	struct reconnect_pick *pick = user_data;
+	int64_t age;
+	int score;
+
+	if (!r->seen || r->rssi == HCI_RSSI_INVALID)
+		return;
+
+	age = (pick->now - r->seen) / 1000;
+	if (age > CONN_CANDIDATE_AGE)
+		return;
+
+	if (btd_device_is_connected(r->device) ||
+			!g_slist_find(pick->adapter->connect_list, r->device))
+		return;
+
+	/* Every 100 ms since the last advertisement cost as much as 1 dB */
+	score = r->rssi - age / 100;
+
+	if (!pick->best || score > pick->best_score) {
+		pick->best = r;
+		pick->best_score = score;
+	}
+}
+
+/*
+ * Without kernel background scanning only one connection attempt can be
+ * outstanding at a time. Rather than resuming passive scanning and waiting
+ * for the next advertisement after each attempt, go straight for the best
+ * device among those advertising while the previous attempt was ongoing.
+ */
+static bool connect_next(struct btd_adapter *adapter)
+{
+	struct reconnect_pick pick;
+	struct btd_device *dev;
+	int err;
+
+	if (kernel_conn_control || adapter->connect_le ||
+			adapter->connecting_le || adapter->discovery_list)
+		return false;
+
+	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
+		return false;
+
+	memset(&pick, 0, sizeof(pick));
+	pick.adapter = adapter;
+	pick.now = g_get_monotonic_time();
+
+	g_slist_foreach(adapter->reconnects, pick_reconnect, &pick);
+	if (!pick.best)
+		return false;
+
+	dev = pick.best->device;
+
+	DBG("%s rssi %d", device_get_path(dev), pick.best->rssi);
+
+	/* Each advertisement is only good for a single attempt */
+	pick.best->seen = 0;
+
+	if (adapter->discovery_enable == 0x01) {
+		adapter->connect_le = dev;
+		stop_passive_scanning(adapter);
+		return true;
+	}
+
+	err = device_connect_le(dev);
+	if (err < 0) {
+		btd_error(adapter->dev_id, "LE auto connection failed: %s (%d)",
+							strerror(-err), -err);
+		return false;
+	}
+
+	adapter->connecting_le = dev;
+
+	return true;
+}
+
+/*
+ * Called once the connection attempt to the device either succeeded or
+ * failed, the controller is then free for the next one.
+ */
+void adapter_connect_le_complete(struct btd_adapter *adapter,
+						struct btd_device *device)
+{
+	if (!device || adapter->connecting_le != device)
+		return;
+
+	adapter->connecting_le = NULL;
+
+	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
+		return;
+
+	if (!connect_next(adapter))
+		trigger_passive_scanning(adapter);
+}
+
 static void cancel_passive_scanning(struct btd_adapter *adapter)
 {
 	if (!(adapter->current_settings & MGMT_SETTING_LE))
@@ -3300,6 +3681,8 @@ static void device_connect_cb(GIOChannel *io, GError *gerr, gpointer user_data)
 	if (!device)
 		goto failed;
 
+	device_export(device);
+
 	path = device_get_path(device);
 
 	g_dbus_send_reply(dbus_conn, data->msg, DBUS_TYPE_OBJECT_PATH, &path,
@@ -3372,6 +3755,7 @@ static DBusMessage *connect_device(DBusConnection *conn,
 					DBusMessage *msg, void *user_data)
 {
 	struct btd_adapter *adapter = user_data;
+	struct btd_device *device;
 	DBusMessageIter iter, subiter, dictiter, value;
 	uint8_t addr_type = BDADDR_BREDR;
 	bdaddr_t addr = *BDADDR_ANY;
@@ -3440,13 +3824,47 @@ static DBusMessage *connect_device(DBusConnection *conn,
 	if (!bacmp(&addr, BDADDR_ANY))
 		return btd_error_invalid_args(msg);
 
-	if (btd_adapter_find_device(adapter, &addr, addr_type))
+	/* Devices without an object are unknown to the caller */
+	device = btd_adapter_find_device(adapter, &addr, addr_type);
+	if (device && device_is_exported(device))
 		return btd_error_already_exists(msg);
 
 	device_connect(adapter, &addr, addr_type, msg);
 	return NULL;
 }
 
+static DBusMessage *get_device(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct btd_adapter *adapter = user_data;
+	struct btd_device *device;
+	const char *address, *path;
+	GSList *l;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &address,
+							DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	if (bachk(address) < 0)
+		return btd_error_invalid_args(msg);
+
+	l = g_slist_find_custom(adapter->devices, address,
+							device_address_cmp);
+	if (!l)
+		return btd_error_does_not_exist(msg);
+
+	device = l->data;
+
+	device_export(device);
+	if (!device_is_exported(device))
+		return btd_error_failed(msg, "Unable to export device");
+
+	path = device_get_path(device);
+
+	return g_dbus_create_reply(msg, DBUS_TYPE_OBJECT_PATH, &path,
+							DBUS_TYPE_INVALID);
+}
+
 static const GDBusMethodTable adapter_methods[] = {
 	{ GDBUS_ASYNC_METHOD("StartDiscovery", NULL, NULL, start_discovery) },
 	{ GDBUS_METHOD("SetDiscoveryFilter",
@@ -3461,6 +3879,10 @@ static const GDBusMethodTable adapter_methods[] = {
 	{ GDBUS_EXPERIMENTAL_ASYNC_METHOD("ConnectDevice",
 				GDBUS_ARGS({ "properties", "a{sv}" }), NULL,
 				connect_device) },
+	{ GDBUS_EXPERIMENTAL_METHOD("GetDevice",
+				GDBUS_ARGS({ "address", "s" }),
+				GDBUS_ARGS({ "device", "o" }),
+				get_device) },
 	{ }
 };
 
@@ -3823,6 +4245,154 @@ static int set_privacy(struct btd_adapter *adapter, uint8_t privacy)
 	return -1;
 }
 
+/*
+ * Load commands are built in place while walking the storage directory.
+ * Each command replaces the whole list in the kernel so all entries must
+ * go in a single command, which is capped by the 16-bit parameter length.
+ */
+struct load_cmd {
+	uint8_t *buf;
+	size_t hdr_len;
+	size_t entry_len;
+	size_t count;
+	size_t alloc;
+	size_t max;
+	bool truncated;
+};
+
+static void load_cmd_init(struct load_cmd *cmd, size_t hdr_len,
+							size_t entry_len)
+{
+	memset(cmd, 0, sizeof(*cmd));
+
+	cmd->hdr_len = hdr_len;
+	cmd->entry_len = entry_len;
+	cmd->max = (UINT16_MAX - hdr_len) / entry_len;
+}
+
+static void *load_cmd_add(struct load_cmd *cmd)
+{
+	uint8_t *entry;
+
+	if (cmd->count == cmd->max) {
+		cmd->truncated = true;
+		return NULL;
+	}
+
+	if (cmd->count == cmd->alloc) {
+		size_t alloc = cmd->alloc ? cmd->alloc * 2 : 16;
+		uint8_t *buf;
+
+		alloc = MIN(alloc, cmd->max);
+
+		buf = g_try_realloc(cmd->buf, cmd->hdr_len +
+						alloc * cmd->entry_len);
+		if (!buf) {
+			cmd->truncated = true;
+			return NULL;
+		}
+
+		cmd->buf = buf;
+		cmd->alloc = alloc;
+	}
+
+	entry = cmd->buf + cmd->hdr_len + cmd->count++ * cmd->entry_len;
+	memset(entry, 0, cmd->entry_len);
+
+	return entry;
+}
+
+static void *load_cmd_finish(struct load_cmd *cmd, size_t *len)
+{
+	if (!cmd->buf) {
+		cmd->buf = g_try_malloc(cmd->hdr_len);
+		if (!cmd->buf)
+			return NULL;
+	}
+
+	memset(cmd->buf, 0, cmd->hdr_len);
+
+	*len = cmd->hdr_len + cmd->count * cmd->entry_len;
+
+	return cmd->buf;
+}
+
+static size_t load_cmd_size(struct load_cmd *cmd)
+{
+	if (!cmd->buf)
+		return 0;
+
+	return cmd->hdr_len + cmd->alloc * cmd->entry_len;
+}
+
+static void load_cmd_free(struct load_cmd *cmd)
+{
+	g_free(cmd->buf);
+	cmd->buf = NULL;
+}
+
+static void add_link_key(struct load_cmd *cmd, struct link_key_info *info)
+{
+	struct mgmt_link_key_info *key;
+
+	key = load_cmd_add(cmd);
+	if (!key)
+		return;
+
+	bacpy(&key->addr.bdaddr, &info->bdaddr);
+	key->addr.type = BDADDR_BREDR;
+	key->type = info->type;
+	memcpy(key->val, info->key, 16);
+	key->pin_len = info->pin_len;
+}
+
+static void add_ltk(struct load_cmd *cmd, struct smp_ltk_info *info)
+{
+	struct mgmt_ltk_info *key;
+
+	key = load_cmd_add(cmd);
+	if (!key)
+		return;
+
+	bacpy(&key->addr.bdaddr, &info->bdaddr);
+	key->addr.type = info->bdaddr_type;
+	memcpy(key->val, info->val, sizeof(info->val));
+	key->rand = cpu_to_le64(info->rand);
+	key->ediv = cpu_to_le16(info->ediv);
+	key->type = info->authenticated;
+	key->master = info->master;
+	key->enc_size = info->enc_size;
+}
+
+static void add_irk(struct load_cmd *cmd, struct irk_info *info)
+{
+	struct mgmt_irk_info *irk;
+
+	irk = load_cmd_add(cmd);
+	if (!irk)
+		return;
+
+	bacpy(&irk->addr.bdaddr, &info->bdaddr);
+	irk->addr.type = info->bdaddr_type;
+	memcpy(irk->val, info->val, sizeof(irk->val));
+}
+
+static void add_conn_param(struct load_cmd *cmd, struct conn_param *info)
+{
+	struct mgmt_conn_param *param;
+
+	param = load_cmd_add(cmd);
+	if (!param)
+		return;
+
+	bacpy(&param->addr.bdaddr, &info->bdaddr);
+	param->addr.type = info->bdaddr_type;
+	param->min_interval = htobs(info->min_interval);
+	param->max_interval = htobs(info->max_interval);
+	param->latency = htobs(info->latency);
+	param->timeout = htobs(info->timeout);
+}
+
 static void load_link_keys_complete(uint8_t status, uint16_t length,
 					const void *param, void *user_data)
 {
@@ -3838,14 +4408,12 @@ static void load_link_keys_complete(uint8_t status, uint16_t length,
 	DBG("link keys loaded for hci%u", adapter->dev_id);
 }
 
-static void load_link_keys(struct btd_adapter *adapter, GSList *keys,
+static void load_link_keys(struct btd_adapter *adapter, struct load_cmd *keys,
 							bool debug_keys)
 {
 	struct mgmt_cp_load_link_keys *cp;
-	struct mgmt_link_key_info *key;
-	size_t key_count, cp_size;
+	size_t cp_size;
 	unsigned int id;
-	GSList *l;
 
 	/*
 	 * If the controller does not support BR/EDR operation,
@@ -3857,20 +4425,20 @@ static void load_link_keys(struct btd_adapter *adapter, GSList *keys,
 	if (!(adapter->supported_settings & MGMT_SETTING_BREDR))
 		return;
 
-	key_count = g_slist_length(keys);
-
-	DBG("hci%u keys %zu debug_keys %d", adapter->dev_id, key_count,
+	DBG("hci%u keys %zu debug_keys %d", adapter->dev_id, keys->count,
 								debug_keys);
 
-	cp_size = sizeof(*cp) + (key_count * sizeof(*key));
-
-	cp = g_try_malloc0(cp_size);
+	cp = load_cmd_finish(keys, &cp_size);
 	if (cp == NULL) {
 		btd_error(adapter->dev_id, "No memory for link keys for hci%u",
 							adapter->dev_id);
 		return;
 	}
 
+	if (keys->truncated)
+		btd_warn(adapter->dev_id, "Only %zu link keys loaded for hci%u",
+						keys->count, adapter->dev_id);
+
 	/*
 	 * Even if the list of stored keys is empty, it is important to
 	 * load an empty list into the kernel. That way it is ensured
@@ -3880,24 +4448,12 @@ static void load_link_keys(struct btd_adapter *adapter, GSList *keys,
 	 * behavior for debug keys.
 	 */
 	cp->debug_keys = debug_keys;
-	cp->key_count = htobs(key_count);
-
-	for (l = keys, key = cp->keys; l != NULL; l = g_slist_next(l), key++) {
-		struct link_key_info *info = l->data;
-
-		bacpy(&key->addr.bdaddr, &info->bdaddr);
-		key->addr.type = BDADDR_BREDR;
-		key->type = info->type;
-		memcpy(key->val, info->key, 16);
-		key->pin_len = info->pin_len;
-	}
+	cp->key_count = htobs(keys->count);
 
 	id = mgmt_send(adapter->mgmt, MGMT_OP_LOAD_LINK_KEYS,
 				adapter->dev_id, cp_size, cp,
 				load_link_keys_complete, adapter, NULL);
 
-	g_free(cp);
-
 	if (id == 0)
 		btd_error(adapter->dev_id, "Failed to load link keys for hci%u",
 							adapter->dev_id);
@@ -3937,12 +4493,10 @@ static void load_ltks_complete(uint8_t status, uint16_t length,
 	DBG("LTKs loaded for hci%u", adapter->dev_id);
 }
 
-static void load_ltks(struct btd_adapter *adapter, GSList *keys)
+static void load_ltks(struct btd_adapter *adapter, struct load_cmd *keys)
 {
 	struct mgmt_cp_load_long_term_keys *cp;
-	struct mgmt_ltk_info *key;
-	size_t key_count, cp_size;
-	GSList *l;
+	size_t cp_size;
 
 	/*
 	 * If the controller does not support Low Energy operation,
@@ -3957,46 +4511,31 @@ static void load_ltks(struct btd_adapter *adapter, GSList *keys)
 	if (!(adapter->supported_settings & MGMT_SETTING_LE))
 		return;
 
-	key_count = g_slist_length(keys);
-
-	DBG("hci%u keys %zu", adapter->dev_id, key_count);
-
-	cp_size = sizeof(*cp) + (key_count * sizeof(*key));
+	DBG("hci%u keys %zu", adapter->dev_id, keys->count);
 
-	cp = g_try_malloc0(cp_size);
+	cp = load_cmd_finish(keys, &cp_size);
 	if (cp == NULL) {
 		btd_error(adapter->dev_id, "No memory for LTKs for hci%u",
 							adapter->dev_id);
 		return;
 	}
 
+	if (keys->truncated)
+		btd_warn(adapter->dev_id, "Only %zu LTKs loaded for hci%u",
+						keys->count, adapter->dev_id);
+
 	/*
 	 * Even if the list of stored keys is empty, it is important to
 	 * load an empty list into the kernel. That way it is ensured
 	 * that no old keys from a previous daemon are present.
 	 */
-	cp->key_count = htobs(key_count);
-
-	for (l = keys, key = cp->keys; l != NULL; l = g_slist_next(l), key++) {
-		struct smp_ltk_info *info = l->data;
-
-		bacpy(&key->addr.bdaddr, &info->bdaddr);
-		key->addr.type = info->bdaddr_type;
-		memcpy(key->val, info->val, sizeof(info->val));
-		key->rand = cpu_to_le64(info->rand);
-		key->ediv = cpu_to_le16(info->ediv);
-		key->type = info->authenticated;
-		key->master = info->master;
-		key->enc_size = info->enc_size;
-	}
+	cp->key_count = htobs(keys->count);
 
 	adapter->load_ltks_id = mgmt_send(adapter->mgmt,
 					MGMT_OP_LOAD_LONG_TERM_KEYS,
 					adapter->dev_id, cp_size, cp,
 					load_ltks_complete, adapter, NULL);
 
-	g_free(cp);
-
 	if (adapter->load_ltks_id == 0) {
 		btd_error(adapter->dev_id, "Failed to load LTKs for hci%u",
 							adapter->dev_id);
@@ -4033,13 +4572,11 @@ static void load_irks_complete(uint8_t status, uint16_t length,
 	DBG("IRKs loaded for hci%u", adapter->dev_id);
 }
 
-static void load_irks(struct btd_adapter *adapter, GSList *irks)
+static void load_irks(struct btd_adapter *adapter, struct load_cmd *irks)
 {
 	struct mgmt_cp_load_irks *cp;
-	struct mgmt_irk_info *irk;
-	size_t irk_count, cp_size;
+	size_t cp_size;
 	unsigned int id;
-	GSList *l;
 
 	/*
 	 * If the controller does not support LE Privacy operation,
@@ -4049,39 +4586,29 @@ static void load_irks(struct btd_adapter *adapter, GSList *irks)
 	if (!(adapter->supported_settings & MGMT_SETTING_PRIVACY))
 		return;
 
-	irk_count = g_slist_length(irks);
-
-	DBG("hci%u irks %zu", adapter->dev_id, irk_count);
+	DBG("hci%u irks %zu", adapter->dev_id, irks->count);
 
-	cp_size = sizeof(*cp) + (irk_count * sizeof(*irk));
-
-	cp = g_try_malloc0(cp_size);
+	cp = load_cmd_finish(irks, &cp_size);
 	if (cp == NULL) {
 		btd_error(adapter->dev_id, "No memory for IRKs for hci%u",
 							adapter->dev_id);
 		return;
 	}
 
+	if (irks->truncated)
+		btd_warn(adapter->dev_id, "Only %zu IRKs loaded for hci%u",
+						irks->count, adapter->dev_id);
+
 	/*
 	 * Even if the list of stored keys is empty, it is important to
 	 * load an empty list into the kernel. That way we tell the
 	 * kernel that we are able to handle New IRK events.
 	 */
-	cp->irk_count = htobs(irk_count);
-
-	for (l = irks, irk = cp->irks; l != NULL; l = g_slist_next(l), irk++) {
-		struct irk_info *info = l->data;
-
-		bacpy(&irk->addr.bdaddr, &info->bdaddr);
-		irk->addr.type = info->bdaddr_type;
-		memcpy(irk->val, info->val, sizeof(irk->val));
-	}
+	cp->irk_count = htobs(irks->count);
 
 	id = mgmt_send(adapter->mgmt, MGMT_OP_LOAD_IRKS, adapter->dev_id,
 			cp_size, cp, load_irks_complete, adapter, NULL);
 
-	g_free(cp);
-
 	if (id == 0)
 		btd_error(adapter->dev_id, "Failed to IRKs for hci%u",
 							adapter->dev_id);
@@ -4102,13 +4629,12 @@ static void load_conn_params_complete(uint8_t status, uint16_t length,
 	DBG("Connection Parameters loaded for hci%u", adapter->dev_id);
 }
 
-static void load_conn_params(struct btd_adapter *adapter, GSList *params)
+static void load_conn_params(struct btd_adapter *adapter,
+						struct load_cmd *params)
 {
 	struct mgmt_cp_load_conn_param *cp;
-	struct mgmt_conn_param *param;
-	size_t param_count, cp_size;
+	size_t cp_size;
 	unsigned int id;
-	GSList *l;
 
 	/*
 	 * If the controller does not support Low Energy operation,
@@ -4118,37 +4644,25 @@ static void load_conn_params(struct btd_adapter *adapter, GSList *params)
 	if (!(adapter->supported_settings & MGMT_SETTING_LE))
 		return;
 
-	param_count = g_slist_length(params);
-
-	DBG("hci%u conn params %zu", adapter->dev_id, param_count);
-
-	cp_size = sizeof(*cp) + (param_count * sizeof(*param));
+	DBG("hci%u conn params %zu", adapter->dev_id, params->count);
 
-	cp = g_try_malloc0(cp_size);
+	cp = load_cmd_finish(params, &cp_size);
 	if (cp == NULL) {
 		btd_error(adapter->dev_id,
 			"Failed to allocate memory for connection parameters");
 		return;
 	}
 
-	cp->param_count = htobs(param_count);
-
-	for (l = params, param = cp->params; l; l = g_slist_next(l), param++) {
-		struct conn_param *info = l->data;
+	if (params->truncated)
+		btd_warn(adapter->dev_id,
+				"Only %zu connection parameters loaded for hci%u",
+				params->count, adapter->dev_id);
 
-		bacpy(&param->addr.bdaddr, &info->bdaddr);
-		param->addr.type = info->bdaddr_type;
-		param->min_interval = htobs(info->min_interval);
-		param->max_interval = htobs(info->max_interval);
-		param->latency = htobs(info->latency);
-		param->timeout = htobs(info->timeout);
-	}
+	cp->param_count = htobs(params->count);
 
 	id = mgmt_send(adapter->mgmt, MGMT_OP_LOAD_CONN_PARAM, adapter->dev_id,
 			cp_size, cp, load_conn_params_complete, adapter, NULL);
 
-	g_free(cp);
-
 	if (id == 0)
 		btd_error(adapter->dev_id, "Load connection parameters failed");
 }
@@ -4448,14 +4962,16 @@ static void load_default_system_params(struct btd_adapter *adapter)
 static void load_devices(struct btd_adapter *adapter)
 {
 	char dirname[PATH_MAX];
-	GSList *keys = NULL;
-	GSList *ltks = NULL;
-	GSList *irks = NULL;
-	GSList *params = NULL;
+	struct load_cmd keys, ltks, irks, params;
 	GSList *added_devices = NULL;
+	unsigned int count = 0;
+	gint64 start;
+	size_t size;
 	DIR *dir;
 	struct dirent *entry;
 
+	start = g_get_monotonic_time();
+
 	snprintf(dirname, PATH_MAX, STORAGEDIR "/%s",
 					btd_adapter_get_storage_dir(adapter));
 
@@ -4467,6 +4983,15 @@ static void load_devices(struct btd_adapter *adapter)
 		return;
 	}
 
+	load_cmd_init(&keys, sizeof(struct mgmt_cp_load_link_keys),
+					sizeof(struct mgmt_link_key_info));
+	load_cmd_init(&ltks, sizeof(struct mgmt_cp_load_long_term_keys),
+					sizeof(struct mgmt_ltk_info));
+	load_cmd_init(&irks, sizeof(struct mgmt_cp_load_irks),
+					sizeof(struct mgmt_irk_info));
+	load_cmd_init(&params, sizeof(struct mgmt_cp_load_conn_param),
+					sizeof(struct mgmt_conn_param));
+
 	while ((entry = readdir(dir)) != NULL) {
 		struct btd_device *device;
 		char filename[PATH_MAX];
@@ -4492,6 +5017,8 @@ static void load_devices(struct btd_adapter *adapter)
 		key_file = g_key_file_new();
 		g_key_file_load_from_file(key_file, filename, 0, NULL);
 
+		count++;
+
 		key_info = get_key_info(key_file, entry->d_name);
 
 		bdaddr_type = get_le_addr_type(key_file);
@@ -4534,20 +5061,22 @@ static void load_devices(struct btd_adapter *adapter)
 		}
 
 		if (key_info)
-			keys = g_slist_append(keys, key_info);
+			add_link_key(&keys, key_info);
 
 		if (ltk_info)
-			ltks = g_slist_append(ltks, ltk_info);
+			add_ltk(&ltks, ltk_info);
 
 		if (slave_ltk_info)
-			ltks = g_slist_append(ltks, slave_ltk_info);
+			add_ltk(&ltks, slave_ltk_info);
 
 		if (irk_info)
-			irks = g_slist_append(irks, irk_info);
+			add_irk(&irks, irk_info);
 
 		param = get_conn_param(key_file, entry->d_name, bdaddr_type);
-		if (param)
-			params = g_slist_append(params, param);
+		if (param) {
+			add_conn_param(&params, param);
+			g_free(param);
+		}
 
 		list = g_slist_find_custom(adapter->devices, entry->d_name,
 							device_address_cmp);
@@ -4562,7 +5091,7 @@ static void load_devices(struct btd_adapter *adapter)
 			goto free;
 
 		btd_device_set_temporary(device, false);
-		adapter->devices = g_slist_append(adapter->devices, device);
+		adapter_add_device(adapter, device);
 
 		/* TODO: register services from pre-loaded list of primaries */
 
@@ -4587,20 +5116,31 @@ device_exist:
 		}
 
 free:
+		g_free(key_info);
+		g_free(ltk_info);
+		g_free(slave_ltk_info);
+		g_free(irk_info);
 		g_key_file_free(key_file);
 	}
 
 	closedir(dir);
 
-	load_link_keys(adapter, keys, main_opts.debug_keys);
-	g_slist_free_full(keys, g_free);
+	size = load_cmd_size(&keys) + load_cmd_size(&ltks) +
+				load_cmd_size(&irks) + load_cmd_size(&params);
 
-	load_ltks(adapter, ltks);
-	g_slist_free_full(ltks, g_free);
-	load_irks(adapter, irks);
-	g_slist_free_full(irks, g_free);
-	load_conn_params(adapter, params);
-	g_slist_free_full(params, g_free);
+	load_link_keys(adapter, &keys, main_opts.debug_keys);
+	load_cmd_free(&keys);
+
+	load_ltks(adapter, &ltks);
+	load_cmd_free(&ltks);
+	load_irks(adapter, &irks);
+	load_cmd_free(&irks);
+	load_conn_params(adapter, &params);
+	load_cmd_free(&params);
+
+	DBG("hci%u %u devices loaded in %" G_GINT64_FORMAT " ms using %zu bytes",
+				adapter->dev_id, count,
+				(g_get_monotonic_time() - start) / 1000, size);
 
 	g_slist_free_full(added_devices, probe_devices);
 }
@@ -4878,8 +5418,11 @@ int adapter_connect_list_add(struct btd_adapter *adapter,
 	 * adapter_auto_connect_add() function is used to maintain what to
 	 * connect.
 	 */
-	if (kernel_conn_control)
+	if (kernel_conn_control) {
+		if (g_slist_find(adapter->connect_list, device))
+			reconnect_start(adapter, device);
 		return 0;
+	}
 
 	if (g_slist_find(adapter->connect_list, device)) {
 		DBG("ignoring already added device %s",
@@ -4899,10 +5442,13 @@ int adapter_connect_list_add(struct btd_adapter *adapter,
 							adapter->system_name);
 
 done:
+	reconnect_start(adapter, device);
+
 	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
 		return 0;
 
-	trigger_passive_scanning(adapter);
+	if (!connect_next(adapter))
+		trigger_passive_scanning(adapter);
 
 	return 0;
 }
@@ -4918,6 +5464,8 @@ void adapter_connect_list_remove(struct btd_adapter *adapter,
 	if (device == adapter->connect_le)
 		adapter->connect_le = NULL;
 
+	reconnect_done(adapter, device);
+
 	if (kernel_conn_control)
 		return;
 
@@ -4939,7 +5487,8 @@ void adapter_connect_list_remove(struct btd_adapter *adapter,
 	if (!(adapter->current_settings & MGMT_SETTING_POWERED))
 		return;
 
-	trigger_passive_scanning(adapter);
+	if (!connect_next(adapter))
+		trigger_passive_scanning(adapter);
 }
 
 static void add_whitelist_complete(uint8_t status, uint16_t length,
@@ -5104,6 +5653,8 @@ void adapter_auto_connect_add(struct btd_adapter *adapter,
 		return;
 
 	adapter->connect_list = g_slist_append(adapter->connect_list, device);
+
+	reconnect_start(adapter, device);
 }
 
 static void set_device_wakeable_complete(uint8_t status, uint16_t length,
@@ -5251,6 +5802,8 @@ void adapter_auto_connect_remove(struct btd_adapter *adapter,
 		return;
 
 	adapter->connect_list = g_slist_remove(adapter->connect_list, device);
+
+	reconnect_done(adapter, device);
 }
 
 static void adapter_start(struct btd_adapter *adapter)
@@ -5341,6 +5894,11 @@ static void adapter_free(gpointer user_data)
 		adapter->pairable_timeout_id = 0;
 	}
 
+	if (adapter->temporary_sweep_id > 0) {
+		g_source_remove(adapter->temporary_sweep_id);
+		adapter->temporary_sweep_id = 0;
+	}
+
 	if (adapter->passive_scan_timeout > 0) {
 		g_source_remove(adapter->passive_scan_timeout);
 		adapter->passive_scan_timeout = 0;
@@ -5361,6 +5919,9 @@ static void adapter_free(gpointer user_data)
 	g_queue_foreach(adapter->auths, free_service_auth, NULL);
 	g_queue_free(adapter->auths);
 
+	g_hash_table_destroy(adapter->temporary_links);
+	g_queue_free(adapter->temporary);
+
 	/*
 	 * Unregister all handlers for this specific index since
 	 * the adapter bound to them is no longer valid.
@@ -6135,6 +6696,8 @@ static void convert_config(struct btd_adapter *adapter, const char *filename,
 	char address[18];
 	char str[MAX_NAME_LENGTH + 1];
 	char config_path[PATH_MAX];
+	struct textfile *config;
+	const char *value;
 	int timeout;
 	uint8_t mode;
 	char *data;
@@ -6143,22 +6706,32 @@ static void convert_config(struct btd_adapter *adapter, const char *filename,
 	ba2str(&adapter->bdaddr, address);
 	snprintf(config_path, PATH_MAX, STORAGEDIR "/%s/config", address);
 
-	if (read_pairable_timeout(address, &timeout) == 0)
+	config = textfile_open(config_path);
+
+	value = textfile_lookup(config, "pairto");
+	if (value && sscanf(value, "%d", &timeout) == 1)
 		g_key_file_set_integer(key_file, "General",
 						"PairableTimeout", timeout);
 
-	if (read_discoverable_timeout(address, &timeout) == 0)
+	value = textfile_lookup(config, "discovto");
+	if (value && sscanf(value, "%d", &timeout) == 1)
 		g_key_file_set_integer(key_file, "General",
 						"DiscoverableTimeout", timeout);
 
-	if (read_on_mode(address, str, sizeof(str)) == 0) {
-		mode = get_mode(str);
+	value = textfile_lookup(config, "onmode");
+	if (value) {
+		mode = get_mode(value);
 		g_key_file_set_boolean(key_file, "General", "Discoverable",
 					mode == MODE_DISCOVERABLE);
 	}
 
-	if (read_local_name(&adapter->bdaddr, str) == 0)
+	value = textfile_lookup(config, "name");
+	if (value) {
+		snprintf(str, sizeof(str), "%s", value);
 		g_key_file_set_string(key_file, "General", "Alias", str);
+	}
+
+	textfile_close(config);
 
 	create_file(filename, S_IRUSR | S_IWUSR);
 
@@ -6326,6 +6899,9 @@ static struct btd_adapter *btd_adapter_new(uint16_t index)
 	DBG("Pairable timeout: %u seconds", adapter->pairable_timeout);
 
 	adapter->auths = g_queue_new();
+	adapter->temporary = g_queue_new();
+	adapter->temporary_links = g_hash_table_new(g_direct_hash,
+							g_direct_equal);
 
 	return btd_adapter_ref(adapter);
 }
@@ -6340,11 +6916,23 @@ static void adapter_remove(struct btd_adapter *adapter)
 	g_slist_free(adapter->connect_list);
 	adapter->connect_list = NULL;
 
+	g_slist_free_full(adapter->reconnects, g_free);
+	adapter->reconnects = NULL;
+
 	for (l = adapter->devices; l; l = l->next)
 		device_remove(l->data, FALSE);
 
 	g_slist_free(adapter->devices);
 	adapter->devices = NULL;
+	adapter->devices_count = 0;
+
+	g_hash_table_remove_all(adapter->temporary_links);
+	g_queue_clear(adapter->temporary);
+
+	if (adapter->temporary_sweep_id > 0) {
+		g_source_remove(adapter->temporary_sweep_id);
+		adapter->temporary_sweep_id = 0;
+	}
 
 	discovery_cleanup(adapter, 0);
 
@@ -6727,6 +7315,14 @@ static void update_found_devices(struct btd_adapter *adapter,
 
 	eir_data_free(&eir_data);
 
+	/*
+	 * Only a device matching an actual filter is of interest to the
+	 * discovery client, other temporary devices get an object once
+	 * connected or asked for.
+	 */
+	if (adapter->filtered_discovery)
+		device_export(dev);
+
 	/*
 	 * Only if at least one client has requested discovery, maintain
 	 * list of found devices and name confirming for legacy devices.
@@ -6752,12 +7348,15 @@ connect_le:
 	if (not_connectable)
 		return;
 
+	if (bdaddr_type != BDADDR_BREDR)
+		reconnect_seen(adapter, dev, rssi);
+
 	/*
 	 * If we're in the process of stopping passive scanning and
 	 * connecting another (or maybe even the same) LE device just
 	 * ignore this one.
 	 */
-	if (adapter->connect_le)
+	if (adapter->connect_le || adapter->connecting_le)
 		return;
 
 	/*
@@ -8754,6 +9353,8 @@ static void connected_callback(uint16_t index, uint16_t length,
 		return;
 	}
 
+	adapter_connect_le_complete(adapter, device);
+
 	memset(&eir_data, 0, sizeof(eir_data));
 	if (eir_len > 0)
 		eir_parse(&eir_data, ev->eir, eir_len);
@@ -8763,6 +9364,8 @@ static void connected_callback(uint16_t index, uint16_t length,
 
 	adapter_add_connection(adapter, device, ev->addr.type);
 
+	reconnect_done(adapter, device);
+
 	name_known = device_name_known(device);
 
 	if (eir_data.name && (eir_data.name_complete || !name_known)) {
@@ -211,6 +211,8 @@ bool btd_adapter_ssp_enabled(struct btd_adapter *adapter);
 
 int adapter_connect_list_add(struct btd_adapter *adapter,
 					struct btd_device *device);
+void adapter_connect_le_complete(struct btd_adapter *adapter,
+						struct btd_device *device);
 void adapter_connect_list_remove(struct btd_adapter *adapter,
 						struct btd_device *device);
 void adapter_set_device_wakeable(struct btd_adapter *adapter,
@@ -223,6 +225,8 @@ void adapter_whitelist_add(struct btd_adapter *adapter,
 						struct btd_device *dev);
 void adapter_whitelist_remove(struct btd_adapter *adapter,
 						struct btd_device *dev);
+void adapter_update_temporary_device(struct btd_adapter *adapter,
+						struct btd_device *device);
 
 void btd_adapter_set_oob_handler(struct btd_adapter *adapter,
 						struct oob_handler *handler);
@@ -41,12 +41,21 @@
 #include "src/shared/ad.h"
 #include "src/shared/mgmt.h"
 #include "src/shared/queue.h"
+#include "src/shared/stride.h"
 #include "src/shared/util.h"
 #include "advertising.h"
 
 #define LE_ADVERTISING_MGR_IFACE "org.bluez.LEAdvertisingManager1"
 #define LE_ADVERTISEMENT_IFACE "org.bluez.LEAdvertisement1"
 
+/* Registrations beyond the controller instances are time sliced */
+#define ADV_MUX_MAX_CLIENTS 64
+#define ADV_MUX_SLICE 2
+
+/* Refreshes failing with a transient status are retried this many times */
+#define ADV_REFRESH_RETRIES 3
+#define ADV_REFRESH_RETRY_DELAY 1
+
 struct btd_adv_manager {
 	struct btd_adapter *adapter;
 	struct queue *clients;
@@ -71,9 +80,17 @@ struct btd_adv_client {
 	uint16_t duration;
 	uint16_t timeout;
 	uint16_t discoverable_to;
+	uint8_t priority;
 	unsigned int to_id;
 	unsigned int disc_to_id;
 	unsigned int add_adv_id;
+	unsigned int slice_id;
+	unsigned int retry_id;
+	uint8_t retries;
+	gint64 registered;
+	gint64 loaded;
+	gint64 airtime;
+	struct stride_entry stride;
 	GDBusClient *client;
 	GDBusProxy *proxy;
 	DBusMessage *reg;
@@ -113,6 +130,12 @@ static void client_free(void *data)
 	if (client->disc_to_id > 0)
 		g_source_remove(client->disc_to_id);
 
+	if (client->slice_id > 0)
+		g_source_remove(client->slice_id);
+
+	if (client->retry_id > 0)
+		g_source_remove(client->retry_id);
+
 	if (client->client) {
 		g_dbus_client_set_disconnect_watch(client->client, NULL, NULL);
 		g_dbus_client_unref(client->client);
@@ -189,6 +212,8 @@ static void remove_advertising(struct btd_adv_manager *manager,
 			manager->mgmt_index, sizeof(cp), &cp, NULL, NULL, NULL);
 }
 
+static bool mux_handover(struct btd_adv_client *client);
+
 static void client_remove(void *data)
 {
 	struct btd_adv_client *client = data;
@@ -198,11 +223,14 @@ static void client_remove(void *data)
 									client);
 	g_dbus_client_set_disconnect_watch(client->client, NULL, NULL);
 
-	cp.instance = client->instance;
+	/* Hand the instance over to a waiting advertisement if any */
+	if (client->instance && !mux_handover(client)) {
+		cp.instance = client->instance;
 
-	mgmt_send(client->manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
-			client->manager->mgmt_index, sizeof(cp), &cp,
-			NULL, NULL, NULL);
+		mgmt_send(client->manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
+				client->manager->mgmt_index, sizeof(cp), &cp,
+				NULL, NULL, NULL);
+	}
 
 	queue_remove(client->manager->clients, client);
 
@@ -571,6 +599,24 @@ static bool parse_duration(DBusMessageIter *iter,
 	return true;
 }
 
+static bool parse_priority(DBusMessageIter *iter,
+					struct btd_adv_client *client)
+{
+	if (!iter) {
+		client->priority = 0;
+		client->stride.weight = 1;
+		return true;
+	}
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_BYTE)
+		return false;
+
+	dbus_message_iter_get_basic(iter, &client->priority);
+	client->stride.weight = client->priority + 1;
+
+	return true;
+}
+
 static gboolean client_timeout(void *user_data)
 {
 	struct btd_adv_client *client = user_data;
@@ -788,19 +834,16 @@ static uint8_t *generate_scan_rsp(struct btd_adv_client *client,
 	return bt_ad_generate(client->scan, len);
 }
 
-static int refresh_adv(struct btd_adv_client *client, mgmt_request_func_t func,
-						unsigned int *mgmt_id)
+static struct mgmt_cp_add_advertising *generate_add_adv(
+					struct btd_adv_client *client,
+					uint8_t *param_len)
 {
 	struct mgmt_cp_add_advertising *cp;
-	uint8_t param_len;
 	uint8_t *adv_data;
 	size_t adv_data_len;
 	uint8_t *scan_rsp;
 	size_t scan_rsp_len = -1;
 	uint32_t flags = 0;
-	unsigned int mgmt_ret;
-
-	DBG("Refreshing advertisement: %s", client->path);
 
 	if (client->type == AD_TYPE_PERIPHERAL) {
 		flags = MGMT_ADV_FLAG_CONNECTABLE;
@@ -815,25 +858,25 @@ static int refresh_adv(struct btd_adv_client *client, mgmt_request_func_t func,
 	adv_data = generate_adv_data(client, &flags, &adv_data_len);
 	if (!adv_data || (adv_data_len > calc_max_adv_len(client, flags))) {
 		error("Advertising data too long or couldn't be generated.");
-		return -EINVAL;
+		return NULL;
 	}
 
 	scan_rsp = generate_scan_rsp(client, &flags, &scan_rsp_len);
 	if (!scan_rsp && scan_rsp_len) {
 		error("Scan data couldn't be generated.");
 		free(adv_data);
-		return -EINVAL;
+		return NULL;
 	}
 
-	param_len = sizeof(struct mgmt_cp_add_advertising) + adv_data_len +
+	*param_len = sizeof(struct mgmt_cp_add_advertising) + adv_data_len +
 							scan_rsp_len;
 
-	cp = malloc0(param_len);
+	cp = malloc0(*param_len);
 	if (!cp) {
 		error("Couldn't allocate for MGMT!");
 		free(adv_data);
 		free(scan_rsp);
-		return -ENOMEM;
+		return NULL;
 	}
 
 	cp->flags = htobl(flags);
@@ -847,6 +890,26 @@ static int refresh_adv(struct btd_adv_client *client, mgmt_request_func_t func,
 	free(adv_data);
 	free(scan_rsp);
 
+	return cp;
+}
+
+static int refresh_adv(struct btd_adv_client *client, mgmt_request_func_t func,
+						unsigned int *mgmt_id)
+{
+	struct mgmt_cp_add_advertising *cp;
+	uint8_t param_len;
+	unsigned int mgmt_ret;
+
+	DBG("Refreshing advertisement: %s", client->path);
+
+	/* Waiting advertisements are pushed once they get an instance */
+	if (!client->instance)
+		return 0;
+
+	cp = generate_add_adv(client, &param_len);
+	if (!cp)
+		return -EINVAL;
+
 	mgmt_ret = mgmt_send(client->manager->mgmt, MGMT_OP_ADD_ADVERTISING,
 			client->manager->mgmt_index, param_len, cp,
 			func, client, NULL);
@@ -864,6 +927,209 @@ static int refresh_adv(struct btd_adv_client *client, mgmt_request_func_t func,
 	return 0;
 }
 
+static void refresh_adv_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data);
+
+static gboolean refresh_retry_timeout(gpointer user_data)
+{
+	struct btd_adv_client *client = user_data;
+
+	client->retry_id = 0;
+
+	DBG("Retrying refresh of advertisement %s", client->path);
+
+	refresh_adv(client, refresh_adv_callback, &client->add_adv_id);
+
+	return FALSE;
+}
+
+static bool refresh_status_transient(uint8_t status)
+{
+	switch (status) {
+	case MGMT_STATUS_BUSY:
+	case MGMT_STATUS_TIMEOUT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void refresh_adv_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct btd_adv_client *client = user_data;
+
+	client->add_adv_id = 0;
+
+	if (!status) {
+		client->retries = 0;
+		return;
+	}
+
+	error("Failed to refresh advertisement %s: %s (0x%02x)",
+				client->path, mgmt_errstr(status), status);
+
+	/* The controller still holds the previous data, try again later */
+	if (refresh_status_transient(status) &&
+				client->retries < ADV_REFRESH_RETRIES) {
+		client->retries++;
+		client->retry_id = g_timeout_add_seconds(
+						ADV_REFRESH_RETRY_DELAY,
+						refresh_retry_timeout, client);
+		return;
+	}
+
+	/* Don't leave the instance with data that is not the client's */
+	client_release(client);
+	client_remove(client);
+}
+
+static void client_refresh(struct btd_adv_client *client)
+{
+	/* Registration is completed by add_adv_callback */
+	if (client->reg) {
+		refresh_adv(client, NULL, NULL);
+		return;
+	}
+
+	/* Only the last update matters */
+	if (client->add_adv_id) {
+		mgmt_cancel(client->manager->mgmt, client->add_adv_id);
+		client->add_adv_id = 0;
+	}
+
+	if (client->retry_id) {
+		g_source_remove(client->retry_id);
+		client->retry_id = 0;
+	}
+
+	client->retries = 0;
+
+	refresh_adv(client, refresh_adv_callback, &client->add_adv_id);
+}
+
+/*
+ * Duration is both the time the controller shows the instance before
+ * rotating to its next instance and, when there are more advertisements
+ * than instances, the time the advertisement stays loaded before it can
+ * be swapped out. Both let the application bound how long it waits for
+ * its turn, so a single property controls the two.
+ */
+static uint16_t client_slice(struct btd_adv_client *client)
+{
+	return client->duration ? client->duration : ADV_MUX_SLICE;
+}
+
+static struct stride_entry *registered_entry(void *data)
+{
+	struct btd_adv_client *client = data;
+
+	return client->reg ? NULL : &client->stride;
+}
+
+static struct stride_entry *waiting_entry(void *data)
+{
+	struct btd_adv_client *client = data;
+
+	return client->instance ? NULL : registered_entry(client);
+}
+
+static struct btd_adv_client *mux_next(struct btd_adv_manager *manager)
+{
+	return stride_next(manager->clients, waiting_entry);
+}
+
+static gboolean client_slice_timeout(gpointer user_data);
+
+static void mux_arm(struct btd_adv_client *client)
+{
+	if (client->slice_id)
+		return;
+
+	client->slice_id = g_timeout_add_seconds(client_slice(client),
+						client_slice_timeout, client);
+}
+
+static void mux_start(struct btd_adv_manager *manager)
+{
+	const struct queue_entry *entry;
+
+	for (entry = queue_get_entries(manager->clients); entry;
+							entry = entry->next) {
+		struct btd_adv_client *client = entry->data;
+
+		if (client->instance && !client->reg)
+			mux_arm(client);
+	}
+}
+
+static uint8_t client_unload(struct btd_adv_client *client)
+{
+	uint8_t instance = client->instance;
+
+	if (client->slice_id) {
+		g_source_remove(client->slice_id);
+		client->slice_id = 0;
+	}
+
+	client->airtime += g_get_monotonic_time() - client->loaded;
+	client->instance = 0;
+
+	return instance;
+}
+
+static void client_load(struct btd_adv_client *client, uint8_t instance)
+{
+	DBG("Advertisement %s loaded into instance %u", client->path,
+								instance);
+
+	client->instance = instance;
+	client->loaded = g_get_monotonic_time();
+
+	/* Add Advertising replaces the data of an existing instance */
+	client_refresh(client);
+
+	if (mux_next(client->manager))
+		mux_arm(client);
+}
+
+static bool mux_handover(struct btd_adv_client *client)
+{
+	struct btd_adv_client *next;
+
+	next = mux_next(client->manager);
+	if (!next)
+		return false;
+
+	client_load(next, client_unload(client));
+
+	return true;
+}
+
+static gboolean client_slice_timeout(gpointer user_data)
+{
+	struct btd_adv_client *client = user_data;
+	struct btd_adv_client *next;
+
+	client->slice_id = 0;
+
+	/* Higher priority advances slower */
+	stride_advance(&client->stride, client_slice(client));
+
+	next = mux_next(client->manager);
+	if (!next)
+		return FALSE;
+
+	if (next->stride.pass > client->stride.pass) {
+		mux_arm(client);
+		return FALSE;
+	}
+
+	client_load(next, client_unload(client));
+
+	return FALSE;
+}
+
 static gboolean client_discoverable_timeout(void *user_data)
 {
 	struct btd_adv_client *client = user_data;
@@ -874,7 +1140,7 @@ static gboolean client_discoverable_timeout(void *user_data)
 
 	bt_ad_clear_flags(client->data);
 
-	refresh_adv(client, NULL, NULL);
+	client_refresh(client);
 
 	return FALSE;
 }
@@ -958,6 +1224,7 @@ static struct adv_parser {
 	{ "LocalName", parse_local_name },
 	{ "Appearance", parse_appearance },
 	{ "Duration", parse_duration },
+	{ "Priority", parse_priority },
 	{ "Timeout", parse_timeout },
 	{ "Data", parse_data },
 	{ "Discoverable", parse_discoverable },
@@ -977,7 +1244,7 @@ static void properties_changed(GDBusProxy *proxy, const char *name,
 			continue;
 
 		if (parser->func(iter, client)) {
-			refresh_adv(client, NULL, NULL);
+			client_refresh(client);
 			break;
 		}
 	}
@@ -992,6 +1259,8 @@ static void add_client_complete(struct btd_adv_client *client, uint8_t status)
 						mgmt_errstr(status), status);
 		reply = btd_error_failed(client->reg,
 					"Failed to register advertisement");
+		if (client->instance)
+			mux_handover(client);
 		queue_remove(client->manager->clients, client);
 		g_idle_add(client_free_idle_cb, client);
 
@@ -1003,6 +1272,26 @@ static void add_client_complete(struct btd_adv_client *client, uint8_t status)
 	client->reg = NULL;
 }
 
+static void client_added(struct btd_adv_client *client)
+{
+	client->registered = g_get_monotonic_time();
+
+	g_dbus_client_set_disconnect_watch(client->client, client_disconnect_cb,
+									client);
+	DBG("Advertisement registered: %s", client->path);
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+				adapter_get_path(client->manager->adapter),
+				LE_ADVERTISING_MGR_IFACE, "SupportedInstances");
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+				adapter_get_path(client->manager->adapter),
+				LE_ADVERTISING_MGR_IFACE, "ActiveInstances");
+
+	g_dbus_proxy_set_property_watch(client->proxy, properties_changed,
+								client);
+}
+
 static void add_adv_callback(uint8_t status, uint16_t length,
 					  const void *param, void *user_data)
 {
@@ -1021,23 +1310,39 @@ static void add_adv_callback(uint8_t status, uint16_t length,
 
 	client->instance = rp->instance;
 
-	g_dbus_client_set_disconnect_watch(client->client, client_disconnect_cb,
-									client);
-	DBG("Advertisement registered: %s", client->path);
+	client_added(client);
+	client->loaded = client->registered;
 
-	g_dbus_emit_property_changed(btd_get_dbus_connection(),
-				adapter_get_path(client->manager->adapter),
-				LE_ADVERTISING_MGR_IFACE, "SupportedInstances");
+done:
+	add_client_complete(client, status);
 
-	g_dbus_emit_property_changed(btd_get_dbus_connection(),
-				adapter_get_path(client->manager->adapter),
-				LE_ADVERTISING_MGR_IFACE, "ActiveInstances");
+	if (!status && mux_next(client->manager))
+		mux_arm(client);
+}
 
-	g_dbus_proxy_set_property_watch(client->proxy, properties_changed,
-								client);
+static int client_enqueue(struct btd_adv_client *client)
+{
+	struct mgmt_cp_add_advertising *cp;
+	uint8_t param_len;
 
-done:
-	add_client_complete(client, status);
+	/* Validate the data now so errors are reported on registration */
+	cp = generate_add_adv(client, &param_len);
+	if (!cp)
+		return -EINVAL;
+
+	free(cp);
+
+	DBG("Advertisement %s waiting for an instance", client->path);
+
+	client->stride.pass = stride_min_pass(client->manager->clients,
+							registered_entry);
+
+	client_added(client);
+	add_client_complete(client, 0);
+
+	mux_start(client->manager);
+
+	return 0;
 }
 
 static DBusMessage *parse_advertisement(struct btd_adv_client *client)
@@ -1091,7 +1396,11 @@ static DBusMessage *parse_advertisement(struct btd_adv_client *client)
 		goto fail;
 	}
 
-	err = refresh_adv(client, add_adv_callback, &client->add_adv_id);
+	if (!client->instance)
+		err = client_enqueue(client);
+	else
+		err = refresh_adv(client, add_adv_callback,
+							&client->add_adv_id);
 	if (!err)
 		return NULL;
 
@@ -1135,6 +1444,7 @@ static struct btd_adv_client *client_create(struct btd_adv_manager *manager,
 		return NULL;
 
 	client = new0(struct btd_adv_client, 1);
+	client->stride.weight = 1;
 	client->client = g_dbus_client_new_full(conn, sender, path, path);
 	if (!client->client)
 		goto fail;
@@ -1210,7 +1520,8 @@ static DBusMessage *register_advertisement(DBusConnection *conn,
 
 	client->instance = util_get_uid(&manager->instance_bitmap,
 							manager->max_ads);
-	if (!client->instance) {
+	if (!client->instance && (!manager->max_ads ||
+			queue_length(manager->clients) >= ADV_MUX_MAX_CLIENTS)) {
 		client_free(client);
 		return btd_error_not_permitted(msg,
 					"Maximum advertisements reached");
@@ -1255,13 +1566,75 @@ static DBusMessage *unregister_advertisement(DBusConnection *conn,
 	return dbus_message_new_method_return(msg);
 }
 
+static DBusMessage *get_airtime(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	struct btd_adv_manager *manager = user_data;
+	struct btd_adv_client *client;
+	struct dbus_obj_match match;
+	DBusMessageIter iter, dict;
+	DBusMessage *reply;
+	gint64 now, elapsed, achieved;
+	uint32_t val;
+
+	if (!dbus_message_get_args(msg, NULL,
+				DBUS_TYPE_OBJECT_PATH, &match.path,
+				DBUS_TYPE_INVALID))
+		return btd_error_invalid_args(msg);
+
+	match.owner = dbus_message_get_sender(msg);
+
+	client = queue_find(manager->clients, match_client, &match);
+	if (!client)
+		return btd_error_does_not_exist(msg);
+
+	if (client->reg)
+		return btd_error_not_ready(msg);
+
+	now = g_get_monotonic_time();
+	elapsed = now - client->registered;
+	achieved = client->airtime;
+	if (client->instance)
+		achieved += now - client->loaded;
+
+	reply = dbus_message_new_method_return(msg);
+	if (!reply)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+
+	val = elapsed / 1000;
+	dict_append_entry(&dict, "Elapsed", DBUS_TYPE_UINT32, &val);
+
+	val = elapsed / 1000 * stride_share(manager->clients,
+						registered_entry,
+						&client->stride,
+						manager->max_ads) / 1000;
+	dict_append_entry(&dict, "Requested", DBUS_TYPE_UINT32, &val);
+
+	val = achieved / 1000;
+	dict_append_entry(&dict, "Achieved", DBUS_TYPE_UINT32, &val);
+
+	dbus_message_iter_close_container(&iter, &dict);
+
+	return reply;
+}
+
 static gboolean get_instances(const GDBusPropertyTable *property,
 					DBusMessageIter *iter, void *data)
 {
 	struct btd_adv_manager *manager = data;
 	uint8_t instances;
 
-	instances = manager->max_ads - queue_length(manager->clients);
+	instances = manager->max_ads -
+			__builtin_popcount(manager->instance_bitmap);
 
 	dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &instances);
 
@@ -1274,7 +1647,8 @@ static gboolean get_active_instances(const GDBusPropertyTable *property,
 	struct btd_adv_manager *manager = data;
 	uint8_t instances;
 
-	instances = queue_length(manager->clients);
+	/* Waiting advertisements don't occupy a controller instance */
+	instances = __builtin_popcount(manager->instance_bitmap);
 
 	dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &instances);
 
@@ -1363,6 +1737,10 @@ static const GDBusMethodTable methods[] = {
 						GDBUS_ARGS({ "service", "o" }),
 						NULL,
 						unregister_advertisement) },
+	{ GDBUS_EXPERIMENTAL_METHOD("GetAirtime",
+					GDBUS_ARGS({ "advertisement", "o" }),
+					GDBUS_ARGS({ "airtime", "a{sv}" }),
+					get_airtime) },
 	{ }
 };
 
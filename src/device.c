@@ -231,10 +231,11 @@ struct btd_device {
 	GSList		*pending;		/* Pending services */
 	GSList		*watches;		/* List of disconnect_data */
 	bool		temporary;
+	bool		exported;		/* Device1 object registered */
 	bool		connectable;
 	guint		disconn_timer;
 	guint		discov_timer;
-	guint		temporary_timer;	/* Temporary/disappear timer */
+	gint64		temporary_seen;		/* Expiry base, 0 if none */
 	struct browse_req *browse;		/* service discover request */
 	struct bonding_req *bonding;
 	struct authentication_req *authr;	/* authentication request */
@@ -615,17 +616,27 @@ static void gatt_server_cleanup(struct btd_device *device)
 	device->server = NULL;
 }
 
+static void att_io_shutdown(struct btd_device *device)
+{
+	if (!device->att_io)
+		return;
+
+	g_io_channel_shutdown(device->att_io, FALSE, NULL);
+	g_io_channel_unref(device->att_io);
+	device->att_io = NULL;
+
+	/* att_connect_cb won't be called for the aborted attempt */
+	if (device->adapter)
+		adapter_connect_le_complete(device->adapter, device);
+}
+
 static void attio_cleanup(struct btd_device *device)
 {
 	if (device->att_disconn_id)
 		bt_att_unregister_disconnect(device->att,
 							device->att_disconn_id);
 
-	if (device->att_io) {
-		g_io_channel_shutdown(device->att_io, FALSE, NULL);
-		g_io_channel_unref(device->att_io);
-		device->att_io = NULL;
-	}
+	att_io_shutdown(device);
 
 	gatt_client_cleanup(device);
 	gatt_server_cleanup(device);
@@ -670,10 +681,32 @@ static void svc_dev_remove(gpointer user_data)
 	g_free(cb);
 }
 
+/* Devices with and without a D-Bus object */
+static unsigned int exported_count;
+static unsigned int shadow_count;
+
+static void device_emit_property_changed(struct btd_device *device,
+							const char *name)
+{
+	/* Nobody can be watching a device that has no object yet */
+	if (!device->exported)
+		return;
+
+	g_dbus_emit_property_changed(dbus_conn, device->path,
+						DEVICE_INTERFACE, name);
+}
+
 static void device_free(gpointer user_data)
 {
 	struct btd_device *device = user_data;
 
+	if (device->adapter) {
+		if (device->exported)
+			exported_count--;
+		else
+			shadow_count--;
+	}
+
 	btd_gatt_client_destroy(device->client_dbus);
 	device->client_dbus = NULL;
 
@@ -700,9 +733,6 @@ static void device_free(gpointer user_data)
 	if (device->discov_timer)
 		g_source_remove(device->discov_timer);
 
-	if (device->temporary_timer)
-		g_source_remove(device->temporary_timer);
-
 	if (device->connect)
 		dbus_message_unref(device->connect);
 
@@ -836,8 +866,7 @@ static void set_alias(GDBusPendingPropertySet id, const char *alias,
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Alias");
+	device_emit_property_changed(device, "Alias");
 
 	g_dbus_pending_property_success(id);
 }
@@ -1408,8 +1437,7 @@ void device_set_wake_allowed_complete(struct btd_device *device)
 	}
 
 	device->wake_allowed = device->pending_wake_allowed;
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "WakeAllowed");
+	device_emit_property_changed(device, "WakeAllowed");
 
 	store_device_info(device);
 }
@@ -1529,8 +1557,7 @@ int device_block(struct btd_device *device, gboolean update_only)
 
 	btd_device_set_temporary(device, false);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Blocked");
+	device_emit_property_changed(device, "Blocked");
 
 	return 0;
 }
@@ -1562,8 +1589,7 @@ int device_unblock(struct btd_device *device, gboolean silent,
 	store_device_info(device);
 
 	if (!silent) {
-		g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Blocked");
+		device_emit_property_changed(device, "Blocked");
 		device_probe_profiles(device, device->uuids);
 	}
 
@@ -1600,11 +1626,7 @@ void device_request_disconnect(struct btd_device *device, DBusMessage *msg)
 	if (device->browse)
 		browse_request_cancel(device->browse);
 
-	if (device->att_io) {
-		g_io_channel_shutdown(device->att_io, FALSE, NULL);
-		g_io_channel_unref(device->att_io);
-		device->att_io = NULL;
-	}
+	att_io_shutdown(device);
 
 	if (device->connect) {
 		DBusMessage *reply = btd_error_failed(device->connect,
@@ -1831,8 +1853,7 @@ void device_add_eir_uuids(struct btd_device *dev, GSList *uuids)
 	}
 
 	if (added)
-		g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE, "UUIDs");
+		device_emit_property_changed(dev, "UUIDs");
 }
 
 static void add_manufacturer_data(void *data, void *user_data)
@@ -1844,8 +1865,7 @@ static void add_manufacturer_data(void *data, void *user_data)
 								msd->data_len))
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ManufacturerData");
+	device_emit_property_changed(dev, "ManufacturerData");
 }
 
 void device_set_manufacturer_data(struct btd_device *dev, GSList *list,
@@ -1869,8 +1889,7 @@ static void add_service_data(void *data, void *user_data)
 	if (!bt_ad_add_service_data(dev->ad, &uuid, sd->data, sd->data_len))
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ServiceData");
+	device_emit_property_changed(dev, "ServiceData");
 }
 
 void device_set_service_data(struct btd_device *dev, GSList *list,
@@ -1891,9 +1910,7 @@ static void add_data(void *data, void *user_data)
 		return;
 
 	if (ad->type == EIR_TRANSPORT_DISCOVERY)
-		g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE,
-						"AdvertisingData");
+		device_emit_property_changed(dev, "AdvertisingData");
 }
 
 void device_set_data(struct btd_device *dev, GSList *list,
@@ -2523,8 +2540,7 @@ static void browse_request_complete(struct browse_req *req, uint8_t type,
 		}
 
 		if (dev->pending_paired) {
-			g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE, "Paired");
+			device_emit_property_changed(dev, "Paired");
 			dev->pending_paired = false;
 		}
 
@@ -2584,8 +2600,7 @@ static void device_set_svc_refreshed(struct btd_device *device, bool value)
 
 	device->svc_refreshed = value;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "ServicesResolved");
+	device_emit_property_changed(device, "ServicesResolved");
 }
 
 static void device_svc_resolved(struct btd_device *dev, uint8_t browse_type,
@@ -2609,8 +2624,7 @@ static void device_svc_resolved(struct btd_device *dev, uint8_t browse_type,
 	dev->eir_uuids = NULL;
 
 	if (dev->pending_paired) {
-		g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE, "Paired");
+		device_emit_property_changed(dev, "Paired");
 		dev->pending_paired = false;
 	}
 
@@ -2979,6 +2993,8 @@ void device_add_connection(struct btd_device *dev, uint8_t bdaddr_type)
 		return;
 	}
 
+	device_export(dev);
+
 	bacpy(&dev->conn_bdaddr, &dev->bdaddr);
 	dev->conn_bdaddr_type = dev->bdaddr_type;
 
@@ -2993,14 +3009,11 @@ void device_add_connection(struct btd_device *dev, uint8_t bdaddr_type)
 	if (dev->le_state.connected && dev->bredr_state.connected)
 		return;
 
-	/* Remove temporary timer while connected */
-	if (dev->temporary_timer) {
-		g_source_remove(dev->temporary_timer);
-		dev->temporary_timer = 0;
-	}
+	/* Don't expire while connected */
+	dev->temporary_seen = 0;
+	adapter_update_temporary_device(dev->adapter, dev);
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path, DEVICE_INTERFACE,
-								"Connected");
+	device_emit_property_changed(dev, "Connected");
 }
 
 void device_remove_connection(struct btd_device *device, uint8_t bdaddr_type)
@@ -3049,9 +3062,7 @@ void device_remove_connection(struct btd_device *device, uint8_t bdaddr_type)
 
 		/* report change only if both bearers are unpaired */
 		if (!device->bredr_state.paired && !device->le_state.paired)
-			g_dbus_emit_property_changed(dbus_conn, device->path,
-							DEVICE_INTERFACE,
-							"Paired");
+			device_emit_property_changed(device, "Paired");
 	}
 
 	if (device->bredr_state.connected || device->le_state.connected)
@@ -3059,8 +3070,7 @@ void device_remove_connection(struct btd_device *device, uint8_t bdaddr_type)
 
 	device_update_last_seen(device, bdaddr_type);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Connected");
+	device_emit_property_changed(device, "Connected");
 }
 
 guint device_add_disconnect_watch(struct btd_device *device,
@@ -3797,8 +3807,7 @@ static void device_add_uuids(struct btd_device *device, GSList *uuids)
 	}
 
 	if (changed)
-		g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "UUIDs");
+		device_emit_property_changed(device, "UUIDs");
 }
 
 static bool device_match_profile(struct btd_device *device,
@@ -4015,8 +4024,7 @@ static void gatt_service_removed(struct gatt_db_attribute *attr,
 
 		g_free(l->data);
 		device->uuids = g_slist_delete_link(device->uuids, l);
-		g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "UUIDs");
+		device_emit_property_changed(device, "UUIDs");
 	}
 
 	g_free(prim);
@@ -4028,6 +4036,43 @@ static void gatt_service_removed(struct gatt_db_attribute *attr,
 	gatt_services_changed(device);
 }
 
+static bool device_register(struct btd_device *device)
+{
+	if (!g_dbus_register_interface(dbus_conn,
+					device->path, DEVICE_INTERFACE,
+					device_methods, NULL,
+					device_properties, device,
+					device_free))
+		return false;
+
+	device->exported = true;
+
+	return true;
+}
+
+void device_export(struct btd_device *device)
+{
+	if (device->exported)
+		return;
+
+	if (!device_register(device)) {
+		error("Unable to register device interface for %s",
+								device->path);
+		return;
+	}
+
+	shadow_count--;
+	exported_count++;
+
+	DBG("Exported %s (%u exported, %u shadow)", device->path,
+					exported_count, shadow_count);
+}
+
+bool device_is_exported(struct btd_device *device)
+{
+	return device->exported;
+}
+
 static struct btd_device *device_new(struct btd_adapter *adapter,
 				const char *address)
 {
@@ -4073,11 +4118,11 @@ static struct btd_device *device_new(struct btd_adapter *adapter,
 
 	DBG("Creating device %s", device->path);
 
-	if (g_dbus_register_interface(dbus_conn,
-					device->path, DEVICE_INTERFACE,
-					device_methods, NULL,
-					device_properties, device,
-					device_free) == FALSE) {
+	/*
+	 * Temporary devices may be kept without a D-Bus object until they
+	 * are connected, match a discovery filter or are asked for.
+	 */
+	if (main_opts.export_temporary && !device_register(device)) {
 		error("Unable to register device interface for %s", address);
 		device_free(device);
 		return NULL;
@@ -4086,6 +4131,11 @@ static struct btd_device *device_new(struct btd_adapter *adapter,
 	device->adapter = adapter;
 	device->temporary = true;
 
+	if (device->exported)
+		exported_count++;
+	else
+		shadow_count++;
+
 	device->db_id = gatt_db_register(device->db, gatt_service_added,
 					gatt_service_removed, device, NULL);
 
@@ -4181,14 +4231,12 @@ void btd_device_device_set_name(struct btd_device *device, const char *name)
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Name");
+	device_emit_property_changed(device, "Name");
 
 	if (device->alias != NULL)
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Alias");
+	device_emit_property_changed(device, "Alias");
 }
 
 void device_get_name(struct btd_device *device, char *name, size_t len)
@@ -4215,10 +4263,8 @@ void device_set_class(struct btd_device *device, uint32_t class)
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Class");
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Icon");
+	device_emit_property_changed(device, "Class");
+	device_emit_property_changed(device, "Icon");
 }
 
 void device_update_addr(struct btd_device *device, const bdaddr_t *bdaddr,
@@ -4238,10 +4284,8 @@ void device_update_addr(struct btd_device *device, const bdaddr_t *bdaddr,
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Address");
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "AddressType");
+	device_emit_property_changed(device, "Address");
+	device_emit_property_changed(device, "AddressType");
 }
 
 void device_set_bredr_support(struct btd_device *device)
@@ -4264,17 +4308,6 @@ void device_set_le_support(struct btd_device *device, uint8_t bdaddr_type)
 	store_device_info(device);
 }
 
-static gboolean device_disappeared(gpointer user_data)
-{
-	struct btd_device *dev = user_data;
-
-	dev->temporary_timer = 0;
-
-	btd_adapter_remove_device(dev->adapter, dev);
-
-	return FALSE;
-}
-
 void device_update_last_seen(struct btd_device *device, uint8_t bdaddr_type)
 {
 	if (bdaddr_type == BDADDR_BREDR)
@@ -4285,13 +4318,14 @@ void device_update_last_seen(struct btd_device *device, uint8_t bdaddr_type)
 	if (!device_is_temporary(device))
 		return;
 
-	/* Restart temporary timer */
-	if (device->temporary_timer)
-		g_source_remove(device->temporary_timer);
+	/* Restart temporary expiry, the adapter sweeps expired devices */
+	device->temporary_seen = g_get_monotonic_time();
+	adapter_update_temporary_device(device->adapter, device);
+}
 
-	device->temporary_timer = g_timeout_add_seconds(main_opts.tmpto,
-							device_disappeared,
-							device);
+gint64 device_get_temporary_seen(struct btd_device *device)
+{
+	return device->temporary_seen;
 }
 
 /* It is possible that we have two device objects for the same device in
@@ -5005,8 +5039,7 @@ static void search_cb(sdp_list_t *recs, int err, gpointer user_data)
 	device_probe_profiles(device, req->profiles_added);
 
 	/* Propagate services changes */
-	g_dbus_emit_property_changed(dbus_conn, req->device->path,
-						DEVICE_INTERFACE, "UUIDs");
+	device_emit_property_changed(req->device, "UUIDs");
 
 send_reply:
 	device_svc_resolved(device, BROWSE_SDP, BDADDR_BREDR, err);
@@ -5366,6 +5399,8 @@ static void att_connect_cb(GIOChannel *io, GError *gerr, gpointer user_data)
 	g_io_channel_unref(device->att_io);
 	device->att_io = NULL;
 
+	adapter_connect_le_complete(device->adapter, device);
+
 	if (gerr) {
 		DBG("%s", gerr->message);
 
@@ -5672,18 +5707,16 @@ void btd_device_set_temporary(struct btd_device *device, bool temporary)
 
 	device->temporary = temporary;
 
-	if (device->temporary_timer) {
-		g_source_remove(device->temporary_timer);
-		device->temporary_timer = 0;
-	}
+	if (!temporary)
+		device_export(device);
+
+	device->temporary_seen = temporary ? g_get_monotonic_time() : 0;
+	adapter_update_temporary_device(device->adapter, device);
 
 	if (temporary) {
 		if (device->bredr)
 			adapter_whitelist_remove(device->adapter, device);
 		adapter_connect_list_remove(device->adapter, device);
-		device->temporary_timer = g_timeout_add_seconds(main_opts.tmpto,
-							device_disappeared,
-							device);
 		return;
 	}
 
@@ -5713,8 +5746,7 @@ void btd_device_set_trusted(struct btd_device *device, gboolean trusted)
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "Trusted");
+	device_emit_property_changed(device, "Trusted");
 }
 
 void device_set_bonded(struct btd_device *device, uint8_t bdaddr_type)
@@ -5744,8 +5776,7 @@ void device_set_legacy(struct btd_device *device, bool legacy)
 
 	device->legacy = legacy;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "LegacyPairing");
+	device_emit_property_changed(device, "LegacyPairing");
 }
 
 void device_store_svc_chng_ccc(struct btd_device *device, uint8_t bdaddr_type,
@@ -5868,8 +5899,7 @@ void device_set_rssi_with_delta(struct btd_device *device, int8_t rssi,
 		device->rssi = rssi;
 	}
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "RSSI");
+	device_emit_property_changed(device, "RSSI");
 }
 
 void device_set_rssi(struct btd_device *device, int8_t rssi)
@@ -5889,8 +5919,7 @@ void device_set_tx_power(struct btd_device *device, int8_t tx_power)
 
 	device->tx_power = tx_power;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "TxPower");
+	device_emit_property_changed(device, "TxPower");
 }
 
 void device_set_flags(struct btd_device *device, uint8_t flags)
@@ -5905,8 +5934,7 @@ void device_set_flags(struct btd_device *device, uint8_t flags)
 
 	device->ad_flags[0] = flags;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "AdvertisingFlags");
+	device_emit_property_changed(device, "AdvertisingFlags");
 }
 
 bool device_is_connectable(struct btd_device *device)
@@ -5955,8 +5983,7 @@ void device_set_paired(struct btd_device *dev, uint8_t bdaddr_type)
 		return;
 	}
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE, "Paired");
+	device_emit_property_changed(dev, "Paired");
 }
 
 void device_set_unpaired(struct btd_device *dev, uint8_t bdaddr_type)
@@ -5980,8 +6007,7 @@ void device_set_unpaired(struct btd_device *dev, uint8_t bdaddr_type)
 		return;
 	}
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-						DEVICE_INTERFACE, "Paired");
+	device_emit_property_changed(dev, "Paired");
 
 	btd_device_set_temporary(dev, true);
 
@@ -6159,6 +6185,11 @@ bool device_remove_svc_complete_callback(struct btd_device *dev,
 	return false;
 }
 
+bool device_is_busy(struct btd_device *device)
+{
+	return device->bonding || device->connect || device->att_io;
+}
+
 gboolean device_is_bonding(struct btd_device *device, const char *sender)
 {
 	struct bonding_req *bonding = device->bonding;
@@ -6334,6 +6365,9 @@ static struct authentication_req *new_auth(struct btd_device *device,
 	ba2str(&device->bdaddr, addr);
 	DBG("Requesting agent authentication for %s", addr);
 
+	/* Agents are given the object path of the device */
+	device_export(device);
+
 	if (device->authr) {
 		error("Authentication already requested for %s", addr);
 		return NULL;
@@ -6646,8 +6680,7 @@ void btd_device_add_uuid(struct btd_device *device, const char *uuid)
 
 	store_device_info(device);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "UUIDs");
+	device_emit_property_changed(device, "UUIDs");
 }
 
 static sdp_list_t *read_device_records(struct btd_device *device)
@@ -6713,8 +6746,7 @@ void btd_device_set_record(struct btd_device *device, const char *uuid,
 	device_probe_profiles(device, req->profiles_added);
 
 	/* Propagate services changes */
-	g_dbus_emit_property_changed(dbus_conn, req->device->path,
-						DEVICE_INTERFACE, "UUIDs");
+	device_emit_property_changed(req->device, "UUIDs");
 
 	device_svc_resolved(device, BROWSE_SDP, device->bdaddr_type, 0);
 }
@@ -6751,6 +6783,11 @@ void btd_device_unref(struct btd_device *device)
 
 	DBG("Freeing device %s", device->path);
 
+	if (!device->exported) {
+		device_free(device);
+		return;
+	}
+
 	g_dbus_unregister_interface(dbus_conn, device->path, DEVICE_INTERFACE);
 }
 
@@ -6772,12 +6809,10 @@ void device_set_appearance(struct btd_device *device, uint16_t value)
 	if (device->appearance == value)
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-					DEVICE_INTERFACE, "Appearance");
+	device_emit_property_changed(device, "Appearance");
 
 	if (icon)
-		g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Icon");
+		device_emit_property_changed(device, "Icon");
 
 	device->appearance = value;
 	store_device_info(device);
@@ -6798,8 +6833,7 @@ void btd_device_set_pnpid(struct btd_device *device, uint16_t source,
 	free(device->modalias);
 	device->modalias = bt_modalias(source, vendor, product, version);
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "Modalias");
+	device_emit_property_changed(device, "Modalias");
 
 	store_device_info(device);
 }
@@ -48,6 +48,7 @@
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
 #include "src/shared/util.h"
+#include "src/shared/shm-ring.h"
 #include "gatt-client.h"
 #include "dbus-common.h"
 
@@ -59,6 +60,12 @@
 #define GATT_CHARACTERISTIC_IFACE	"org.bluez.GattCharacteristic1"
 #define GATT_DESCRIPTOR_IFACE		"org.bluez.GattDescriptor1"
 
+/* Records taken from a write ring per wakeup */
+#define RING_READ_MAX			64
+
+/* Maximum number of notifications sent to a socket per system call */
+#define NFY_BATCH_MAX			32
+
 struct btd_gatt_client {
 	struct btd_device *device;
 	uint8_t features;
@@ -97,6 +104,9 @@ struct async_dbus_op {
 struct sock_io {
 	DBusMessage *msg;
 	struct io *io;
+	uint32_t ring_size;
+	struct shm_ring *ring;
+	struct io *ring_io;
 	void (*destroy)(void *data);
 	void *data;
 };
@@ -432,6 +442,47 @@ static int parse_options(DBusMessageIter *iter, uint16_t *offset,
 	return 0;
 }
 
+static int parse_acquire_options(DBusMessageIter *iter, uint32_t *ring_size,
+								bool *batch)
+{
+	DBusMessageIter dict;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY)
+		return -EINVAL;
+
+	dbus_message_iter_recurse(iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		const char *key;
+		DBusMessageIter value, entry;
+
+		dbus_message_iter_recurse(&dict, &entry);
+		dbus_message_iter_get_basic(&entry, &key);
+
+		dbus_message_iter_next(&entry);
+		dbus_message_iter_recurse(&entry, &value);
+
+		if (strcasecmp(key, "ring-size") == 0) {
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_UINT32)
+				return -EINVAL;
+			dbus_message_iter_get_basic(&value, ring_size);
+		} else if (batch && strcasecmp(key, "batch") == 0) {
+			dbus_bool_t enable;
+
+			if (dbus_message_iter_get_arg_type(&value) !=
+							DBUS_TYPE_BOOLEAN)
+				return -EINVAL;
+			dbus_message_iter_get_basic(&value, &enable);
+			*batch = enable;
+		}
+
+		dbus_message_iter_next(&dict);
+	}
+
+	return 0;
+}
+
 static struct async_dbus_op *async_dbus_op_new(DBusMessage *msg, void *data)
 {
 	struct async_dbus_op *op;
@@ -1107,6 +1158,19 @@ static void sock_io_destroy(struct sock_io *io)
 	if (io->destroy)
 		io->destroy(io->data);
 
+	if (io->ring) {
+		struct shm_ring_stats stats;
+
+		shm_ring_get_stats(io->ring, &stats);
+
+		DBG("ring %p pushed %u dropped %u doorbells %u max used %u",
+					io->ring, stats.pushed, stats.dropped,
+					stats.doorbells, stats.max_used);
+
+		io_destroy(io->ring_io);
+		shm_ring_free(io->ring);
+	}
+
 	if (io->msg)
 		dbus_message_unref(io->msg);
 
@@ -1146,6 +1210,125 @@ static bool sock_hup(struct io *io, void *user_data)
 	return false;
 }
 
+static bool ring_read(struct io *io, void *user_data)
+{
+	struct characteristic *chrc = user_data;
+	struct bt_gatt_client *gatt = chrc->service->client->gatt;
+	struct shm_ring *ring = chrc->write_io->ring;
+	uint8_t buf[512];
+	unsigned int i;
+	int len;
+
+	shm_ring_ack(ring);
+
+	for (i = 0; i < RING_READ_MAX; i++) {
+		len = shm_ring_pop(ring, buf, sizeof(buf));
+		if (len == -EAGAIN) {
+			/* Only sleep once the ring is seen empty after arming */
+			if (shm_ring_prepare_wait(ring))
+				return true;
+			continue;
+		}
+
+		if (len == -EMSGSIZE)
+			continue;
+
+		if (len < 0) {
+			error("%s: invalid write ring", chrc->path);
+			return false;
+		}
+
+		if (gatt)
+			bt_gatt_client_write_without_response(gatt,
+					chrc->value_handle,
+					chrc->props & BT_GATT_CHRC_PROP_AUTH,
+					buf, len);
+	}
+
+	/* The application may keep the ring full, let others run first */
+	shm_ring_rearm(ring);
+
+	return true;
+}
+
+/*
+ * The ring is handed over as the first packet of the socket: the ring size
+ * as payload and the memfd followed by the eventfd as ancillary data. The
+ * socket itself remains in place to track the lifetime of the session.
+ */
+static int ring_send(int fd, struct shm_ring *ring)
+{
+	uint32_t size = shm_ring_get_size(ring);
+	int fds[2] = { shm_ring_get_mem_fd(ring),
+					shm_ring_get_event_fd(ring) };
+	char control[CMSG_SPACE(sizeof(fds))];
+	struct iovec iov = { .iov_base = &size, .iov_len = sizeof(size) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static struct shm_ring *create_ring(struct characteristic *chrc,
+					struct sock_io *sio, int fd, bool dir)
+{
+	struct shm_ring *ring;
+	int err;
+
+	ring = shm_ring_new(sio->ring_size);
+	if (!ring) {
+		error("%s: unable to create ring: %s", chrc->path,
+							strerror(errno));
+		return NULL;
+	}
+
+	err = ring_send(fd, ring);
+	if (err < 0) {
+		error("%s: unable to send ring: %s", chrc->path,
+							strerror(-err));
+		goto fail;
+	}
+
+	/* Notifications are produced here, there is nothing to wait for */
+	if (!dir)
+		return ring;
+
+	sio->ring_io = io_new(shm_ring_get_event_fd(ring));
+	if (!sio->ring_io)
+		goto fail;
+
+	if (!io_set_read_handler(sio->ring_io, ring_read, chrc, NULL)) {
+		io_destroy(sio->ring_io);
+		sio->ring_io = NULL;
+		goto fail;
+	}
+
+	shm_ring_prepare_wait(ring);
+
+	return ring;
+
+fail:
+	shm_ring_free(ring);
+	return NULL;
+}
+
 static DBusMessage *create_sock(struct characteristic *chrc, DBusMessage *msg)
 {
 	struct bt_gatt_client *gatt = chrc->service->client->gatt;
@@ -1154,6 +1337,7 @@ static DBusMessage *create_sock(struct characteristic *chrc, DBusMessage *msg)
 	bool dir;
 	uint16_t mtu;
 	DBusMessage *reply;
+	struct sock_io *sio;
 
 	if (!gatt || !bt_gatt_client_is_ready(gatt))
 		return btd_error_failed(msg, "Not connected");
@@ -1179,6 +1363,14 @@ static DBusMessage *create_sock(struct characteristic *chrc, DBusMessage *msg)
 	if (!io_set_disconnect_handler(io, sock_hup, chrc, NULL))
 		goto fail;
 
+	sio = dir ? chrc->write_io : chrc->notify_io;
+
+	if (sio->ring_size) {
+		sio->ring = create_ring(chrc, sio, fds[!dir], dir);
+		if (!sio->ring)
+			goto fail;
+	}
+
 	mtu = bt_gatt_client_get_mtu(gatt);
 
 	reply = g_dbus_create_reply(msg, DBUS_TYPE_UNIX_FD, &fds[dir],
@@ -1245,6 +1437,8 @@ static DBusMessage *characteristic_acquire_write(DBusConnection *conn,
 {
 	struct characteristic *chrc = user_data;
 	struct bt_gatt_client *gatt = chrc->service->client->gatt;
+	DBusMessageIter iter;
+	uint32_t ring_size = 0;
 
 	if (!gatt)
 		return btd_error_failed(msg, "Not connected");
@@ -1255,7 +1449,13 @@ static DBusMessage *characteristic_acquire_write(DBusConnection *conn,
 	if (!(chrc->props & BT_GATT_CHRC_PROP_WRITE_WITHOUT_RESP))
 		return btd_error_not_supported(msg);
 
+	dbus_message_iter_init(msg, &iter);
+
+	if (parse_acquire_options(&iter, &ring_size, NULL))
+		return btd_error_invalid_args(msg);
+
 	chrc->write_io = new0(struct sock_io, 1);
+	chrc->write_io->ring_size = ring_size;
 
 	if (!bt_gatt_client_is_ready(gatt)) {
 		/* GATT not ready, wait until it becomes ready */
@@ -1436,29 +1636,74 @@ static void register_notify_cb(uint16_t att_ecode, void *user_data)
 	create_notify_reply(op, true, 0);
 }
 
-static void notify_io_cb(uint16_t value_handle, const uint8_t *value,
-					uint16_t length, void *user_data)
+static void notify_io_cb(uint16_t value_handle, const struct iovec *values,
+					unsigned int count, void *user_data)
 {
-	struct msghdr msg;
-	struct iovec iov;
+	struct mmsghdr msgs[NFY_BATCH_MAX];
 	struct notify_client *client = user_data;
 	struct characteristic *chrc = client->chrc;
+	unsigned int i, n, sent;
 	int err;
 
 	/* Drop notification if the sock is not ready */
 	if (!chrc->notify_io || !chrc->notify_io->io)
 		return;
 
+	if (chrc->notify_io->ring) {
+		struct shm_ring *ring = chrc->notify_io->ring;
+
+		/* One doorbell at most for the whole batch */
+		i = shm_ring_pushv(ring, values, count);
+		shm_ring_kick(ring);
+
+		if (i < count)
+			DBG("%s: dropped %u notifications", chrc->path,
+								count - i);
+		return;
+	}
+
+	/*
+	 * Each value is sent as its own packet so the boundaries between
+	 * notifications are preserved, but up to NFY_BATCH_MAX of them take
+	 * a single system call.
+	 */
+	memset(msgs, 0, sizeof(msgs));
+
+	for (sent = 0; sent < count; sent += n) {
+		n = MIN(count - sent, NFY_BATCH_MAX);
+
+		for (i = 0; i < n; i++) {
+			msgs[i].msg_hdr.msg_iov =
+					(struct iovec *) &values[sent + i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		err = sendmmsg(io_get_fd(chrc->notify_io->io), msgs, n,
+								MSG_NOSIGNAL);
+		if (err < 0) {
+			error("sendmmsg: %s", strerror(errno));
+			break;
+		}
+
+		if ((unsigned int) err < n) {
+			sent += err;
+			break;
+		}
+	}
+
+	if (sent < count)
+		DBG("%s: dropped %u notifications", chrc->path, count - sent);
+}
+
+static void notify_io_value_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	struct iovec iov;
+
 	iov.iov_base = (void *) value;
 	iov.iov_len = length;
 
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-
-	err = sendmsg(io_get_fd(chrc->notify_io->io), &msg, MSG_NOSIGNAL);
-	if (err < 0)
-		error("sendmsg: %s", strerror(errno));
+	notify_io_cb(value_handle, &iov, 1, user_data);
 }
 
 static void register_notify_io_cb(uint16_t att_ecode, void *user_data)
@@ -1499,6 +1744,9 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 	struct bt_gatt_client *gatt = chrc->service->client->gatt;
 	const char *sender = dbus_message_get_sender(msg);
 	struct notify_client *client;
+	DBusMessageIter iter;
+	uint32_t ring_size = 0;
+	bool batch = false;
 
 	if (!gatt)
 		return btd_error_failed(msg, "Not connected");
@@ -1513,15 +1761,28 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 	if (!(chrc->props & BT_GATT_CHRC_PROP_NOTIFY))
 		return btd_error_not_supported(msg);
 
+	dbus_message_iter_init(msg, &iter);
+
+	if (parse_acquire_options(&iter, &ring_size, &batch))
+		return btd_error_invalid_args(msg);
+
 	client = notify_client_create(chrc, sender);
 	if (!client)
 		return btd_error_failed(msg, "Failed allocate notify session");
 
-	client->notify_id = bt_gatt_client_register_notify(gatt,
+	/* Batching delays values by up to 10 ms so only do it on request */
+	if (batch)
+		client->notify_id = bt_gatt_client_register_notify_batch(gatt,
 						chrc->value_handle,
 						register_notify_io_cb,
 						notify_io_cb,
 						client, NULL);
+	else
+		client->notify_id = bt_gatt_client_register_notify(gatt,
+						chrc->value_handle,
+						register_notify_io_cb,
+						notify_io_value_cb,
+						client, NULL);
 	if (!client->notify_id) {
 		notify_client_unref(client);
 		return btd_error_failed(msg, "Failed to subscribe");
@@ -1530,6 +1791,7 @@ static DBusMessage *characteristic_acquire_notify(DBusConnection *conn,
 	queue_push_tail(chrc->notify_clients, client);
 
 	chrc->notify_io = new0(struct sock_io, 1);
+	chrc->notify_io->ring_size = ring_size;
 	chrc->notify_io->data = client;
 	chrc->notify_io->msg = dbus_message_ref(msg);
 	chrc->notify_io->destroy = notify_io_destroy;
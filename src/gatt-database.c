@@ -134,6 +134,8 @@ struct external_chrc {
 	unsigned int ntfy_cnt;
 	bool prep_authorized;
 	bool req_prep_authorization;
+	bool cache_value;
+	bool value_valid;
 };
 
 struct external_desc {
@@ -147,6 +149,8 @@ struct external_desc {
 	struct queue *pending_writes;
 	bool prep_authorized;
 	bool req_prep_authorization;
+	bool cache_value;
+	bool value_valid;
 };
 
 struct pending_op {
@@ -180,6 +184,7 @@ struct device_state {
 	bool out_of_sync;
 	struct queue *ccc_states;
 	struct notify *pending;
+	struct bt_gatt_server *server;	/* Cached while connected */
 };
 
 typedef uint8_t (*btd_gatt_database_ccc_write_t) (struct pending_op *op,
@@ -187,6 +192,7 @@ typedef uint8_t (*btd_gatt_database_ccc_write_t) (struct pending_op *op,
 typedef void (*btd_gatt_database_destroy_t) (void *data);
 
 struct ccc_state {
+	struct device_state *state;
 	uint16_t handle;
 	uint16_t value;
 };
@@ -196,6 +202,7 @@ struct ccc_cb_data {
 	btd_gatt_database_ccc_write_t callback;
 	btd_gatt_database_destroy_t destroy;
 	void *user_data;
+	struct queue *subscribers;	/* ccc_state entries with a value set */
 };
 
 struct device_info {
@@ -210,6 +217,7 @@ static void ccc_cb_free(void *data)
 	if (ccc_cb->destroy)
 		ccc_cb->destroy(ccc_cb->user_data);
 
+	queue_destroy(ccc_cb->subscribers, NULL);
 	free(ccc_cb);
 }
 
@@ -271,6 +279,32 @@ static struct ccc_state *find_ccc_state(struct device_state *dev_state,
 							UINT_TO_PTR(handle));
 }
 
+static void ccc_state_set_value(struct ccc_state *ccc, uint16_t value)
+{
+	struct btd_gatt_database *db = ccc->state->db;
+	struct ccc_cb_data *ccc_cb;
+
+	/* Keep the subscriber index of the CCC in sync with the value */
+	ccc_cb = queue_find(db->ccc_callbacks, ccc_cb_match_handle,
+						UINT_TO_PTR(ccc->handle));
+	if (ccc_cb) {
+		if (!ccc->value && value)
+			queue_push_tail(ccc_cb->subscribers, ccc);
+		else if (ccc->value && !value)
+			queue_remove(ccc_cb->subscribers, ccc);
+	}
+
+	ccc->value = value;
+}
+
+static void ccc_state_free(void *data)
+{
+	struct ccc_state *ccc = data;
+
+	ccc_state_set_value(ccc, 0);
+	free(ccc);
+}
+
 static struct device_state *device_state_create(struct btd_gatt_database *db,
 							const bdaddr_t *bdaddr,
 							uint8_t bdaddr_type)
@@ -290,7 +324,7 @@ static void device_state_free(void *data)
 {
 	struct device_state *state = data;
 
-	queue_destroy(state->ccc_states, free);
+	queue_destroy(state->ccc_states, ccc_state_free);
 
 	if (state->pending) {
 		free(state->pending->value);
@@ -327,6 +361,7 @@ static void att_disconnected(int err, void *user_data)
 
 	state->disc_id = 0;
 	state->out_of_sync = false;
+	state->server = NULL;
 
 	device = btd_adapter_find_device(state->db->adapter, &state->bdaddr,
 							state->bdaddr_type);
@@ -429,6 +464,7 @@ static struct ccc_state *get_ccc_state(struct btd_gatt_database *database,
 		return ccc;
 
 	ccc = new0(struct ccc_state, 1);
+	ccc->state = dev_state;
 	ccc->handle = handle;
 	queue_push_tail(dev_state->ccc_states, ccc);
 
@@ -479,6 +515,7 @@ static void desc_free(void *data)
 	queue_destroy(desc->pending_reads, cancel_pending_read);
 	queue_destroy(desc->pending_writes, cancel_pending_write);
 
+	g_dbus_proxy_set_property_watch(desc->proxy, NULL, NULL);
 	g_dbus_proxy_unref(desc->proxy);
 	g_free(desc->chrc_path);
 
@@ -1026,7 +1063,7 @@ static void gatt_ccc_write_cb(struct gatt_db_attribute *attrib,
 	}
 
 	if (!ecode)
-		ccc->value = val;
+		ccc_state_set_value(ccc, val);
 
 done:
 	gatt_db_attribute_write_result(attrib, id, ecode);
@@ -1056,6 +1093,7 @@ service_add_ccc(struct gatt_db_attribute *service,
 	}
 
 	ccc_cb->handle = gatt_db_attribute_get_handle(ccc);
+	ccc_cb->subscribers = queue_new();
 	ccc_cb->callback = write_callback;
 	ccc_cb->destroy = destroy;
 	ccc_cb->user_data = user_data;
@@ -1335,29 +1373,21 @@ static void state_set_pending(struct device_state *state, struct notify *notify)
 	memcpy(state->pending->value, notify->value, notify->len);
 }
 
-static void send_notification_to_device(void *data, void *user_data)
+static void send_notification_to_ccc(void *data, void *user_data)
 {
-	struct device_state *device_state = data;
+	struct ccc_state *ccc = data;
+	struct device_state *device_state = ccc->state;
 	struct notify *notify = user_data;
-	struct ccc_state *ccc;
 	struct btd_device *device;
 	struct bt_gatt_server *server;
 
-	if (notify->conf == service_changed_conf) {
-		if (device_state->cli_feat[0] &
-				BT_GATT_CHRC_CLI_FEAT_ROBUST_CACHING) {
-			device_state->change_aware = false;
-			notify->user_data = device_state;
-		}
-	}
-
-	ccc = find_ccc_state(device_state, notify->ccc_handle);
-	if (!ccc)
-		return;
-
 	if (!ccc->value || (notify->conf && !(ccc->value & 0x0002)))
 		return;
 
+	server = device_state->server;
+	if (server)
+		goto send;
+
 	device = btd_adapter_get_device(notify->database->adapter,
 						&device_state->bdaddr,
 						device_state->bdaddr_type);
@@ -1372,6 +1402,9 @@ static void send_notification_to_device(void *data, void *user_data)
 		return;
 	}
 
+	device_state->server = server;
+
+send:
 	/*
 	 * TODO: If the device is not connected but bonded, send the
 	 * notification/indication when it becomes connected.
@@ -1401,6 +1434,27 @@ remove:
 	}
 }
 
+static void send_notification_to_device(void *data, void *user_data)
+{
+	struct device_state *device_state = data;
+	struct notify *notify = user_data;
+	struct ccc_state *ccc;
+
+	if (notify->conf == service_changed_conf) {
+		if (device_state->cli_feat[0] &
+				BT_GATT_CHRC_CLI_FEAT_ROBUST_CACHING) {
+			device_state->change_aware = false;
+			notify->user_data = device_state;
+		}
+	}
+
+	ccc = find_ccc_state(device_state, notify->ccc_handle);
+	if (!ccc)
+		return;
+
+	send_notification_to_ccc(ccc, notify);
+}
+
 static void send_notification_to_devices(struct btd_gatt_database *database,
 					uint16_t handle, uint8_t *value,
 					uint16_t len, uint16_t ccc_handle,
@@ -1408,6 +1462,7 @@ static void send_notification_to_devices(struct btd_gatt_database *database,
 					void *user_data)
 {
 	struct notify notify;
+	struct ccc_cb_data *ccc_cb;
 
 	memset(&notify, 0, sizeof(notify));
 
@@ -1419,8 +1474,22 @@ static void send_notification_to_devices(struct btd_gatt_database *database,
 	notify.conf = conf;
 	notify.user_data = user_data;
 
-	queue_foreach(database->device_states, send_notification_to_device,
-								&notify);
+	/*
+	 * Service Changed has to visit every device in order to track its
+	 * change awareness, anything else only needs the subscribers.
+	 */
+	if (conf == service_changed_conf) {
+		queue_foreach(database->device_states,
+					send_notification_to_device, &notify);
+		return;
+	}
+
+	ccc_cb = queue_find(database->ccc_callbacks, ccc_cb_match_handle,
+						UINT_TO_PTR(ccc_handle));
+	if (!ccc_cb)
+		return;
+
+	queue_foreach(ccc_cb->subscribers, send_notification_to_ccc, &notify);
 }
 
 static void send_service_changed(struct btd_gatt_database *database,
@@ -1479,7 +1548,8 @@ static void remove_device_ccc(void *data, void *user_data)
 {
 	struct device_state *state = data;
 
-	queue_remove_all(state->ccc_states, ccc_match_service, user_data, free);
+	queue_remove_all(state->ccc_states, ccc_match_service, user_data,
+							ccc_state_free);
 }
 
 static bool match_gatt_record(const void *data, const void *user_data)
@@ -1602,7 +1672,8 @@ static bool incr_attr_count(struct external_service *service, uint16_t incr)
 
 static bool parse_chrc_flags(DBusMessageIter *array, uint8_t *props,
 					uint8_t *ext_props, uint32_t *perm,
-					bool *req_prep_authorization)
+					bool *req_prep_authorization,
+					bool *cache_value)
 {
 	const char *flag;
 
@@ -1665,6 +1736,8 @@ static bool parse_chrc_flags(DBusMessageIter *array, uint8_t *props,
 			*perm |= BT_ATT_PERM_WRITE | BT_ATT_PERM_WRITE_SECURE;
 		} else if (!strcmp("authorize", flag)) {
 			*req_prep_authorization = true;
+		} else if (!strcmp("cache-value", flag)) {
+			*cache_value = true;
 		} else {
 			error("Invalid characteristic flag: %s", flag);
 			return false;
@@ -1678,7 +1751,8 @@ static bool parse_chrc_flags(DBusMessageIter *array, uint8_t *props,
 }
 
 static bool parse_desc_flags(DBusMessageIter *array, uint32_t *perm,
-						bool *req_prep_authorization)
+						bool *req_prep_authorization,
+						bool *cache_value)
 {
 	const char *flag;
 
@@ -1708,6 +1782,8 @@ static bool parse_desc_flags(DBusMessageIter *array, uint32_t *perm,
 			*perm |= BT_ATT_PERM_WRITE | BT_ATT_PERM_WRITE_SECURE;
 		else if (!strcmp("authorize", flag))
 			*req_prep_authorization = true;
+		else if (!strcmp("cache-value", flag))
+			*cache_value = true;
 		else {
 			error("Invalid descriptor flag: %s", flag);
 			return false;
@@ -1718,7 +1794,8 @@ static bool parse_desc_flags(DBusMessageIter *array, uint32_t *perm,
 }
 
 static bool parse_flags(GDBusProxy *proxy, uint8_t *props, uint8_t *ext_props,
-				uint32_t *perm, bool *req_prep_authorization)
+				uint32_t *perm, bool *req_prep_authorization,
+				bool *cache_value)
 {
 	DBusMessageIter iter, array;
 	const char *iface;
@@ -1733,10 +1810,11 @@ static bool parse_flags(GDBusProxy *proxy, uint8_t *props, uint8_t *ext_props,
 
 	iface = g_dbus_proxy_get_interface(proxy);
 	if (!strcmp(iface, GATT_DESC_IFACE))
-		return parse_desc_flags(&array, perm, req_prep_authorization);
+		return parse_desc_flags(&array, perm, req_prep_authorization,
+								cache_value);
 
 	return parse_chrc_flags(&array, props, ext_props, perm,
-							req_prep_authorization);
+					req_prep_authorization, cache_value);
 }
 
 static struct external_chrc *chrc_create(struct gatt_app *app,
@@ -1785,7 +1863,8 @@ static struct external_chrc *chrc_create(struct gatt_app *app,
 	 * created.
 	 */
 	if (!parse_flags(proxy, &chrc->props, &chrc->ext_props, &chrc->perm,
-					&chrc->req_prep_authorization)) {
+					&chrc->req_prep_authorization,
+					&chrc->cache_value)) {
 		error("Failed to parse characteristic properties");
 		goto fail;
 	}
@@ -1868,7 +1947,8 @@ static struct external_desc *desc_create(struct gatt_app *app,
 	 * determine the permission the descriptor should have
 	 */
 	if (!parse_flags(proxy, NULL, NULL, &desc->perm,
-					&desc->req_prep_authorization)) {
+					&desc->req_prep_authorization,
+					&desc->cache_value)) {
 		error("Failed to parse characteristic properties");
 		goto fail;
 	}
@@ -2229,6 +2309,44 @@ static void read_setup_cb(DBusMessageIter *iter, void *user_data)
 	dbus_message_iter_close_container(iter, &dict);
 }
 
+static bool send_cached_read(GDBusProxy *proxy,
+					struct gatt_db_attribute *attrib,
+					unsigned int id, uint16_t offset)
+{
+	DBusMessageIter iter, array;
+	uint8_t *value = NULL;
+	int len = 0;
+
+	/* The proxy keeps the last Value set through PropertiesChanged */
+	if (!g_dbus_proxy_get_property(proxy, "Value", &iter))
+		return false;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+		return false;
+
+	dbus_message_iter_recurse(&iter, &array);
+	dbus_message_iter_get_fixed_array(&array, &value, &len);
+
+	if (len < 0)
+		return false;
+
+	/* Truncate the value if it's too large */
+	len = MIN(BT_ATT_MAX_VALUE_LEN, len);
+
+	if (offset > len) {
+		gatt_db_attribute_read_result(attrib, id,
+					BT_ATT_ERROR_INVALID_OFFSET, NULL, 0);
+		return true;
+	}
+
+	len -= offset;
+	value = len ? value + offset : NULL;
+
+	gatt_db_attribute_read_result(attrib, id, 0, value, len);
+
+	return true;
+}
+
 static struct pending_op *send_read(struct btd_device *device,
 					struct gatt_db_attribute *attrib,
 					GDBusProxy *proxy,
@@ -2718,6 +2836,12 @@ static void property_changed_cb(GDBusProxy *proxy, const char *name,
 	len = MIN(BT_ATT_MAX_VALUE_LEN, len);
 	value = len ? value : NULL;
 
+	if (chrc->cache_value)
+		chrc->value_valid = true;
+
+	if (!chrc->ccc)
+		return;
+
 	send_notification_to_devices(chrc->service->app->database,
 				gatt_db_attribute_get_handle(chrc->attrib),
 				value, len,
@@ -2740,17 +2864,27 @@ static bool database_add_ccc(struct external_service *service,
 		return false;
 	}
 
-	if (g_dbus_proxy_set_property_watch(chrc->proxy, property_changed_cb,
-							chrc) == FALSE) {
-		error("Failed to set up property watch for characteristic");
-		return false;
-	}
-
 	DBG("Created CCC entry for characteristic");
 
 	return true;
 }
 
+static void desc_property_changed_cb(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct external_desc *desc = user_data;
+
+	if (strcmp(name, "Value"))
+		return;
+
+	if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY) {
+		DBG("Malformed \"Value\" property received");
+		return;
+	}
+
+	desc->value_valid = true;
+}
+
 static void cep_write_cb(struct gatt_db_attribute *attrib, int err,
 								void *user_data)
 {
@@ -2806,6 +2940,10 @@ static void desc_read_cb(struct gatt_db_attribute *attrib,
 		goto fail;
 	}
 
+	if (desc->value_valid && send_cached_read(desc->proxy, attrib, id,
+								offset))
+		return;
+
 	device = att_get_device(att);
 	if (!device) {
 		error("Unable to find device object");
@@ -2835,6 +2973,9 @@ static void desc_write_cb(struct gatt_db_attribute *attrib,
 		goto fail;
 	}
 
+	/* Serve reads from the application until it sets a new Value */
+	desc->value_valid = false;
+
 	device = att_get_device(att);
 	if (!device) {
 		error("Unable to find device object");
@@ -2884,6 +3025,7 @@ static bool database_add_desc(struct external_service *service,
 	uint16_t handle;
 	bt_uuid_t uuid;
 	char str[MAX_LEN_UUID_STR];
+	DBusMessageIter iter;
 
 	if (!parse_handle(desc->proxy, &handle)) {
 		error("Failed to read \"Handle\" property of descriptor");
@@ -2907,6 +3049,18 @@ static bool database_add_desc(struct external_service *service,
 
 	desc->handled = true;
 
+	if (desc->cache_value) {
+		if (g_dbus_proxy_set_property_watch(desc->proxy,
+						desc_property_changed_cb,
+						desc) == FALSE) {
+			error("Failed to set up property watch for descriptor");
+			return false;
+		}
+
+		desc->value_valid = g_dbus_proxy_get_property(desc->proxy,
+							"Value", &iter);
+	}
+
 	if (!handle) {
 		handle = gatt_db_attribute_get_handle(desc->attrib);
 		write_handle(desc->proxy, handle);
@@ -2932,6 +3086,10 @@ static void chrc_read_cb(struct gatt_db_attribute *attrib,
 		goto fail;
 	}
 
+	if (chrc->value_valid && send_cached_read(chrc->proxy, attrib, id,
+								offset))
+		return;
+
 	device = att_get_device(att);
 	if (!device) {
 		error("Unable to find device object");
@@ -2963,6 +3121,9 @@ static void chrc_write_cb(struct gatt_db_attribute *attrib,
 		goto fail;
 	}
 
+	/* Serve reads from the application until it sets a new Value */
+	chrc->value_valid = false;
+
 	device = att_get_device(att);
 	if (!device) {
 		error("Unable to find device object");
@@ -3051,6 +3212,7 @@ static bool database_add_chrc(struct external_service *service,
 	bt_uuid_t uuid;
 	char str[MAX_LEN_UUID_STR];
 	const struct queue_entry *entry;
+	DBusMessageIter iter;
 
 	if (!parse_handle(chrc->proxy, &handle)) {
 		error("Failed to read \"Handle\" property of characteristic");
@@ -3079,6 +3241,18 @@ static bool database_add_chrc(struct external_service *service,
 	if (!database_add_ccc(service, chrc))
 		return false;
 
+	if ((chrc->ccc || chrc->cache_value) &&
+			g_dbus_proxy_set_property_watch(chrc->proxy,
+						property_changed_cb,
+						chrc) == FALSE) {
+		error("Failed to set up property watch for characteristic");
+		return false;
+	}
+
+	if (chrc->cache_value)
+		chrc->value_valid = g_dbus_proxy_get_property(chrc->proxy,
+							"Value", &iter);
+
 	if (!database_add_cep(service, chrc))
 		return false;
 
@@ -3738,7 +3912,12 @@ void btd_gatt_database_server_connected(struct btd_gatt_database *database,
 	bt_gatt_server_set_authorize(server, server_authorize, database);
 
 	state = find_device_state(database, &bdaddr, bdaddr_type);
-	if (!state || !state->pending)
+	if (!state)
+		return;
+
+	state->server = server;
+
+	if (!state->pending)
 		return;
 
 	send_notification_to_device(state, state->pending);
@@ -3782,8 +3961,9 @@ static void restore_ccc(struct btd_gatt_database *database,
 	queue_push_tail(database->device_states, dev_state);
 
 	ccc = new0(struct ccc_state, 1);
+	ccc->state = dev_state;
 	ccc->handle = gatt_db_attribute_get_handle(database->svc_chngd_ccc);
-	ccc->value = value;
+	ccc_state_set_value(ccc, value);
 	queue_push_tail(dev_state->ccc_states, ccc);
 }
 
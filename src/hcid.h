@@ -54,6 +54,7 @@ struct main_opts {
 	uint32_t	pairto;
 	uint32_t	discovto;
 	uint32_t	tmpto;
+	uint32_t	tmp_max;
 	uint8_t		privacy;
 
 	struct {
@@ -101,6 +102,7 @@ struct main_opts {
 	gboolean	debug_keys;
 	gboolean	fast_conn;
 	gboolean	refresh_discovery;
+	gboolean	export_temporary;
 
 	uint16_t	did_source;
 	uint16_t	did_vendor;
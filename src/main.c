@@ -91,6 +91,8 @@ static const char *supported_options[] = {
 	"Privacy",
 	"JustWorksRepairing",
 	"TemporaryTimeout",
+	"MaxTemporaryDevices",
+	"ExportTemporaryDevices",
 	NULL
 };
 
@@ -543,6 +545,26 @@ static void parse_config(GKeyFile *config)
 		main_opts.tmpto = val;
 	}
 
+	val = g_key_file_get_integer(config, "General",
+						"MaxTemporaryDevices", &err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+	} else {
+		DBG("tmp_max=%d", val);
+		main_opts.tmp_max = val;
+	}
+
+	boolean = g_key_file_get_boolean(config, "General",
+						"ExportTemporaryDevices", &err);
+	if (err) {
+		DBG("%s", err->message);
+		g_clear_error(&err);
+	} else {
+		DBG("export_temporary=%s", boolean ? "true" : "false");
+		main_opts.export_temporary = boolean;
+	}
+
 	str = g_key_file_get_string(config, "General", "Name", &err);
 	if (err) {
 		DBG("%s", err->message);
@@ -696,6 +718,7 @@ static void init_defaults(void)
 	main_opts.name_resolv = TRUE;
 	main_opts.debug_keys = FALSE;
 	main_opts.refresh_discovery = TRUE;
+	main_opts.export_temporary = TRUE;
 
 	main_opts.default_params.num_entries = 0;
 	main_opts.default_params.br_page_scan_type = 0xFFFF;
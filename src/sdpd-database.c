@@ -31,10 +31,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include <glib.h>
+
 #include "lib/bluetooth.h"
 #include "lib/sdp.h"
 #include "lib/sdp_lib.h"
 
+#include "src/shared/util.h"
+
 #include "sdpd.h"
 #include "log.h"
 
@@ -46,6 +50,24 @@ typedef struct {
 	bdaddr_t device;
 } sdp_access_t;
 
+/*
+ * Inverted index from the UUIDs found in the records to the records
+ * containing them, in handle order. It is hashed by 128-bit UUID and
+ * rebuilt on the next lookup after the repository changed.
+ */
+typedef struct {
+	uuid_t uuid;
+	int count;
+	sdp_list_t *records;
+	sdp_list_t *last;
+} sdp_uuid_index_t;
+
+static GHashTable *uuid_index;
+static bool uuid_index_valid;
+
+/* Serialized records, hashed by handle and built on first use */
+static GHashTable *pdu_cache;
+
 /*
  * Ordering function called when inserting a service record.
  * The service repository is a linked list in sorted order
@@ -82,6 +104,107 @@ static void access_free(void *p)
 	free(p);
 }
 
+static void uuid_index_free(void *p)
+{
+	sdp_uuid_index_t *entry = p;
+
+	sdp_list_free(entry->records, NULL);
+	free(entry);
+}
+
+static guint uuid128_hash(gconstpointer key)
+{
+	const uuid_t *uuid = key;
+	const uint8_t *data = (const uint8_t *) &uuid->value.uuid128;
+	guint hash = 5381;
+	size_t i;
+
+	for (i = 0; i < sizeof(uint128_t); i++)
+		hash = hash * 33 + data[i];
+
+	return hash;
+}
+
+static gboolean uuid128_equal(gconstpointer a, gconstpointer b)
+{
+	return sdp_uuid128_cmp(a, b) == 0;
+}
+
+static void uuid_index_reset(void)
+{
+	if (uuid_index)
+		g_hash_table_remove_all(uuid_index);
+
+	uuid_index_valid = false;
+}
+
+static void uuid_index_build(void)
+{
+	sdp_list_t *l, *p;
+
+	if (!uuid_index)
+		uuid_index = g_hash_table_new_full(uuid128_hash, uuid128_equal,
+							NULL, uuid_index_free);
+
+	uuid_index_reset();
+
+	for (l = service_db; l; l = l->next) {
+		sdp_record_t *rec = l->data;
+
+		for (p = rec->pattern; p; p = p->next) {
+			sdp_uuid_index_t *entry;
+			sdp_list_t *node;
+
+			if (!p->data)
+				continue;
+
+			entry = g_hash_table_lookup(uuid_index, p->data);
+			if (!entry) {
+				entry = malloc(sizeof(*entry));
+				if (!entry)
+					continue;
+
+				memcpy(&entry->uuid, p->data, sizeof(uuid_t));
+				entry->count = 0;
+				entry->records = NULL;
+				entry->last = NULL;
+				g_hash_table_insert(uuid_index, &entry->uuid,
+									entry);
+			}
+
+			node = sdp_list_append(NULL, rec);
+			if (!node)
+				continue;
+
+			/* Records are visited in handle order */
+			if (entry->last)
+				entry->last->next = node;
+			else
+				entry->records = node;
+
+			entry->last = node;
+			entry->count++;
+		}
+	}
+
+	uuid_index_valid = true;
+}
+
+static void pdu_cache_free(void *p)
+{
+	sdp_record_pdu_t *cache = p;
+
+	free(cache->pdu.data);
+	free(cache->attrs);
+	free(cache);
+}
+
+static void pdu_cache_remove(uint32_t handle)
+{
+	if (pdu_cache)
+		g_hash_table_remove(pdu_cache, GUINT_TO_POINTER(handle));
+}
+
 /*
  * Reset the service repository by deleting its contents
  */
@@ -92,6 +215,18 @@ void sdp_svcdb_reset(void)
 
 	sdp_list_free(access_db, access_free);
 	access_db = NULL;
+
+	if (pdu_cache) {
+		g_hash_table_destroy(pdu_cache);
+		pdu_cache = NULL;
+	}
+
+	if (uuid_index) {
+		g_hash_table_destroy(uuid_index);
+		uuid_index = NULL;
+	}
+
+	uuid_index_valid = false;
 }
 
 typedef struct _indexed {
@@ -180,6 +315,7 @@ void sdp_record_add(const bdaddr_t *device, sdp_record_t *rec)
 	SDPDBG("with handle : 0x%x", rec->handle);
 
 	service_db = sdp_list_insert_sorted(service_db, rec, record_sort);
+	sdp_record_changed(rec->handle);
 
 	dev = malloc(sizeof(*dev));
 	if (!dev)
@@ -254,6 +390,8 @@ int sdp_record_remove(uint32_t handle)
 	if (r)
 		service_db = sdp_list_remove(service_db, r);
 
+	sdp_record_changed(handle);
+
 	p = access_locate(handle);
 	if (p == NULL || p->data == NULL)
 		return 0;
@@ -303,3 +441,182 @@ uint32_t sdp_next_handle(void)
 
 	return handle;
 }
+
+/*
+ * Must be called whenever a record that may already have been served is
+ * modified, so that its serialized form and the UUID index are rebuilt.
+ */
+void sdp_record_changed(uint32_t handle)
+{
+	pdu_cache_remove(handle);
+	uuid_index_valid = false;
+}
+
+/*
+ * Return the records containing the given UUID, in handle order, and
+ * their number in count.
+ */
+sdp_list_t *sdp_uuid_find_records(const uuid_t *uuid, int *count)
+{
+	sdp_uuid_index_t *entry;
+	uuid_t *uuid128;
+
+	if (!uuid_index_valid)
+		uuid_index_build();
+
+	uuid128 = sdp_uuid_to_uuid128(uuid);
+	if (!uuid128)
+		return NULL;
+
+	entry = g_hash_table_lookup(uuid_index, uuid128);
+	bt_free(uuid128);
+
+	if (!entry) {
+		*count = 0;
+		return NULL;
+	}
+
+	*count = entry->count;
+
+	return entry->records;
+}
+
+/* Size of the data element at p including its header, or -1 */
+static int element_size(const uint8_t *p, uint32_t len)
+{
+	uint32_t size;
+	int hdr = 1;
+
+	if (len < 1)
+		return -1;
+
+	switch (p[0] & 0x07) {
+	case 0:
+		size = p[0] == SDP_DATA_NIL ? 0 : 1;
+		break;
+	case 1:
+		size = 2;
+		break;
+	case 2:
+		size = 4;
+		break;
+	case 3:
+		size = 8;
+		break;
+	case 4:
+		size = 16;
+		break;
+	case 5:
+		if (len < 2)
+			return -1;
+		size = p[1];
+		hdr += 1;
+		break;
+	case 6:
+		if (len < 3)
+			return -1;
+		size = get_be16(p + 1);
+		hdr += 2;
+		break;
+	default:
+		if (len < 5)
+			return -1;
+		size = get_be32(p + 1);
+		hdr += 4;
+		break;
+	}
+
+	if (hdr + size > len)
+		return -1;
+
+	return hdr + size;
+}
+
+static sdp_record_pdu_t *pdu_cache_new(sdp_record_t *rec)
+{
+	sdp_record_pdu_t *cache;
+	sdp_list_t *l;
+	uint32_t offset;
+	uint8_t dtd;
+	int size, i;
+
+	cache = malloc(sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->handle = rec->handle;
+
+	if (sdp_gen_record_pdu(rec, &cache->pdu) < 0) {
+		free(cache);
+		return NULL;
+	}
+
+	/* Locate each attribute id and value pair in the sequence */
+	offset = sdp_extract_seqtype(cache->pdu.data, cache->pdu.data_size,
+								&dtd, &size);
+
+	cache->num_attrs = sdp_list_len(rec->attrlist);
+	if (!cache->num_attrs)
+		return cache;
+
+	cache->attrs = malloc(cache->num_attrs * sizeof(*cache->attrs));
+	if (!cache->attrs || !offset)
+		goto failed;
+
+	for (l = rec->attrlist, i = 0; l; l = l->next, i++) {
+		sdp_data_t *d = l->data;
+		int id_len, val_len;
+
+		id_len = element_size(cache->pdu.data + offset,
+					cache->pdu.data_size - offset);
+		if (id_len < 0)
+			goto failed;
+
+		val_len = element_size(cache->pdu.data + offset + id_len,
+					cache->pdu.data_size - offset - id_len);
+		if (val_len < 0)
+			goto failed;
+
+		cache->attrs[i].attr = d->attrId;
+		cache->attrs[i].offset = offset;
+		cache->attrs[i].len = id_len + val_len;
+
+		offset += id_len + val_len;
+	}
+
+	return cache;
+
+failed:
+	/* The whole record can still be served, just not by attribute */
+	error("Unable to index attributes of record 0x%x", rec->handle);
+	free(cache->attrs);
+	cache->attrs = NULL;
+	cache->num_attrs = 0;
+
+	return cache;
+}
+
+/*
+ * Return the serialized form of the record, generating it on first use.
+ */
+const sdp_record_pdu_t *sdp_record_get_pdu(sdp_record_t *rec)
+{
+	sdp_record_pdu_t *cache;
+
+	if (!pdu_cache)
+		pdu_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+							NULL, pdu_cache_free);
+
+	cache = g_hash_table_lookup(pdu_cache, GUINT_TO_POINTER(rec->handle));
+	if (cache)
+		return cache;
+
+	cache = pdu_cache_new(rec);
+	if (!cache)
+		return NULL;
+
+	g_hash_table_insert(pdu_cache, GUINT_TO_POINTER(rec->handle), cache);
+
+	return cache;
+}
@@ -361,6 +361,39 @@ static int sdp_match_uuid(sdp_list_t *search, sdp_list_t *pattern)
 	return 1;
 }
 
+/*
+ * Return the records that may match the search pattern, in handle order.
+ * Only the records containing the least common UUID of the pattern need
+ * to be checked with sdp_match_uuid().
+ */
+static sdp_list_t *search_candidates(sdp_list_t *search)
+{
+	sdp_list_t *best = NULL;
+	int best_count = INT_MAX;
+
+	if (!search)
+		return sdp_get_record_list();
+
+	for (; search; search = search->next) {
+		sdp_list_t *records;
+		int count;
+
+		if (!search->data)
+			return NULL;
+
+		records = sdp_uuid_find_records(search->data, &count);
+		if (!records)
+			return NULL;
+
+		if (count < best_count) {
+			best = records;
+			best_count = count;
+		}
+	}
+
+	return best;
+}
+
 /*
  * Service search request PDU. This method extracts the search pattern
  * (a sequence of UUIDs) and calls the matching function
@@ -438,8 +471,8 @@ static int service_search_req(sdp_req_t *req, sdp_buf_t *buf)
 	buf->data_size += sizeof(uint16_t);
 
 	if (cstate == NULL) {
-		/* for every record in the DB, do a pattern search */
-		sdp_list_t *list = sdp_get_record_list();
+		/* for every candidate record, do a pattern search */
+		sdp_list_t *list = search_candidates(pattern);
 
 		handleSize = 0;
 		for (; list && rsp_count < expected; list = list->next) {
@@ -566,9 +599,43 @@ done:
  * requested identifiers are present in the PDU form of
  * the request
  */
+static void append_attrs(sdp_record_t *rec, const sdp_record_pdu_t *cache,
+				uint16_t low, uint16_t high, sdp_buf_t *buf)
+{
+	int i;
+
+	/* An inverted range only ever returned its high attribute */
+	if (low > high)
+		low = high;
+
+	if (!cache->attrs) {
+		uint32_t attr;
+
+		for (attr = low; attr <= high; attr++) {
+			sdp_data_t *data = sdp_data_get(rec, attr);
+			if (data)
+				sdp_append_to_pdu(buf, data);
+		}
+
+		return;
+	}
+
+	for (i = 0; i < cache->num_attrs; i++) {
+		const sdp_attr_pdu_t *a = &cache->attrs[i];
+
+		if (a->attr < low)
+			continue;
+
+		if (a->attr > high)
+			break;
+
+		sdp_append_to_buf(buf, cache->pdu.data + a->offset, a->len);
+	}
+}
+
 static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 {
-	sdp_buf_t pdu;
+	const sdp_record_pdu_t *cache;
 
 	if (!rec)
 		return SDP_INVALID_RECORD_HANDLE;
@@ -580,7 +647,9 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 	SDPDBG("Entries in attr seq : %d", sdp_list_len(seq));
 
-	sdp_gen_record_pdu(rec, &pdu);
+	cache = sdp_record_get_pdu(rec);
+	if (!cache)
+		return SDP_INVALID_SYNTAX;
 
 	for (; seq; seq = seq->next) {
 		struct attrid *aid = seq->data;
@@ -589,45 +658,35 @@ static int extract_attrs(sdp_record_t *rec, sdp_list_t *seq, sdp_buf_t *buf)
 
 		if (aid->dtd == SDP_UINT16) {
 			uint16_t attr = aid->uint16;
-			sdp_data_t *a = sdp_data_get(rec, attr);
-			if (a)
-				sdp_append_to_pdu(buf, a);
+
+			append_attrs(rec, cache, attr, attr, buf);
 		} else if (aid->dtd == SDP_UINT32) {
 			uint32_t range = aid->uint32;
-			uint16_t attr;
 			uint16_t low = (0xffff0000 & range) >> 16;
 			uint16_t high = 0x0000ffff & range;
-			sdp_data_t *data;
 
 			SDPDBG("attr range : 0x%x", range);
 			SDPDBG("Low id : 0x%x", low);
 			SDPDBG("High id : 0x%x", high);
 
-			if (low == 0x0000 && high == 0xffff && pdu.data_size <= buf->buf_size) {
+			if (low == 0x0000 && high == 0xffff &&
+					cache->pdu.data_size <= buf->buf_size) {
 				/* copy it */
-				memcpy(buf->data, pdu.data, pdu.data_size);
-				buf->data_size = pdu.data_size;
+				memcpy(buf->data, cache->pdu.data,
+							cache->pdu.data_size);
+				buf->data_size = cache->pdu.data_size;
 				break;
 			}
+
 			/* (else) sub-range of attributes */
-			for (attr = low; attr < high; attr++) {
-				data = sdp_data_get(rec, attr);
-				if (data)
-					sdp_append_to_pdu(buf, data);
-			}
-			data = sdp_data_get(rec, high);
-			if (data)
-				sdp_append_to_pdu(buf, data);
+			append_attrs(rec, cache, low, high, buf);
 		} else {
 			error("Unexpected data type : 0x%x", aid->dtd);
 			error("Expect uint16_t or uint32_t");
-			free(pdu.data);
 			return SDP_INVALID_SYNTAX;
 		}
 	}
 
-	free(pdu.data);
-
 	return 0;
 }
 
@@ -795,6 +854,13 @@ done:
 	return 0;
 }
 
+/*
+ * Scratch buffer for the attributes of one record, reused across requests.
+ * Only its first byte needs clearing between uses since that's what
+ * sdp_append_to_buf() checks to start a new sequence.
+ */
+static uint8_t *attr_buf;
+
 /*
  * combined service search and attribute extraction
  */
@@ -811,7 +877,6 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 	sdp_buf_t tmpbuf;
 	size_t data_left;
 
-	tmpbuf.data = NULL;
 	pdata = req->buf + sizeof(sdp_pdu_hdr_t);
 	data_left = req->len - sizeof(sdp_pdu_hdr_t);
 	scanned = extract_des(pdata, data_left, &pattern, &dtd, SDP_TYPE_UUID);
@@ -870,12 +935,20 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 		goto done;
 	}
 
-	svcList = sdp_get_record_list();
+	svcList = search_candidates(pattern);
 
-	tmpbuf.data = malloc(USHRT_MAX);
+	if (!attr_buf) {
+		attr_buf = malloc(USHRT_MAX);
+		if (!attr_buf) {
+			status = SDP_INVALID_SYNTAX;
+			goto done;
+		}
+	}
+
+	tmpbuf.data = attr_buf;
 	tmpbuf.data_size = 0;
 	tmpbuf.buf_size = USHRT_MAX;
-	memset(tmpbuf.data, 0, USHRT_MAX);
+	tmpbuf.data[0] = 0;
 
 	/*
 	 * Calculate Attribute size according to MTU
@@ -907,7 +980,7 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 					/* to be sure no relocations */
 					sdp_append_to_buf(buf, tmpbuf.data, tmpbuf.data_size);
 					tmpbuf.data_size = 0;
-					memset(tmpbuf.data, 0, USHRT_MAX);
+					tmpbuf.data[0] = 0;
 				} else {
 					error("Relocation needed");
 					break;
@@ -956,7 +1029,6 @@ static int service_search_attr_req(sdp_req_t *req, sdp_buf_t *buf)
 
 done:
 	free(cstate);
-	free(tmpbuf.data);
 	if (pattern)
 		sdp_list_free(pattern, free);
 	if (seq)
@@ -964,6 +1036,9 @@ done:
 	return status;
 }
 
+/* Response buffer, reused across requests */
+static uint8_t *rsp_buf;
+
 /*
  * Top level request processor. Calls the appropriate processing
  * function based on request type. Handles service registration
@@ -974,10 +1049,23 @@ static void process_request(sdp_req_t *req)
 	sdp_pdu_hdr_t *reqhdr = (sdp_pdu_hdr_t *)req->buf;
 	sdp_pdu_hdr_t *rsphdr;
 	sdp_buf_t rsp;
-	uint8_t *buf = malloc(USHRT_MAX);
+	uint8_t *buf;
 	int status = SDP_INVALID_SYNTAX;
 
-	memset(buf, 0, USHRT_MAX);
+	if (!rsp_buf) {
+		rsp_buf = malloc(USHRT_MAX);
+		if (!rsp_buf) {
+			free(req->buf);
+			return;
+		}
+	}
+
+	/*
+	 * The response is written front to back, only the start of the
+	 * attribute list is looked at before being set.
+	 */
+	buf = rsp_buf;
+	memset(buf, 0, sizeof(sdp_pdu_hdr_t) + sizeof(uint16_t) + 1);
 	rsp.data = buf + sizeof(sdp_pdu_hdr_t);
 	rsp.data_size = 0;
 	rsp.buf_size = USHRT_MAX - sizeof(sdp_pdu_hdr_t);
@@ -1053,7 +1141,6 @@ send_rsp:
 
 	SDPDBG("Bytes Sent : %d", rsp.data_size);
 
-	free(rsp.data);
 	free(req->buf);
 }
 
@@ -318,6 +318,8 @@ static void update_db_timestamp(void)
 		sdp_data_t *d = sdp_data_alloc(SDP_UINT32, &dbts);
 		sdp_attr_replace(server, SDP_ATTR_SVCDB_STATE, d);
 	}
+
+	sdp_record_changed(server->handle);
 }
 
 void set_fixed_db_timestamp(uint32_t dbts)
@@ -640,6 +642,8 @@ static void update_mps(void)
 		data = sdp_data_alloc(SDP_UINT64, &mpmd_feat);
 		sdp_attr_replace(rec, SDP_ATTR_MPMD_SCENARIOS, data);
 	}
+
+	sdp_record_changed(rec->handle);
 }
 
 int add_record_to_server(const bdaddr_t *src, sdp_record_t *rec)
@@ -864,6 +868,7 @@ success:
 		sdp_pattern_add_uuid(rec, &uuid);
 	}
 
+	sdp_record_changed(rec->handle);
 	update_db_timestamp();
 
 	/* Build a rsp buffer */
@@ -912,6 +917,7 @@ int service_update_req(sdp_req_t *req, sdp_buf_t *rsp)
 
 	assert(nrec == orec);
 
+	sdp_record_changed(handle);
 	update_db_timestamp();
 
 done:
@@ -69,6 +69,23 @@ sdp_list_t *sdp_get_record_list(void);
 int sdp_check_access(uint32_t handle, bdaddr_t *device);
 uint32_t sdp_next_handle(void);
 
+typedef struct {
+	uint16_t attr;
+	uint32_t offset;	/* Of the attribute id in pdu */
+	uint32_t len;		/* Of the attribute id and value */
+} sdp_attr_pdu_t;
+
+typedef struct {
+	uint32_t handle;
+	sdp_buf_t pdu;		/* Sequence of all the attributes */
+	sdp_attr_pdu_t *attrs;	/* In attribute id order */
+	int num_attrs;
+} sdp_record_pdu_t;
+
+void sdp_record_changed(uint32_t handle);
+sdp_list_t *sdp_uuid_find_records(const uuid_t *uuid, int *count);
+const sdp_record_pdu_t *sdp_record_get_pdu(sdp_record_t *rec);
+
 uint32_t sdp_get_time(void);
 
 #define SDP_SERVER_COMPAT (1 << 0)
@@ -47,6 +47,13 @@
 /* Length of signature in write signed packet */
 #define BT_ATT_SIGNATURE_LEN		12
 
+/* Send ops are recycled in two size classes, PDUs that fit the default LE
+ * MTU and PDUs up to the biggest MTU of any channel.
+ */
+#define ATT_POOL_SMALL			0
+#define ATT_POOL_LARGE			1
+#define ATT_POOL_MAX			16
+
 struct att_send_op;
 
 struct bt_att_chan {
@@ -98,6 +105,10 @@ struct bt_att {
 
 	struct sign_info *local_sign;
 	struct sign_info *remote_sign;
+
+	struct queue *op_pool[2];	/* Recycled send ops by size class */
+	unsigned int pool_alloc;	/* Send ops allocated */
+	unsigned int pool_reuse;	/* Send ops taken from the pool */
 };
 
 struct sign_info {
@@ -198,17 +209,74 @@ static uint8_t get_req_opcode(uint8_t rsp_opcode)
 }
 
 struct att_send_op {
+	struct bt_att *att;
 	unsigned int id;
 	unsigned int timeout_id;
 	enum att_op_type type;
 	uint8_t opcode;
 	void *pdu;
 	uint16_t len;
+	uint16_t size;			/* Space available for the PDU */
 	bt_att_response_func_t callback;
 	bt_att_destroy_func_t destroy;
 	void *user_data;
+	uint8_t buf[0];
 };
 
+static uint16_t pool_size(struct bt_att *att, int pool)
+{
+	if (pool == ATT_POOL_LARGE && att->mtu > BT_ATT_DEFAULT_LE_MTU)
+		return att->mtu;
+
+	return BT_ATT_DEFAULT_LE_MTU;
+}
+
+static struct att_send_op *alloc_att_send_op(struct bt_att *att,
+								uint16_t len)
+{
+	int pool = len > BT_ATT_DEFAULT_LE_MTU ? ATT_POOL_LARGE :
+							ATT_POOL_SMALL;
+	struct att_send_op *op;
+	uint16_t size;
+
+	op = queue_pop_head(att->op_pool[pool]);
+	if (op && op->size >= len) {
+		att->pool_reuse++;
+		size = op->size;
+	} else {
+		/* Left over from before the MTU grew */
+		free(op);
+
+		size = pool_size(att, pool);
+		op = malloc(sizeof(*op) + size);
+		if (!op)
+			return NULL;
+
+		att->pool_alloc++;
+	}
+
+	memset(op, 0, sizeof(*op));
+	op->att = att;
+	op->size = size;
+	op->pdu = op->buf;
+
+	return op;
+}
+
+static void free_att_send_op(struct att_send_op *op)
+{
+	struct bt_att *att = op->att;
+	int pool = op->size > BT_ATT_DEFAULT_LE_MTU ? ATT_POOL_LARGE :
+							ATT_POOL_SMALL;
+
+	if (op->size == pool_size(att, pool) &&
+			queue_length(att->op_pool[pool]) < ATT_POOL_MAX &&
+			queue_push_head(att->op_pool[pool], op))
+		return;
+
+	free(op);
+}
+
 static void destroy_att_send_op(void *data)
 {
 	struct att_send_op *op = data;
@@ -219,8 +287,7 @@ static void destroy_att_send_op(void *data)
 	if (op->destroy)
 		op->destroy(op->user_data);
 
-	free(op->pdu);
-	free(op);
+	free_att_send_op(op);
 }
 
 static void cancel_att_send_op(void *data)
@@ -287,62 +354,46 @@ static bool match_disconn_id(const void *a, const void *b)
 	return disconn->id == id;
 }
 
-static bool encode_pdu(struct bt_att *att, struct att_send_op *op,
-					const void *pdu, uint16_t length)
+static bool sign_pdu(struct bt_att *att, struct att_send_op *op)
 {
-	uint16_t pdu_len = 1;
 	struct sign_info *sign = att->local_sign;
+	uint16_t len = op->len - BT_ATT_SIGNATURE_LEN;
 	uint32_t sign_cnt;
 
-	if (sign && (op->opcode & ATT_OP_SIGNED_MASK))
-		pdu_len += BT_ATT_SIGNATURE_LEN;
-
-	if (length && pdu)
-		pdu_len += length;
-
-	if (pdu_len > att->mtu)
-		return false;
-
-	op->len = pdu_len;
-	op->pdu = malloc(op->len);
-	if (!op->pdu)
-		return false;
-
-	((uint8_t *) op->pdu)[0] = op->opcode;
-	if (pdu_len > 1)
-		memcpy(op->pdu + 1, pdu, length);
-
-	if (!sign || !(op->opcode & ATT_OP_SIGNED_MASK) || !att->crypto)
-		return true;
-
 	if (!sign->counter(&sign_cnt, sign->user_data))
-		goto fail;
+		return false;
 
-	if ((bt_crypto_sign_att(att->crypto, sign->key, op->pdu, 1 + length,
-				sign_cnt, &((uint8_t *) op->pdu)[1 + length])))
+	if ((bt_crypto_sign_att(att->crypto, sign->key, op->pdu, len,
+				sign_cnt, &((uint8_t *) op->pdu)[len])))
 		return true;
 
 	util_debug(att->debug_callback, att->debug_data,
 					"ATT unable to generate signature");
 
-fail:
-	free(op->pdu);
 	return false;
 }
 
 static struct att_send_op *create_att_send_op(struct bt_att *att,
 						uint8_t opcode,
-						const void *pdu,
-						uint16_t length,
+						const struct iovec *iov,
+						int iovcnt,
 						bt_att_response_func_t callback,
 						void *user_data,
 						bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
 	enum att_op_type type;
+	bool sign;
+	size_t pdu_len = 1;
+	uint8_t *ptr;
+	int i;
 
-	if (length && !pdu)
-		return NULL;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len && !iov[i].iov_base)
+			return NULL;
+
+		pdu_len += iov[i].iov_len;
+	}
 
 	type = get_op_type(opcode);
 	if (type == ATT_OP_TYPE_UNKNOWN)
@@ -361,15 +412,38 @@ static struct att_send_op *create_att_send_op(struct bt_att *att,
 	if (!callback && (type == ATT_OP_TYPE_REQ || type == ATT_OP_TYPE_IND))
 		return NULL;
 
-	op = new0(struct att_send_op, 1);
+	sign = att->local_sign && (opcode & ATT_OP_SIGNED_MASK);
+	if (sign)
+		pdu_len += BT_ATT_SIGNATURE_LEN;
+
+	if (pdu_len > att->mtu)
+		return NULL;
+
+	op = alloc_att_send_op(att, pdu_len);
+	if (!op)
+		return NULL;
+
 	op->type = type;
 	op->opcode = opcode;
 	op->callback = callback;
 	op->destroy = destroy;
 	op->user_data = user_data;
+	op->len = pdu_len;
 
-	if (!encode_pdu(att, op, pdu, length)) {
-		free(op);
+	/* Gather the parameters straight into the PDU */
+	ptr = op->pdu;
+	*ptr++ = opcode;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+
+		memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+		ptr += iov[i].iov_len;
+	}
+
+	if (sign && att->crypto && !sign_pdu(att, op)) {
+		free_att_send_op(op);
 		return NULL;
 	}
 
@@ -996,7 +1070,13 @@ static bool can_read_data(struct io *io, void *user_data)
 	uint8_t *pdu;
 	ssize_t bytes_read;
 
-	bytes_read = read(chan->fd, chan->buf, chan->mtu);
+	/*
+	 * Only one PDU is read per wakeup, reads are not batched. The io
+	 * backend used by bluetoothd has no way to receive more without
+	 * blocking and reading past io_recv() would reorder PDUs already
+	 * queued by the io_uring backend.
+	 */
+	bytes_read = io_recv(io, chan->buf, chan->mtu);
 	if (bytes_read < 0)
 		return false;
 
@@ -1113,6 +1193,8 @@ static void bt_att_free(struct bt_att *att)
 	queue_destroy(att->notify_list, NULL);
 	queue_destroy(att->disconn_list, NULL);
 	queue_destroy(att->chans, bt_att_chan_free);
+	queue_destroy(att->op_pool[ATT_POOL_SMALL], free);
+	queue_destroy(att->op_pool[ATT_POOL_LARGE], free);
 
 	free(att);
 }
@@ -1238,6 +1320,8 @@ struct bt_att *bt_att_new(int fd, bool ext_signed)
 	att->ind_queue = queue_new();
 	att->write_queue = queue_new();
 	att->notify_list = queue_new();
+	att->op_pool[ATT_POOL_SMALL] = queue_new();
+	att->op_pool[ATT_POOL_LARGE] = queue_new();
 	att->disconn_list = queue_new();
 
 	bt_att_attach_chan(att, chan);
@@ -1469,8 +1553,8 @@ bool bt_att_unregister_disconnect(struct bt_att *att, unsigned int id)
 	return true;
 }
 
-unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
-				const void *pdu, uint16_t length,
+unsigned int bt_att_sendv(struct bt_att *att, uint8_t opcode,
+				const struct iovec *iov, int iovcnt,
 				bt_att_response_func_t callback, void *user_data,
 				bt_att_destroy_func_t destroy)
 {
@@ -1480,7 +1564,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	if (!att || queue_isempty(att->chans))
 		return 0;
 
-	op = create_att_send_op(att, opcode, pdu, length, callback, user_data,
+	op = create_att_send_op(att, opcode, iov, iovcnt, callback, user_data,
 								destroy);
 	if (!op)
 		return 0;
@@ -1509,8 +1593,7 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	}
 
 	if (!result) {
-		free(op->pdu);
-		free(op);
+		free_att_send_op(op);
 		return 0;
 	}
 
@@ -1519,6 +1602,23 @@ unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
 	return op->id;
 }
 
+unsigned int bt_att_send(struct bt_att *att, uint8_t opcode,
+				const void *pdu, uint16_t length,
+				bt_att_response_func_t callback, void *user_data,
+				bt_att_destroy_func_t destroy)
+{
+	struct iovec iov;
+
+	if (length && !pdu)
+		return 0;
+
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = length;
+
+	return bt_att_sendv(att, opcode, &iov, 1, callback, user_data,
+								destroy);
+}
+
 unsigned int bt_att_chan_send(struct bt_att_chan *chan, uint8_t opcode,
 				const void *pdu, uint16_t len,
 				bt_att_response_func_t callback,
@@ -1526,18 +1626,24 @@ unsigned int bt_att_chan_send(struct bt_att_chan *chan, uint8_t opcode,
 				bt_att_destroy_func_t destroy)
 {
 	struct att_send_op *op;
+	struct iovec iov;
 
 	if (!chan || !chan->att)
 		return -EINVAL;
 
-	op = create_att_send_op(chan->att, opcode, pdu, len, callback,
+	if (len && !pdu)
+		return -EINVAL;
+
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = len;
+
+	op = create_att_send_op(chan->att, opcode, &iov, 1, callback,
 						user_data, destroy);
 	if (!op)
 		return -EINVAL;
 
 	if (!queue_push_tail(chan->queue, op)) {
-		free(op->pdu);
-		free(op);
+		free_att_send_op(op);
 		return 0;
 	}
 
@@ -1867,3 +1973,18 @@ bool bt_att_has_crypto(struct bt_att *att)
 
 	return att->crypto ? true : false;
 }
+
+bool bt_att_get_pool_stats(struct bt_att *att, unsigned int *alloc,
+							unsigned int *reuse)
+{
+	if (!att)
+		return false;
+
+	if (alloc)
+		*alloc = att->pool_alloc;
+
+	if (reuse)
+		*reuse = att->pool_reuse;
+
+	return true;
+}
@@ -128,41 +128,16 @@ static bool vli_is_zero(const uint64_t *vli)
 	return true;
 }
 
-/* Returns nonzero if bit bit of vli is set. */
-static uint64_t vli_test_bit(const uint64_t *vli, unsigned int bit)
-{
-	return (vli[bit / 64] & ((uint64_t) 1 << (bit % 64)));
-}
-
-/* Counts the number of 64-bit "digits" in vli. */
-static unsigned int vli_num_digits(const uint64_t *vli)
+/* Returns all ones if vli == 0, zero otherwise, without branching. */
+static uint64_t vli_zero_mask(const uint64_t *vli)
 {
+	uint64_t bits = 0;
 	int i;
 
-	/* Search from the end until we find a non-zero digit.
-	 * We do it in reverse because we expect that most digits will
-	 * be nonzero.
-	 */
-	for (i = NUM_ECC_DIGITS - 1; i >= 0 && vli[i] == 0; i--);
-
-	return (i + 1);
-}
-
-/* Counts the number of bits required for vli. */
-static unsigned int vli_num_bits(const uint64_t *vli)
-{
-	unsigned int i, num_digits;
-	uint64_t digit;
-
-	num_digits = vli_num_digits(vli);
-	if (num_digits == 0)
-		return 0;
-
-	digit = vli[num_digits - 1];
-	for (i = 0; digit; i++)
-		digit >>= 1;
+	for (i = 0; i < NUM_ECC_DIGITS; i++)
+		bits |= vli[i];
 
-	return ((num_digits - 1) * 64 + i);
+	return ((bits | -bits) >> 63) - 1;
 }
 
 /* Sets dest = src. */
@@ -244,11 +219,11 @@ static uint64_t vli_add(uint64_t *result, const uint64_t *left,
 	int i;
 
 	for (i = 0; i < NUM_ECC_DIGITS; i++) {
-		uint64_t sum;
+		uint64_t sum = left[i] + carry;
 
-		sum = left[i] + right[i] + carry;
-		if (sum != left[i])
-			carry = (sum < left[i]);
+		carry = (sum < carry);
+		sum += right[i];
+		carry |= (sum < right[i]);
 
 		result[i] = sum;
 	}
@@ -264,11 +239,11 @@ static uint64_t vli_sub(uint64_t *result, const uint64_t *left,
 	int i;
 
 	for (i = 0; i < NUM_ECC_DIGITS; i++) {
-		uint64_t diff;
+		uint64_t diff = left[i] - borrow;
 
-		diff = left[i] - right[i] - borrow;
-		if (diff != left[i])
-			borrow = (diff > left[i]);
+		borrow = (diff > left[i]);
+		borrow |= (diff < right[i]);
+		diff -= right[i];
 
 		result[i] = diff;
 	}
@@ -278,6 +253,13 @@ static uint64_t vli_sub(uint64_t *result, const uint64_t *left,
 
 static uint128_t mul_64_64(uint64_t left, uint64_t right)
 {
+	uint128_t result;
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 m = (unsigned __int128) left * right;
+
+	result.m_low = m;
+	result.m_high = m >> 64;
+#else
 	uint64_t a0 = left & 0xffffffffull;
 	uint64_t a1 = left >> 32;
 	uint64_t b0 = right & 0xffffffffull;
@@ -286,7 +268,6 @@ static uint128_t mul_64_64(uint64_t left, uint64_t right)
 	uint64_t m1 = a0 * b1;
 	uint64_t m2 = a1 * b0;
 	uint64_t m3 = a1 * b1;
-	uint128_t result;
 
 	m2 += (m0 >> 32);
 	m2 += m1;
@@ -297,6 +278,7 @@ static uint128_t mul_64_64(uint64_t left, uint64_t right)
 
 	result.m_low = (m0 & 0xffffffffull) | (m2 << 32);
 	result.m_high = m3 + (m2 >> 32);
+#endif
 
 	return result;
 }
@@ -386,21 +368,31 @@ static void vli_square(uint64_t *result, const uint64_t *left)
 	result[NUM_ECC_DIGITS * 2 - 1] = r01.m_low;
 }
 
+/* Sets dest = src if mask is all ones, leaves dest alone if it is zero. */
+static void vli_cmov(uint64_t *dest, const uint64_t *src, uint64_t mask)
+{
+	int i;
+
+	for (i = 0; i < NUM_ECC_DIGITS; i++)
+		dest[i] ^= (dest[i] ^ src[i]) & mask;
+}
+
 /* Computes result = (left + right) % mod.
  * Assumes that left < mod and right < mod, result != mod.
  */
 static void vli_mod_add(uint64_t *result, const uint64_t *left,
 				const uint64_t *right, const uint64_t *mod)
 {
-	uint64_t carry;
+	uint64_t tmp[NUM_ECC_DIGITS];
+	uint64_t carry, borrow;
 
 	carry = vli_add(result, left, right);
 
 	/* result > mod (result = mod + remainder), so subtract mod to
 	 * get remainder.
 	 */
-	if (carry || vli_cmp(result, mod) >= 0)
-		vli_sub(result, result, mod);
+	borrow = vli_sub(tmp, result, mod);
+	vli_cmov(result, tmp, -(carry | !borrow));
 }
 
 /* Computes result = (left - right) % mod.
@@ -409,14 +401,15 @@ static void vli_mod_add(uint64_t *result, const uint64_t *left,
 static void vli_mod_sub(uint64_t *result, const uint64_t *left,
 				const uint64_t *right, const uint64_t *mod)
 {
+	uint64_t tmp[NUM_ECC_DIGITS];
 	uint64_t borrow = vli_sub(result, left, right);
 
 	/* In this case, p_result == -diff == (max int) - diff.
 	 * Since -x % d == d - x, we can get the correct result from
 	 * result + mod (with overflow).
 	 */
-	if (borrow)
-		vli_add(result, result, mod);
+	vli_add(tmp, result, mod);
+	vli_cmov(result, tmp, -borrow);
 }
 
 /* Computes result = product % curve_p
@@ -424,7 +417,11 @@ static void vli_mod_sub(uint64_t *result, const uint64_t *left,
 static void vli_mmod_fast(uint64_t *result, const uint64_t *product)
 {
 	uint64_t tmp[NUM_ECC_DIGITS];
-	int carry;
+	uint64_t fold[NUM_ECC_DIGITS];
+	uint64_t sum[NUM_ECC_DIGITS];
+	uint64_t diff[NUM_ECC_DIGITS];
+	uint64_t sign, k, c, b;
+	int carry, i;
 
 	/* t */
 	vli_set(result, product);
@@ -486,14 +483,40 @@ static void vli_mmod_fast(uint64_t *result, const uint64_t *product)
 	tmp[3] = product[6] & 0xffffffff00000000ull;
 	carry -= vli_sub(result, result, tmp);
 
-	if (carry < 0) {
-		do {
-			carry += vli_add(result, result, curve_p);
-		} while (carry < 0);
-	} else {
-		while (carry || vli_cmp(curve_p, result) != 1)
-			carry -= vli_sub(result, result, curve_p);
+	/* carry is in [-4, 6] at this point. As 2^256 = 2^256 - p (mod p),
+	 * fold carry * (2^256 - p) back into the result, which leaves at most
+	 * one more wrap around and one subtraction of p. Both directions are
+	 * computed and the right one kept with masks, so the time taken
+	 * doesn't depend on the value.
+	 */
+	vli_clear(fold);
+	vli_sub(fold, fold, curve_p);
+
+	sign = -(uint64_t) (carry < 0);
+	k = ((uint64_t) carry ^ sign) - sign;
+
+	c = 0;
+	for (i = 0; i < NUM_ECC_DIGITS; i++) {
+		uint128_t m = mul_64_64(fold[i], k);
+
+		tmp[i] = m.m_low + c;
+		c = m.m_high + (tmp[i] < c);
 	}
+
+	c = vli_add(sum, result, tmp);
+	b = vli_sub(diff, result, tmp);
+	vli_cmov(sum, diff, sign);
+	vli_set(result, sum);
+	c = (c & ~sign) | (b & sign);
+
+	/* A wrap around left result < 2^227, so this can't wrap again */
+	vli_add(sum, result, fold);
+	vli_sub(diff, result, fold);
+	vli_cmov(result, sum, -c & ~sign);
+	vli_cmov(result, diff, -c & sign);
+
+	b = vli_sub(tmp, result, curve_p);
+	vli_cmov(result, tmp, b - 1);
 }
 
 /* Computes result = (left * right) % curve_p. */
@@ -594,6 +617,60 @@ static void vli_mod_inv(uint64_t *result, const uint64_t *input,
 	vli_set(result, u);
 }
 
+/* Computes result = left^(2^n) % curve_p. */
+static void vli_mod_square_times(uint64_t *result, const uint64_t *left,
+							unsigned int n)
+{
+	vli_mod_square_fast(result, left);
+
+	while (--n)
+		vli_mod_square_fast(result, result);
+}
+
+/* Computes result = (1 / input) % curve_p as input^(p - 2) using a fixed
+ * addition chain. Slower than vli_mod_inv, but the timing doesn't depend
+ * on the input, so this is the one to use on anything derived from a
+ * private key.
+ */
+static void vli_mod_inv_fast(uint64_t *result, const uint64_t *input)
+{
+	uint64_t x2[NUM_ECC_DIGITS], x4[NUM_ECC_DIGITS];
+	uint64_t x8[NUM_ECC_DIGITS], x16[NUM_ECC_DIGITS];
+	uint64_t x32[NUM_ECC_DIGITS], t[NUM_ECC_DIGITS];
+
+	/* xN = input^(2^N - 1) */
+	vli_mod_square_fast(t, input);
+	vli_mod_mult_fast(x2, t, input);
+	vli_mod_square_times(t, x2, 2);
+	vli_mod_mult_fast(x4, t, x2);
+	vli_mod_square_times(t, x4, 4);
+	vli_mod_mult_fast(x8, t, x4);
+	vli_mod_square_times(t, x8, 8);
+	vli_mod_mult_fast(x16, t, x8);
+	vli_mod_square_times(t, x16, 16);
+	vli_mod_mult_fast(x32, t, x16);
+
+	/* p - 2 = ffffffff00000001 0000000000000000
+	 *         00000000ffffffff fffffffffffffffd
+	 */
+	vli_mod_square_times(t, x32, 32);
+	vli_mod_mult_fast(t, t, input);
+	vli_mod_square_times(t, t, 128);
+	vli_mod_mult_fast(t, t, x32);
+	vli_mod_square_times(t, t, 32);
+	vli_mod_mult_fast(t, t, x32);
+	vli_mod_square_times(t, t, 16);
+	vli_mod_mult_fast(t, t, x16);
+	vli_mod_square_times(t, t, 8);
+	vli_mod_mult_fast(t, t, x8);
+	vli_mod_square_times(t, t, 4);
+	vli_mod_mult_fast(t, t, x4);
+	vli_mod_square_times(t, t, 2);
+	vli_mod_mult_fast(t, t, x2);
+	vli_mod_square_times(t, t, 2);
+	vli_mod_mult_fast(result, t, input);
+}
+
 /* ------ Point operations ------ */
 
 /* Returns true if p_point is the point at infinity, false otherwise. */
@@ -602,20 +679,16 @@ static bool ecc_point_is_zero(const struct ecc_point *point)
 	return (vli_is_zero(point->x) && vli_is_zero(point->y));
 }
 
-/* Point multiplication algorithm using Montgomery's ladder with co-Z
- * coordinates. From http://eprint.iacr.org/2011/338.pdf
- */
-
 /* Double in place */
 static void ecc_point_double_jacobian(uint64_t *x1, uint64_t *y1, uint64_t *z1)
 {
 	/* t1 = x, t2 = y, t3 = z */
 	uint64_t t4[NUM_ECC_DIGITS];
 	uint64_t t5[NUM_ECC_DIGITS];
+	uint64_t t6[NUM_ECC_DIGITS];
+	uint64_t carry, odd;
 
-	if (vli_is_zero(z1))
-		return;
-
+	/* A z1 of zero stays zero, so the point at infinity needs no check */
 	vli_mod_square_fast(t4, y1);   /* t4 = y1^2 */
 	vli_mod_mult_fast(t5, x1, t4); /* t5 = x1*y1^2 = A */
 	vli_mod_square_fast(t4, t4);   /* t4 = y1^4 */
@@ -629,13 +702,11 @@ static void ecc_point_double_jacobian(uint64_t *x1, uint64_t *y1, uint64_t *z1)
 
 	vli_mod_add(z1, x1, x1, curve_p); /* t3 = 2*(x1^2 - z1^4) */
 	vli_mod_add(x1, x1, z1, curve_p); /* t1 = 3*(x1^2 - z1^4) */
-	if (vli_test_bit(x1, 0)) {
-		uint64_t carry = vli_add(x1, x1, curve_p);
-		vli_rshift1(x1);
-		x1[NUM_ECC_DIGITS - 1] |= carry << 63;
-	} else {
-		vli_rshift1(x1);
-	}
+	odd = -(x1[0] & 1);
+	carry = vli_add(t6, x1, curve_p);
+	vli_cmov(x1, t6, odd);
+	vli_rshift1(x1);
+	x1[NUM_ECC_DIGITS - 1] |= (carry & odd) << 63;
 	/* t1 = 3/2*(x1^2 - z1^4) = B */
 
 	vli_mod_square_fast(z1, x1);      /* t3 = B^2 */
@@ -661,132 +732,341 @@ static void apply_z(uint64_t *x1, uint64_t *y1, uint64_t *z)
 	vli_mod_mult_fast(y1, y1, t1); /* y1 * z^3 */
 }
 
-/* P = (x1, y1) => 2P, (x2, y2) => P' */
-static void xycz_initial_double(uint64_t *x1, uint64_t *y1, uint64_t *x2,
-					uint64_t *y2, uint64_t *p_initial_z)
+/* Add the affine point (x2, y2) to the Jacobian point (x1, y1, z1) in place.
+ * A z1 of zero is the point at infinity. The special cases are computed
+ * alongside the general one and picked with masks, so there are no
+ * branches on the values. Adding a point to itself costs a doubling on
+ * every call, so that is only covered if maybe_same is set; the scalar
+ * multiplications can only get there on their last additions.
+ */
+static void ecc_point_add_mixed(uint64_t *x1, uint64_t *y1, uint64_t *z1,
+				const uint64_t *x2, const uint64_t *y2,
+				bool maybe_same)
 {
-	uint64_t z[NUM_ECC_DIGITS];
-
-	vli_set(x2, x1);
-	vli_set(y2, y1);
+	uint64_t t1[NUM_ECC_DIGITS];
+	uint64_t t2[NUM_ECC_DIGITS];
+	uint64_t t3[NUM_ECC_DIGITS];
+	uint64_t t4[NUM_ECC_DIGITS];
+	uint64_t dx[NUM_ECC_DIGITS];
+	uint64_t dy[NUM_ECC_DIGITS];
+	uint64_t dz[NUM_ECC_DIGITS];
+	uint64_t infinity, same;
+
+	infinity = vli_zero_mask(z1);
+
+	/* 2 * (x2, y2), in case both points turn out to be the same */
+	if (maybe_same) {
+		vli_set(dx, x2);
+		vli_set(dy, y2);
+		vli_clear(dz);
+		dz[0] = 1;
+		ecc_point_double_jacobian(dx, dy, dz);
+	}
 
-	vli_clear(z);
-	z[0] = 1;
+	vli_mod_square_fast(t1, z1);      /* t1 = z1^2 */
+	vli_mod_mult_fast(t2, t1, z1);    /* t2 = z1^3 */
+	vli_mod_mult_fast(t1, t1, x2);    /* t1 = x2*z1^2 = U2 */
+	vli_mod_mult_fast(t2, t2, y2);    /* t2 = y2*z1^3 = S2 */
+	vli_mod_sub(t1, t1, x1, curve_p); /* t1 = U2 - x1 = H */
+	vli_mod_sub(t2, t2, y1, curve_p); /* t2 = S2 - y1 = R */
+
+	/* H = 0 and R != 0 is P + (-P), where z3 = z1*H = 0 already */
+	same = vli_zero_mask(t1) & vli_zero_mask(t2);
+
+	vli_mod_mult_fast(z1, z1, t1);    /* z3 = z1*H */
+	vli_mod_square_fast(t3, t1);      /* t3 = H^2 */
+	vli_mod_mult_fast(t4, t3, t1);    /* t4 = H^3 */
+	vli_mod_mult_fast(t3, t3, x1);    /* t3 = x1*H^2 */
+	vli_mod_square_fast(x1, t2);      /* t1 = R^2 */
+	vli_mod_sub(x1, x1, t4, curve_p); /* t1 = R^2 - H^3 */
+	vli_mod_sub(x1, x1, t3, curve_p);
+	vli_mod_sub(x1, x1, t3, curve_p); /* t1 = R^2 - H^3 - 2*x1*H^2 = x3 */
+	vli_mod_sub(t3, t3, x1, curve_p); /* t3 = x1*H^2 - x3 */
+	vli_mod_mult_fast(t3, t3, t2);    /* t3 = R*(x1*H^2 - x3) */
+	vli_mod_mult_fast(t4, t4, y1);    /* t4 = y1*H^3 */
+	vli_mod_sub(y1, t3, t4, curve_p); /* t2 = y3 */
+
+	if (maybe_same) {
+		vli_cmov(x1, dx, same);
+		vli_cmov(y1, dy, same);
+		vli_cmov(z1, dz, same);
+	}
 
-	if (p_initial_z)
-		vli_set(z, p_initial_z);
+	vli_clear(t1);
+	t1[0] = 1;
+	vli_cmov(x1, x2, infinity);
+	vli_cmov(y1, y2, infinity);
+	vli_cmov(z1, t1, infinity);
+}
 
-	apply_z(x1, y1, z);
+/* Convert (x, y, z) back to affine coordinates, negating the result if
+ * negate is all ones. The inverse of a zero z comes out as zero, so the
+ * point at infinity ends up as (0, 0) without a branch.
+ */
+static void ecc_point_to_affine(struct ecc_point *result, uint64_t *x,
+				uint64_t *y, const uint64_t *z, uint64_t negate)
+{
+	uint64_t t1[NUM_ECC_DIGITS];
+	uint64_t t2[NUM_ECC_DIGITS];
 
-	ecc_point_double_jacobian(x1, y1, z);
+	vli_mod_inv_fast(t1, z);
+	vli_mod_square_fast(t2, t1);             /* 1/z^2 */
+	vli_mod_mult_fast(result->x, x, t2);
+	vli_mod_mult_fast(t2, t2, t1);           /* 1/z^3 */
+	vli_mod_mult_fast(result->y, y, t2);
 
-	apply_z(x2, y2, z);
+	vli_clear(t2);
+	vli_mod_sub(t1, t2, result->y, curve_p);
+	vli_cmov(result->y, t1, negate);
 }
 
-/* Input P = (x1, y1, Z), Q = (x2, y2, Z)
- * Output P' = (x1', y1', Z3), P + Q = (x3, y3, Z3)
- * or P => P', Q => P + Q
+/* Scalar multiplication works on signed odd digits of ECC_WINDOW bits each,
+ * every digit adds exactly one precomputed odd multiple of the point.
  */
-static void xycz_add(uint64_t *x1, uint64_t *y1, uint64_t *x2, uint64_t *y2)
+#define ECC_WINDOW	4
+#define ECC_TABLE_SIZE	(1 << (ECC_WINDOW - 1))
+#define ECC_NUM_DIGITS	(ECC_BYTES * 8 / ECC_WINDOW + 1)
+
+/* Fill table with the affine points P, 3P, 5P, ... (2 * ECC_TABLE_SIZE - 1)P.
+ * P isn't secret, so the faster vli_mod_inv can be used here.
+ */
+static void ecc_point_precompute(struct ecc_point *table,
+					const struct ecc_point *point)
 {
-	/* t1 = X1, t2 = Y1, t3 = X2, t4 = Y2 */
-	uint64_t t5[NUM_ECC_DIGITS];
+	uint64_t x[ECC_TABLE_SIZE][NUM_ECC_DIGITS];
+	uint64_t y[ECC_TABLE_SIZE][NUM_ECC_DIGITS];
+	uint64_t z[ECC_TABLE_SIZE][NUM_ECC_DIGITS];
+	uint64_t acc[ECC_TABLE_SIZE][NUM_ECC_DIGITS];
+	uint64_t inv[NUM_ECC_DIGITS];
+	uint64_t t[NUM_ECC_DIGITS];
+	struct ecc_point p2;
+	int i;
+
+	/* 2P */
+	vli_set(x[0], point->x);
+	vli_set(y[0], point->y);
+	vli_clear(z[0]);
+	z[0][0] = 1;
+	ecc_point_double_jacobian(x[0], y[0], z[0]);
+	vli_mod_inv(t, z[0], curve_p);
+	apply_z(x[0], y[0], t);
+	vli_set(p2.x, x[0]);
+	vli_set(p2.y, y[0]);
+
+	vli_set(x[0], point->x);
+	vli_set(y[0], point->y);
+	vli_clear(z[0]);
+	z[0][0] = 1;
+
+	for (i = 1; i < ECC_TABLE_SIZE; i++) {
+		vli_set(x[i], x[i - 1]);
+		vli_set(y[i], y[i - 1]);
+		vli_set(z[i], z[i - 1]);
+		ecc_point_add_mixed(x[i], y[i], z[i], p2.x, p2.y, false);
+	}
+
+	/* Convert all of them with a single inversion */
+	vli_set(acc[0], z[0]);
+	for (i = 1; i < ECC_TABLE_SIZE; i++)
+		vli_mod_mult_fast(acc[i], acc[i - 1], z[i]);
 
-	vli_mod_sub(t5, x2, x1, curve_p); /* t5 = x2 - x1 */
-	vli_mod_square_fast(t5, t5);      /* t5 = (x2 - x1)^2 = A */
-	vli_mod_mult_fast(x1, x1, t5);    /* t1 = x1*A = B */
-	vli_mod_mult_fast(x2, x2, t5);    /* t3 = x2*A = C */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y2 - y1 */
-	vli_mod_square_fast(t5, y2);      /* t5 = (y2 - y1)^2 = D */
+	vli_mod_inv(inv, acc[ECC_TABLE_SIZE - 1], curve_p);
 
-	vli_mod_sub(t5, t5, x1, curve_p); /* t5 = D - B */
-	vli_mod_sub(t5, t5, x2, curve_p); /* t5 = D - B - C = x3 */
-	vli_mod_sub(x2, x2, x1, curve_p); /* t3 = C - B */
-	vli_mod_mult_fast(y1, y1, x2);    /* t2 = y1*(C - B) */
-	vli_mod_sub(x2, x1, t5, curve_p); /* t3 = B - x3 */
-	vli_mod_mult_fast(y2, y2, x2);    /* t4 = (y2 - y1)*(B - x3) */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y3 */
+	for (i = ECC_TABLE_SIZE - 1; i >= 0; i--) {
+		if (i > 0) {
+			vli_mod_mult_fast(t, inv, acc[i - 1]); /* 1/z[i] */
+			vli_mod_mult_fast(inv, inv, z[i]);
+		} else {
+			vli_set(t, inv);
+		}
 
-	vli_set(x2, t5);
+		apply_z(x[i], y[i], t);
+		vli_set(table[i].x, x[i]);
+		vli_set(table[i].y, y[i]);
+	}
 }
 
-/* Input P = (x1, y1, Z), Q = (x2, y2, Z)
- * Output P + Q = (x3, y3, Z3), P - Q = (x3', y3', Z3)
- * or P => P - Q, Q => P + Q
+/* Replace an even scalar in [1, n-1] by n - scalar so that it is always odd.
+ * Returns all ones if that happened and the result needs to be negated.
  */
-static void xycz_add_c(uint64_t *x1, uint64_t *y1, uint64_t *x2, uint64_t *y2)
+static uint64_t ecc_scalar_make_odd(uint64_t *result, const uint64_t *scalar)
 {
-	/* t1 = X1, t2 = Y1, t3 = X2, t4 = Y2 */
-	uint64_t t5[NUM_ECC_DIGITS];
-	uint64_t t6[NUM_ECC_DIGITS];
-	uint64_t t7[NUM_ECC_DIGITS];
+	uint64_t negate = (scalar[0] & 1) - 1;
+	uint64_t tmp[NUM_ECC_DIGITS];
+
+	vli_sub(tmp, curve_n, scalar);
+	vli_set(result, scalar);
+	vli_cmov(result, tmp, negate);
+
+	return negate;
+}
+
+/* Recode an odd scalar into ECC_NUM_DIGITS odd digits in the range
+ * [-(2^ECC_WINDOW - 1), 2^ECC_WINDOW - 1], least significant first.
+ * None of the digits is zero, so there is no data dependent skipping of
+ * additions, and the most significant one always ends up as 1.
+ */
+static void ecc_scalar_recode(int8_t *digits, const uint64_t *scalar)
+{
+	uint64_t k[NUM_ECC_DIGITS];
+	int i, j;
 
-	vli_mod_sub(t5, x2, x1, curve_p); /* t5 = x2 - x1 */
-	vli_mod_square_fast(t5, t5);      /* t5 = (x2 - x1)^2 = A */
-	vli_mod_mult_fast(x1, x1, t5);    /* t1 = x1*A = B */
-	vli_mod_mult_fast(x2, x2, t5);    /* t3 = x2*A = C */
-	vli_mod_add(t5, y2, y1, curve_p); /* t4 = y2 + y1 */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y2 - y1 */
+	vli_set(k, scalar);
 
-	vli_mod_sub(t6, x2, x1, curve_p); /* t6 = C - B */
-	vli_mod_mult_fast(y1, y1, t6);    /* t2 = y1 * (C - B) */
-	vli_mod_add(t6, x1, x2, curve_p); /* t6 = B + C */
-	vli_mod_square_fast(x2, y2);      /* t3 = (y2 - y1)^2 */
-	vli_mod_sub(x2, x2, t6, curve_p); /* t3 = x3 */
+	for (i = 0; i < ECC_NUM_DIGITS - 1; i++) {
+		int digit = k[0] & ((2 << ECC_WINDOW) - 1);
 
-	vli_mod_sub(t7, x1, x2, curve_p); /* t7 = B - x3 */
-	vli_mod_mult_fast(y2, y2, t7);    /* t4 = (y2 - y1)*(B - x3) */
-	vli_mod_sub(y2, y2, y1, curve_p); /* t4 = y3 */
+		digits[i] = digit - (1 << ECC_WINDOW);
 
-	vli_mod_square_fast(t7, t5);      /* t7 = (y2 + y1)^2 = F */
-	vli_mod_sub(t7, t7, t6, curve_p); /* t7 = x3' */
-	vli_mod_sub(t6, t7, x1, curve_p); /* t6 = x3' - B */
-	vli_mod_mult_fast(t6, t6, t5);    /* t6 = (y2 + y1)*(x3' - B) */
-	vli_mod_sub(y1, t6, y1, curve_p); /* t2 = y3' */
+		/* k = (k - digits[i]) >> ECC_WINDOW */
+		k[0] = (k[0] & ~(uint64_t) ((2 << ECC_WINDOW) - 1)) |
+							(1 << ECC_WINDOW);
 
-	vli_set(x1, t7);
+		for (j = 0; j < NUM_ECC_DIGITS - 1; j++)
+			k[j] = (k[j] >> ECC_WINDOW) |
+					(k[j + 1] << (64 - ECC_WINDOW));
+
+		k[NUM_ECC_DIGITS - 1] >>= ECC_WINDOW;
+	}
+
+	digits[ECC_NUM_DIGITS - 1] = k[0];
 }
 
-static void ecc_point_mult(struct ecc_point *result,
-				const struct ecc_point *point,
-				uint64_t *scalar, uint64_t *initial_z,
-				int num_bits)
+/* Load digit * P from the table of odd multiples of P, reading every entry
+ * so the memory access pattern doesn't depend on the digit.
+ */
+static void ecc_table_select(uint64_t *x, uint64_t *y,
+				const struct ecc_point *table, int digit)
 {
-	/* R0 and R1 */
-	uint64_t rx[2][NUM_ECC_DIGITS];
-	uint64_t ry[2][NUM_ECC_DIGITS];
+	uint64_t negate = -(uint64_t) (digit < 0);
+	unsigned int index = ((digit ^ (int) negate) - (int) negate) >> 1;
+	uint64_t tmp[NUM_ECC_DIGITS];
+	unsigned int i;
+
+	vli_clear(x);
+	vli_clear(y);
+
+	for (i = 0; i < ECC_TABLE_SIZE; i++) {
+		uint64_t mask = -(uint64_t) (i == index);
+
+		vli_cmov(x, table[i].x, mask);
+		vli_cmov(y, table[i].y, mask);
+	}
+
+	vli_sub(tmp, curve_p, y);
+	vli_cmov(y, tmp, negate);
+}
+
+/* Odd multiples of 16^i * G for every digit position i, computed on first
+ * use. This turns public key generation into ECC_NUM_DIGITS additions
+ * without any doublings.
+ */
+static struct ecc_point curve_g_table[ECC_NUM_DIGITS][ECC_TABLE_SIZE];
+static bool curve_g_table_ready;
+
+static void ecc_base_precompute(void)
+{
+	struct ecc_point base;
 	uint64_t z[NUM_ECC_DIGITS];
-	int i, nb;
+	int i, j;
+
+	base = curve_g;
+
+	for (i = 0; i < ECC_NUM_DIGITS; i++) {
+		ecc_point_precompute(curve_g_table[i], &base);
+
+		if (i == ECC_NUM_DIGITS - 1)
+			break;
 
-	vli_set(rx[1], point->x);
-	vli_set(ry[1], point->y);
+		vli_clear(z);
+		z[0] = 1;
 
-	xycz_initial_double(rx[1], ry[1], rx[0], ry[0], initial_z);
+		for (j = 0; j < ECC_WINDOW; j++)
+			ecc_point_double_jacobian(base.x, base.y, z);
 
-	for (i = num_bits - 2; i > 0; i--) {
-		nb = !vli_test_bit(scalar, i);
-		xycz_add_c(rx[1 - nb], ry[1 - nb], rx[nb], ry[nb]);
-		xycz_add(rx[nb], ry[nb], rx[1 - nb], ry[1 - nb]);
+		ecc_point_to_affine(&base, base.x, base.y, z, 0);
 	}
 
-	nb = !vli_test_bit(scalar, 0);
-	xycz_add_c(rx[1 - nb], ry[1 - nb], rx[nb], ry[nb]);
+	curve_g_table_ready = true;
+}
+
+/* Computes result = scalar * G for a scalar in [1, n-1]. */
+static void ecc_point_mult_base(struct ecc_point *result,
+						const uint64_t *scalar)
+{
+	int8_t digits[ECC_NUM_DIGITS];
+	uint64_t k[NUM_ECC_DIGITS];
+	uint64_t x[NUM_ECC_DIGITS], y[NUM_ECC_DIGITS], z[NUM_ECC_DIGITS];
+	uint64_t tx[NUM_ECC_DIGITS], ty[NUM_ECC_DIGITS];
+	uint64_t negate;
+	int i;
+
+	if (!curve_g_table_ready)
+		ecc_base_precompute();
 
-	/* Find final 1/Z value. */
-	vli_mod_sub(z, rx[1], rx[0], curve_p); /* X1 - X0 */
-	vli_mod_mult_fast(z, z, ry[1 - nb]); /* Yb * (X1 - X0) */
-	vli_mod_mult_fast(z, z, point->x);   /* xP * Yb * (X1 - X0) */
-	vli_mod_inv(z, z, curve_p);          /* 1 / (xP * Yb * (X1 - X0)) */
-	vli_mod_mult_fast(z, z, point->y);   /* yP / (xP * Yb * (X1 - X0)) */
-	vli_mod_mult_fast(z, z, rx[1 - nb]); /* Xb * yP / (xP * Yb * (X1 - X0)) */
-	/* End 1/Z calculation */
+	negate = ecc_scalar_make_odd(k, scalar);
+	ecc_scalar_recode(digits, k);
 
-	xycz_add(rx[nb], ry[nb], rx[1 - nb], ry[1 - nb]);
+	ecc_table_select(x, y, curve_g_table[0], digits[0]);
+	vli_clear(z);
+	z[0] = 1;
 
-	apply_z(rx[0], ry[0], z);
+	/* The sum of the lower digits is smaller than 16^i in magnitude, so
+	 * it can only be congruent to the next term once 16^(i + 1) > n.
+	 */
+	for (i = 1; i < ECC_NUM_DIGITS; i++) {
+		ecc_table_select(tx, ty, curve_g_table[i], digits[i]);
+		ecc_point_add_mixed(x, y, z, tx, ty,
+					i >= ECC_NUM_DIGITS - 2);
+	}
 
-	vli_set(result->x, rx[0]);
-	vli_set(result->y, ry[0]);
+	ecc_point_to_affine(result, x, y, z, negate);
+}
+
+/* Computes result = scalar * point for a scalar in [1, n-1] using a fixed
+ * window over the signed digits. initial_z randomizes the projective
+ * representation of the intermediate results.
+ */
+static void ecc_point_mult(struct ecc_point *result,
+				const struct ecc_point *point,
+				const uint64_t *scalar, uint64_t *initial_z)
+{
+	struct ecc_point table[ECC_TABLE_SIZE];
+	int8_t digits[ECC_NUM_DIGITS];
+	uint64_t k[NUM_ECC_DIGITS];
+	uint64_t x[NUM_ECC_DIGITS], y[NUM_ECC_DIGITS], z[NUM_ECC_DIGITS];
+	uint64_t tx[NUM_ECC_DIGITS], ty[NUM_ECC_DIGITS];
+	uint64_t negate;
+	int i, j;
+
+	ecc_point_precompute(table, point);
+
+	negate = ecc_scalar_make_odd(k, scalar);
+	ecc_scalar_recode(digits, k);
+
+	/* The most significant digit is always 1 */
+	vli_set(x, point->x);
+	vli_set(y, point->y);
+	vli_clear(z);
+	z[0] = 1;
+
+	if (initial_z && !vli_is_zero(initial_z)) {
+		vli_set(z, initial_z);
+		apply_z(x, y, z);
+	}
+
+	/* Before the last digit the accumulated multiple is far below n, so
+	 * it can't meet the digit's multiple until then.
+	 */
+	for (i = ECC_NUM_DIGITS - 2; i >= 0; i--) {
+		for (j = 0; j < ECC_WINDOW; j++)
+			ecc_point_double_jacobian(x, y, z);
+
+		ecc_table_select(tx, ty, table, digits[i]);
+		ecc_point_add_mixed(x, y, z, tx, ty, i == 0);
+	}
+
+	ecc_point_to_affine(result, x, y, z, negate);
 }
 
 static bool ecc_valid_point(const struct ecc_point *point)
@@ -872,7 +1152,7 @@ bool ecc_make_public_key(const uint8_t private_key[32], uint8_t public_key[64])
 	if (vli_cmp(curve_n, priv) != 1)
 		return false;
 
-	ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+	ecc_point_mult_base(&pk, priv);
 
 	if (ecc_point_is_zero(&pk))
 		return false;
@@ -900,7 +1180,7 @@ bool ecc_make_key(uint8_t public_key[64], uint8_t private_key[32])
 		if (vli_cmp(curve_n, priv) != 1)
 			continue;
 
-		ecc_point_mult(&pk, &curve_g, priv, NULL, vli_num_bits(priv));
+		ecc_point_mult_base(&pk, priv);
 	} while (ecc_point_is_zero(&pk));
 
 	ecc_native2bytes(priv, private_key);
@@ -939,7 +1219,11 @@ bool ecdh_shared_secret(const uint8_t public_key[64],
 
 	ecc_bytes2native(private_key, priv);
 
-	ecc_point_mult(&product, &pk, priv, rand, vli_num_bits(priv));
+	/* Make sure the private key is in the range [1, n-1]. */
+	if (vli_is_zero(priv) || vli_cmp(curve_n, priv) != 1)
+		return false;
+
+	ecc_point_mult(&product, &pk, priv, rand);
 
 	ecc_native2bytes(product.x, secret);
 
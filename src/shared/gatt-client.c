@@ -33,6 +33,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/gatt-db.h"
 #include "src/shared/gatt-client.h"
+#include "src/shared/timeout.h"
 
 #include <assert.h>
 #include <limits.h>
@@ -51,6 +52,10 @@
 #define GATT_SVC_UUID	0x1801
 #define SVC_CHNGD_UUID	0x2a05
 
+#define NFY_BATCH_TIMEOUT	10
+#define NFY_BATCH_MAX		32
+#define NFY_BATCH_SIZE		4096
+
 struct ready_cb {
 	bt_gatt_client_callback_t callback;
 	bt_gatt_client_destroy_func_t destroy;
@@ -94,6 +99,7 @@ struct bt_gatt_client {
 	/* List of registered disconnect/notification/indication callbacks */
 	struct queue *notify_list;
 	struct queue *notify_chrcs;
+	struct notify_batch *nfy_batch;	/* Spare batch buffer */
 	int next_reg_id;
 	unsigned int disc_id, nfy_id, nfy_mult_id, ind_id;
 
@@ -107,6 +113,10 @@ struct bt_gatt_client {
 	struct queue *svc_chngd_queue;  /* Queued service changed events */
 	bool in_svc_chngd;
 
+	/* Attribute handles taken from the cache vs. discovered again */
+	unsigned int attrs_reused;
+	unsigned int attrs_discovered;
+
 	/*
 	 * List of pending read/write operations. For operations that span
 	 * across multiple PDUs, this list provides a mapping from an operation
@@ -187,6 +197,19 @@ struct notify_chrc {
 	 */
 	struct queue *reg_notify_queue;
 	unsigned int ccc_write_id;
+
+	/* Values waiting to be delivered to batched notify callbacks */
+	struct notify_batch *batch;
+};
+
+struct notify_batch {
+	struct bt_gatt_client *client;
+	uint16_t value_handle;
+	unsigned int timeout_id;
+	unsigned int count;
+	size_t len;
+	struct iovec iov[NFY_BATCH_MAX];
+	uint8_t buf[NFY_BATCH_SIZE];
 };
 
 struct notify_data {
@@ -198,6 +221,7 @@ struct notify_data {
 	struct notify_chrc *chrc;
 	bt_gatt_client_register_callback_t callback;
 	bt_gatt_client_notify_callback_t notify;
+	bt_gatt_client_notify_batch_callback_t notify_batch;
 	void *user_data;
 	bt_gatt_client_destroy_func_t destroy;
 };
@@ -256,6 +280,17 @@ static void notify_data_cleanup(void *data)
 	notify_data_unref(notify_data);
 }
 
+static void notify_batch_free(struct notify_batch *batch)
+{
+	if (!batch)
+		return;
+
+	if (batch->timeout_id)
+		timeout_remove(batch->timeout_id);
+
+	free(batch);
+}
+
 static void notify_chrc_free(void *data)
 {
 	struct notify_chrc *chrc = data;
@@ -263,6 +298,8 @@ static void notify_chrc_free(void *data)
 	if (chrc->notify_id)
 		gatt_db_attribute_unregister(chrc->attr, chrc->notify_id);
 
+	notify_batch_free(chrc->batch);
+
 	queue_destroy(chrc->reg_notify_queue, notify_data_unref);
 	free(chrc);
 }
@@ -353,6 +390,7 @@ typedef void (*discovery_op_complete_func_t)(struct discovery_op *op,
 							bool success,
 							uint8_t att_ecode);
 typedef void (*discovery_op_fail_func_t)(struct discovery_op *op);
+typedef void (*discovery_op_next_func_t)(struct discovery_op *op);
 
 struct discovery_op {
 	struct bt_gatt_client *client;
@@ -360,8 +398,15 @@ struct discovery_op {
 	struct queue *pending_svcs;
 	struct queue *pending_chrcs;
 	struct queue *ext_prop_desc;
+	struct queue *verify_svcs;
 	struct gatt_db_attribute *cur_svc;
+	struct gatt_db_attribute *verify_svc;
 	struct gatt_db_attribute *hash;
+	uint8_t hash_value[16];
+	bool hash_changed;
+	bool verify;
+	unsigned int reused;
+	unsigned int discovered;
 	uint8_t server_feat;
 	bool success;
 	uint16_t start;
@@ -373,6 +418,7 @@ struct discovery_op {
 	int ref_count;
 	discovery_op_complete_func_t complete_func;
 	discovery_op_fail_func_t failure_func;
+	discovery_op_next_func_t verify_done;
 };
 
 static void discovery_op_free(struct discovery_op *op)
@@ -384,10 +430,12 @@ static void discovery_op_free(struct discovery_op *op)
 	queue_destroy(op->pending_svcs, NULL);
 	queue_destroy(op->pending_chrcs, free);
 	queue_destroy(op->ext_prop_desc, NULL);
+	queue_destroy(op->verify_svcs, NULL);
 	free(op);
 }
 
 static bool read_db_hash(struct discovery_op *op);
+static void store_db_hash(struct discovery_op *op);
 
 static void discovery_op_complete(struct discovery_op *op, bool success,
 								uint8_t err)
@@ -430,6 +478,21 @@ static void discovery_op_complete(struct discovery_op *op, bool success,
 	if (op->last != UINT16_MAX)
 		gatt_db_clear_range(op->client->db, op->last + 1, UINT16_MAX);
 
+	/*
+	 * Only store a new hash once the cache is in sync, otherwise a later
+	 * Service Changed would wrongly match it.
+	 */
+	if (success && op->hash_changed &&
+				queue_isempty(op->client->svc_chngd_queue))
+		store_db_hash(op);
+
+	op->client->attrs_reused += op->reused;
+	op->client->attrs_discovered += op->discovered;
+
+	util_debug(op->client->debug_callback, op->client->debug_data,
+			"Attributes reused: %u discovered: %u",
+			op->reused, op->discovered);
+
 	op->complete_func(op, success, err);
 }
 
@@ -447,6 +510,10 @@ static void discovery_service_changed(struct gatt_db_attribute *attr,
 	struct discovery_op *op = user_data;
 
 	queue_remove(op->pending_svcs, attr);
+	queue_remove(op->verify_svcs, attr);
+
+	if (op->verify_svc == attr)
+		op->verify_svc = NULL;
 }
 
 static struct discovery_op *discovery_op_create(struct bt_gatt_client *client,
@@ -462,6 +529,7 @@ static struct discovery_op *discovery_op_create(struct bt_gatt_client *client,
 	op->pending_svcs = queue_new();
 	op->pending_chrcs = queue_new();
 	op->ext_prop_desc = queue_new();
+	op->verify_svcs = queue_new();
 	op->client = client;
 	op->complete_func = complete_func;
 	op->failure_func = failure_func;
@@ -1095,11 +1163,22 @@ static void discovery_found_service(struct discovery_op *op,
 			op->svc_first = start;
 		if (end > op->svc_last)
 			op->svc_last = end;
+
+		op->discovered += end - start + 1;
 	} else {
 		/* Remove from pending if active */
 		queue_remove(op->pending_svcs, attr);
 
 		remove_discov_range(op, start, end);
+
+		/*
+		 * The declaration is unchanged but the database is known to
+		 * have changed, so check its characteristics before reusing.
+		 */
+		if (op->verify && end > start)
+			queue_push_tail(op->verify_svcs, attr);
+		else
+			op->reused += end - start + 1;
 	}
 
 	/* Update last handle */
@@ -1150,6 +1229,283 @@ static bool discovery_parse_services(struct discovery_op *op, bool primary,
 	return true;
 }
 
+static void add_discov_range(struct discovery_op *op, uint16_t start,
+								uint16_t end)
+{
+	const struct queue_entry *entry;
+	struct handle_range *range, *prev = NULL;
+
+	for (entry = queue_get_entries(op->discov_ranges); entry;
+							entry = entry->next) {
+		range = entry->data;
+
+		if (range->start > end)
+			break;
+
+		prev = range;
+	}
+
+	range = new0(struct handle_range, 1);
+	range->start = start;
+	range->end = end;
+
+	if (prev)
+		queue_push_after(op->discov_ranges, prev, range);
+	else
+		queue_push_head(op->discov_ranges, range);
+}
+
+static bool discovery_invalidate_service(struct discovery_op *op,
+					struct gatt_db_attribute *attr)
+{
+	struct bt_gatt_client *client = op->client;
+	uint16_t start, end;
+	bool primary;
+	bt_uuid_t uuid;
+
+	gatt_db_attribute_get_service_data(attr, &start, &end, &primary,
+									&uuid);
+
+	util_debug(client->debug_callback, client->debug_data,
+				"service changed: start 0x%04x end 0x%04x",
+				start, end);
+
+	gatt_db_remove_service(client->db, attr);
+
+	attr = gatt_db_insert_service(client->db, start, &uuid, primary,
+							end - start + 1);
+	if (!attr)
+		return false;
+
+	add_discov_range(op, start, end);
+	discovery_found_service(op, attr, start, end);
+
+	return true;
+}
+
+struct chrc_verify {
+	struct bt_gatt_iter iter;
+	bool has_result;
+	bool valid;
+};
+
+static void verify_chrc(struct gatt_db_attribute *attr, void *user_data)
+{
+	struct chrc_verify *verify = user_data;
+	uint16_t handle, value_handle, start, end, value;
+	uint8_t properties, props;
+	uint128_t u128;
+	bt_uuid_t uuid, found;
+
+	if (!verify->valid)
+		return;
+
+	verify->valid = false;
+
+	if (!verify->has_result)
+		return;
+
+	if (!gatt_db_attribute_get_char_data(attr, &handle, &value_handle,
+						&properties, NULL, &uuid))
+		return;
+
+	if (!bt_gatt_iter_next_characteristic(&verify->iter, &start, &end,
+						&value, &props, u128.data))
+		return;
+
+	bt_uuid128_create(&found, u128);
+
+	if (start != handle || value != value_handle ||
+			props != properties || bt_uuid_cmp(&found, &uuid))
+		return;
+
+	verify->valid = true;
+}
+
+/*
+ * Compare the characteristic declarations of a cached service with the
+ * ones just read from the remote.
+ */
+static bool verify_service(struct gatt_db_attribute *attr,
+						struct bt_gatt_result *result)
+{
+	struct chrc_verify verify;
+	uint16_t start, end, value;
+	uint8_t props;
+	uint128_t u128;
+
+	memset(&verify, 0, sizeof(verify));
+
+	if (result) {
+		if (!bt_gatt_iter_init(&verify.iter, result))
+			return false;
+
+		verify.has_result = true;
+	}
+
+	verify.valid = true;
+
+	gatt_db_service_foreach_char(attr, verify_chrc, &verify);
+
+	if (!verify.valid)
+		return false;
+
+	/* Any characteristic left means one was added */
+	return !verify.has_result ||
+		!bt_gatt_iter_next_characteristic(&verify.iter, &start, &end,
+						&value, &props, u128.data);
+}
+
+static void verify_chrcs_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data);
+
+static bool verify_services(struct discovery_op *op,
+					discovery_op_next_func_t done)
+{
+	struct bt_gatt_client *client = op->client;
+	uint16_t start, end;
+
+	op->verify_done = done;
+
+	while ((op->verify_svc = queue_pop_head(op->verify_svcs))) {
+		gatt_db_attribute_get_service_handles(op->verify_svc, &start,
+									&end);
+
+		client->discovery_req = bt_gatt_discover_characteristics(
+							client->att,
+							start, end,
+							verify_chrcs_cb,
+							discovery_op_ref(op),
+							discovery_op_unref);
+		if (client->discovery_req)
+			return true;
+
+		discovery_op_unref(op);
+
+		/* Unable to check it, discover it again instead */
+		discovery_invalidate_service(op, op->verify_svc);
+	}
+
+	return false;
+}
+
+static void verify_chrcs_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data)
+{
+	struct discovery_op *op = user_data;
+	struct bt_gatt_client *client = op->client;
+	struct gatt_db_attribute *attr = op->verify_svc;
+	uint16_t start, end;
+
+	discovery_req_clear(client);
+
+	op->verify_svc = NULL;
+
+	if (!success && att_ecode != BT_ATT_ERROR_ATTRIBUTE_NOT_FOUND) {
+		util_debug(client->debug_callback, client->debug_data,
+				"Characteristic verification failed."
+				" ATT ECODE: 0x%02x", att_ecode);
+		discovery_op_complete(op, false, att_ecode);
+		return;
+	}
+
+	/* Service removed while the request was ongoing */
+	if (!attr)
+		goto next;
+
+	if (!verify_service(attr, success ? result : NULL)) {
+		if (!discovery_invalidate_service(op, attr)) {
+			discovery_op_complete(op, false, 0);
+			return;
+		}
+
+		goto next;
+	}
+
+	gatt_db_attribute_get_service_handles(attr, &start, &end);
+
+	util_debug(client->debug_callback, client->debug_data,
+				"service unchanged: start 0x%04x end 0x%04x",
+				start, end);
+
+	op->reused += end - start + 1;
+
+next:
+	if (verify_services(op, op->verify_done))
+		return;
+
+	op->verify_done(op);
+}
+
+static void discover_secondary_cb(bool success, uint8_t att_ecode,
+						struct bt_gatt_result *result,
+						void *user_data);
+
+static void discover_secondary(struct discovery_op *op)
+{
+	struct bt_gatt_client *client = op->client;
+
+	/*
+	 * Version 4.2 [Vol 1, Part A] page 101:
+	 * A secondary service is a service that provides auxiliary
+	 * functionality of a device and is referenced from at least one
+	 * primary service on the device.
+	 */
+	if (queue_isempty(op->pending_svcs)) {
+		discovery_op_complete(op, true, 0);
+		return;
+	}
+
+	/* Discover secondary services */
+	client->discovery_req = bt_gatt_discover_secondary_services(client->att,
+						NULL, op->start, op->end,
+						discover_secondary_cb,
+						discovery_op_ref(op),
+						discovery_op_unref);
+	if (client->discovery_req)
+		return;
+
+	util_debug(client->debug_callback, client->debug_data,
+				"Failed to start secondary service discovery");
+	discovery_op_unref(op);
+	discovery_op_complete(op, false, 0);
+}
+
+static void discover_included(struct discovery_op *op)
+{
+	struct bt_gatt_client *client = op->client;
+	struct handle_range *range;
+
+	if (queue_isempty(op->pending_svcs) ||
+					queue_isempty(op->discov_ranges)) {
+		discovery_op_complete(op, true, 0);
+		return;
+	}
+
+	if (op->svc_first > 0x0001)
+		remove_discov_range(op, 1, op->svc_first - 1);
+	if (op->svc_last < 0xffff)
+		remove_discov_range(op, op->svc_last + 1, 0xffff);
+
+	range = queue_peek_head(op->discov_ranges);
+
+	client->discovery_req = bt_gatt_discover_included_services(client->att,
+							range->start,
+							range->end,
+							discover_incl_cb,
+							discovery_op_ref(op),
+							discovery_op_unref);
+	if (client->discovery_req)
+		return;
+
+	util_debug(client->debug_callback, client->debug_data,
+				"Failed to start included services discovery");
+	discovery_op_unref(op);
+	discovery_op_complete(op, false, 0);
+}
+
 static void discover_secondary_cb(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data)
@@ -1157,7 +1513,6 @@ static void discover_secondary_cb(bool success, uint8_t att_ecode,
 	struct discovery_op *op = user_data;
 	struct bt_gatt_client *client = op->client;
 	struct bt_gatt_iter iter;
-	struct handle_range *range;
 
 	discovery_req_clear(client);
 
@@ -1190,31 +1545,12 @@ static void discover_secondary_cb(bool success, uint8_t att_ecode,
 		goto done;
 	}
 
-
 next:
-	if (queue_isempty(op->pending_svcs) || queue_isempty(op->discov_ranges))
-		goto done;
-
-	if (op->svc_first > 0x0001)
-		remove_discov_range(op, 1, op->svc_first - 1);
-	if (op->svc_last < 0xffff)
-		remove_discov_range(op, op->svc_last + 1, 0xffff);
-
-	range = queue_peek_head(op->discov_ranges);
-
-	client->discovery_req = bt_gatt_discover_included_services(client->att,
-							range->start,
-							range->end,
-							discover_incl_cb,
-							discovery_op_ref(op),
-							discovery_op_unref);
-	if (client->discovery_req)
+	if (verify_services(op, discover_included))
 		return;
 
-	util_debug(client->debug_callback, client->debug_data,
-				"Failed to start included services discovery");
-	discovery_op_unref(op);
-	success = false;
+	discover_included(op);
+	return;
 
 done:
 	discovery_op_complete(op, success, att_ecode);
@@ -1260,28 +1596,11 @@ static void discover_primary_cb(bool success, uint8_t att_ecode,
 	}
 
 secondary:
-	/*
-	 * Version 4.2 [Vol 1, Part A] page 101:
-	 * A secondary service is a service that provides auxiliary
-	 * functionality of a device and is referenced from at least one
-	 * primary service on the device.
-	 */
-	if (queue_isempty(op->pending_svcs))
-		goto done;
-
-	/* Discover secondary services */
-	client->discovery_req = bt_gatt_discover_secondary_services(client->att,
-						NULL, op->start, op->end,
-						discover_secondary_cb,
-						discovery_op_ref(op),
-						discovery_op_unref);
-	if (client->discovery_req)
+	if (verify_services(op, discover_secondary))
 		return;
 
-	util_debug(client->debug_callback, client->debug_data,
-				"Failed to start secondary service discovery");
-	discovery_op_unref(op);
-	success = false;
+	discover_secondary(op);
+	return;
 
 done:
 	discovery_op_complete(op, success, att_ecode);
@@ -1373,6 +1692,37 @@ static void db_hash_read_value_cb(struct gatt_db_attribute *attrib,
 	*hash = value;
 }
 
+static void count_reused(void *data, void *user_data)
+{
+	struct gatt_db_attribute *attr = data;
+	struct discovery_op *op = user_data;
+	uint16_t start, end;
+
+	gatt_db_attribute_get_service_handles(attr, &start, &end);
+
+	op->reused += end - start + 1;
+}
+
+static void discover_changed(struct discovery_op *op)
+{
+	struct bt_gatt_client *client = op->client;
+
+	client->discovery_req = bt_gatt_discover_primary_services(client->att,
+						NULL, op->start, op->end,
+						discover_primary_cb,
+						discovery_op_ref(op),
+						discovery_op_unref);
+	if (client->discovery_req)
+		return;
+
+	util_debug(client->debug_callback, client->debug_data,
+					"Failed to initiate service discovery"
+					" after Service Changed");
+
+	discovery_op_unref(op);
+	discovery_op_complete(op, false, BT_ATT_ERROR_UNLIKELY);
+}
+
 static void db_hash_read_cb(bool success, uint8_t att_ecode,
 						struct bt_gatt_result *result,
 						void *user_data)
@@ -1404,6 +1754,7 @@ static void db_hash_read_cb(bool success, uint8_t att_ecode,
 	if (hash && !memcmp(hash, value, len)) {
 		util_debug(client->debug_callback, client->debug_data,
 				"DB Hash match: skipping discovery");
+		queue_foreach(op->pending_svcs, count_reused, op);
 		queue_remove_all(op->pending_svcs, NULL, NULL, NULL);
 		discovery_op_complete(op, true, 0);
 		return;
@@ -1414,13 +1765,19 @@ static void db_hash_read_cb(bool success, uint8_t att_ecode,
 	util_hexdump(' ', value, len, client->debug_callback,
 						client->debug_data);
 
-	/* Store ithe new hash in the db */
-	gatt_db_attribute_write(op->hash, 0, value, len, 0, NULL,
-					db_hash_write_value_cb, client);
+	/* Stored once discovery completes */
+	memcpy(op->hash_value, value, len);
+	op->hash_changed = true;
+
+	/* Cached services can no longer be trusted as they are */
+	op->verify = true;
 
 discover:
 	if (!op->success) {
-		discover_all(op);
+		if (client->in_svc_chngd)
+			discover_changed(op);
+		else
+			discover_all(op);
 		return;
 	}
 
@@ -1438,6 +1795,24 @@ static void get_first_attribute(struct gatt_db_attribute *attrib,
 	*stored = attrib;
 }
 
+static void store_db_hash(struct discovery_op *op)
+{
+	struct bt_gatt_client *client = op->client;
+	struct gatt_db_attribute *attr = NULL;
+	bt_uuid_t uuid;
+
+	/* The attribute read before discovery may have been replaced */
+	bt_uuid16_create(&uuid, GATT_CHARAC_DB_HASH);
+	gatt_db_find_by_type(client->db, 0x0001, 0xffff, &uuid,
+						get_first_attribute, &attr);
+	if (!attr)
+		return;
+
+	gatt_db_attribute_write(attr, 0, op->hash_value,
+					sizeof(op->hash_value), 0, NULL,
+					db_hash_write_value_cb, client);
+}
+
 static bool read_db_hash(struct discovery_op *op)
 {
 	struct bt_gatt_client *client = op->client;
@@ -1683,6 +2058,7 @@ static unsigned int register_notify(struct bt_gatt_client *client,
 				uint16_t handle,
 				bt_gatt_client_register_callback_t callback,
 				bt_gatt_client_notify_callback_t notify,
+				bt_gatt_client_notify_batch_callback_t notify_batch,
 				void *user_data,
 				bt_gatt_client_destroy_func_t destroy)
 {
@@ -1713,6 +2089,7 @@ static unsigned int register_notify(struct bt_gatt_client *client,
 	notify_data->chrc = chrc;
 	notify_data->callback = callback;
 	notify_data->notify = notify;
+	notify_data->notify_batch = notify_batch;
 	notify_data->user_data = user_data;
 	notify_data->destroy = destroy;
 
@@ -1801,7 +2178,7 @@ static bool register_service_changed(struct bt_gatt_client *client)
 	client->svc_chngd_ind_id = register_notify(client,
 					gatt_db_attribute_get_handle(attr),
 					service_changed_register_cb,
-					service_changed_cb,
+					service_changed_cb, NULL,
 					client, NULL);
 
 	return client->svc_chngd_ind_id ? true : false;
@@ -1876,16 +2253,36 @@ static void process_service_changed(struct bt_gatt_client *client,
 	if (!op)
 		goto fail;
 
+	/*
+	 * Services left in place by the server are only reused once their
+	 * characteristic declarations are found to be unchanged.
+	 */
+	op->verify = true;
+
+	client->in_svc_chngd = true;
+
+	/*
+	 * If the hash is back to the cached one there is nothing to
+	 * rediscover, e.g. a service was removed and added back.
+	 */
+	discovery_op_ref(op);
+
+	if (read_db_hash(op)) {
+		discovery_op_unref(op);
+		return;
+	}
+
 	client->discovery_req = bt_gatt_discover_primary_services(client->att,
 						NULL, start_handle, end_handle,
 						discover_primary_cb,
 						discovery_op_ref(op),
 						discovery_op_unref);
 	if (client->discovery_req) {
-		client->in_svc_chngd = true;
+		discovery_op_unref(op);
 		return;
 	}
 
+	client->in_svc_chngd = false;
 	discovery_op_free(op);
 
 fail:
@@ -2101,6 +2498,7 @@ struct value_data {
 	uint16_t handle;
 	uint16_t len;
 	const void *data;
+	bool batched;
 };
 
 static void disable_ccc_callback(uint8_t opcode, const void *pdu,
@@ -2148,6 +2546,105 @@ done:
 	notify_data_unref(notify_data);
 }
 
+static void batch_handler(void *data, void *user_data)
+{
+	struct notify_data *notify_data = data;
+	struct notify_batch *batch = user_data;
+
+	if (notify_data->chrc->value_handle != batch->value_handle)
+		return;
+
+	if (notify_data->notify_batch)
+		notify_data->notify_batch(batch->value_handle, batch->iov,
+						batch->count,
+						notify_data->user_data);
+}
+
+static bool notify_batch_flush(void *user_data)
+{
+	struct notify_chrc *chrc = user_data;
+	struct notify_batch *batch = chrc->batch;
+	struct bt_gatt_client *client = batch->client;
+
+	/*
+	 * Detach the batch while the handlers run since any of them may
+	 * unregister and cause the characteristic to go away.
+	 */
+	chrc->batch = NULL;
+	batch->timeout_id = 0;
+
+	bt_gatt_client_ref(client);
+
+	queue_foreach(client->notify_list, batch_handler, batch);
+
+	if (!client->nfy_batch)
+		client->nfy_batch = batch;
+	else
+		free(batch);
+
+	bt_gatt_client_unref(client);
+
+	return false;
+}
+
+/*
+ * Flush the batch of the characteristic if the value does not fit in it.
+ * This must not be called while iterating over the notify list since the
+ * handlers may unregister.
+ */
+static void notify_batch_reserve(struct bt_gatt_client *client,
+						struct value_data *value_data)
+{
+	struct notify_chrc *chrc;
+	struct notify_batch *batch;
+
+	chrc = queue_find(client->notify_chrcs, match_notify_chrc_value_handle,
+					UINT_TO_PTR(value_data->handle));
+	if (!chrc || !chrc->batch)
+		return;
+
+	batch = chrc->batch;
+
+	if (batch->count < NFY_BATCH_MAX &&
+			batch->len + value_data->len <= NFY_BATCH_SIZE)
+		return;
+
+	timeout_remove(batch->timeout_id);
+	batch->timeout_id = 0;
+	notify_batch_flush(chrc);
+}
+
+static void notify_batch_push(struct notify_chrc *chrc,
+						struct value_data *value_data)
+{
+	struct bt_gatt_client *client = chrc->client;
+	struct notify_batch *batch = chrc->batch;
+
+	if (!batch) {
+		batch = client->nfy_batch;
+		client->nfy_batch = NULL;
+
+		if (!batch)
+			batch = new0(struct notify_batch, 1);
+
+		batch->client = client;
+		batch->value_handle = chrc->value_handle;
+		batch->count = 0;
+		batch->len = 0;
+		batch->timeout_id = timeout_add(NFY_BATCH_TIMEOUT,
+						notify_batch_flush, chrc,
+						NULL);
+		chrc->batch = batch;
+	}
+
+	batch->iov[batch->count].iov_base = batch->buf + batch->len;
+	batch->iov[batch->count].iov_len = value_data->len;
+	batch->count++;
+
+	memcpy(batch->buf + batch->len, value_data->data, value_data->len);
+	batch->len += value_data->len;
+}
+
 static void notify_handler(void *data, void *user_data)
 {
 	struct notify_data *notify_data = data;
@@ -2156,6 +2653,15 @@ static void notify_handler(void *data, void *user_data)
 	if (notify_data->chrc->value_handle != value_data->handle)
 		return;
 
+	/*
+	 * Batched handlers share one copy of the value per characteristic,
+	 * it is delivered to all of them once the batch is flushed.
+	 */
+	if (notify_data->notify_batch && !value_data->batched) {
+		value_data->batched = true;
+		notify_batch_push(notify_data->chrc, value_data);
+	}
+
 	/*
 	 * Even if the notify data has a pending ATT request to write to the
 	 * CCC, there is really no reason not to notify the handlers.
@@ -2187,7 +2693,9 @@ static void notify_cb(struct bt_att_chan *chan, uint8_t opcode,
 			pdu += 2;
 
 			data.data = pdu;
+			data.batched = false;
 
+			notify_batch_reserve(client, &data);
 			queue_foreach(client->notify_list, notify_handler,
 								&data);
 
@@ -2201,6 +2709,7 @@ static void notify_cb(struct bt_att_chan *chan, uint8_t opcode,
 		data.len = length;
 		data.data = pdu;
 
+		notify_batch_reserve(client, &data);
 		queue_foreach(client->notify_list, notify_handler, &data);
 	}
 
@@ -2217,6 +2726,7 @@ static void bt_gatt_client_free(struct bt_gatt_client *client)
 
 	queue_destroy(client->notify_chrcs, notify_chrc_free);
 	queue_destroy(client->notify_list, notify_data_cleanup);
+	free(client->nfy_batch);
 
 	queue_destroy(client->ready_cbs, ready_destroy);
 
@@ -2484,6 +2994,25 @@ uint8_t bt_gatt_client_get_features(struct bt_gatt_client *client)
 	return client->features;
 }
 
+bool bt_gatt_client_get_cache_stats(struct bt_gatt_client *client,
+						unsigned int *reused,
+						unsigned int *discovered)
+{
+	if (!client)
+		return false;
+
+	if (client->parent)
+		client = client->parent;
+
+	if (reused)
+		*reused = client->attrs_reused;
+
+	if (discovered)
+		*discovered = client->attrs_discovered;
+
+	return true;
+}
+
 static bool match_req_id(const void *a, const void *b)
 {
 	const struct request *req = a;
@@ -3665,7 +4194,26 @@ unsigned int bt_gatt_client_register_notify(struct bt_gatt_client *client,
 		return 0;
 
 	return register_notify(client, chrc_value_handle, callback, notify,
-							user_data, destroy);
+						NULL, user_data, destroy);
+}
+
+unsigned int bt_gatt_client_register_notify_batch(
+				struct bt_gatt_client *client,
+				uint16_t chrc_value_handle,
+				bt_gatt_client_register_callback_t callback,
+				bt_gatt_client_notify_batch_callback_t notify,
+				void *user_data,
+				bt_gatt_client_destroy_func_t destroy)
+{
+	if (!client || !client->db || !chrc_value_handle || !callback ||
+								!notify)
+		return 0;
+
+	if (client->in_svc_chngd)
+		return 0;
+
+	return register_notify(client, chrc_value_handle, callback, NULL,
+						notify, user_data, destroy);
 }
 
 bool bt_gatt_client_unregister_notify(struct bt_gatt_client *client,
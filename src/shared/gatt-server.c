@@ -1760,14 +1760,24 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 					uint16_t length, bool multiple)
 {
 	struct nfy_mult_data *data = NULL;
-	bool result;
+	struct iovec iov[2];
+	uint8_t pdu[2];
 
 	if (!server || (length && !value))
 		return false;
 
-	if (multiple)
-		data = server->nfy_mult;
+	if (!multiple) {
+		put_le16(handle, pdu);
+		iov[0].iov_base = pdu;
+		iov[0].iov_len = sizeof(pdu);
+		iov[1].iov_base = (void *) value;
+		iov[1].iov_len = MIN(bt_att_get_mtu(server->att) - 3, length);
+
+		return !!bt_att_sendv(server->att, BT_ATT_OP_HANDLE_NFY, iov,
+						2, NULL, NULL, NULL);
+	}
 
+	data = server->nfy_mult;
 	if (!data) {
 		data = new0(struct nfy_mult_data, 1);
 		data->len = bt_att_get_mtu(server->att) - 1;
@@ -1779,32 +1789,21 @@ bool bt_gatt_server_send_notification(struct bt_gatt_server *server,
 
 	length = MIN(data->len - data->offset, length);
 
-	if (multiple) {
-		put_le16(length, data->pdu + data->offset);
-		data->offset += 2;
-	}
+	put_le16(length, data->pdu + data->offset);
+	data->offset += 2;
 
 	memcpy(data->pdu + data->offset, value, length);
 	data->offset += length;
 
-	if (multiple) {
-		if (!server->nfy_mult)
-			server->nfy_mult = data;
+	if (!server->nfy_mult)
+		server->nfy_mult = data;
 
-		if (!server->nfy_mult->id)
-			server->nfy_mult->id = timeout_add(NFY_MULT_TIMEOUT,
-						   notify_multiple, server,
-						   NULL);
+	if (!server->nfy_mult->id)
+		server->nfy_mult->id = timeout_add(NFY_MULT_TIMEOUT,
+					   notify_multiple, server,
+					   NULL);
 
-		return true;
-	}
-
-	result = !!bt_att_send(server->att, BT_ATT_OP_HANDLE_NFY,
-				data->pdu, data->offset, NULL, NULL, NULL);
-	free(data->pdu);
-	free(data);
-
-	return result;
+	return true;
 }
 
 struct ind_data {
@@ -1839,19 +1838,14 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 					void *user_data,
 					bt_gatt_server_destroy_func_t destroy)
 {
-	uint16_t pdu_len;
-	uint8_t *pdu;
+	struct iovec iov[2];
+	uint8_t pdu[2];
 	struct ind_data *data;
 	bool result;
 
 	if (!server || (length && !value))
 		return false;
 
-	pdu_len = MIN(bt_att_get_mtu(server->att) - 1, length + 2);
-	pdu = malloc(pdu_len);
-	if (!pdu)
-		return false;
-
 	data = new0(struct ind_data, 1);
 
 	data->callback = callback;
@@ -1859,16 +1853,17 @@ bool bt_gatt_server_send_indication(struct bt_gatt_server *server,
 	data->user_data = user_data;
 
 	put_le16(handle, pdu);
-	memcpy(pdu + 2, value, pdu_len - 2);
-
-	result = !!bt_att_send(server->att, BT_ATT_OP_HANDLE_IND, pdu,
-							pdu_len, conf_cb,
-							data, destroy_ind_data);
+	iov[0].iov_base = pdu;
+	iov[0].iov_len = sizeof(pdu);
+	iov[1].iov_base = (void *) value;
+	iov[1].iov_len = MIN(bt_att_get_mtu(server->att) - 3, length);
+
+	result = !!bt_att_sendv(server->att, BT_ATT_OP_HANDLE_IND, iov, 2,
+							conf_cb, data,
+							destroy_ind_data);
 	if (!result)
 		destroy_ind_data(data);
 
-	free(pdu);
-
 	return result;
 }
 
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
 
@@ -55,6 +56,34 @@ struct hci_filter {
 	uint16_t opcode;
 };
 
+/* ACL packets have the largest length field of all H:4 packets */
+#define HCI_MAX_FRAME	(1 + sizeof(struct bt_hci_acl_hdr) + UINT16_MAX)
+
+#define ACL_CONT	0x01
+#define ACL_START	0x02
+
+#define ISO_START	0x00
+#define ISO_CONT	0x01
+#define ISO_SINGLE	0x02
+#define ISO_END		0x03
+
+/*
+ * Controller buffer pools. LE links only have buffers of their own when
+ * the controller reports any, otherwise they share the ACL ones.
+ */
+enum {
+	HCI_POOL_ACL,
+	HCI_POOL_LE,
+	HCI_POOL_ISO,
+	HCI_POOL_MAX,
+};
+
+struct hci_pool {
+	uint16_t mtu;
+	uint16_t max;
+	uint16_t used;
+};
+
 struct bt_hci {
 	int ref_count;
 	struct io *io;
@@ -63,9 +92,18 @@ struct bt_hci {
 	uint8_t num_cmds;
 	unsigned int next_cmd_id;
 	unsigned int next_evt_id;
+	unsigned int next_data_id;
 	struct queue *cmd_queue;
 	struct queue *rsp_queue;
 	struct queue *evt_list;
+	struct hci_pool pools[HCI_POOL_MAX];
+	struct queue *conn_list;
+	struct queue *data_queue;
+	struct queue *data_list;
+	uint8_t *rx_buf;
+	bt_hci_debug_func_t debug_callback;
+	bt_hci_destroy_func_t debug_destroy;
+	void *debug_data;
 };
 
 struct cmd {
@@ -86,6 +124,27 @@ struct evt {
 	void *user_data;
 };
 
+struct conn {
+	uint16_t handle;
+	uint8_t pool;
+	uint16_t sent;
+	bool queued;
+	struct queue *tx_queue;
+};
+
+struct pkt {
+	uint16_t len;
+	uint8_t data[0];
+};
+
+struct data {
+	unsigned int id;
+	uint8_t type;
+	bt_hci_data_func_t callback;
+	bt_hci_destroy_func_t destroy;
+	void *user_data;
+};
+
 static void cmd_free(void *data)
 {
 	struct cmd *cmd = data;
@@ -107,6 +166,81 @@ static void evt_free(void *data)
 	free(evt);
 }
 
+static void conn_free(void *data)
+{
+	struct conn *conn = data;
+
+	queue_destroy(conn->tx_queue, free);
+	free(conn);
+}
+
+static void data_free(void *data)
+{
+	struct data *handler = data;
+
+	if (handler->destroy)
+		handler->destroy(handler->user_data);
+
+	free(handler);
+}
+
+static bool match_conn_handle(const void *a, const void *b)
+{
+	const struct conn *conn = a;
+	uint16_t handle = PTR_TO_UINT(b);
+
+	return conn->handle == handle;
+}
+
+static struct conn *conn_get(struct bt_hci *hci, uint16_t handle,
+								uint8_t pool)
+{
+	struct conn *conn;
+
+	conn = queue_find(hci->conn_list, match_conn_handle,
+						UINT_TO_PTR(handle));
+	if (conn)
+		return conn;
+
+	conn = new0(struct conn, 1);
+	conn->handle = handle;
+	conn->pool = pool;
+	conn->tx_queue = queue_new();
+
+	queue_push_tail(hci->conn_list, conn);
+
+	return conn;
+}
+
+static struct hci_pool *conn_pool(struct bt_hci *hci,
+						const struct conn *conn)
+{
+	if (conn->pool == HCI_POOL_LE && !hci->pools[HCI_POOL_LE].max)
+		return &hci->pools[HCI_POOL_ACL];
+
+	return &hci->pools[conn->pool];
+}
+
+static void conn_release(struct bt_hci *hci, struct conn *conn)
+{
+	struct hci_pool *pool = conn_pool(hci, conn);
+
+	/* Packets of a link that is gone won't be completed anymore */
+	if (pool->used > conn->sent)
+		pool->used -= conn->sent;
+	else
+		pool->used = 0;
+
+	conn->sent = 0;
+
+	queue_remove_all(conn->tx_queue, NULL, NULL, free);
+
+	if (conn->queued) {
+		queue_remove(hci->data_queue, conn);
+		conn->queued = false;
+	}
+}
+
 static void send_command(struct bt_hci *hci, uint16_t opcode,
 						void *data, uint8_t size)
 {
@@ -139,17 +273,87 @@ static void send_command(struct bt_hci *hci, uint16_t opcode,
 	hci->num_cmds--;
 }
 
+static bool conn_ready(const void *data, const void *user_data)
+{
+	const struct conn *conn = data;
+	struct bt_hci *hci = (void *) user_data;
+	struct hci_pool *pool = conn_pool(hci, conn);
+
+	return pool->used < pool->max;
+}
+
+/*
+ * Links with queued data take turns, each one getting to send a single
+ * packet per turn as long as its buffer pool has room left.
+ */
+static bool send_data(struct bt_hci *hci)
+{
+	struct conn *conn;
+	struct pkt *pkt;
+	struct iovec iov;
+	ssize_t ret;
+
+	conn = queue_find(hci->data_queue, conn_ready, hci);
+	if (!conn)
+		return false;
+
+	queue_remove(hci->data_queue, conn);
+
+	pkt = queue_peek_head(conn->tx_queue);
+
+	iov.iov_base = pkt->data;
+	iov.iov_len = pkt->len;
+
+	ret = io_send(hci->io, &iov, 1);
+	if (ret == -EAGAIN) {
+		queue_push_head(hci->data_queue, conn);
+		return false;
+	}
+
+	free(queue_pop_head(conn->tx_queue));
+
+	if (ret >= 0) {
+		conn_pool(hci, conn)->used++;
+		conn->sent++;
+	}
+
+	if (queue_isempty(conn->tx_queue))
+		conn->queued = false;
+	else
+		queue_push_tail(hci->data_queue, conn);
+
+	return true;
+}
+
+static bool can_send_command(struct bt_hci *hci)
+{
+	return hci->num_cmds > 0 && !queue_isempty(hci->cmd_queue);
+}
+
+static bool can_send_data(struct bt_hci *hci)
+{
+	return queue_find(hci->data_queue, conn_ready, hci) != NULL;
+}
+
 static bool io_write_callback(struct io *io, void *user_data)
 {
 	struct bt_hci *hci = user_data;
 	struct cmd *cmd;
 
-	cmd = queue_pop_head(hci->cmd_queue);
-	if (cmd) {
-		send_command(hci, cmd->opcode, cmd->data, cmd->size);
-		queue_push_tail(hci->rsp_queue, cmd);
+	/* Commands always go ahead of any data */
+	if (hci->num_cmds > 0) {
+		cmd = queue_pop_head(hci->cmd_queue);
+		if (cmd) {
+			send_command(hci, cmd->opcode, cmd->data, cmd->size);
+			queue_push_tail(hci->rsp_queue, cmd);
+		}
 	}
 
+	while (send_data(hci));
+
+	if (can_send_command(hci) || can_send_data(hci))
+		return true;
+
 	hci->writer_active = false;
 
 	return false;
@@ -160,10 +364,7 @@ static void wakeup_writer(struct bt_hci *hci)
 	if (hci->writer_active)
 		return;
 
-	if (hci->num_cmds < 1)
-		return;
-
-	if (queue_isempty(hci->cmd_queue))
+	if (!can_send_command(hci) && !can_send_data(hci))
 		return;
 
 	if (!io_set_write_handler(hci->io, io_write_callback, hci, NULL))
@@ -210,6 +411,154 @@ static void process_response(struct bt_hci *hci, uint16_t opcode,
 	bt_hci_unref(hci);
 }
 
+static void process_buffer_size(struct bt_hci *hci, uint16_t opcode,
+					const void *data, size_t size)
+{
+	const struct bt_hci_rsp_read_buffer_size *rbs = data;
+	const struct bt_hci_rsp_le_read_buffer_size *lrbs = data;
+	const struct bt_hci_rsp_le_read_buffer_size_v2 *lrbs2 = data;
+	struct hci_pool *pool = hci->pools;
+
+	switch (opcode) {
+	case BT_HCI_CMD_RESET:
+		queue_remove_all(hci->data_queue, NULL, NULL, NULL);
+		queue_remove_all(hci->conn_list, NULL, NULL, conn_free);
+		memset(hci->pools, 0, sizeof(hci->pools));
+		break;
+	case BT_HCI_CMD_READ_BUFFER_SIZE:
+		if (size < sizeof(*rbs) || rbs->status)
+			return;
+		pool[HCI_POOL_ACL].mtu = le16_to_cpu(rbs->acl_mtu);
+		pool[HCI_POOL_ACL].max = le16_to_cpu(rbs->acl_max_pkt);
+		break;
+	case BT_HCI_CMD_LE_READ_BUFFER_SIZE:
+		if (size < sizeof(*lrbs) || lrbs->status)
+			return;
+		pool[HCI_POOL_LE].mtu = le16_to_cpu(lrbs->le_mtu);
+		pool[HCI_POOL_LE].max = lrbs->le_max_pkt;
+		break;
+	case BT_HCI_CMD_LE_READ_BUFFER_SIZE_V2:
+		if (size < sizeof(*lrbs2) || lrbs2->status)
+			return;
+		pool[HCI_POOL_LE].mtu = le16_to_cpu(lrbs2->acl_mtu);
+		pool[HCI_POOL_LE].max = lrbs2->acl_max_pkt;
+		pool[HCI_POOL_ISO].mtu = le16_to_cpu(lrbs2->iso_mtu);
+		pool[HCI_POOL_ISO].max = lrbs2->iso_max_pkt;
+		break;
+	}
+}
+
+static void process_completed(struct bt_hci *hci, const void *data,
+								size_t size)
+{
+	const struct bt_hci_evt_num_completed_packets *evt = data;
+	const uint8_t *ptr = data + 1;
+	uint8_t i;
+
+	if (size < 1 || size < 1 + evt->num_handles * 4U)
+		return;
+
+	for (i = 0; i < evt->num_handles; i++, ptr += 4) {
+		uint16_t handle = get_le16(ptr) & 0x0fff;
+		uint16_t count = get_le16(ptr + 2);
+		struct hci_pool *pool;
+		struct conn *conn;
+
+		conn = queue_find(hci->conn_list, match_conn_handle,
+							UINT_TO_PTR(handle));
+		if (!conn)
+			continue;
+
+		if (count > conn->sent)
+			count = conn->sent;
+
+		pool = conn_pool(hci, conn);
+		pool->used -= count < pool->used ? count : pool->used;
+		conn->sent -= count;
+	}
+
+	wakeup_writer(hci);
+}
+
+static void process_conn(struct bt_hci *hci, uint8_t status,
+					uint16_t handle, uint8_t pool)
+{
+	struct conn *conn;
+
+	if (status)
+		return;
+
+	conn = conn_get(hci, handle & 0x0fff, pool);
+	conn->pool = pool;
+}
+
+static void process_le_meta(struct bt_hci *hci, const void *data,
+								size_t size)
+{
+	const uint8_t *subevent = data;
+	const struct bt_hci_evt_le_conn_complete *lcc = data + 1;
+	const struct bt_hci_evt_le_enhanced_conn_complete *lecc = data + 1;
+	const struct bt_hci_evt_le_cis_established *cis = data + 1;
+	const struct bt_hci_evt_le_big_complete *big = data + 1;
+	uint8_t i;
+
+	if (size < 1)
+		return;
+
+	size--;
+
+	switch (*subevent) {
+	case BT_HCI_EVT_LE_CONN_COMPLETE:
+		if (size < sizeof(*lcc))
+			return;
+		process_conn(hci, lcc->status, le16_to_cpu(lcc->handle),
+								HCI_POOL_LE);
+		break;
+	case BT_HCI_EVT_LE_ENHANCED_CONN_COMPLETE:
+		if (size < sizeof(*lecc))
+			return;
+		process_conn(hci, lecc->status, le16_to_cpu(lecc->handle),
+								HCI_POOL_LE);
+		break;
+	case BT_HCI_EVT_LE_CIS_ESTABLISHED:
+		if (size < sizeof(*cis))
+			return;
+		process_conn(hci, cis->status,
+					le16_to_cpu(cis->conn_handle),
+								HCI_POOL_ISO);
+		break;
+	case BT_HCI_EVT_LE_BIG_COMPLETE:
+		if (size < sizeof(*big) ||
+				size < sizeof(*big) + big->num_bis * 2U)
+			return;
+		for (i = 0; i < big->num_bis; i++)
+			process_conn(hci, big->status,
+					get_le16(&big->handle[i]),
+					HCI_POOL_ISO);
+		break;
+	}
+}
+
+static void process_disconnect(struct bt_hci *hci, const void *data,
+								size_t size)
+{
+	const struct bt_hci_evt_disconnect_complete *evt = data;
+	struct conn *conn;
+
+	if (size < sizeof(*evt) || evt->status)
+		return;
+
+	conn = queue_remove_if(hci->conn_list, match_conn_handle,
+			UINT_TO_PTR(le16_to_cpu(evt->handle) & 0x0fff));
+	if (!conn)
+		return;
+
+	conn_release(hci, conn);
+	conn_free(conn);
+
+	wakeup_writer(hci);
+}
+
 static void process_notify(void *data, void *user_data)
 {
 	struct bt_hci_evt_hdr *hdr = user_data;
@@ -225,6 +574,7 @@ static void process_event(struct bt_hci *hci, const void *data, size_t size)
 	const struct bt_hci_evt_hdr *hdr = data;
 	const struct bt_hci_evt_cmd_complete *cc;
 	const struct bt_hci_evt_cmd_status *cs;
+	const struct bt_hci_evt_conn_complete *ccp;
 
 	if (size < sizeof(struct bt_hci_evt_hdr))
 		return;
@@ -241,6 +591,9 @@ static void process_event(struct bt_hci *hci, const void *data, size_t size)
 			return;
 		cc = data;
 		hci->num_cmds = cc->ncmd;
+		process_buffer_size(hci, le16_to_cpu(cc->opcode),
+						data + sizeof(*cc),
+						size - sizeof(*cc));
 		process_response(hci, le16_to_cpu(cc->opcode),
 						data + sizeof(*cc),
 						size - sizeof(*cc));
@@ -255,36 +608,117 @@ static void process_event(struct bt_hci *hci, const void *data, size_t size)
 		break;
 
 	default:
+		switch (hdr->evt) {
+		case BT_HCI_EVT_NUM_COMPLETED_PACKETS:
+			process_completed(hci, data, size);
+			break;
+		case BT_HCI_EVT_CONN_COMPLETE:
+			if (size < sizeof(*ccp))
+				return;
+			ccp = data;
+			if (ccp->link_type == 0x01)
+				process_conn(hci, ccp->status,
+						le16_to_cpu(ccp->handle),
+						HCI_POOL_ACL);
+			break;
+		case BT_HCI_EVT_DISCONNECT_COMPLETE:
+			process_disconnect(hci, data, size);
+			break;
+		case BT_HCI_EVT_LE_META_EVENT:
+			process_le_meta(hci, data, size);
+			break;
+		}
+
 		queue_foreach(hci->evt_list, process_notify, (void *) hdr);
 		break;
 	}
 }
 
+struct data_match {
+	uint8_t type;
+	uint16_t handle;
+	uint8_t flags;
+	const void *data;
+	uint16_t size;
+};
+
+static void process_data_notify(void *data, void *user_data)
+{
+	struct data *handler = data;
+	struct data_match *match = user_data;
+
+	if (handler->type == match->type)
+		handler->callback(match->handle, match->flags, match->data,
+					match->size, handler->user_data);
+}
+
+static void process_data(struct bt_hci *hci, uint8_t type,
+					const void *data, size_t size)
+{
+	const struct bt_hci_acl_hdr *hdr = data;
+	struct data_match match;
+	uint16_t handle;
+
+	if (size < sizeof(*hdr))
+		return;
+
+	handle = le16_to_cpu(hdr->handle);
+
+	match.type = type;
+	match.handle = handle & 0x0fff;
+	match.flags = handle >> 12;
+	match.data = data + sizeof(*hdr);
+	match.size = le16_to_cpu(hdr->dlen);
+
+	/* ISO packets have the top bits of the length reserved */
+	if (type == BT_H4_ISO_PKT)
+		match.size &= 0x3fff;
+
+	if (match.size != size - sizeof(*hdr)) {
+		util_debug(hci->debug_callback, hci->debug_data,
+				"Dropping data packet of %zu bytes with "
+				"length %u", size - sizeof(*hdr), match.size);
+		return;
+	}
+
+	/* Handlers get to look at the packet in the receive buffer */
+	bt_hci_ref(hci);
+	queue_foreach(hci->data_list, process_data_notify, &match);
+	bt_hci_unref(hci);
+}
+
 static bool io_read_callback(struct io *io, void *user_data)
 {
 	struct bt_hci *hci = user_data;
-	uint8_t buf[512];
+	uint8_t *buf = hci->rx_buf;
 	ssize_t len;
-	int fd;
-
-	fd = io_get_fd(hci->io);
-	if (fd < 0)
-		return false;
 
 	if (hci->is_stream)
 		return false;
 
-	len = read(fd, buf, sizeof(buf));
+	/* The spare byte tells oversized packets from truncated ones */
+	len = io_recv(io, buf, HCI_MAX_FRAME + 1);
 	if (len < 0)
 		return false;
 
 	if (len < 1)
 		return true;
 
+	if (len > (ssize_t) HCI_MAX_FRAME) {
+		util_debug(hci->debug_callback, hci->debug_data,
+				"Dropping packet larger than %zu bytes",
+				HCI_MAX_FRAME);
+		return true;
+	}
+
 	switch (buf[0]) {
 	case BT_H4_EVT_PKT:
 		process_event(hci, buf + 1, len - 1);
 		break;
+	case BT_H4_ACL_PKT:
+	case BT_H4_ISO_PKT:
+		process_data(hci, buf[0], buf + 1, len - 1);
+		break;
 	}
 
 	return true;
@@ -309,15 +743,24 @@ static struct bt_hci *create_hci(int fd)
 	hci->num_cmds = 1;
 	hci->next_cmd_id = 1;
 	hci->next_evt_id = 1;
+	hci->next_data_id = 1;
 
 	hci->cmd_queue = queue_new();
 	hci->rsp_queue = queue_new();
 	hci->evt_list = queue_new();
+	hci->conn_list = queue_new();
+	hci->data_queue = queue_new();
+	hci->data_list = queue_new();
+	hci->rx_buf = btd_malloc(HCI_MAX_FRAME + 1);
 
 	if (!io_set_read_handler(hci->io, io_read_callback, hci, NULL)) {
+		queue_destroy(hci->data_list, NULL);
+		queue_destroy(hci->data_queue, NULL);
+		queue_destroy(hci->conn_list, NULL);
 		queue_destroy(hci->evt_list, NULL);
 		queue_destroy(hci->rsp_queue, NULL);
 		queue_destroy(hci->cmd_queue, NULL);
+		free(hci->rx_buf);
 		io_destroy(hci->io);
 		free(hci);
 		return NULL;
@@ -329,11 +772,19 @@ static struct bt_hci *create_hci(int fd)
 struct bt_hci *bt_hci_new(int fd)
 {
 	struct bt_hci *hci;
+	socklen_t len;
+	int type;
 
 	hci = create_hci(fd);
 	if (!hci)
 		return NULL;
 
+	/* Packet based sockets carry one H:4 packet each */
+	len = sizeof(type);
+	if (!getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) &&
+						type == SOCK_SEQPACKET)
+		hci->is_stream = false;
+
 	return hci;
 }
 
@@ -433,15 +884,38 @@ void bt_hci_unref(struct bt_hci *hci)
 	if (__sync_sub_and_fetch(&hci->ref_count, 1))
 		return;
 
+	queue_destroy(hci->data_list, data_free);
+	queue_destroy(hci->data_queue, NULL);
+	queue_destroy(hci->conn_list, conn_free);
 	queue_destroy(hci->evt_list, evt_free);
 	queue_destroy(hci->cmd_queue, cmd_free);
 	queue_destroy(hci->rsp_queue, cmd_free);
 
 	io_destroy(hci->io);
 
+	if (hci->debug_destroy)
+		hci->debug_destroy(hci->debug_data);
+
+	free(hci->rx_buf);
 	free(hci);
 }
 
+bool bt_hci_set_debug(struct bt_hci *hci, bt_hci_debug_func_t callback,
+				void *user_data, bt_hci_destroy_func_t destroy)
+{
+	if (!hci)
+		return false;
+
+	if (hci->debug_destroy)
+		hci->debug_destroy(hci->debug_data);
+
+	hci->debug_callback = callback;
+	hci->debug_destroy = destroy;
+	hci->debug_data = user_data;
+
+	return true;
+}
+
 bool bt_hci_set_close_on_unref(struct bt_hci *hci, bool do_close)
 {
 	if (!hci)
@@ -592,3 +1066,188 @@ bool bt_hci_unregister(struct bt_hci *hci, unsigned int id)
 
 	return true;
 }
+
+static uint8_t type_pool(uint8_t type)
+{
+	switch (type) {
+	case BT_H4_ACL_PKT:
+		return HCI_POOL_ACL;
+	case BT_H4_ISO_PKT:
+		return HCI_POOL_ISO;
+	}
+
+	return HCI_POOL_MAX;
+}
+
+bool bt_hci_set_data_buffers(struct bt_hci *hci, uint8_t type,
+					uint16_t mtu, uint16_t count)
+{
+	uint8_t pool = type_pool(type);
+
+	if (!hci || pool == HCI_POOL_MAX)
+		return false;
+
+	hci->pools[pool].mtu = mtu;
+	hci->pools[pool].max = count;
+
+	wakeup_writer(hci);
+
+	return true;
+}
+
+static void queue_fragment(struct conn *conn, uint8_t type, uint16_t handle,
+					uint8_t flags, const void *data,
+					uint16_t size)
+{
+	struct bt_hci_acl_hdr *hdr;
+	struct pkt *pkt;
+
+	pkt = btd_malloc(sizeof(*pkt) + 1 + sizeof(*hdr) + size);
+
+	pkt->len = 1 + sizeof(*hdr) + size;
+	pkt->data[0] = type;
+
+	hdr = (void *) &pkt->data[1];
+	hdr->handle = cpu_to_le16((handle & 0x0fff) | (flags << 12));
+	hdr->dlen = cpu_to_le16(size);
+
+	memcpy(pkt->data + 1 + sizeof(*hdr), data, size);
+
+	queue_push_tail(conn->tx_queue, pkt);
+}
+
+static uint8_t fragment_flags(uint8_t type, uint8_t flags, uint16_t offset,
+							uint16_t left)
+{
+	if (type == BT_H4_ACL_PKT)
+		return offset ? ACL_CONT : flags;
+
+	/* ISO carries the fragment position, only the timestamp is kept */
+	flags &= 0x04;
+
+	if (!offset)
+		return flags | (left ? ISO_START : ISO_SINGLE);
+
+	return flags | (left ? ISO_CONT : ISO_END);
+}
+
+bool bt_hci_send_data(struct bt_hci *hci, uint8_t type, uint16_t handle,
+				uint8_t flags, const void *data, uint16_t size)
+{
+	uint8_t pool_type = type_pool(type);
+	struct hci_pool *pool;
+	struct conn *conn;
+	uint16_t offset = 0;
+
+	if (!hci || hci->is_stream || pool_type == HCI_POOL_MAX)
+		return false;
+
+	if (size > 0 && !data)
+		return false;
+
+	conn = conn_get(hci, handle & 0x0fff, pool_type);
+
+	pool = conn_pool(hci, conn);
+	if (!pool->mtu || !pool->max)
+		return false;
+
+	/* Fragment to the controller buffer size up front */
+	do {
+		uint16_t len = size - offset;
+
+		if (len > pool->mtu)
+			len = pool->mtu;
+
+		queue_fragment(conn, type, handle,
+				fragment_flags(type, flags, offset,
+						size - offset - len),
+				data + offset, len);
+
+		offset += len;
+	} while (offset < size);
+
+	if (!conn->queued) {
+		conn->queued = true;
+		queue_push_tail(hci->data_queue, conn);
+	}
+
+	wakeup_writer(hci);
+
+	return true;
+}
+
+bool bt_hci_flush_data(struct bt_hci *hci, uint16_t handle)
+{
+	struct conn *conn;
+
+	if (!hci)
+		return false;
+
+	conn = queue_find(hci->conn_list, match_conn_handle,
+					UINT_TO_PTR(handle & 0x0fff));
+	if (!conn)
+		return false;
+
+	queue_remove_all(conn->tx_queue, NULL, NULL, free);
+
+	if (conn->queued) {
+		queue_remove(hci->data_queue, conn);
+		conn->queued = false;
+	}
+
+	return true;
+}
+
+unsigned int bt_hci_register_data(struct bt_hci *hci, uint8_t type,
+				bt_hci_data_func_t callback,
+				void *user_data, bt_hci_destroy_func_t destroy)
+{
+	struct data *handler;
+
+	if (!hci || !callback || type_pool(type) == HCI_POOL_MAX)
+		return 0;
+
+	handler = new0(struct data, 1);
+	handler->type = type;
+
+	if (hci->next_data_id < 1)
+		hci->next_data_id = 1;
+
+	handler->id = hci->next_data_id++;
+
+	handler->callback = callback;
+	handler->destroy = destroy;
+	handler->user_data = user_data;
+
+	if (!queue_push_tail(hci->data_list, handler)) {
+		free(handler);
+		return 0;
+	}
+
+	return handler->id;
+}
+
+static bool match_data_id(const void *a, const void *b)
+{
+	const struct data *handler = a;
+	unsigned int id = PTR_TO_UINT(b);
+
+	return handler->id == id;
+}
+
+bool bt_hci_unregister_data(struct bt_hci *hci, unsigned int id)
+{
+	struct data *handler;
+
+	if (!hci || !id)
+		return false;
+
+	handler = queue_remove_if(hci->data_list, match_data_id,
+							UINT_TO_PTR(id));
+	if (!handler)
+		return false;
+
+	data_free(handler);
+
+	return true;
+}
@@ -35,6 +35,11 @@ struct bt_hci *bt_hci_new_raw_device(uint16_t index);
 struct bt_hci *bt_hci_ref(struct bt_hci *hci);
 void bt_hci_unref(struct bt_hci *hci);
 
+typedef void (*bt_hci_debug_func_t)(const char *str, void *user_data);
+
+bool bt_hci_set_debug(struct bt_hci *hci, bt_hci_debug_func_t callback,
+				void *user_data, bt_hci_destroy_func_t destroy);
+
 bool bt_hci_set_close_on_unref(struct bt_hci *hci, bool do_close);
 
 typedef void (*bt_hci_callback_func_t)(const void *data, uint8_t size,
@@ -51,3 +56,18 @@ unsigned int bt_hci_register(struct bt_hci *hci, uint8_t event,
 				bt_hci_callback_func_t callback,
 				void *user_data, bt_hci_destroy_func_t destroy);
 bool bt_hci_unregister(struct bt_hci *hci, unsigned int id);
+
+typedef void (*bt_hci_data_func_t)(uint16_t handle, uint8_t flags,
+					const void *data, uint16_t size,
+					void *user_data);
+
+bool bt_hci_set_data_buffers(struct bt_hci *hci, uint8_t type,
+					uint16_t mtu, uint16_t count);
+bool bt_hci_send_data(struct bt_hci *hci, uint8_t type, uint16_t handle,
+				uint8_t flags, const void *data, uint16_t size);
+bool bt_hci_flush_data(struct bt_hci *hci, uint16_t handle);
+
+unsigned int bt_hci_register_data(struct bt_hci *hci, uint8_t type,
+				bt_hci_data_func_t callback,
+				void *user_data, bt_hci_destroy_func_t destroy);
+bool bt_hci_unregister_data(struct bt_hci *hci, unsigned int id);
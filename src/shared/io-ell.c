@@ -139,6 +139,28 @@ ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
 	return ret;
 }
 
+ssize_t io_recv(struct io *io, void *buf, size_t len)
+{
+	ssize_t ret;
+	int fd;
+
+	if (!io || !io->l_io)
+		return -ENOTCONN;
+
+	fd = l_io_get_fd(io->l_io);
+	if (fd < 0)
+		return -ENOTCONN;
+
+	do {
+		ret = read(fd, buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
 bool io_shutdown(struct io *io)
 {
 	int fd;
@@ -152,3 +174,8 @@ bool io_shutdown(struct io *io)
 
 	return shutdown(fd, SHUT_RDWR) == 0;
 }
+
+bool io_set_uring(bool enable)
+{
+	return !enable;
+}
@@ -25,6 +25,7 @@
 #include <config.h>
 #endif
 
+#include <unistd.h>
 #include <errno.h>
 
 #include <glib.h>
@@ -283,6 +284,23 @@ ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
 	return ret;
 }
 
+ssize_t io_recv(struct io *io, void *buf, size_t len)
+{
+	ssize_t ret;
+
+	if (!io || !io->channel)
+		return -ENOTCONN;
+
+	do {
+		ret = read(io_get_fd(io), buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
 bool io_shutdown(struct io *io)
 {
 	if (!io || !io->channel)
@@ -291,3 +309,8 @@ bool io_shutdown(struct io *io)
 	return g_io_channel_shutdown(io->channel, TRUE, NULL)
 							== G_IO_STATUS_NORMAL;
 }
+
+bool io_set_uring(bool enable)
+{
+	return !enable;
+}
@@ -27,12 +27,42 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/socket.h>
 
 #include "src/shared/mainloop.h"
 #include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/uring.h"
 #include "src/shared/io.h"
 
+/*
+ * Once enabled with io_set_uring(), message based sockets are driven
+ * through io_uring when the kernel supports it: readiness through one-shot
+ * polls on fixed files, receives through a multishot recv into provided
+ * buffers once the read handler uses io_recv() and sends queued as linked
+ * requests. Submissions made while completions are being processed go out
+ * in a single batch.
+ *
+ * The backend is off by default and currently only tools/io-bench turns it
+ * on; none of the daemons or tools shipped with BlueZ enable it.
+ */
+#define IO_RING_ENTRIES		256
+#define IO_RING_FILES		1024
+#define IO_RING_BUF_COUNT	256
+#define IO_RING_BUF_SIZE	2048
+#define IO_RING_TX_BATCH	16
+#define IO_RING_TX_MAX		64
+#define IO_RING_ROUNDS		4
+
+#define IO_OP_POLL	0
+#define IO_OP_RECV	1
+#define IO_OP_SEND	2
+#define IO_OP_WAKE	3
+#define IO_OP_MASK	3
+
+#define IO_DATA(io, op)	((uint64_t) (uintptr_t) (io) | (op))
+
 struct io {
 	int ref_count;
 	int fd;
@@ -47,8 +77,45 @@ struct io {
 	io_callback_func_t disconnect_callback;
 	io_destroy_func_t disconnect_destroy;
 	void *disconnect_data;
+	bool ring;
+	bool removed;
+	int index;
+	unsigned int ops;
+	bool poll_armed;
+	uint32_t poll_events;
+	bool recv_wanted;
+	bool recv_armed;
+	bool recv_cancel;
+	bool recv_eof;
+	bool recv_nobufs;
+	bool wake_pending;
+	bool hup;
+	struct queue *rx_queue;
+	struct queue *tx_queue;
+	unsigned int tx_inflight;
+	bool tx_dirty;
+	int tx_error;
 };
 
+struct io_rx {
+	uint16_t bid;
+	uint16_t len;
+};
+
+struct io_tx {
+	size_t len;
+	uint8_t data[0];
+};
+
+static struct uring *ring;
+static bool ring_failed;
+static bool ring_enabled;
+static bool ring_dispatch;
+static bool ring_recv_failed;
+static struct queue *ring_ios;
+static struct queue *ring_dirty;
+static struct queue *ring_nobufs;
+
 static struct io *io_ref(struct io *io)
 {
 	if (!io)
@@ -89,6 +156,33 @@ static void io_cleanup(void *user_data)
 	io->fd = -1;
 }
 
+static void io_ring_update(struct io *io);
+static void io_ring_remove(struct io *io);
+
+static int io_modify(struct io *io, uint32_t events)
+{
+	if (io->ring) {
+		io->events = events;
+		io_ring_update(io);
+		return 0;
+	}
+
+	if (mainloop_modify_fd(io->fd, events) < 0)
+		return -EIO;
+
+	io->events = events;
+
+	return 0;
+}
+
+static void io_remove(struct io *io)
+{
+	if (io->ring)
+		io_ring_remove(io);
+	else
+		mainloop_remove_fd(io->fd);
+}
+
 static void io_callback(int fd, uint32_t events, void *user_data)
 {
 	struct io *io = user_data;
@@ -100,7 +194,7 @@ static void io_callback(int fd, uint32_t events, void *user_data)
 		io->write_callback = NULL;
 
 		if (!io->disconnect_callback) {
-			mainloop_remove_fd(io->fd);
+			io_remove(io);
 			io_unref(io);
 			return;
 		}
@@ -113,9 +207,7 @@ static void io_callback(int fd, uint32_t events, void *user_data)
 			io->disconnect_destroy = NULL;
 			io->disconnect_data = NULL;
 
-			io->events &= ~EPOLLRDHUP;
-
-			mainloop_modify_fd(io->fd, io->events);
+			io_modify(io, io->events & ~EPOLLRDHUP);
 		}
 	}
 
@@ -128,13 +220,14 @@ static void io_callback(int fd, uint32_t events, void *user_data)
 			io->read_destroy = NULL;
 			io->read_data = NULL;
 
-			io->events &= ~EPOLLIN;
-
-			mainloop_modify_fd(io->fd, io->events);
+			io_modify(io, io->events & ~EPOLLIN);
 		}
 	}
 
-	if ((events & EPOLLOUT) && io->write_callback) {
+	while ((events & EPOLLOUT) && io->write_callback) {
+		unsigned int queued = io->ring ?
+					queue_length(io->tx_queue) : 0;
+
 		if (!io->write_callback(io, io->write_data)) {
 			if (io->write_destroy)
 				io->write_destroy(io->write_data);
@@ -143,12 +236,490 @@ static void io_callback(int fd, uint32_t events, void *user_data)
 			io->write_destroy = NULL;
 			io->write_data = NULL;
 
-			io->events &= ~EPOLLOUT;
+			io_modify(io, io->events & ~EPOLLOUT);
+			break;
+		}
+
+		/*
+		 * Sends through the ring never block, so keep the writer
+		 * going for as long as it has something to queue.
+		 */
+		if (!io->ring || io->removed)
+			break;
+
+		if (queue_length(io->tx_queue) == queued ||
+				queue_length(io->tx_queue) >= IO_RING_TX_MAX)
+			break;
+	}
+
+	io_unref(io);
+}
+
+static void io_ring_get(struct io *io)
+{
+	io->ops++;
+	io_ref(io);
+}
+
+static void io_ring_release(struct io *io)
+{
+	struct io_rx *rx;
+
+	while ((rx = queue_pop_head(io->rx_queue))) {
+		uring_buf_put(ring, rx->bid);
+		free(rx);
+	}
+
+	queue_destroy(io->rx_queue, NULL);
+	queue_destroy(io->tx_queue, free);
+	io->rx_queue = NULL;
+	io->tx_queue = NULL;
+
+	queue_remove(ring_ios, io);
+	queue_remove(ring_nobufs, io);
+
+	uring_file_unregister(ring, io->index);
+	io->index = -1;
+}
+
+static void io_ring_put(struct io *io)
+{
+	if (!--io->ops && io->removed)
+		io_ring_release(io);
+
+	io_unref(io);
+}
+
+static void io_ring_kick(void)
+{
+	/* Completion processing submits everything in one go at the end */
+	if (!ring_dispatch)
+		uring_submit(ring);
+}
+
+static bool io_ring_use_recv(struct io *io)
+{
+	return io->recv_wanted && !io->recv_eof && !io->recv_nobufs &&
+							!ring_recv_failed;
+}
+
+static uint32_t io_ring_events(struct io *io)
+{
+	uint32_t events = io->events & EPOLLRDHUP;
+
+	if (io->read_callback && !io_ring_use_recv(io))
+		events |= EPOLLIN;
+
+	if (io->write_callback && queue_length(io->tx_queue) < IO_RING_TX_MAX)
+		events |= EPOLLOUT;
+
+	return events;
+}
+
+static void io_ring_update(struct io *io)
+{
+	uint32_t events;
+
+	if (io->removed)
+		return;
+
+	if (io->read_callback && io_ring_use_recv(io)) {
+		if (!io->recv_armed && !uring_recv(ring, io->index,
+						IO_DATA(io, IO_OP_RECV))) {
+			io->recv_armed = true;
+			io_ring_get(io);
+		}
+	} else if (io->recv_armed && !io->recv_cancel) {
+		if (!uring_cancel(ring, IO_DATA(io, IO_OP_RECV)))
+			io->recv_cancel = true;
+	}
+
+	events = io_ring_events(io);
+
+	if (!io->poll_armed) {
+		if (!io->hup && !uring_poll(ring, io->index, events,
+						IO_DATA(io, IO_OP_POLL))) {
+			io->poll_armed = true;
+			io->poll_events = events;
+			io_ring_get(io);
+		}
+	} else if (events != io->poll_events) {
+		if (!uring_poll_update(ring, IO_DATA(io, IO_OP_POLL), events))
+			io->poll_events = events;
+	}
+
+	io_ring_kick();
+}
+
+static void io_ring_send(struct io *io)
+{
+	const struct queue_entry *entry;
+	unsigned int i, count;
+
+	count = queue_length(io->tx_queue);
+	if (!count)
+		return;
+
+	if (count > IO_RING_TX_BATCH)
+		count = IO_RING_TX_BATCH;
+
+	/* A chain of linked sends has to go out in one submission */
+	if (uring_sq_space(ring) < count)
+		uring_submit(ring);
+
+	entry = queue_get_entries(io->tx_queue);
+
+	for (i = 0; i < count; i++, entry = entry->next) {
+		struct io_tx *tx = entry->data;
+
+		if (uring_send(ring, io->index, tx->data, tx->len,
+				i + 1 < count, IO_DATA(io, IO_OP_SEND)) < 0)
+			break;
+
+		io->tx_inflight++;
+		io_ring_get(io);
+	}
+}
+
+static void io_ring_flush(struct io *io)
+{
+	if (io->tx_inflight)
+		return;
+
+	if (!ring_dispatch) {
+		io_ring_send(io);
+		uring_submit(ring);
+		return;
+	}
+
+	if (io->tx_dirty)
+		return;
+
+	io->tx_dirty = true;
+	io_ring_get(io);
+	queue_push_tail(ring_dirty, io);
+}
+
+static void io_ring_deliver(struct io *io)
+{
+	while (io->read_callback && !queue_isempty(io->rx_queue)) {
+		unsigned int len = queue_length(io->rx_queue);
+
+		if (!io->read_callback(io, io->read_data)) {
+			if (io->read_destroy)
+				io->read_destroy(io->read_data);
+
+			io->read_callback = NULL;
+			io->read_destroy = NULL;
+			io->read_data = NULL;
+
+			io_modify(io, io->events & ~EPOLLIN);
+			break;
+		}
+
+		/* Stop if the handler didn't pick anything up */
+		if (io->removed || queue_length(io->rx_queue) == len)
+			break;
+	}
+}
+
+static void io_ring_wake(struct io *io)
+{
+	if (io->wake_pending || queue_isempty(io->rx_queue))
+		return;
+
+	if (uring_nop(ring, IO_DATA(io, IO_OP_WAKE)) < 0)
+		return;
+
+	io->wake_pending = true;
+	io_ring_get(io);
+	io_ring_kick();
+}
+
+static void io_ring_recv_done(struct io *io, int32_t res, uint32_t flags)
+{
+	int bid = uring_cqe_buffer(flags);
+
+	if (bid >= 0) {
+		struct io_rx *rx;
+
+		if (res <= 0 || io->removed) {
+			uring_buf_put(ring, bid);
+		} else {
+			rx = new0(struct io_rx, 1);
+			rx->bid = bid;
+			rx->len = res;
+			queue_push_tail(io->rx_queue, rx);
+		}
+	}
+
+	if (!uring_cqe_more(flags)) {
+		io->recv_armed = false;
+		io->recv_cancel = false;
+
+		switch (res) {
+		case 0:
+			/* Leave end of stream to the poll and read() */
+			io->recv_eof = true;
+			break;
+		case -ENOBUFS:
+			io->recv_nobufs = true;
+			queue_push_tail(ring_nobufs, io);
+			break;
+		case -EINVAL:
+		case -EOPNOTSUPP:
+			/* No multishot receive support, fall back to read() */
+			ring_recv_failed = true;
+			break;
+		}
+	}
+
+	if (!io->removed) {
+		io_ring_deliver(io);
+
+		if (!io->recv_armed)
+			io_ring_update(io);
+	}
+}
+
+static void io_ring_send_done(struct io *io, int32_t res)
+{
+	free(queue_pop_head(io->tx_queue));
+	io->tx_inflight--;
+
+	/*
+	 * io_send() has already accounted the data as written, so a failed
+	 * send is reported as a disconnect once the rest of the chain has
+	 * come back cancelled.
+	 */
+	if (res < 0 && !io->tx_error)
+		io->tx_error = res;
+
+	if (io->tx_error) {
+		if (io->tx_inflight)
+			return;
+
+		queue_remove_all(io->tx_queue, NULL, NULL, free);
+
+		if (io->removed || io->hup)
+			return;
+
+		io->hup = true;
+		io_callback(io->fd, EPOLLERR | EPOLLHUP, io);
+		io_ring_update(io);
+		return;
+	}
+
+	if (!io->tx_inflight && !queue_isempty(io->tx_queue))
+		io_ring_flush(io);
+
+	if (!io->removed && io->write_callback &&
+					!(io->poll_events & EPOLLOUT))
+		io_ring_update(io);
+}
+
+static void ring_complete(uint64_t data, int32_t res, uint32_t flags,
+							void *user_data)
+{
+	struct io *io = (struct io *) (uintptr_t) (data & ~IO_OP_MASK);
+
+	/* Cancel and update requests don't carry any data */
+	if (!io)
+		return;
+
+	switch (data & IO_OP_MASK) {
+	case IO_OP_POLL:
+		io->poll_armed = false;
+
+		if (io->removed || res < 0)
+			break;
+
+		if (res & (EPOLLHUP | EPOLLERR))
+			io->hup = true;
+
+		/* Data is delivered by the receive, don't read() behind it */
+		if (io->recv_armed)
+			res &= ~EPOLLIN;
+
+		io_callback(io->fd, res, io);
+		io_ring_update(io);
+		break;
+	case IO_OP_RECV:
+		io_ring_recv_done(io, res, flags);
+		break;
+	case IO_OP_SEND:
+		io_ring_send_done(io, res);
+		break;
+	case IO_OP_WAKE:
+		io->wake_pending = false;
+
+		if (!io->removed)
+			io_ring_deliver(io);
+		break;
+	}
+
+	if (!uring_cqe_more(flags))
+		io_ring_put(io);
+}
 
-			mainloop_modify_fd(io->fd, io->events);
+static void ring_callback(int fd, uint32_t events, void *user_data)
+{
+	unsigned int rounds = IO_RING_ROUNDS;
+	struct io *io;
+
+	/*
+	 * Local socket operations tend to complete inline with the
+	 * submission, so reap those right away instead of going back
+	 * through epoll for each of them.
+	 */
+	do {
+		ring_dispatch = true;
+		uring_process(ring, ring_complete, NULL);
+		ring_dispatch = false;
+
+		while ((io = queue_pop_head(ring_dirty))) {
+			io->tx_dirty = false;
+
+			if (!io->tx_inflight)
+				io_ring_send(io);
+
+			io_ring_put(io);
 		}
+	} while (uring_submit(ring) > 0 && --rounds);
+}
+
+static void ring_destroy(void *user_data)
+{
+	struct io *io;
+
+	/* The mainloop is going away, nothing is going to complete */
+	while ((io = queue_pop_head(ring_ios))) {
+		unsigned int ops = io->ops;
+
+		if (!io->removed) {
+			io->removed = true;
+			io_cleanup(io);
+		}
+
+		queue_destroy(io->rx_queue, free);
+		queue_destroy(io->tx_queue, free);
+		io->rx_queue = NULL;
+		io->tx_queue = NULL;
+		io->ring = false;
+		io->index = -1;
+		io->ops = 0;
+
+		while (ops--)
+			io_unref(io);
+	}
+
+	queue_destroy(ring_ios, NULL);
+	queue_destroy(ring_dirty, NULL);
+	queue_destroy(ring_nobufs, NULL);
+	ring_ios = NULL;
+	ring_dirty = NULL;
+	ring_nobufs = NULL;
+
+	uring_free(ring);
+	ring = NULL;
+	ring_dispatch = false;
+}
+
+static struct uring *ring_get(void)
+{
+	if (ring || ring_failed || !ring_enabled)
+		return ring;
+
+	ring = uring_new(IO_RING_ENTRIES, IO_RING_FILES);
+	if (!ring) {
+		ring_failed = true;
+		return NULL;
+	}
+
+	/* Without provided buffers reads stay with the handlers */
+	if (!uring_buf_setup(ring, IO_RING_BUF_COUNT, IO_RING_BUF_SIZE))
+		ring_recv_failed = true;
+
+	if (mainloop_add_fd(uring_get_fd(ring), EPOLLIN, ring_callback,
+						NULL, ring_destroy) < 0) {
+		uring_free(ring);
+		ring = NULL;
+		return NULL;
+	}
+
+	ring_ios = queue_new();
+	ring_dirty = queue_new();
+	ring_nobufs = queue_new();
+
+	return ring;
+}
+
+static bool io_ring_attach(struct io *io)
+{
+	socklen_t len;
+	int type;
+
+	len = sizeof(type);
+	if (getsockopt(io->fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+		return false;
+
+	/* Stream sockets would need partial sends handled, keep them out */
+	if (type != SOCK_SEQPACKET && type != SOCK_DGRAM && type != SOCK_RAW)
+		return false;
+
+	if (!ring_get())
+		return false;
+
+	io->index = uring_file_register(ring, io->fd);
+	if (io->index < 0)
+		return false;
+
+	io->ring = true;
+	io->rx_queue = queue_new();
+	io->tx_queue = queue_new();
+
+	queue_push_tail(ring_ios, io);
+
+	io_ring_update(io);
+
+	return true;
+}
+
+static void io_ring_remove(struct io *io)
+{
+	struct io_rx *rx;
+
+	if (io->removed)
+		return;
+
+	io->removed = true;
+
+	if (io->poll_armed)
+		uring_cancel(ring, IO_DATA(io, IO_OP_POLL));
+
+	if (io->recv_armed && !io->recv_cancel) {
+		uring_cancel(ring, IO_DATA(io, IO_OP_RECV));
+		io->recv_cancel = true;
+	}
+
+	while ((rx = queue_pop_head(io->rx_queue))) {
+		uring_buf_put(ring, rx->bid);
+		free(rx);
 	}
 
+	/* Whatever was handed to io_send() still goes out */
+	if (!io->tx_inflight && !io->tx_dirty)
+		io_ring_send(io);
+
+	uring_submit(ring);
+
+	io_cleanup(io);
+
+	io_ref(io);
+
+	if (!io->ops)
+		io_ring_release(io);
+
 	io_unref(io);
 }
 
@@ -163,6 +734,10 @@ struct io *io_new(int fd)
 	io->fd = fd;
 	io->events = 0;
 	io->close_on_destroy = false;
+	io->index = -1;
+
+	if (io_ring_attach(io))
+		return io_ref(io);
 
 	if (mainloop_add_fd(io->fd, io->events, io_callback,
 						io, io_cleanup) < 0) {
@@ -182,7 +757,7 @@ void io_destroy(struct io *io)
 	io->write_callback = NULL;
 	io->disconnect_callback = NULL;
 
-	mainloop_remove_fd(io->fd);
+	io_remove(io);
 
 	io_unref(io);
 }
@@ -225,15 +800,14 @@ bool io_set_read_handler(struct io *io, io_callback_func_t callback,
 	io->read_destroy = destroy;
 	io->read_data = user_data;
 
+	/* Data might already be waiting in the receive buffers */
+	if (io->ring && callback)
+		io_ring_wake(io);
+
 	if (events == io->events)
 		return true;
 
-	if (mainloop_modify_fd(io->fd, events) < 0)
-		return false;
-
-	io->events = events;
-
-	return true;
+	return io_modify(io, events) == 0;
 }
 
 bool io_set_write_handler(struct io *io, io_callback_func_t callback,
@@ -259,12 +833,7 @@ bool io_set_write_handler(struct io *io, io_callback_func_t callback,
 	if (events == io->events)
 		return true;
 
-	if (mainloop_modify_fd(io->fd, events) < 0)
-		return false;
-
-	io->events = events;
-
-	return true;
+	return io_modify(io, events) == 0;
 }
 
 bool io_set_disconnect_handler(struct io *io, io_callback_func_t callback,
@@ -290,12 +859,38 @@ bool io_set_disconnect_handler(struct io *io, io_callback_func_t callback,
 	if (events == io->events)
 		return true;
 
-	if (mainloop_modify_fd(io->fd, events) < 0)
-		return false;
+	return io_modify(io, events) == 0;
+}
 
-	io->events = events;
+static ssize_t io_ring_queue(struct io *io, const struct iovec *iov,
+								int iovcnt)
+{
+	struct io_tx *tx;
+	size_t len = 0;
+	int i;
 
-	return true;
+	if (io->tx_error)
+		return io->tx_error;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	tx = malloc(sizeof(*tx) + len);
+	if (!tx)
+		return -ENOMEM;
+
+	tx->len = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		memcpy(tx->data + tx->len, iov[i].iov_base, iov[i].iov_len);
+		tx->len += iov[i].iov_len;
+	}
+
+	queue_push_tail(io->tx_queue, tx);
+
+	io_ring_flush(io);
+
+	return len;
 }
 
 ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
@@ -305,6 +900,9 @@ ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
 	if (!io || io->fd < 0)
 		return -ENOTCONN;
 
+	if (io->ring)
+		return io_ring_queue(io, iov, iovcnt);
+
 	do {
 		ret = writev(io->fd, iov, iovcnt);
 	} while (ret < 0 && errno == EINTR);
@@ -315,6 +913,59 @@ ssize_t io_send(struct io *io, const struct iovec *iov, int iovcnt)
 	return ret;
 }
 
+ssize_t io_recv(struct io *io, void *buf, size_t len)
+{
+	struct io *stalled;
+	struct io_rx *rx;
+	ssize_t ret;
+
+	if (!io || io->fd < 0)
+		return -ENOTCONN;
+
+	if (!io->ring)
+		goto done;
+
+	rx = queue_pop_head(io->rx_queue);
+	if (rx) {
+		ret = len < rx->len ? len : rx->len;
+		memcpy(buf, uring_buf_get(ring, rx->bid), ret);
+
+		uring_buf_put(ring, rx->bid);
+		free(rx);
+
+		/* Give a receive stalled on buffers another go */
+		stalled = queue_pop_head(ring_nobufs);
+		if (stalled) {
+			stalled->recv_nobufs = false;
+			io_ring_update(stalled);
+		}
+
+		return ret;
+	}
+
+	/*
+	 * Switch over to the multishot receive once the handler has shown
+	 * it reads through here with buffers the ring can satisfy.
+	 */
+	if (io->recv_armed)
+		return -EAGAIN;
+
+	if (!io->recv_wanted && len <= IO_RING_BUF_SIZE) {
+		io->recv_wanted = true;
+		io_ring_update(io);
+	}
+
+done:
+	do {
+		ret = read(io->fd, buf, len);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
 bool io_shutdown(struct io *io)
 {
 	if (!io || io->fd < 0)
@@ -322,3 +973,13 @@ bool io_shutdown(struct io *io)
 
 	return shutdown(io->fd, SHUT_RDWR) == 0;
 }
+
+bool io_set_uring(bool enable)
+{
+	ring_enabled = enable;
+
+	if (!enable)
+		return true;
+
+	return ring_get() != NULL;
+}
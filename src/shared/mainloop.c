@@ -28,12 +28,15 @@
 
 #define _GNU_SOURCE
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
 #include <sys/signalfd.h>
 #include <sys/timerfd.h>
 #include <sys/epoll.h>
@@ -43,6 +46,7 @@
 #include "mainloop.h"
 #include "mainloop-notify.h"
 
+
 #define MAX_EPOLL_EVENTS 10
 
 static int epoll_fd;
@@ -57,25 +61,72 @@ struct mainloop_data {
 	void *user_data;
 };
 
-#define MAX_MAINLOOP_ENTRIES 128
+/* Indexed by file descriptor, grown on demand */
+static struct mainloop_data **mainloop_list;
+static unsigned int mainloop_list_size;
 
-static struct mainloop_data *mainloop_list[MAX_MAINLOOP_ENTRIES];
+/*
+ * Timeouts are kept in a hierarchical timer wheel driven by a single
+ * timerfd. Level 0 has one slot per millisecond and every following level
+ * has slots spanning a whole turn of the previous one. Slots of the upper
+ * levels are cascaded down when the level below wraps around. Timeouts
+ * beyond the last level are parked in it and re-inserted on cascade.
+ */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4
+
+#define WHEEL_SHIFT(level)	((level) * WHEEL_BITS)
+#define WHEEL_RANGE(level)	(UINT64_C(1) << WHEEL_SHIFT((level) + 1))
+#define WHEEL_INDEX(tick, level) (((tick) >> WHEEL_SHIFT(level)) & WHEEL_MASK)
+
+struct timeout_entry {
+	struct timeout_entry *next;
+	struct timeout_entry *prev;
+};
 
 struct timeout_data {
-	int fd;
+	struct timeout_entry entry;
+	int id;
+	uint64_t expires;
+	int level;
 	mainloop_timeout_func callback;
 	mainloop_destroy_func destroy;
 	void *user_data;
 };
 
+struct timeout_wheel {
+	int fd;
+	uint64_t now;
+	uint64_t armed;
+	unsigned int count[WHEEL_LEVELS];
+	struct timeout_entry slots[WHEEL_LEVELS][WHEEL_SIZE];
+};
+
+static struct timeout_wheel *wheel;
+
+/* Indexed by timeout id minus one, released ids are reused first */
+static struct timeout_data **timeout_list;
+static unsigned int timeout_list_size;
+static unsigned int timeout_list_used;
+static int *timeout_free;
+static unsigned int timeout_free_count;
+
 void mainloop_init(void)
 {
-	unsigned int i;
-
 	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++)
-		mainloop_list[i] = NULL;
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
+
+	wheel = NULL;
+
+	timeout_list = NULL;
+	timeout_list_size = 0;
+	timeout_list_used = 0;
+	timeout_free = NULL;
+	timeout_free_count = 0;
 
 	epoll_terminate = 0;
 
@@ -121,7 +172,7 @@ int mainloop_run(void)
 		}
 	}
 
-	for (i = 0; i < MAX_MAINLOOP_ENTRIES; i++) {
+	for (i = 0; i < mainloop_list_size; i++) {
 		struct mainloop_data *data = mainloop_list[i];
 
 		mainloop_list[i] = NULL;
@@ -136,6 +187,10 @@ int mainloop_run(void)
 		}
 	}
 
+	free(mainloop_list);
+	mainloop_list = NULL;
+	mainloop_list_size = 0;
+
 	close(epoll_fd);
 	epoll_fd = 0;
 
@@ -144,6 +199,31 @@ int mainloop_run(void)
 	return exit_status;
 }
 
+static int mainloop_list_grow(int fd)
+{
+	struct mainloop_data **list;
+	unsigned int size;
+
+	if ((unsigned int) fd < mainloop_list_size)
+		return 0;
+
+	size = mainloop_list_size ? mainloop_list_size : 128;
+	while (size <= (unsigned int) fd)
+		size *= 2;
+
+	list = realloc(mainloop_list, size * sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+
+	memset(list + mainloop_list_size, 0,
+			(size - mainloop_list_size) * sizeof(*list));
+
+	mainloop_list = list;
+	mainloop_list_size = size;
+
+	return 0;
+}
+
 int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 				void *user_data, mainloop_destroy_func destroy)
 {
@@ -151,9 +231,12 @@ int mainloop_add_fd(int fd, uint32_t events, mainloop_event_func callback,
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1 || !callback)
+	if (fd < 0 || !callback)
 		return -EINVAL;
 
+	if (mainloop_list_grow(fd) < 0)
+		return -ENOMEM;
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
@@ -186,7 +269,7 @@ int mainloop_modify_fd(int fd, uint32_t events)
 	struct epoll_event ev;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -211,7 +294,7 @@ int mainloop_remove_fd(int fd)
 	struct mainloop_data *data;
 	int err;
 
-	if (fd < 0 || fd > MAX_MAINLOOP_ENTRIES - 1)
+	if (fd < 0 || (unsigned int) fd >= mainloop_list_size)
 		return -EINVAL;
 
 	data = mainloop_list[fd];
@@ -230,48 +313,406 @@ int mainloop_remove_fd(int fd)
 	return err;
 }
 
-static void timeout_destroy(void *user_data)
+static uint64_t wheel_time(void)
 {
-	struct timeout_data *data = user_data;
+	struct timespec ts;
 
-	close(data->fd);
-	data->fd = -1;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	if (data->destroy)
-		data->destroy(data->user_data);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-	free(data);
+static inline void entry_init(struct timeout_entry *head)
+{
+	head->next = head;
+	head->prev = head;
 }
 
-static void timeout_callback(int fd, uint32_t events, void *user_data)
+static inline bool entry_empty(const struct timeout_entry *head)
 {
-	struct timeout_data *data = user_data;
-	uint64_t expired;
-	ssize_t result;
+	return head->next == head;
+}
 
-	if (events & (EPOLLERR | EPOLLHUP))
+static inline void entry_add(struct timeout_entry *head,
+						struct timeout_entry *entry)
+{
+	entry->prev = head->prev;
+	entry->next = head;
+	head->prev->next = entry;
+	head->prev = entry;
+}
+
+static inline void entry_del(struct timeout_entry *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry_init(entry);
+}
+
+static inline void entry_splice(struct timeout_entry *from,
+						struct timeout_entry *to)
+{
+	entry_init(to);
+
+	if (entry_empty(from))
 		return;
 
-	result = read(data->fd, &expired, sizeof(expired));
-	if (result != sizeof(expired))
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+
+	entry_init(from);
+}
+
+static bool wheel_empty(void)
+{
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		if (wheel->count[level])
+			return false;
+	}
+
+	return true;
+}
+
+static void wheel_insert(struct timeout_data *data)
+{
+	uint64_t expires = data->expires;
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (expires - wheel->now < WHEEL_RANGE(level))
+			break;
+	}
+
+	/* Park anything beyond the last level in its furthest slot */
+	if (expires - wheel->now >= WHEEL_RANGE(level))
+		expires = wheel->now + WHEEL_RANGE(level) - 1;
+
+	data->level = level;
+	wheel->count[level]++;
+	entry_add(&wheel->slots[level][WHEEL_INDEX(expires, level)],
+								&data->entry);
+}
+
+static void wheel_unlink(struct timeout_data *data)
+{
+	if (data->level < 0)
 		return;
 
-	if (data->callback)
-		data->callback(data->fd, data->user_data);
+	wheel->count[data->level]--;
+
+	entry_del(&data->entry);
+	data->level = -1;
+}
+
+static void wheel_cascade(int level)
+{
+	struct timeout_entry list;
+
+	entry_splice(&wheel->slots[level][WHEEL_INDEX(wheel->now, level)],
+									&list);
+
+	while (!entry_empty(&list)) {
+		struct timeout_data *data = (struct timeout_data *) list.next;
+
+		entry_del(&data->entry);
+		wheel->count[level]--;
+		wheel_insert(data);
+	}
+}
+
+static void wheel_expire(void)
+{
+	struct timeout_entry list;
+	unsigned int index = WHEEL_INDEX(wheel->now, 0);
+	int level;
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		if (WHEEL_INDEX(wheel->now, level - 1))
+			break;
+
+		wheel_cascade(level);
+	}
+
+	entry_splice(&wheel->slots[0][index], &list);
+
+	wheel->now++;
+
+	while (!entry_empty(&list)) {
+		struct timeout_data *data = (struct timeout_data *) list.next;
+
+		/*
+		 * Until popped here the remaining timeouts still count as
+		 * level 0 so that callbacks are able to remove them.
+		 */
+		entry_del(&data->entry);
+		wheel->count[0]--;
+		data->level = -1;
+
+		data->callback(data->id, data->user_data);
+	}
+}
+
+/* Next tick at which a timeout expires or a non-empty slot cascades */
+static uint64_t wheel_next(void)
+{
+	uint64_t next = UINT64_MAX;
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		uint64_t base = wheel->now >> WHEEL_SHIFT(level);
+		unsigned int i;
+
+		if (!wheel->count[level])
+			continue;
+
+		for (i = 0; i <= WHEEL_SIZE; i++) {
+			uint64_t tick = (base + i) << WHEEL_SHIFT(level);
+
+			/* Cascade of the current slot may already be past */
+			if (tick < wheel->now)
+				continue;
+
+			if (tick >= next)
+				break;
+
+			if (!entry_empty(&wheel->slots[level][
+						(base + i) & WHEEL_MASK])) {
+				next = tick;
+				break;
+			}
+		}
+	}
+
+	return next;
 }
 
-static inline int timeout_set(int fd, unsigned int msec)
+static void wheel_arm(uint64_t tick)
 {
 	struct itimerspec itimer;
-	unsigned int sec = msec / 1000;
 
 	memset(&itimer, 0, sizeof(itimer));
-	itimer.it_interval.tv_sec = 0;
-	itimer.it_interval.tv_nsec = 0;
-	itimer.it_value.tv_sec = sec;
-	itimer.it_value.tv_nsec = (msec - (sec * 1000)) * 1000 * 1000;
 
-	return timerfd_settime(fd, 0, &itimer, NULL);
+	if (tick != UINT64_MAX) {
+		/* A zero it_value would disarm the timer */
+		if (!tick)
+			tick = 1;
+
+		itimer.it_value.tv_sec = tick / 1000;
+		itimer.it_value.tv_nsec = (tick % 1000) * 1000 * 1000;
+	}
+
+	if (timerfd_settime(wheel->fd, TFD_TIMER_ABSTIME, &itimer, NULL) < 0)
+		return;
+
+	wheel->armed = tick;
+}
+
+static void wheel_run(uint64_t now)
+{
+	while (wheel->now <= now) {
+		uint64_t mask;
+		int level;
+
+		/*
+		 * Skip over ticks where the empty lower levels have nothing
+		 * to expire or cascade.
+		 */
+		if (wheel_empty()) {
+			wheel->now = now + 1;
+			break;
+		}
+
+		level = 0;
+		while (!wheel->count[level])
+			level++;
+
+		mask = (UINT64_C(1) << WHEEL_SHIFT(level)) - 1;
+		if (wheel->now & mask) {
+			uint64_t tick = (wheel->now | mask) + 1;
+
+			if (tick > now) {
+				wheel->now = now + 1;
+				break;
+			}
+
+			wheel->now = tick;
+		}
+
+		wheel_expire();
+	}
+}
+
+static void wheel_callback(int fd, uint32_t events, void *user_data)
+{
+	uint64_t expired;
+
+	if (events & (EPOLLERR | EPOLLHUP))
+		return;
+
+	if (read(fd, &expired, sizeof(expired)) < 0 && errno != EAGAIN)
+		return;
+
+	wheel->armed = UINT64_MAX;
+
+	wheel_run(wheel_time());
+
+	wheel_arm(wheel_next());
+}
+
+static void timeout_release(struct timeout_data *data)
+{
+	timeout_list[data->id - 1] = NULL;
+	timeout_list_used--;
+	timeout_free[timeout_free_count++] = data->id;
+
+	if (data->destroy)
+		data->destroy(data->user_data);
+
+	free(data);
+}
+
+static void wheel_destroy(void *user_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < timeout_list_size; i++) {
+		struct timeout_data *data = timeout_list[i];
+
+		if (!data)
+			continue;
+
+		wheel_unlink(data);
+		timeout_release(data);
+	}
+
+	close(wheel->fd);
+	free(wheel);
+	wheel = NULL;
+
+	free(timeout_list);
+	free(timeout_free);
+	timeout_list = NULL;
+	timeout_free = NULL;
+	timeout_list_size = 0;
+	timeout_list_used = 0;
+	timeout_free_count = 0;
+}
+
+static bool wheel_init(void)
+{
+	int level, i;
+
+	if (wheel)
+		return true;
+
+	wheel = malloc(sizeof(*wheel));
+	if (!wheel)
+		return false;
+
+	memset(wheel, 0, sizeof(*wheel));
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SIZE; i++)
+			entry_init(&wheel->slots[level][i]);
+	}
+
+	wheel->now = wheel_time();
+	wheel->armed = UINT64_MAX;
+
+	wheel->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (wheel->fd < 0)
+		goto failed;
+
+	if (mainloop_add_fd(wheel->fd, EPOLLIN, wheel_callback, NULL,
+						wheel_destroy) < 0) {
+		close(wheel->fd);
+		goto failed;
+	}
+
+	return true;
+
+failed:
+	free(wheel);
+	wheel = NULL;
+	return false;
+}
+
+static int timeout_alloc_id(struct timeout_data *data)
+{
+	unsigned int size;
+	void *list;
+	int id;
+
+	if (timeout_free_count) {
+		id = timeout_free[--timeout_free_count];
+		goto done;
+	}
+
+	if (timeout_list_used == timeout_list_size) {
+		size = timeout_list_size ? timeout_list_size * 2 : 64;
+
+		list = realloc(timeout_free, size * sizeof(*timeout_free));
+		if (!list)
+			return -ENOMEM;
+
+		timeout_free = list;
+
+		list = realloc(timeout_list, size * sizeof(*timeout_list));
+		if (!list)
+			return -ENOMEM;
+
+		timeout_list = list;
+		memset(timeout_list + timeout_list_size, 0,
+			(size - timeout_list_size) * sizeof(*timeout_list));
+		timeout_list_size = size;
+	}
+
+	/* Without free ids every slot below timeout_list_used is taken */
+	id = timeout_list_used + 1;
+
+done:
+	timeout_list[id - 1] = data;
+	timeout_list_used++;
+
+	return id;
+}
+
+static struct timeout_data *timeout_find(int id)
+{
+	if (id <= 0 || (unsigned int) id > timeout_list_size)
+		return NULL;
+
+	return timeout_list[id - 1];
+}
+
+static void timeout_schedule(struct timeout_data *data, unsigned int msec)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	/* An idle wheel is not kept running, catch up with real time */
+	if (wheel_empty() && now > wheel->now)
+		wheel->now = now;
+
+	/*
+	 * The current tick is already partly over, counting it would let
+	 * the timeout expire up to 1 ms early.
+	 */
+	data->expires = now + msec + (ts.tv_nsec % 1000000 ? 1 : 0);
+	if (data->expires < wheel->now)
+		data->expires = wheel->now;
+
+	wheel_insert(data);
+
+	if (data->expires < wheel->armed)
+		wheel_arm(data->expires);
 }
 
 int mainloop_add_timeout(unsigned int msec, mainloop_timeout_func callback,
@@ -282,53 +723,58 @@ int mainloop_add_timeout(unsigned int msec, mainloop_timeout_func callback,
 	if (!callback)
 		return -EINVAL;
 
+	if (!wheel_init())
+		return -EIO;
+
 	data = malloc(sizeof(*data));
 	if (!data)
 		return -ENOMEM;
 
 	memset(data, 0, sizeof(*data));
+	entry_init(&data->entry);
+	data->level = -1;
 	data->callback = callback;
 	data->destroy = destroy;
 	data->user_data = user_data;
 
-	data->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-	if (data->fd < 0) {
+	data->id = timeout_alloc_id(data);
+	if (data->id < 0) {
 		free(data);
-		return -EIO;
-	}
-
-	if (msec > 0) {
-		if (timeout_set(data->fd, msec) < 0) {
-			close(data->fd);
-			free(data);
-			return -EIO;
-		}
+		return -ENOMEM;
 	}
 
-	if (mainloop_add_fd(data->fd, EPOLLIN | EPOLLONESHOT,
-				timeout_callback, data, timeout_destroy) < 0) {
-		close(data->fd);
-		free(data);
-		return -EIO;
-	}
+	if (msec > 0)
+		timeout_schedule(data, msec);
 
-	return data->fd;
+	return data->id;
 }
 
 int mainloop_modify_timeout(int id, unsigned int msec)
 {
-	if (msec > 0) {
-		if (timeout_set(id, msec) < 0)
-			return -EIO;
-	}
+	struct timeout_data *data;
 
-	if (mainloop_modify_fd(id, EPOLLIN | EPOLLONESHOT) < 0)
+	data = timeout_find(id);
+	if (!data)
 		return -EIO;
 
+	if (msec > 0) {
+		wheel_unlink(data);
+		timeout_schedule(data, msec);
+	}
+
 	return 0;
 }
 
 int mainloop_remove_timeout(int id)
 {
-	return mainloop_remove_fd(id);
+	struct timeout_data *data;
+
+	data = timeout_find(id);
+	if (!data)
+		return -ENXIO;
+
+	wheel_unlink(data);
+	timeout_release(data);
+
+	return 0;
 }
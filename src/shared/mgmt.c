@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include "lib/bluetooth.h"
 #include "lib/mgmt.h"
@@ -69,6 +70,8 @@ struct mgmt_request {
 	mgmt_request_func_t callback;
 	mgmt_destroy_func_t destroy;
 	void *user_data;
+	uint64_t queued;
+	uint64_t sent;
 };
 
 struct mgmt_notify {
@@ -81,6 +84,15 @@ struct mgmt_notify {
 	void *user_data;
 };
 
+static uint64_t get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 static void destroy_request(void *data)
 {
 	struct mgmt_request *request = data;
@@ -183,46 +195,60 @@ static bool send_request(struct mgmt *mgmt, struct mgmt_request *request)
 	util_hexdump('<', request->buf, ret, mgmt->debug_callback,
 							mgmt->debug_data);
 
+	request->sent = get_usec();
+
 	queue_push_tail(mgmt->pending_list, request);
 
 	return true;
 }
 
+/*
+ * Commands for different controller indexes are independent of each
+ * other, so each index gets to have one command outstanding while the
+ * commands for any given index still go out strictly one at a time.
+ */
+static struct mgmt_request *next_request(struct mgmt *mgmt)
+{
+	const struct queue_entry *entry;
+
+	for (entry = queue_get_entries(mgmt->request_queue); entry;
+							entry = entry->next) {
+		struct mgmt_request *request = entry->data;
+
+		if (!queue_find(mgmt->pending_list, match_request_index,
+					UINT_TO_PTR(request->index)))
+			return request;
+	}
+
+	return NULL;
+}
+
 static bool can_write_data(struct io *io, void *user_data)
 {
 	struct mgmt *mgmt = user_data;
 	struct mgmt_request *request;
-	bool can_write;
 
+	/* only reply commands can jump the queue */
 	request = queue_pop_head(mgmt->reply_queue);
 	if (!request) {
-		/* only reply commands can jump the queue */
-		if (!queue_isempty(mgmt->pending_list))
-			return false;
-
-		request = queue_pop_head(mgmt->request_queue);
+		request = next_request(mgmt);
 		if (!request)
 			return false;
 
-		can_write = false;
-	} else {
-		/* allow multiple replies to jump the queue */
-		can_write = !queue_isempty(mgmt->reply_queue);
+		queue_remove(mgmt->request_queue, request);
 	}
 
 	if (!send_request(mgmt, request))
 		return true;
 
-	return can_write;
+	return !queue_isempty(mgmt->reply_queue) || next_request(mgmt);
 }
 
 static void wakeup_writer(struct mgmt *mgmt)
 {
-	if (!queue_isempty(mgmt->pending_list)) {
-		/* only queued reply commands trigger wakeup */
-		if (queue_isempty(mgmt->reply_queue))
-			return;
-	}
+	/* only queued reply commands or an idle index trigger wakeup */
+	if (queue_isempty(mgmt->reply_queue) && !next_request(mgmt))
+		return;
 
 	if (mgmt->writer_active)
 		return;
@@ -257,6 +283,15 @@ static void request_complete(struct mgmt *mgmt, uint8_t status,
 	request = queue_remove_if(mgmt->pending_list,
 					match_request_opcode_index, &match);
 	if (request) {
+		uint64_t now = get_usec();
+
+		util_debug(mgmt->debug_callback, mgmt->debug_data,
+				"[0x%04x] command 0x%04x latency %llu us "
+				"(queued %llu us)", index, opcode,
+				(unsigned long long) (now - request->sent),
+				(unsigned long long) (request->sent -
+							request->queued));
+
 		if (request->callback)
 			request->callback(status, length, param,
 							request->user_data);
@@ -321,7 +356,7 @@ static bool can_read_data(struct io *io, void *user_data)
 	ssize_t bytes_read;
 	uint16_t opcode, event, index, length;
 
-	bytes_read = read(mgmt->fd, mgmt->buf, mgmt->len);
+	bytes_read = io_recv(io, mgmt->buf, mgmt->len);
 	if (bytes_read < 0)
 		return false;
 
@@ -568,6 +603,8 @@ static struct mgmt_request *create_request(uint16_t opcode, uint16_t index,
 	request->destroy = destroy;
 	request->user_data = user_data;
 
+	request->queued = get_usec();
+
 	return request;
 }
 
@@ -28,11 +28,20 @@
 #include "src/shared/util.h"
 #include "src/shared/queue.h"
 
+/*
+ * Entries released by a queue are kept on a small per queue free list and
+ * handed out again on the next push, so a queue cycling through a steady
+ * number of entries doesn't go back to the allocator for each of them.
+ */
+#define QUEUE_CACHE_MAX 32
+
 struct queue {
 	int ref_count;
 	struct queue_entry *head;
 	struct queue_entry *tail;
 	unsigned int entries;
+	struct queue_entry *cache;
+	unsigned int cached;
 };
 
 static struct queue *queue_ref(struct queue *queue)
@@ -50,6 +59,13 @@ static void queue_unref(struct queue *queue)
 	if (__sync_sub_and_fetch(&queue->ref_count, 1))
 		return;
 
+	while (queue->cache) {
+		struct queue_entry *entry = queue->cache;
+
+		queue->cache = entry->next;
+		free(entry);
+	}
+
 	free(queue);
 }
 
@@ -75,16 +91,36 @@ void queue_destroy(struct queue *queue, queue_destroy_func_t destroy)
 	queue_unref(queue);
 }
 
-static struct queue_entry *queue_entry_new(void *data)
+static struct queue_entry *queue_entry_new(struct queue *queue, void *data)
 {
 	struct queue_entry *entry;
 
-	entry = new0(struct queue_entry, 1);
+	entry = queue->cache;
+	if (entry) {
+		queue->cache = entry->next;
+		queue->cached--;
+	} else
+		entry = new0(struct queue_entry, 1);
+
 	entry->data = data;
+	entry->next = NULL;
 
 	return entry;
 }
 
+static void queue_entry_free(struct queue *queue, struct queue_entry *entry)
+{
+	if (queue->cached >= QUEUE_CACHE_MAX) {
+		free(entry);
+		return;
+	}
+
+	entry->data = NULL;
+	entry->next = queue->cache;
+	queue->cache = entry;
+	queue->cached++;
+}
+
 bool queue_push_tail(struct queue *queue, void *data)
 {
 	struct queue_entry *entry;
@@ -92,7 +128,7 @@ bool queue_push_tail(struct queue *queue, void *data)
 	if (!queue)
 		return false;
 
-	entry = queue_entry_new(data);
+	entry = queue_entry_new(queue, data);
 
 	if (queue->tail)
 		queue->tail->next = entry;
@@ -114,7 +150,7 @@ bool queue_push_head(struct queue *queue, void *data)
 	if (!queue)
 		return false;
 
-	entry = queue_entry_new(data);
+	entry = queue_entry_new(queue, data);
 
 	entry->next = queue->head;
 
@@ -147,7 +183,7 @@ bool queue_push_after(struct queue *queue, void *entry, void *data)
 	if (!qentry)
 		return false;
 
-	new_entry = queue_entry_new(data);
+	new_entry = queue_entry_new(queue, data);
 
 	new_entry->next = qentry->next;
 
@@ -178,7 +214,7 @@ void *queue_pop_head(struct queue *queue)
 
 	data = entry->data;
 
-	free(entry);
+	queue_entry_free(queue, entry);
 	queue->entries--;
 
 	return data;
@@ -266,7 +302,7 @@ bool queue_remove(struct queue *queue, void *data)
 		if (!entry->next)
 			queue->tail = prev;
 
-		free(entry);
+		queue_entry_free(queue, entry);
 		queue->entries--;
 
 		return true;
@@ -302,7 +338,7 @@ void *queue_remove_if(struct queue *queue, queue_match_func_t function,
 
 			data = entry->data;
 
-			free(entry);
+			queue_entry_free(queue, entry);
 			queue->entries--;
 
 			return data;
@@ -353,7 +389,7 @@ unsigned int queue_remove_all(struct queue *queue, queue_match_func_t function,
 			if (destroy)
 				destroy(tmp->data);
 
-			free(tmp);
+			queue_entry_free(queue, tmp);
 			count++;
 		}
 	}
@@ -0,0 +1,437 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "src/shared/util.h"
+#include "src/shared/shm-ring.h"
+
+#define SHM_RING_MAGIC		0x525a4c42	/* "BLZR" */
+#define SHM_RING_MIN_SIZE	1024
+#define SHM_RING_MAX_SIZE	(16 * 1024 * 1024)
+
+/* Record header length value marking the rest of the buffer as unused */
+#define SHM_RING_SKIP		0xffff
+
+#define REC_HDR_SIZE		4
+#define REC_SIZE(len)		(REC_HDR_SIZE + (((len) + 3) & ~3U))
+
+/*
+ * Shared header, the producer and consumer indexes sit on their own cache
+ * line. Both indexes are free running and only masked on access.
+ */
+struct shm_ring_hdr {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t reserved0[14];
+	uint32_t head;
+	uint32_t dropped;
+	uint32_t reserved1[14];
+	uint32_t tail;
+	uint32_t wait;
+	uint32_t reserved2[14];
+};
+
+struct shm_ring {
+	struct shm_ring_hdr *hdr;
+	uint8_t *data;
+	uint32_t size;
+	size_t map_len;
+	int mem_fd;
+	int event_fd;
+	/* Private copies, the peer may scribble over the shared ones */
+	uint32_t head;
+	uint32_t tail;
+	bool pending;
+	struct shm_ring_stats stats;
+};
+
+static bool size_is_valid(size_t size)
+{
+	if (size < SHM_RING_MIN_SIZE || size > SHM_RING_MAX_SIZE)
+		return false;
+
+	return !(size & (size - 1));
+}
+
+static struct shm_ring *ring_map(int mem_fd, int event_fd, size_t size,
+								bool create)
+{
+	struct shm_ring *ring;
+	void *map;
+
+	ring = new0(struct shm_ring, 1);
+	ring->map_len = sizeof(struct shm_ring_hdr) + size;
+
+	map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+								mem_fd, 0);
+	if (map == MAP_FAILED) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->hdr = map;
+	ring->data = (uint8_t *) map + sizeof(struct shm_ring_hdr);
+	ring->size = size;
+	ring->mem_fd = mem_fd;
+	ring->event_fd = event_fd;
+
+	if (create) {
+		ring->hdr->magic = SHM_RING_MAGIC;
+		ring->hdr->size = size;
+	} else {
+		ring->head = __atomic_load_n(&ring->hdr->head,
+							__ATOMIC_ACQUIRE);
+		ring->tail = __atomic_load_n(&ring->hdr->tail,
+							__ATOMIC_ACQUIRE);
+	}
+
+	return ring;
+}
+
+struct shm_ring *shm_ring_new(size_t size)
+{
+	struct shm_ring *ring;
+	int mem_fd, event_fd;
+	size_t len = SHM_RING_MIN_SIZE;
+
+	while (len < size && len < SHM_RING_MAX_SIZE)
+		len <<= 1;
+
+	mem_fd = memfd_create("bluez-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (mem_fd < 0)
+		return NULL;
+
+	if (ftruncate(mem_fd, sizeof(struct shm_ring_hdr) + len) < 0)
+		goto fail;
+
+	/* The peer must not be able to truncate the mapping under us */
+	if (fcntl(mem_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+							F_SEAL_SEAL) < 0)
+		goto fail;
+
+	event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (event_fd < 0)
+		goto fail;
+
+	ring = ring_map(mem_fd, event_fd, len, true);
+	if (!ring) {
+		close(event_fd);
+		goto fail;
+	}
+
+	return ring;
+
+fail:
+	close(mem_fd);
+	return NULL;
+}
+
+struct shm_ring *shm_ring_attach(int mem_fd, int event_fd)
+{
+	struct shm_ring_hdr hdr;
+	struct stat st;
+	int seals;
+
+	if (fstat(mem_fd, &st) < 0)
+		return NULL;
+
+	seals = fcntl(mem_fd, F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK))
+		return NULL;
+
+	if (pread(mem_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+		return NULL;
+
+	if (hdr.magic != SHM_RING_MAGIC || !size_is_valid(hdr.size))
+		return NULL;
+
+	if ((size_t) st.st_size < sizeof(hdr) + hdr.size)
+		return NULL;
+
+	return ring_map(mem_fd, event_fd, hdr.size, false);
+}
+
+void shm_ring_free(struct shm_ring *ring)
+{
+	if (!ring)
+		return;
+
+	munmap(ring->hdr, ring->map_len);
+	close(ring->mem_fd);
+	close(ring->event_fd);
+	free(ring);
+}
+
+int shm_ring_get_mem_fd(struct shm_ring *ring)
+{
+	if (!ring)
+		return -1;
+
+	return ring->mem_fd;
+}
+
+int shm_ring_get_event_fd(struct shm_ring *ring)
+{
+	if (!ring)
+		return -1;
+
+	return ring->event_fd;
+}
+
+size_t shm_ring_get_size(struct shm_ring *ring)
+{
+	if (!ring)
+		return 0;
+
+	return ring->size;
+}
+
+static bool ring_write(struct shm_ring *ring, const void *data, uint16_t len)
+{
+	uint32_t tail, used, pos, contig, need;
+	uint16_t hdr[2] = { len, 0 };
+
+	if (len >= SHM_RING_SKIP || REC_SIZE(len) > ring->size / 2)
+		goto drop;
+
+	tail = __atomic_load_n(&ring->hdr->tail, __ATOMIC_ACQUIRE);
+	used = ring->head - tail;
+
+	/* A consumer moving its index past ours is treated as full */
+	if (used > ring->size)
+		goto drop;
+
+	pos = ring->head & (ring->size - 1);
+	contig = ring->size - pos;
+	need = REC_SIZE(len);
+
+	if (need > contig)
+		need += contig;
+
+	if (need > ring->size - used)
+		goto drop;
+
+	if (REC_SIZE(len) > contig) {
+		uint16_t skip[2] = { SHM_RING_SKIP, 0 };
+
+		memcpy(ring->data + pos, skip, sizeof(skip));
+		ring->head += contig;
+		pos = 0;
+	}
+
+	memcpy(ring->data + pos, hdr, sizeof(hdr));
+	memcpy(ring->data + pos + REC_HDR_SIZE, data, len);
+	ring->head += REC_SIZE(len);
+
+	used += need;
+	if (used > ring->stats.max_used)
+		ring->stats.max_used = used;
+
+	ring->stats.pushed++;
+
+	return true;
+
+drop:
+	ring->stats.dropped++;
+	__atomic_store_n(&ring->hdr->dropped, ring->stats.dropped,
+							__ATOMIC_RELAXED);
+	return false;
+}
+
+static void ring_publish(struct shm_ring *ring)
+{
+	__atomic_store_n(&ring->hdr->head, ring->head, __ATOMIC_RELEASE);
+	ring->pending = true;
+}
+
+bool shm_ring_push(struct shm_ring *ring, const void *data, uint16_t len)
+{
+	if (!ring)
+		return false;
+
+	if (!ring_write(ring, data, len))
+		return false;
+
+	ring_publish(ring);
+
+	return true;
+}
+
+unsigned int shm_ring_pushv(struct shm_ring *ring, const struct iovec *iov,
+							unsigned int count)
+{
+	unsigned int i, pushed = 0;
+
+	if (!ring)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		if (iov[i].iov_len > UINT16_MAX) {
+			ring->stats.dropped++;
+			continue;
+		}
+
+		if (ring_write(ring, iov[i].iov_base, iov[i].iov_len))
+			pushed++;
+	}
+
+	/* The whole batch becomes visible at once */
+	if (pushed)
+		ring_publish(ring);
+
+	return pushed;
+}
+
+bool shm_ring_kick(struct shm_ring *ring)
+{
+	uint64_t val = 1;
+
+	if (!ring || !ring->pending)
+		return false;
+
+	ring->pending = false;
+
+	/* Pairs with the barrier in shm_ring_prepare_wait() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!__atomic_exchange_n(&ring->hdr->wait, 0, __ATOMIC_SEQ_CST))
+		return false;
+
+	if (write(ring->event_fd, &val, sizeof(val)) != sizeof(val))
+		return false;
+
+	ring->stats.doorbells++;
+
+	return true;
+}
+
+int shm_ring_pop(struct shm_ring *ring, void *buf, size_t len)
+{
+	uint32_t head, avail, pos, contig;
+	uint16_t hdr[2];
+
+	if (!ring)
+		return -EINVAL;
+
+	head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		avail = head - ring->tail;
+		if (!avail)
+			return -EAGAIN;
+
+		if (avail > ring->size || avail < REC_HDR_SIZE)
+			return -EBADMSG;
+
+		pos = ring->tail & (ring->size - 1);
+		contig = ring->size - pos;
+
+		memcpy(hdr, ring->data + pos, sizeof(hdr));
+
+		if (hdr[0] != SHM_RING_SKIP)
+			break;
+
+		if (contig > avail)
+			return -EBADMSG;
+
+		ring->tail += contig;
+	}
+
+	if (REC_SIZE(hdr[0]) > contig || REC_SIZE(hdr[0]) > avail)
+		return -EBADMSG;
+
+	if (hdr[0] <= len)
+		memcpy(buf, ring->data + pos + REC_HDR_SIZE, hdr[0]);
+
+	/* Records that don't fit are consumed so the ring can't get stuck */
+	ring->tail += REC_SIZE(hdr[0]);
+
+	__atomic_store_n(&ring->hdr->tail, ring->tail, __ATOMIC_RELEASE);
+
+	if (hdr[0] > len)
+		return -EMSGSIZE;
+
+	return hdr[0];
+}
+
+bool shm_ring_prepare_wait(struct shm_ring *ring)
+{
+	uint32_t head;
+
+	if (!ring)
+		return false;
+
+	__atomic_store_n(&ring->hdr->wait, 1, __ATOMIC_SEQ_CST);
+
+	head = __atomic_load_n(&ring->hdr->head, __ATOMIC_SEQ_CST);
+	if (head == ring->tail)
+		return true;
+
+	/* Data raced in, drain it instead of waiting for a doorbell */
+	__atomic_store_n(&ring->hdr->wait, 0, __ATOMIC_RELAXED);
+
+	return false;
+}
+
+void shm_ring_ack(struct shm_ring *ring)
+{
+	uint64_t val;
+
+	if (!ring)
+		return;
+
+	if (read(ring->event_fd, &val, sizeof(val)) < 0)
+		return;
+}
+
+/* Wake the consumer up again when it stopped before the ring was empty */
+void shm_ring_rearm(struct shm_ring *ring)
+{
+	uint64_t val = 1;
+
+	if (!ring)
+		return;
+
+	if (write(ring->event_fd, &val, sizeof(val)) < 0)
+		return;
+}
+
+void shm_ring_get_stats(struct shm_ring *ring, struct shm_ring_stats *stats)
+{
+	if (!ring || !stats)
+		return;
+
+	*stats = ring->stats;
+}
@@ -0,0 +1,67 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/*
+ * Single producer, single consumer ring of variable sized records living
+ * in a memfd, with an eventfd as doorbell. Either side can create the
+ * ring and hand both file descriptors to the other, which attaches to it.
+ *
+ * The producer only rings the doorbell when the consumer announced it is
+ * about to wait, so a busy consumer takes no wakeups at all.
+ *
+ * shm_ring_pop() returns the record length, -EAGAIN once the ring is empty
+ * and -EMSGSIZE for a record that didn't fit in the buffer and was skipped.
+ */
+struct shm_ring;
+
+struct shm_ring_stats {
+	uint32_t pushed;
+	uint32_t dropped;
+	uint32_t doorbells;
+	uint32_t max_used;
+};
+
+struct shm_ring *shm_ring_new(size_t size);
+struct shm_ring *shm_ring_attach(int mem_fd, int event_fd);
+void shm_ring_free(struct shm_ring *ring);
+
+int shm_ring_get_mem_fd(struct shm_ring *ring);
+int shm_ring_get_event_fd(struct shm_ring *ring);
+size_t shm_ring_get_size(struct shm_ring *ring);
+
+bool shm_ring_push(struct shm_ring *ring, const void *data, uint16_t len);
+unsigned int shm_ring_pushv(struct shm_ring *ring, const struct iovec *iov,
+							unsigned int count);
+bool shm_ring_kick(struct shm_ring *ring);
+
+int shm_ring_pop(struct shm_ring *ring, void *buf, size_t len);
+bool shm_ring_prepare_wait(struct shm_ring *ring);
+void shm_ring_ack(struct shm_ring *ring);
+void shm_ring_rearm(struct shm_ring *ring);
+
+void shm_ring_get_stats(struct shm_ring *ring, struct shm_ring_stats *stats);
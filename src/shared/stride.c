@@ -0,0 +1,105 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include "src/shared/queue.h"
+#include "src/shared/stride.h"
+
+void stride_advance(struct stride_entry *entry, unsigned int slice)
+{
+	if (!entry || !entry->weight)
+		return;
+
+	entry->pass += (uint64_t) slice * STRIDE_ONE / entry->weight;
+}
+
+/* Element of the entry with the lowest pass, ties go to the first one */
+void *stride_next(struct queue *queue, stride_entry_func_t func)
+{
+	const struct queue_entry *qe;
+	struct stride_entry *min = NULL;
+	void *data = NULL;
+
+	if (!func)
+		return NULL;
+
+	for (qe = queue_get_entries(queue); qe; qe = qe->next) {
+		struct stride_entry *entry = func(qe->data);
+
+		if (!entry)
+			continue;
+
+		if (!min || entry->pass < min->pass) {
+			min = entry;
+			data = qe->data;
+		}
+	}
+
+	return data;
+}
+
+/* Pass a new entry starts from so it doesn't get a burst of slots */
+uint64_t stride_min_pass(struct queue *queue, stride_entry_func_t func)
+{
+	void *data;
+
+	data = stride_next(queue, func);
+	if (!data)
+		return 0;
+
+	return func(data)->pass;
+}
+
+/* Share of the time, in 1/1000, the entry is expected to hold a slot */
+unsigned int stride_share(struct queue *queue, stride_entry_func_t func,
+				const struct stride_entry *entry,
+				unsigned int slots)
+{
+	const struct queue_entry *qe;
+	unsigned int count = 0, weight = 0, share;
+
+	if (!func || !entry)
+		return 0;
+
+	for (qe = queue_get_entries(queue); qe; qe = qe->next) {
+		struct stride_entry *e = func(qe->data);
+
+		if (!e)
+			continue;
+
+		count++;
+		weight += e->weight;
+	}
+
+	if (count <= slots)
+		return 1000;
+
+	share = 1000 * entry->weight * slots / weight;
+
+	return share < 1000 ? share : 1000;
+}
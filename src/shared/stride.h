@@ -0,0 +1,52 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Stride scheduling of more users than there are slots. Each entry keeps
+ * a pass value that advances by the time it held a slot divided by its
+ * weight, and the waiting entry with the lowest pass gets the next slot,
+ * so over time each entry holds a slot in proportion to its weight.
+ *
+ * Entries live in the caller's own queue, the lookup callback returns the
+ * entry for an element or NULL to skip it.
+ */
+#define STRIDE_ONE 65536
+
+struct stride_entry {
+	uint64_t pass;
+	unsigned int weight;
+};
+
+typedef struct stride_entry *(*stride_entry_func_t)(void *data);
+
+struct queue;
+
+void stride_advance(struct stride_entry *entry, unsigned int slice);
+void *stride_next(struct queue *queue, stride_entry_func_t func);
+uint64_t stride_min_pass(struct queue *queue, stride_entry_func_t func);
+unsigned int stride_share(struct queue *queue, stride_entry_func_t func,
+				const struct stride_entry *entry,
+				unsigned int slots);
@@ -31,6 +31,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stddef.h>
 
 #include "src/shared/io.h"
 #include "src/shared/util.h"
@@ -39,6 +40,10 @@
 
 #define UHID_DEVICE_FILE "/dev/uhid"
 
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
 struct bt_uhid {
 	int ref_count;
 	struct io *io;
@@ -246,3 +251,44 @@ int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 	/* uHID kernel driver does not handle partial writes */
 	return len != sizeof(*ev) ? -EIO : 0;
 }
+
+int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
+								size_t size)
+{
+	struct uhid_event ev;
+	struct iovec iov;
+	uint8_t *buf;
+	ssize_t len;
+
+	if (!uhid->io)
+		return -ENOTCONN;
+
+	ev.type = UHID_INPUT2;
+	buf = ev.u.input2.data;
+
+	if (number) {
+		*buf++ = number;
+		size = MIN(size, sizeof(ev.u.input2.data) - 1);
+		ev.u.input2.size = size + 1;
+	} else {
+		size = MIN(size, sizeof(ev.u.input2.data));
+		ev.u.input2.size = size;
+	}
+
+	if (size)
+		memcpy(buf, data, size);
+
+	/*
+	 * The kernel zeroes whatever is not written, so only the part of
+	 * the event that is actually used is sent.
+	 */
+	iov.iov_base = &ev;
+	iov.iov_len = offsetof(struct uhid_event, u.input2.data) +
+							ev.u.input2.size;
+
+	len = io_send(uhid->io, &iov, 1);
+	if (len < 0)
+		return -errno;
+
+	return (size_t) len != iov.iov_len ? -EIO : 0;
+}
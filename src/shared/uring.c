@@ -0,0 +1,707 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "src/shared/util.h"
+#include "src/shared/uring.h"
+
+#if defined(HAVE_DECL_IORING_REGISTER_PBUF_RING) && \
+				HAVE_DECL_IORING_REGISTER_PBUF_RING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+struct uring_sq {
+	unsigned int *khead;
+	unsigned int *ktail;
+	unsigned int *kflags;
+	unsigned int *array;
+	unsigned int mask;
+	unsigned int entries;
+	unsigned int tail;
+	unsigned int pending;
+	struct io_uring_sqe *sqes;
+};
+
+struct uring_cq {
+	unsigned int *khead;
+	unsigned int *ktail;
+	unsigned int mask;
+	struct io_uring_cqe *cqes;
+};
+
+struct uring {
+	int fd;
+	void *ring_ptr;
+	size_t ring_size;
+	void *cq_ptr;
+	size_t cq_size;
+	size_t sqes_size;
+	struct uring_sq sq;
+	struct uring_cq cq;
+	int *files;
+	unsigned int num_files;
+	unsigned int free_files;
+	struct io_uring_buf_ring *br;
+	size_t br_size;
+	uint8_t *bufs;
+	unsigned int buf_count;
+	size_t buf_size;
+	unsigned short buf_tail;
+};
+
+#define URING_BUF_GROUP 0
+
+static int sys_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned int to_submit,
+				unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+								flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned int opcode, const void *arg,
+							unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static bool ring_mmap(struct uring *ring, struct io_uring_params *p)
+{
+	ring->ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	ring->cq_size = p->cq_off.cqes +
+				p->cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_size > ring->ring_size)
+			ring->ring_size = ring->cq_size;
+		ring->cq_size = 0;
+	}
+
+	ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->fd,
+				IORING_OFF_SQ_RING);
+	if (ring->ring_ptr == MAP_FAILED) {
+		ring->ring_ptr = NULL;
+		return false;
+	}
+
+	if (ring->cq_size) {
+		ring->cq_ptr = mmap(NULL, ring->cq_size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->fd,
+				IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == MAP_FAILED) {
+			ring->cq_ptr = NULL;
+			return false;
+		}
+	} else
+		ring->cq_ptr = ring->ring_ptr;
+
+	ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sq.sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, ring->fd,
+				IORING_OFF_SQES);
+	if (ring->sq.sqes == MAP_FAILED) {
+		ring->sq.sqes = NULL;
+		return false;
+	}
+
+	ring->sq.khead = ring->ring_ptr + p->sq_off.head;
+	ring->sq.ktail = ring->ring_ptr + p->sq_off.tail;
+	ring->sq.kflags = ring->ring_ptr + p->sq_off.flags;
+	ring->sq.array = ring->ring_ptr + p->sq_off.array;
+	ring->sq.mask = *(unsigned int *) (ring->ring_ptr +
+						p->sq_off.ring_mask);
+	ring->sq.entries = p->sq_entries;
+	ring->sq.tail = *ring->sq.ktail;
+
+	ring->cq.khead = ring->cq_ptr + p->cq_off.head;
+	ring->cq.ktail = ring->cq_ptr + p->cq_off.tail;
+	ring->cq.mask = *(unsigned int *) (ring->cq_ptr +
+						p->cq_off.ring_mask);
+	ring->cq.cqes = ring->cq_ptr + p->cq_off.cqes;
+
+	return true;
+}
+
+static bool ring_register_files(struct uring *ring, unsigned int files)
+{
+	struct io_uring_rsrc_register reg;
+	unsigned int i;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.nr = files;
+	reg.flags = IORING_RSRC_REGISTER_SPARSE;
+
+	if (sys_register(ring->fd, IORING_REGISTER_FILES2, &reg,
+							sizeof(reg)) < 0)
+		return false;
+
+	/* Slots are handed out from the end of the free stack */
+	ring->files = new0(int, files);
+	for (i = 0; i < files; i++)
+		ring->files[i] = files - i - 1;
+
+	ring->num_files = files;
+	ring->free_files = files;
+
+	return true;
+}
+
+struct uring *uring_new(unsigned int entries, unsigned int files)
+{
+	struct io_uring_params p;
+	struct uring *ring;
+
+	ring = new0(struct uring, 1);
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CLAMP;
+
+	ring->fd = sys_setup(entries, &p);
+	if (ring->fd < 0) {
+		free(ring);
+		return NULL;
+	}
+
+	/*
+	 * Without these there is no way to tell how far the kernel got
+	 * with the submissions or to stop it from dropping completions.
+	 */
+	if (!(p.features & IORING_FEAT_NODROP) ||
+				!(p.features & IORING_FEAT_SUBMIT_STABLE))
+		goto failed;
+
+	if (!ring_mmap(ring, &p))
+		goto failed;
+
+	if (!ring_register_files(ring, files))
+		goto failed;
+
+	return ring;
+
+failed:
+	uring_free(ring);
+	return NULL;
+}
+
+void uring_free(struct uring *ring)
+{
+	if (!ring)
+		return;
+
+	if (ring->br)
+		munmap(ring->br, ring->br_size);
+
+	free(ring->bufs);
+	free(ring->files);
+
+	if (ring->sq.sqes)
+		munmap(ring->sq.sqes, ring->sqes_size);
+
+	if (ring->cq_ptr && ring->cq_ptr != ring->ring_ptr)
+		munmap(ring->cq_ptr, ring->cq_size);
+
+	if (ring->ring_ptr)
+		munmap(ring->ring_ptr, ring->ring_size);
+
+	close(ring->fd);
+	free(ring);
+}
+
+int uring_get_fd(struct uring *ring)
+{
+	if (!ring)
+		return -EINVAL;
+
+	return ring->fd;
+}
+
+int uring_file_register(struct uring *ring, int fd)
+{
+	struct io_uring_files_update update;
+	int index;
+
+	if (!ring || fd < 0)
+		return -EINVAL;
+
+	if (!ring->free_files)
+		return -ENFILE;
+
+	index = ring->files[ring->free_files - 1];
+
+	memset(&update, 0, sizeof(update));
+	update.offset = index;
+	update.fds = (uint64_t) (uintptr_t) &fd;
+
+	if (sys_register(ring->fd, IORING_REGISTER_FILES_UPDATE,
+							&update, 1) < 0)
+		return -errno;
+
+	ring->free_files--;
+
+	return index;
+}
+
+void uring_file_unregister(struct uring *ring, int index)
+{
+	struct io_uring_files_update update;
+	int fd = -1;
+
+	if (!ring || index < 0 || (unsigned int) index >= ring->num_files)
+		return;
+
+	memset(&update, 0, sizeof(update));
+	update.offset = index;
+	update.fds = (uint64_t) (uintptr_t) &fd;
+
+	sys_register(ring->fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+
+	ring->files[ring->free_files++] = index;
+}
+
+bool uring_buf_setup(struct uring *ring, unsigned int count, size_t size)
+{
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+
+	/* The ring of provided buffers has to be a power of two */
+	if (!ring || ring->br || !count || count > 32768 ||
+						(count & (count - 1)))
+		return false;
+
+	ring->br_size = count * sizeof(struct io_uring_buf);
+	ring->br = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->br == MAP_FAILED) {
+		ring->br = NULL;
+		return false;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t) (uintptr_t) ring->br;
+	reg.ring_entries = count;
+	reg.bgid = URING_BUF_GROUP;
+
+	if (sys_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+		goto failed;
+
+	ring->bufs = malloc(count * size);
+	if (!ring->bufs)
+		goto failed;
+
+	ring->buf_count = count;
+	ring->buf_size = size;
+	ring->buf_tail = 0;
+
+	for (i = 0; i < count; i++)
+		uring_buf_put(ring, i);
+
+	return true;
+
+failed:
+	munmap(ring->br, ring->br_size);
+	ring->br = NULL;
+	return false;
+}
+
+size_t uring_buf_size(struct uring *ring)
+{
+	if (!ring || !ring->bufs)
+		return 0;
+
+	return ring->buf_size;
+}
+
+void *uring_buf_get(struct uring *ring, uint16_t bid)
+{
+	if (!ring || bid >= ring->buf_count)
+		return NULL;
+
+	return ring->bufs + (size_t) bid * ring->buf_size;
+}
+
+void uring_buf_put(struct uring *ring, uint16_t bid)
+{
+	struct io_uring_buf *buf;
+
+	if (!ring || bid >= ring->buf_count)
+		return;
+
+	buf = &ring->br->bufs[ring->buf_tail & (ring->buf_count - 1)];
+	buf->addr = (uint64_t) (uintptr_t) uring_buf_get(ring, bid);
+	buf->len = ring->buf_size;
+	buf->bid = bid;
+
+	ring->buf_tail++;
+	__atomic_store_n(&ring->br->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+unsigned int uring_sq_space(struct uring *ring)
+{
+	unsigned int head;
+
+	head = __atomic_load_n(ring->sq.khead, __ATOMIC_ACQUIRE);
+
+	return ring->sq.entries - (ring->sq.tail - head);
+}
+
+static struct io_uring_sqe *get_sqe(struct uring *ring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int head, index;
+
+	head = __atomic_load_n(ring->sq.khead, __ATOMIC_ACQUIRE);
+
+	if (ring->sq.tail - head >= ring->sq.entries) {
+		if (uring_submit(ring) < 0)
+			return NULL;
+
+		head = __atomic_load_n(ring->sq.khead, __ATOMIC_ACQUIRE);
+		if (ring->sq.tail - head >= ring->sq.entries)
+			return NULL;
+	}
+
+	index = ring->sq.tail & ring->sq.mask;
+
+	sqe = &ring->sq.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+
+	ring->sq.array[index] = index;
+	ring->sq.tail++;
+	ring->sq.pending++;
+
+	return sqe;
+}
+
+int uring_poll(struct uring *ring, int index, uint32_t events, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = index;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->poll32_events = events;
+	sqe->user_data = data;
+
+	return 0;
+}
+
+int uring_poll_update(struct uring *ring, uint64_t old_data, uint32_t events)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = old_data;
+	sqe->poll32_events = events;
+	sqe->len = IORING_POLL_UPDATE_EVENTS;
+
+	return 0;
+}
+
+int uring_recv(struct uring *ring, int index, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	if (!ring->bufs)
+		return -ENOBUFS;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = index;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->buf_group = URING_BUF_GROUP;
+	sqe->user_data = data;
+
+	return 0;
+}
+
+int uring_send(struct uring *ring, int index, const void *buf, size_t len,
+						bool link, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = index;
+	sqe->flags = IOSQE_FIXED_FILE;
+	if (link)
+		sqe->flags |= IOSQE_IO_LINK;
+	sqe->addr = (uint64_t) (uintptr_t) buf;
+	sqe->len = len;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = data;
+
+	return 0;
+}
+
+int uring_cancel(struct uring *ring, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = data;
+
+	return 0;
+}
+
+int uring_nop(struct uring *ring, uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ring);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = data;
+
+	return 0;
+}
+
+int uring_submit(struct uring *ring)
+{
+	unsigned int pending;
+	int ret;
+
+	if (!ring || !ring->sq.pending)
+		return 0;
+
+	pending = ring->sq.pending;
+
+	__atomic_store_n(ring->sq.ktail, ring->sq.tail, __ATOMIC_RELEASE);
+
+	do {
+		ret = sys_enter(ring->fd, pending, 0, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		return -errno;
+
+	/* With stable submissions whatever wasn't consumed stays queued */
+	ring->sq.pending -= ret;
+
+	return ret;
+}
+
+unsigned int uring_process(struct uring *ring, uring_complete_func_t func,
+							void *user_data)
+{
+	unsigned int count = 0;
+
+	while (1) {
+		unsigned int head, tail;
+
+		head = *ring->cq.khead;
+		tail = __atomic_load_n(ring->cq.ktail, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			unsigned int flags;
+
+			/* Flush anything the kernel had to hold back */
+			flags = __atomic_load_n(ring->sq.kflags,
+							__ATOMIC_RELAXED);
+			if (!(flags & IORING_SQ_CQ_OVERFLOW))
+				break;
+
+			if (sys_enter(ring->fd, 0, 0,
+					IORING_ENTER_GETEVENTS) < 0)
+				break;
+
+			continue;
+		}
+
+		for (; head != tail; head++) {
+			struct io_uring_cqe *cqe;
+			uint64_t data;
+			int32_t res;
+			uint32_t flags;
+
+			cqe = &ring->cq.cqes[head & ring->cq.mask];
+			data = cqe->user_data;
+			res = cqe->res;
+			flags = cqe->flags;
+
+			/* Release the entry before the callback runs */
+			__atomic_store_n(ring->cq.khead, head + 1,
+							__ATOMIC_RELEASE);
+
+			func(data, res, flags, user_data);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+bool uring_cqe_more(uint32_t flags)
+{
+	return flags & IORING_CQE_F_MORE;
+}
+
+int uring_cqe_buffer(uint32_t flags)
+{
+	if (!(flags & IORING_CQE_F_BUFFER))
+		return -1;
+
+	return flags >> IORING_CQE_BUFFER_SHIFT;
+}
+
+#else
+
+struct uring *uring_new(unsigned int entries, unsigned int files)
+{
+	return NULL;
+}
+
+void uring_free(struct uring *ring)
+{
+}
+
+int uring_get_fd(struct uring *ring)
+{
+	return -ENOTSUP;
+}
+
+int uring_file_register(struct uring *ring, int fd)
+{
+	return -ENOTSUP;
+}
+
+void uring_file_unregister(struct uring *ring, int index)
+{
+}
+
+bool uring_buf_setup(struct uring *ring, unsigned int count, size_t size)
+{
+	return false;
+}
+
+size_t uring_buf_size(struct uring *ring)
+{
+	return 0;
+}
+
+void *uring_buf_get(struct uring *ring, uint16_t bid)
+{
+	return NULL;
+}
+
+void uring_buf_put(struct uring *ring, uint16_t bid)
+{
+}
+
+unsigned int uring_sq_space(struct uring *ring)
+{
+	return 0;
+}
+
+int uring_poll(struct uring *ring, int index, uint32_t events, uint64_t data)
+{
+	return -ENOTSUP;
+}
+
+int uring_poll_update(struct uring *ring, uint64_t old_data, uint32_t events)
+{
+	return -ENOTSUP;
+}
+
+int uring_recv(struct uring *ring, int index, uint64_t data)
+{
+	return -ENOTSUP;
+}
+
+int uring_send(struct uring *ring, int index, const void *buf, size_t len,
+						bool link, uint64_t data)
+{
+	return -ENOTSUP;
+}
+
+int uring_cancel(struct uring *ring, uint64_t data)
+{
+	return -ENOTSUP;
+}
+
+int uring_nop(struct uring *ring, uint64_t data)
+{
+	return -ENOTSUP;
+}
+
+int uring_submit(struct uring *ring)
+{
+	return -ENOTSUP;
+}
+
+unsigned int uring_process(struct uring *ring, uring_complete_func_t func,
+							void *user_data)
+{
+	return 0;
+}
+
+bool uring_cqe_more(uint32_t flags)
+{
+	return false;
+}
+
+int uring_cqe_buffer(uint32_t flags)
+{
+	return -1;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Minimal io_uring wrapper. Operations are only queued until
+ * uring_submit() is called, completions are reported through
+ * uring_process() with the data they were queued with.
+ */
+struct uring;
+
+typedef void (*uring_complete_func_t)(uint64_t data, int32_t res,
+					uint32_t flags, void *user_data);
+
+struct uring *uring_new(unsigned int entries, unsigned int files);
+void uring_free(struct uring *ring);
+
+int uring_get_fd(struct uring *ring);
+
+int uring_file_register(struct uring *ring, int fd);
+void uring_file_unregister(struct uring *ring, int index);
+
+bool uring_buf_setup(struct uring *ring, unsigned int count, size_t size);
+size_t uring_buf_size(struct uring *ring);
+void *uring_buf_get(struct uring *ring, uint16_t bid);
+void uring_buf_put(struct uring *ring, uint16_t bid);
+
+unsigned int uring_sq_space(struct uring *ring);
+
+int uring_poll(struct uring *ring, int index, uint32_t events,
+							uint64_t data);
+int uring_poll_update(struct uring *ring, uint64_t old_data,
+							uint32_t events);
+int uring_recv(struct uring *ring, int index, uint64_t data);
+int uring_send(struct uring *ring, int index, const void *buf, size_t len,
+						bool link, uint64_t data);
+int uring_cancel(struct uring *ring, uint64_t data);
+int uring_nop(struct uring *ring, uint64_t data);
+
+int uring_submit(struct uring *ring);
+unsigned int uring_process(struct uring *ring, uring_complete_func_t func,
+							void *user_data);
+
+bool uring_cqe_more(uint32_t flags);
+int uring_cqe_buffer(uint32_t flags);
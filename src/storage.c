@@ -44,7 +44,6 @@
 #include "lib/sdp_lib.h"
 #include "lib/uuid.h"
 
-#include "textfile.h"
 #include "uuid-helper.h"
 #include "storage.h"
 
@@ -56,95 +55,6 @@ struct match {
 	char *pattern;
 };
 
-static inline int create_filename(char *buf, size_t size,
-				const bdaddr_t *bdaddr, const char *name)
-{
-	char addr[18];
-
-	ba2str(bdaddr, addr);
-
-	return create_name(buf, size, STORAGEDIR, addr, name);
-}
-
-int read_discoverable_timeout(const char *src, int *timeout)
-{
-	char filename[PATH_MAX], *str;
-
-	create_name(filename, PATH_MAX, STORAGEDIR, src, "config");
-
-	str = textfile_get(filename, "discovto");
-	if (!str)
-		return -ENOENT;
-
-	if (sscanf(str, "%d", timeout) != 1) {
-		free(str);
-		return -ENOENT;
-	}
-
-	free(str);
-
-	return 0;
-}
-
-int read_pairable_timeout(const char *src, int *timeout)
-{
-	char filename[PATH_MAX], *str;
-
-	create_name(filename, PATH_MAX, STORAGEDIR, src, "config");
-
-	str = textfile_get(filename, "pairto");
-	if (!str)
-		return -ENOENT;
-
-	if (sscanf(str, "%d", timeout) != 1) {
-		free(str);
-		return -ENOENT;
-	}
-
-	free(str);
-
-	return 0;
-}
-
-int read_on_mode(const char *src, char *mode, int length)
-{
-	char filename[PATH_MAX], *str;
-
-	create_name(filename, PATH_MAX, STORAGEDIR, src, "config");
-
-	str = textfile_get(filename, "onmode");
-	if (!str)
-		return -ENOENT;
-
-	strncpy(mode, str, length);
-	mode[length - 1] = '\0';
-
-	free(str);
-
-	return 0;
-}
-
-int read_local_name(const bdaddr_t *bdaddr, char *name)
-{
-	char filename[PATH_MAX], *str;
-	int len;
-
-	create_filename(filename, PATH_MAX, bdaddr, "config");
-
-	str = textfile_get(filename, "name");
-	if (!str)
-		return -ENOENT;
-
-	len = strlen(str);
-	if (len > HCI_MAX_NAME_LENGTH)
-		str[HCI_MAX_NAME_LENGTH] = '\0';
-	strcpy(name, str);
-
-	free(str);
-
-	return 0;
-}
-
 sdp_record_t *record_from_string(const char *str)
 {
 	sdp_record_t *rec;
@@ -474,3 +474,581 @@ close:
 
 	return 0;
 }
+
+struct textfile_entry {
+	struct textfile_entry *prev;
+	struct textfile_entry *next;
+	struct textfile_entry *hash_next;
+	unsigned int hash;
+	char *value;
+	char key[0];
+};
+
+struct textfile_change {
+	struct textfile_change *next;
+	char *value;
+	char key[0];
+};
+
+struct textfile {
+	char *pathname;
+	struct textfile_entry *head;
+	struct textfile_entry *tail;
+	struct textfile_entry **buckets;
+	unsigned int num_buckets;
+	unsigned int num_entries;
+	struct textfile_change *changes;
+	struct textfile_change **changes_tail;
+};
+
+#define TEXTFILE_MIN_BUCKETS 64
+
+static unsigned int hash_key(const char *key, size_t len)
+{
+	unsigned int hash = 2166136261u;
+
+	while (len--)
+		hash = (hash ^ (unsigned char) *key++) * 16777619u;
+
+	return hash;
+}
+
+static struct textfile_entry *lookup_entry(struct textfile *file,
+						const char *key, size_t len,
+						unsigned int hash)
+{
+	struct textfile_entry *entry;
+
+	entry = file->buckets[hash & (file->num_buckets - 1)];
+
+	for (; entry; entry = entry->hash_next) {
+		if (entry->hash == hash && !strncmp(entry->key, key, len) &&
+							!entry->key[len])
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void grow_buckets(struct textfile *file)
+{
+	struct textfile_entry **buckets;
+	unsigned int num_buckets = file->num_buckets * 2;
+	unsigned int i;
+
+	/* Without memory for a bigger table the chains just get longer */
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < file->num_buckets; i++) {
+		struct textfile_entry *entry = file->buckets[i];
+
+		while (entry) {
+			struct textfile_entry *next = entry->hash_next;
+			unsigned int j = entry->hash & (num_buckets - 1);
+
+			entry->hash_next = buckets[j];
+			buckets[j] = entry;
+
+			entry = next;
+		}
+	}
+
+	free(file->buckets);
+	file->buckets = buckets;
+	file->num_buckets = num_buckets;
+}
+
+static struct textfile_entry *add_entry(struct textfile *file,
+					const char *key, size_t key_len,
+					const char *value, size_t value_len)
+{
+	struct textfile_entry *entry;
+	unsigned int hash = hash_key(key, key_len);
+
+	entry = malloc(sizeof(*entry) + key_len + 1);
+	if (!entry)
+		return NULL;
+
+	memcpy(entry->key, key, key_len);
+	entry->key[key_len] = '\0';
+	entry->hash = hash;
+	entry->hash_next = NULL;
+
+	if (value) {
+		entry->value = strndup(value, value_len);
+		if (!entry->value) {
+			free(entry);
+			return NULL;
+		}
+	} else
+		entry->value = NULL;
+
+	entry->next = NULL;
+	entry->prev = file->tail;
+	if (file->tail)
+		file->tail->next = entry;
+	else
+		file->head = entry;
+	file->tail = entry;
+
+	/* Lines that aren't key value pairs are kept but never indexed, and
+	 * only the first of duplicate keys is visible as with textfile_get().
+	 */
+	if (!value || lookup_entry(file, key, key_len, hash))
+		return entry;
+
+	if (file->num_entries >= file->num_buckets)
+		grow_buckets(file);
+
+	entry->hash_next = file->buckets[hash & (file->num_buckets - 1)];
+	file->buckets[hash & (file->num_buckets - 1)] = entry;
+	file->num_entries++;
+
+	return entry;
+}
+
+static int parse_file(struct textfile *file, const char *map, size_t size)
+{
+	const char *off = map, *end = map + size;
+
+	while (off < end) {
+		const char *eol, *sep;
+
+		eol = strnpbrk(off, end - off, "\r\n");
+		if (!eol)
+			eol = end;
+
+		if (eol == off) {
+			off++;
+			continue;
+		}
+
+		sep = memchr(off, ' ', eol - off);
+		if (sep) {
+			if (!add_entry(file, off, sep - off, sep + 1,
+							eol - sep - 1))
+				return -ENOMEM;
+		} else if (!add_entry(file, off, eol - off, NULL, 0))
+			return -ENOMEM;
+
+		off = eol + 1;
+	}
+
+	return 0;
+}
+
+static struct textfile *textfile_new(const char *pathname)
+{
+	struct textfile *file;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return NULL;
+
+	file->pathname = strdup(pathname);
+	file->num_buckets = TEXTFILE_MIN_BUCKETS;
+	file->buckets = calloc(file->num_buckets, sizeof(*file->buckets));
+	file->changes_tail = &file->changes;
+
+	if (!file->pathname || !file->buckets) {
+		textfile_close(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+/* The caller holds the lock on fd */
+static int load_file(struct textfile *file, int fd)
+{
+	struct stat st;
+	char *map;
+	int err;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+
+	if (!st.st_size)
+		return 0;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (!map || map == MAP_FAILED)
+		return -errno;
+
+	err = parse_file(file, map, st.st_size);
+
+	munmap(map, st.st_size);
+
+	return err;
+}
+
+struct textfile *textfile_open(const char *pathname)
+{
+	struct textfile *file;
+	int fd, err = 0;
+
+	fd = open(pathname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	file = textfile_new(pathname);
+	if (!file) {
+		err = -ENOMEM;
+		goto close;
+	}
+
+	if (flock(fd, LOCK_SH) < 0) {
+		err = -errno;
+		goto failed;
+	}
+
+	err = load_file(file, fd);
+
+	flock(fd, LOCK_UN);
+
+	if (!err)
+		goto close;
+
+failed:
+	textfile_close(file);
+	file = NULL;
+
+close:
+	close(fd);
+	errno = -err;
+
+	return file;
+}
+
+static void free_entries(struct textfile *file)
+{
+	struct textfile_entry *entry = file->head;
+
+	while (entry) {
+		struct textfile_entry *next = entry->next;
+
+		free(entry->value);
+		free(entry);
+
+		entry = next;
+	}
+
+	file->head = NULL;
+	file->tail = NULL;
+}
+
+static void free_changes(struct textfile *file)
+{
+	struct textfile_change *change = file->changes;
+
+	while (change) {
+		struct textfile_change *next = change->next;
+
+		free(change->value);
+		free(change);
+
+		change = next;
+	}
+
+	file->changes = NULL;
+	file->changes_tail = &file->changes;
+}
+
+void textfile_close(struct textfile *file)
+{
+	if (!file)
+		return;
+
+	free_entries(file);
+	free_changes(file);
+
+	free(file->buckets);
+	free(file->pathname);
+	free(file);
+}
+
+const char *textfile_lookup(struct textfile *file, const char *key)
+{
+	struct textfile_entry *entry;
+	size_t len;
+
+	if (!file || !key)
+		return NULL;
+
+	len = strlen(key);
+
+	entry = lookup_entry(file, key, len, hash_key(key, len));
+	if (!entry)
+		return NULL;
+
+	return entry->value;
+}
+
+static void remove_entry(struct textfile *file, struct textfile_entry *entry)
+{
+	struct textfile_entry **ptr, *dup;
+	unsigned int i = entry->hash & (file->num_buckets - 1);
+
+	for (ptr = &file->buckets[i]; *ptr != entry; ptr = &(*ptr)->hash_next);
+
+	*ptr = entry->hash_next;
+	file->num_entries--;
+
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		file->head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		file->tail = entry->prev;
+
+	/* A later duplicate of the same key now becomes the visible one */
+	for (dup = entry->next; dup; dup = dup->next) {
+		if (dup->value && dup->hash == entry->hash &&
+					!strcmp(dup->key, entry->key)) {
+			dup->hash_next = file->buckets[i];
+			file->buckets[i] = dup;
+			file->num_entries++;
+			break;
+		}
+	}
+
+	free(entry->value);
+	free(entry);
+}
+
+static int update_entry(struct textfile *file, const char *key,
+							const char *value)
+{
+	struct textfile_entry *entry;
+	size_t len = strlen(key);
+	char *str;
+
+	entry = lookup_entry(file, key, len, hash_key(key, len));
+	if (!entry) {
+		if (value && !add_entry(file, key, len, value, strlen(value)))
+			return -ENOMEM;
+
+		return 0;
+	}
+
+	if (!value) {
+		remove_entry(file, entry);
+		return 0;
+	}
+
+	if (!strcmp(entry->value, value))
+		return 0;
+
+	str = strdup(value);
+	if (!str)
+		return -ENOMEM;
+
+	free(entry->value);
+	entry->value = str;
+
+	return 0;
+}
+
+int textfile_set(struct textfile *file, const char *key, const char *value)
+{
+	struct textfile_change *change;
+	size_t len;
+	int err;
+
+	if (!file || !key || !*key || strpbrk(key, " \r\n"))
+		return -EINVAL;
+
+	if (value && strpbrk(value, "\r\n"))
+		return -EINVAL;
+
+	len = strlen(key);
+
+	change = malloc(sizeof(*change) + len + 1);
+	if (!change)
+		return -ENOMEM;
+
+	memcpy(change->key, key, len + 1);
+	change->next = NULL;
+	change->value = NULL;
+
+	if (value) {
+		change->value = strdup(value);
+		if (!change->value) {
+			free(change);
+			return -ENOMEM;
+		}
+	}
+
+	err = update_entry(file, key, value);
+	if (err < 0) {
+		free(change->value);
+		free(change);
+		return err;
+	}
+
+	/* Kept to be replayed on top of the file as it is at commit time */
+	*file->changes_tail = change;
+	file->changes_tail = &change->next;
+
+	return 0;
+}
+
+static char *build_file(struct textfile *file, size_t *size)
+{
+	struct textfile_entry *entry;
+	char *buf, *ptr;
+
+	*size = 0;
+
+	for (entry = file->head; entry; entry = entry->next) {
+		*size += strlen(entry->key) + 1;
+		if (entry->value)
+			*size += strlen(entry->value) + 1;
+	}
+
+	buf = malloc(*size + 1);
+	if (!buf)
+		return NULL;
+
+	ptr = buf;
+
+	for (entry = file->head; entry; entry = entry->next) {
+		if (entry->value)
+			ptr += sprintf(ptr, "%s %s\n", entry->key, entry->value);
+		else
+			ptr += sprintf(ptr, "%s\n", entry->key);
+	}
+
+	return buf;
+}
+
+static void swap_entries(struct textfile *a, struct textfile *b)
+{
+	struct textfile tmp = *a;
+
+	a->head = b->head;
+	a->tail = b->tail;
+	a->buckets = b->buckets;
+	a->num_buckets = b->num_buckets;
+	a->num_entries = b->num_entries;
+
+	b->head = tmp.head;
+	b->tail = tmp.tail;
+	b->buckets = tmp.buckets;
+	b->num_buckets = tmp.num_buckets;
+	b->num_entries = tmp.num_entries;
+}
+
+int textfile_commit(struct textfile *file)
+{
+	struct textfile *current;
+	struct textfile_change *change;
+	char *buf, *ptr;
+	size_t size;
+	int fd, err = 0;
+
+	if (!file)
+		return -EINVAL;
+
+	if (!file->changes)
+		return 0;
+
+	/* The file is rewritten in place under its own lock, just like
+	 * textfile_put() does, so both always work on the same inode. It is
+	 * read again under that lock and the staged changes are replayed on
+	 * top, which keeps whatever was written since textfile_open().
+	 */
+	fd = open(file->pathname, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (flock(fd, LOCK_EX) < 0) {
+		err = -errno;
+		goto close;
+	}
+
+	current = textfile_new(file->pathname);
+	if (!current) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	err = load_file(current, fd);
+	if (err < 0)
+		goto failed;
+
+	for (change = file->changes; change; change = change->next) {
+		err = update_entry(current, change->key, change->value);
+		if (err < 0)
+			goto failed;
+	}
+
+	buf = build_file(current, &size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto failed;
+	}
+
+	if (ftruncate(fd, 0) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+		err = -errno;
+		goto done;
+	}
+
+	for (ptr = buf; ptr < buf + size; ) {
+		ssize_t ret;
+
+		ret = write(fd, ptr, buf + size - ptr);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			goto done;
+		}
+
+		ptr += ret;
+	}
+
+	if (fdatasync(fd) < 0) {
+		err = -errno;
+		goto done;
+	}
+
+	/* From here on the handle shows the file as it was written */
+	swap_entries(file, current);
+	free_changes(file);
+
+done:
+	free(buf);
+
+failed:
+	textfile_close(current);
+
+unlock:
+	flock(fd, LOCK_UN);
+
+close:
+	close(fd);
+	errno = -err;
+
+	return err;
+}
+
+int textfile_iterate(struct textfile *file, textfile_cb func, void *data)
+{
+	struct textfile_entry *entry;
+
+	if (!file || !func)
+		return -EINVAL;
+
+	for (entry = file->head; entry; entry = entry->next) {
+		if (entry->value)
+			func(entry->key, entry->value, data);
+	}
+
+	return 0;
+}
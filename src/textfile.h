@@ -32,3 +32,13 @@ char *textfile_get(const char *pathname, const char *key);
 typedef void (*textfile_cb) (char *key, char *value, void *data);
 
 int textfile_foreach(const char *pathname, textfile_cb func, void *data);
+
+struct textfile;
+
+struct textfile *textfile_open(const char *pathname);
+void textfile_close(struct textfile *file);
+
+const char *textfile_lookup(struct textfile *file, const char *key);
+int textfile_set(struct textfile *file, const char *key, const char *value);
+int textfile_commit(struct textfile *file);
+int textfile_iterate(struct textfile *file, textfile_cb func, void *data);
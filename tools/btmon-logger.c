@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <inttypes.h>
 #include <string.h>
 #include <time.h>
 #include <getopt.h>
@@ -49,71 +50,62 @@
 #include "src/shared/mainloop.h"
 #include "src/shared/btsnoop.h"
 
-#define MONITOR_INDEX_NONE 0xffff
+#include "monitor/batch.h"
 
-struct monitor_hdr {
-	uint16_t opcode;
-	uint16_t index;
-	uint16_t len;
-} __attribute__ ((packed));
+#define MONITOR_INDEX_NONE 0xffff
 
 static struct btsnoop *btsnoop_file = NULL;
 
+static struct batch *data_batch;
+
+static struct {
+	uint64_t packets;
+	uint64_t batches;
+	unsigned int max_batch;
+	uint64_t drops;
+} stats;
+
 static void data_callback(int fd, uint32_t events, void *user_data)
 {
-	uint8_t buf[BTSNOOP_MAX_PACKET_SIZE];
-	unsigned char control[64];
-	struct monitor_hdr hdr;
-	struct msghdr msg;
-	struct iovec iov[2];
+	struct batch_packet pkt;
+	int i, count;
 
 	if (events & (EPOLLERR | EPOLLHUP)) {
 		mainloop_exit_failure();
 		return;
 	}
 
-	iov[0].iov_base = &hdr;
-	iov[0].iov_len = sizeof(hdr);
-	iov[1].iov_base = buf;
-	iov[1].iov_len = sizeof(buf);
-
-	memset(&msg, 0, sizeof(msg));
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 2;
-	msg.msg_control = control;
-	msg.msg_controllen = sizeof(control);
-
 	while (1) {
-		struct cmsghdr *cmsg;
-		struct timeval *tv = NULL;
-		struct timeval ctv;
-		uint16_t opcode, index, pktlen;
-		ssize_t len;
-
-		len = recvmsg(fd, &msg, MSG_DONTWAIT);
-		if (len < 0)
-			break;
+		count = batch_read(data_batch, fd);
+		if (count < 0) {
+			fprintf(stderr, "Failed to read monitor channel: %s\n",
+							strerror(-count));
+			mainloop_remove_fd(fd);
+			mainloop_exit_failure();
+			return;
+		}
 
-		if (len < (ssize_t) sizeof(hdr))
+		if (!count)
 			break;
 
-		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
-					cmsg = CMSG_NXTHDR(&msg, cmsg)) {
-			if (cmsg->cmsg_level != SOL_SOCKET)
+		stats.batches++;
+		stats.packets += count;
+		if ((unsigned int) count > stats.max_batch)
+			stats.max_batch = count;
+
+		for (i = 0; i < count; i++) {
+			if (!batch_get(data_batch, i, &pkt))
 				continue;
 
-			if (cmsg->cmsg_type == SCM_TIMESTAMP) {
-				memcpy(&ctv, CMSG_DATA(cmsg), sizeof(ctv));
-				tv = &ctv;
-			}
-		}
+			stats.drops += pkt.drops;
 
-		opcode = le16_to_cpu(hdr.opcode);
-		index  = le16_to_cpu(hdr.index);
-		pktlen = le16_to_cpu(hdr.len);
+			btsnoop_write_hci(btsnoop_file, pkt.tv, pkt.index,
+						pkt.opcode, pkt.drops,
+						pkt.data, pkt.len);
+		}
 
-		btsnoop_write_hci(btsnoop_file, tv, index, opcode, 0, buf,
-									pktlen);
+		if (count < BATCH_SIZE)
+			break;
 	}
 }
 
@@ -151,6 +143,15 @@ static bool open_monitor_channel(void)
 		return false;
 	}
 
+	/* Kernel drop counter is optional */
+	setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt));
+
+	data_batch = batch_new();
+	if (!data_batch) {
+		close(fd);
+		return false;
+	}
+
 	mainloop_add_fd(fd, EPOLLIN, data_callback, NULL, NULL);
 
 	return true;
@@ -374,6 +375,12 @@ int main(int argc, char *argv[])
 
 	mainloop_sd_notify("STATUS=Quitting");
 
+	printf("Received %" PRIu64 " packets in %" PRIu64 " reads "
+			"(max %u per read), %" PRIu64 " dropped\n",
+			stats.packets, stats.batches, stats.max_batch,
+			stats.drops);
+
+	batch_free(data_batch);
 	btsnoop_unref(btsnoop_file);
 
 	return exit_status;
@@ -0,0 +1,343 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "src/shared/mainloop.h"
+#include "src/shared/io.h"
+
+#define MAX_PDU_SIZE 2048
+
+struct bench {
+	struct io *client;
+	struct io *server;
+	bool ping;
+	unsigned int sent;
+	unsigned int received;
+	unsigned int echoed;
+	bool failed;
+};
+
+static unsigned int num_pdus = 100000;
+static unsigned int pdu_size = 32;
+
+static uint64_t get_usec(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void bench_done(struct bench *b, bool failed)
+{
+	b->failed = failed;
+
+	io_destroy(b->client);
+	io_destroy(b->server);
+	b->client = NULL;
+	b->server = NULL;
+
+	mainloop_quit();
+}
+
+static bool bench_send(struct bench *b, struct io *io)
+{
+	uint8_t pdu[MAX_PDU_SIZE];
+	struct iovec iov;
+	ssize_t ret;
+
+	memset(pdu, b->sent & 0xff, pdu_size);
+
+	iov.iov_base = pdu;
+	iov.iov_len = pdu_size;
+
+	ret = io_send(io, &iov, 1);
+	if (ret == -EAGAIN)
+		return false;
+
+	if (ret != (ssize_t) pdu_size) {
+		fprintf(stderr, "Failed to send PDU: %s\n",
+					strerror(ret < 0 ? -ret : EIO));
+		bench_done(b, true);
+		return false;
+	}
+
+	return true;
+}
+
+static bool client_write(struct io *io, void *user_data)
+{
+	struct bench *b = user_data;
+
+	if (b->sent == num_pdus)
+		return false;
+
+	if (bench_send(b, io))
+		b->sent++;
+
+	return b->client && b->sent < num_pdus;
+}
+
+static bool client_read(struct io *io, void *user_data)
+{
+	struct bench *b = user_data;
+	uint8_t pdu[MAX_PDU_SIZE];
+	ssize_t len;
+
+	len = io_recv(io, pdu, sizeof(pdu));
+	if (len < 0)
+		return len == -EAGAIN;
+
+	if (++b->echoed == num_pdus) {
+		bench_done(b, false);
+		return false;
+	}
+
+	if (bench_send(b, io))
+		b->sent++;
+
+	return true;
+}
+
+static bool server_read(struct io *io, void *user_data)
+{
+	struct bench *b = user_data;
+	uint8_t pdu[MAX_PDU_SIZE];
+	struct iovec iov;
+	ssize_t len;
+
+	len = io_recv(io, pdu, sizeof(pdu));
+	if (len < 0)
+		return len == -EAGAIN;
+
+	if (len != pdu_size || pdu[0] != (b->received & 0xff)) {
+		fprintf(stderr, "Unexpected PDU %u\n", b->received);
+		bench_done(b, true);
+		return false;
+	}
+
+	b->received++;
+
+	if (!b->ping) {
+		if (b->received == num_pdus) {
+			bench_done(b, false);
+			return false;
+		}
+
+		return true;
+	}
+
+	iov.iov_base = pdu;
+	iov.iov_len = len;
+
+	if (io_send(io, &iov, 1) != len) {
+		fprintf(stderr, "Failed to echo PDU\n");
+		bench_done(b, true);
+		return false;
+	}
+
+	return true;
+}
+
+static bool bench_disconnect(struct io *io, void *user_data)
+{
+	struct bench *b = user_data;
+
+	fprintf(stderr, "Unexpected disconnect\n");
+	bench_done(b, true);
+
+	return false;
+}
+
+static int bench_run(bool uring, bool ping)
+{
+	struct bench b;
+	uint64_t start, cpu;
+	double secs;
+	int sv[2];
+
+	memset(&b, 0, sizeof(b));
+	b.ping = ping;
+
+	mainloop_init();
+
+	if (!io_set_uring(uring)) {
+		printf("%-8s %-6s not supported\n", "io_uring",
+						ping ? "ping" : "flood");
+		mainloop_quit();
+		mainloop_run();
+		return 0;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC,
+								0, sv) < 0) {
+		perror("Failed to create socket pair");
+		return -errno;
+	}
+
+	b.client = io_new(sv[0]);
+	b.server = io_new(sv[1]);
+	io_set_close_on_destroy(b.client, true);
+	io_set_close_on_destroy(b.server, true);
+
+	io_set_disconnect_handler(b.client, bench_disconnect, &b, NULL);
+	io_set_disconnect_handler(b.server, bench_disconnect, &b, NULL);
+	io_set_read_handler(b.server, server_read, &b, NULL);
+
+	if (ping) {
+		io_set_read_handler(b.client, client_read, &b, NULL);
+		if (bench_send(&b, b.client))
+			b.sent++;
+	} else
+		io_set_write_handler(b.client, client_write, &b, NULL);
+
+	start = get_usec(CLOCK_MONOTONIC);
+	cpu = get_usec(CLOCK_PROCESS_CPUTIME_ID);
+
+	mainloop_run();
+
+	cpu = get_usec(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	secs = (get_usec(CLOCK_MONOTONIC) - start) / 1000000.0;
+
+	if (b.failed)
+		return -EIO;
+
+	printf("%-8s %-6s %8u PDUs of %4u bytes: %10.0f PDU/s, "
+				"%6.2f us CPU/PDU\n",
+				uring ? "io_uring" : "epoll",
+				ping ? "ping" : "flood", num_pdus, pdu_size,
+				num_pdus / secs, (double) cpu / num_pdus);
+
+	return 0;
+}
+
+static void usage(void)
+{
+	printf("io-bench - Mainloop io backend benchmark\n"
+		"Usage:\n");
+	printf("\tio-bench [options]\n");
+	printf("options:\n"
+		"\t-n, --count <num>      Number of PDUs\n"
+		"\t-s, --size <bytes>     PDU size\n"
+		"\t-e, --epoll            Only run with epoll\n"
+		"\t-u, --uring            Only run with io_uring\n"
+		"\t-p, --ping             Only run request/response\n"
+		"\t-f, --flood            Only run one way flood\n"
+		"\t-h, --help             Show help options\n");
+}
+
+static const struct option main_options[] = {
+	{ "count",   required_argument, NULL, 'n' },
+	{ "size",    required_argument, NULL, 's' },
+	{ "epoll",   no_argument,       NULL, 'e' },
+	{ "uring",   no_argument,       NULL, 'u' },
+	{ "ping",    no_argument,       NULL, 'p' },
+	{ "flood",   no_argument,       NULL, 'f' },
+	{ "version", no_argument,       NULL, 'v' },
+	{ "help",    no_argument,       NULL, 'h' },
+	{ }
+};
+
+int main(int argc, char *argv[])
+{
+	bool backends[2] = { true, true };
+	bool patterns[2] = { true, true };
+	unsigned int i, j;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "n:s:eupfvh", main_options, NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'n':
+			num_pdus = atoi(optarg);
+			break;
+		case 's':
+			pdu_size = atoi(optarg);
+			break;
+		case 'e':
+			backends[1] = false;
+			break;
+		case 'u':
+			backends[0] = false;
+			break;
+		case 'p':
+			patterns[1] = false;
+			break;
+		case 'f':
+			patterns[0] = false;
+			break;
+		case 'v':
+			printf("%s\n", VERSION);
+			return EXIT_SUCCESS;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind > 0) {
+		fprintf(stderr, "Invalid command line parameters\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!num_pdus || !pdu_size || pdu_size > MAX_PDU_SIZE) {
+		fprintf(stderr, "Invalid PDU count or size\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!patterns[i])
+			continue;
+
+		for (j = 0; j < 2; j++) {
+			if (!backends[j])
+				continue;
+
+			if (bench_run(j, !i) < 0)
+				return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,388 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "src/shared/shm-ring.h"
+
+#define MAX_VALUE_SIZE 512
+#define MAX_BATCH 64
+
+static unsigned int num_values = 1000000;
+static unsigned int value_size = 20;
+static unsigned int batch = 8;
+static unsigned int ring_size = 65536;
+
+static uint64_t get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t get_cpu_usec(int who)
+{
+	struct rusage ru;
+
+	getrusage(who, &ru);
+
+	return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+				ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/*
+ * Values are produced in batches, the way bt_gatt_client hands over the
+ * notifications it found in a single read of the ATT socket.
+ */
+static void fill_batch(struct iovec *iov, uint8_t *buf, unsigned int count,
+							unsigned int seq)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = buf + i * value_size;
+		iov[i].iov_len = value_size;
+		memset(iov[i].iov_base, (seq + i) & 0xff, value_size);
+	}
+}
+
+static unsigned int batch_len(unsigned int sent)
+{
+	return num_values - sent < batch ? num_values - sent : batch;
+}
+
+static int sock_consume(int fd)
+{
+	uint8_t buf[MAX_VALUE_SIZE];
+	unsigned int received = 0;
+	ssize_t len;
+
+	while (received < num_values) {
+		len = recv(fd, buf, sizeof(buf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return EXIT_FAILURE;
+		}
+
+		if (len != value_size || buf[0] != (received & 0xff))
+			return EXIT_FAILURE;
+
+		received++;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static bool sock_produce(int fd, unsigned int *stalls)
+{
+	struct mmsghdr msgs[MAX_BATCH];
+	struct iovec iov[MAX_BATCH];
+	uint8_t buf[MAX_BATCH * MAX_VALUE_SIZE];
+	unsigned int sent = 0, i;
+	int ret;
+
+	while (sent < num_values) {
+		unsigned int count = batch_len(sent);
+
+		fill_batch(iov, buf, count, sent);
+
+		memset(msgs, 0, sizeof(msgs));
+
+		for (i = 0; i < count; i++) {
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		for (i = 0; i < count; i += ret) {
+			ret = sendmmsg(fd, msgs + i, count - i, MSG_NOSIGNAL);
+			if (ret < 0) {
+				if (errno != EAGAIN && errno != EINTR)
+					return false;
+
+				/* Socket buffer full, wait for the reader */
+				(*stalls)++;
+				poll(&(struct pollfd) { fd, POLLOUT, 0 }, 1, -1);
+				ret = 0;
+			}
+		}
+
+		sent += count;
+	}
+
+	return true;
+}
+
+static int ring_consume(struct shm_ring *ring)
+{
+	uint8_t buf[MAX_VALUE_SIZE];
+	struct pollfd pfd;
+	unsigned int received = 0;
+	int len;
+
+	pfd.fd = shm_ring_get_event_fd(ring);
+	pfd.events = POLLIN;
+
+	while (received < num_values) {
+		len = shm_ring_pop(ring, buf, sizeof(buf));
+		if (len == -EAGAIN) {
+			if (!shm_ring_prepare_wait(ring))
+				continue;
+
+			poll(&pfd, 1, -1);
+			shm_ring_ack(ring);
+			continue;
+		}
+
+		if (len != (int) value_size || buf[0] != (received & 0xff))
+			return EXIT_FAILURE;
+
+		received++;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static bool ring_produce(struct shm_ring *ring, unsigned int *stalls)
+{
+	struct iovec iov[MAX_BATCH];
+	uint8_t buf[MAX_BATCH * MAX_VALUE_SIZE];
+	unsigned int sent = 0, i;
+
+	while (sent < num_values) {
+		unsigned int count = batch_len(sent);
+
+		fill_batch(iov, buf, count, sent);
+
+		/*
+		 * bluetoothd drops what doesn't fit, the benchmark retries
+		 * instead so both sides see every value.
+		 */
+		for (i = 0; i < count;) {
+			i += shm_ring_pushv(ring, iov + i, count - i);
+			shm_ring_kick(ring);
+
+			if (i < count) {
+				(*stalls)++;
+				sched_yield();
+			}
+		}
+
+		sent += count;
+	}
+
+	return true;
+}
+
+static int bench_run(bool use_ring)
+{
+	struct shm_ring *ring = NULL;
+	struct shm_ring_stats stats;
+	uint64_t start, cpu, elapsed;
+	unsigned int stalls = 0;
+	int sv[2], status;
+	bool result;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		perror("Failed to create socket pair");
+		return EXIT_FAILURE;
+	}
+
+	if (use_ring) {
+		ring = shm_ring_new(ring_size);
+		if (!ring) {
+			perror("Failed to create ring");
+			close(sv[0]);
+			close(sv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	start = get_usec();
+	cpu = get_cpu_usec(RUSAGE_SELF) + get_cpu_usec(RUSAGE_CHILDREN);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("Failed to fork");
+		shm_ring_free(ring);
+		close(sv[0]);
+		close(sv[1]);
+		return EXIT_FAILURE;
+	}
+
+	if (!pid) {
+		close(sv[0]);
+
+		if (!use_ring)
+			_exit(sock_consume(sv[1]));
+
+		ring = shm_ring_attach(dup(shm_ring_get_mem_fd(ring)),
+					dup(shm_ring_get_event_fd(ring)));
+		if (!ring)
+			_exit(EXIT_FAILURE);
+
+		_exit(ring_consume(ring));
+	}
+
+	close(sv[1]);
+
+	/* Like bluetoothd, never block on a slow reader */
+	fcntl(sv[0], F_SETFL, O_NONBLOCK);
+
+	if (use_ring)
+		result = ring_produce(ring, &stalls);
+	else
+		result = sock_produce(sv[0], &stalls);
+
+	if (!result)
+		kill(pid, SIGTERM);
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+					WEXITSTATUS(status) != EXIT_SUCCESS)
+		result = false;
+
+	elapsed = get_usec() - start;
+	cpu = get_cpu_usec(RUSAGE_SELF) + get_cpu_usec(RUSAGE_CHILDREN) - cpu;
+
+	close(sv[0]);
+
+	if (!result) {
+		fprintf(stderr, "%s benchmark failed\n",
+						use_ring ? "ring" : "socket");
+		shm_ring_free(ring);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-8s %8u values in %8llu us: %10.0f values/s "
+					"%6.1f us CPU/1000 values, %u stalls",
+				use_ring ? "ring" : "socket", num_values,
+				(unsigned long long) elapsed,
+				num_values * 1000000.0 / elapsed,
+				cpu * 1000.0 / num_values, stalls);
+
+	if (ring) {
+		shm_ring_get_stats(ring, &stats);
+		printf(", %u doorbells", stats.doorbells);
+		shm_ring_free(ring);
+	}
+
+	printf("\n");
+
+	return EXIT_SUCCESS;
+}
+
+static void usage(void)
+{
+	printf("notify-bench - Acquired notification transport benchmark\n"
+		"Usage:\n");
+	printf("\tnotify-bench [options]\n");
+	printf("options:\n"
+		"\t-n, --count <num>      Number of values\n"
+		"\t-s, --size <bytes>     Value size\n"
+		"\t-b, --batch <num>      Values per batch\n"
+		"\t-r, --ring <bytes>     Ring size\n"
+		"\t-h, --help             Show help options\n");
+}
+
+static const struct option main_options[] = {
+	{ "count",   required_argument, NULL, 'n' },
+	{ "size",    required_argument, NULL, 's' },
+	{ "batch",   required_argument, NULL, 'b' },
+	{ "ring",    required_argument, NULL, 'r' },
+	{ "version", no_argument,       NULL, 'v' },
+	{ "help",    no_argument,       NULL, 'h' },
+	{ }
+};
+
+int main(int argc, char *argv[])
+{
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "n:s:b:r:vh", main_options, NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'n':
+			num_values = atoi(optarg);
+			break;
+		case 's':
+			value_size = atoi(optarg);
+			break;
+		case 'b':
+			batch = atoi(optarg);
+			break;
+		case 'r':
+			ring_size = atoi(optarg);
+			break;
+		case 'v':
+			printf("%s\n", VERSION);
+			return EXIT_SUCCESS;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind > 0) {
+		fprintf(stderr, "Invalid command line parameters\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!num_values || !value_size || value_size > MAX_VALUE_SIZE ||
+					!batch || batch > MAX_BATCH) {
+		fprintf(stderr, "Invalid count, size or batch\n");
+		return EXIT_FAILURE;
+	}
+
+	if (bench_run(false) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	return bench_run(true);
+}
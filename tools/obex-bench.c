@@ -0,0 +1,298 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "gobex/gobex.h"
+
+static GMainLoop *main_loop = NULL;
+
+static gboolean option_packet = FALSE;
+static gboolean option_get = FALSE;
+static int option_mtu = 0;
+static int option_depth = 0;
+static int option_size = 32;
+
+static const int default_mtus[] = { 4096, 8192, 16384, 32767, 65535 };
+
+struct bench {
+	GObex *client;
+	GObex *server;
+	gsize size;
+	gsize sent;
+	gsize received;
+	guint packets;
+	gint64 start;
+	GError *err;
+};
+
+static GOptionEntry options[] = {
+	{ "packet", 'p', 0, G_OPTION_ARG_NONE,
+			&option_packet, "Packet based transport (SRM)" },
+	{ "stream", 's', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE,
+			&option_packet, "Stream based transport" },
+	{ "get", 'g', 0, G_OPTION_ARG_NONE,
+			&option_get, "Benchmark GET instead of PUT" },
+	{ "mtu", 'm', 0, G_OPTION_ARG_INT,
+			&option_mtu, "Transport MTU (default: sweep)", "MTU" },
+	{ "depth", 'd', 0, G_OPTION_ARG_INT,
+			&option_depth, "SRM pipelining depth", "PACKETS" },
+	{ "size", 'S', 0, G_OPTION_ARG_INT,
+			&option_size, "Object size in MiB", "SIZE" },
+	{ NULL },
+};
+
+static gssize provide_data(void *buf, gsize len, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (b->sent >= b->size)
+		return 0;
+
+	len = MIN(len, b->size - b->sent);
+	memset(buf, b->sent & 0xff, len);
+	b->sent += len;
+
+	return len;
+}
+
+static gboolean consume_data(const void *buf, gsize len, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	b->received += len;
+	b->packets++;
+
+	return TRUE;
+}
+
+static void server_complete(GObex *obex, GError *err, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (err != NULL && b->err == NULL)
+		b->err = g_error_copy(err);
+}
+
+static void client_complete(GObex *obex, GError *err, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (err != NULL && b->err == NULL)
+		b->err = g_error_copy(err);
+
+	g_main_loop_quit(main_loop);
+}
+
+static void handle_connect(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	g_obex_send_rsp(obex, G_OBEX_RSP_SUCCESS, &b->err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void handle_put(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	g_obex_put_rsp(obex, req, consume_data, server_complete, b, &b->err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void handle_get(GObex *obex, GObexPacket *req, gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	g_obex_get_rsp(obex, provide_data, server_complete, b, &b->err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void conn_complete(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct bench *b = user_data;
+
+	if (err != NULL) {
+		b->err = g_error_copy(err);
+		g_main_loop_quit(main_loop);
+		return;
+	}
+
+	b->start = g_get_monotonic_time();
+
+	if (option_get)
+		g_obex_get_req(obex, consume_data, client_complete, b, &b->err,
+					G_OBEX_HDR_NAME, "bench.bin",
+					G_OBEX_HDR_INVALID);
+	else
+		g_obex_put_req(obex, provide_data, client_complete, b, &b->err,
+					G_OBEX_HDR_NAME, "bench.bin",
+					G_OBEX_HDR_INVALID);
+
+	if (b->err != NULL)
+		g_main_loop_quit(main_loop);
+}
+
+static GObex *bench_obex(int fd, GObexTransportType type, int mtu)
+{
+	GIOChannel *io;
+	GObex *obex;
+
+	io = g_io_channel_unix_new(fd);
+	g_io_channel_set_close_on_unref(io, TRUE);
+
+	obex = g_obex_new(io, type, mtu, type == G_OBEX_TRANSPORT_PACKET ?
+								mtu : -1);
+	g_io_channel_unref(io);
+
+	if (obex != NULL && option_depth > 0)
+		g_obex_set_srm_depth(obex, option_depth);
+
+	return obex;
+}
+
+static int bench_run(int mtu)
+{
+	GObexTransportType type;
+	struct bench b;
+	int sock_type, sv[2];
+	gdouble secs;
+
+	memset(&b, 0, sizeof(b));
+	b.size = (gsize) option_size * 1024 * 1024;
+
+	if (option_packet) {
+		type = G_OBEX_TRANSPORT_PACKET;
+		sock_type = SOCK_SEQPACKET;
+	} else {
+		type = G_OBEX_TRANSPORT_STREAM;
+		sock_type = SOCK_STREAM;
+	}
+
+	if (socketpair(AF_UNIX, sock_type | SOCK_NONBLOCK, 0, sv) < 0) {
+		g_printerr("socketpair: %s\n", strerror(errno));
+		return -errno;
+	}
+
+	b.client = bench_obex(sv[0], type, mtu);
+	b.server = bench_obex(sv[1], type, mtu);
+	if (b.client == NULL || b.server == NULL) {
+		g_printerr("Invalid MTU %d\n", mtu);
+		goto failed;
+	}
+
+	g_obex_add_request_function(b.server, G_OBEX_OP_CONNECT,
+							handle_connect, &b);
+	g_obex_add_request_function(b.server, G_OBEX_OP_PUT,
+							handle_put, &b);
+	g_obex_add_request_function(b.server, G_OBEX_OP_GET,
+							handle_get, &b);
+
+	g_obex_connect(b.client, conn_complete, &b, &b.err,
+					G_OBEX_HDR_INVALID);
+	if (b.err == NULL)
+		g_main_loop_run(main_loop);
+
+	if (b.err != NULL) {
+		g_printerr("%s failed: %s\n", option_get ? "GET" : "PUT",
+							b.err->message);
+		g_error_free(b.err);
+		goto failed;
+	}
+
+	secs = (g_get_monotonic_time() - b.start) / 1000000.0;
+
+	printf("%s %s mtu %5u/%5u: %8.2f MB/s, %6u packets, %.3f s\n",
+				option_get ? "GET" : "PUT",
+				option_packet ? "packet" : "stream",
+				g_obex_get_tx_mtu(b.client),
+				g_obex_get_rx_mtu(b.client),
+				b.received / secs / 1000000.0,
+				b.packets, secs);
+
+	g_obex_unref(b.client);
+	g_obex_unref(b.server);
+
+	return 0;
+
+failed:
+	/* The channels close the sockets even if g_obex_new failed */
+	if (b.client)
+		g_obex_unref(b.client);
+
+	if (b.server)
+		g_obex_unref(b.server);
+
+	return -EIO;
+}
+
+int main(int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *err = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	context = g_option_context_new(NULL);
+	g_option_context_add_main_entries(context, options, NULL);
+
+	g_option_context_parse(context, &argc, &argv, &err);
+	if (err != NULL) {
+		g_printerr("%s\n", err->message);
+		g_error_free(err);
+		g_option_context_free(context);
+		exit(EXIT_FAILURE);
+	}
+
+	g_option_context_free(context);
+
+	if (option_size <= 0) {
+		g_printerr("Invalid size %d\n", option_size);
+		exit(EXIT_FAILURE);
+	}
+
+	main_loop = g_main_loop_new(NULL, FALSE);
+
+	if (option_mtu > 0)
+		ret = bench_run(option_mtu);
+	else {
+		for (i = 0; i < G_N_ELEMENTS(default_mtus) && !ret; i++)
+			ret = bench_run(default_mtus[i]);
+	}
+
+	g_main_loop_unref(main_loop);
+
+	if (ret < 0)
+		exit(EXIT_FAILURE);
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,555 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "lib/bluetooth.h"
+#include "lib/sdp.h"
+#include "lib/sdp_lib.h"
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/ecc.h"
+#include "src/sdpd.h"
+#include "src/textfile.h"
+
+static unsigned int scale = 1;
+
+static uint64_t get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_rate(const char *name, unsigned int ops, uint64_t start)
+{
+	uint64_t elapsed = get_usec() - start;
+
+	printf("%-24s %9u ops in %9llu us: %10.1f ns/op\n", name, ops,
+					(unsigned long long) elapsed,
+					elapsed * 1000.0 / (ops ? ops : 1));
+}
+
+static void sdp_add_record(uint16_t svclass)
+{
+	sdp_list_t *svclass_id, *root;
+	uuid_t root_uuid, svclass_uuid;
+	sdp_record_t *record = sdp_record_alloc();
+	sdp_data_t *data;
+
+	record->handle = sdp_next_handle();
+
+	sdp_record_add(BDADDR_ANY, record);
+	data = sdp_data_alloc(SDP_UINT32, &record->handle);
+	sdp_attr_add(record, SDP_ATTR_RECORD_HANDLE, data);
+
+	sdp_uuid16_create(&root_uuid, PUBLIC_BROWSE_GROUP);
+	root = sdp_list_append(NULL, &root_uuid);
+	sdp_set_browse_groups(record, root);
+	sdp_list_free(root, NULL);
+
+	sdp_uuid16_create(&svclass_uuid, svclass);
+	svclass_id = sdp_list_append(NULL, &svclass_uuid);
+	sdp_set_service_classes(record, svclass_id);
+	sdp_list_free(svclass_id, NULL);
+
+	sdp_set_info_attr(record, "Benchmark", NULL, NULL);
+}
+
+static bool sdp_search(const char *name, uint16_t uuid,
+						unsigned int iterations)
+{
+	uint8_t req[] = { SDP_SVC_SEARCH_ATTR_REQ, 0x00, 0x00, 0x00, 0x0f,
+				0x35, 0x03, 0x19, uuid >> 8, uuid & 0xff,
+				0xff, 0xff,
+				0x35, 0x05, 0x0a, 0x00, 0x00, 0xff, 0xff,
+				0x00 };
+	uint8_t *rsp, *pdu;
+	uint64_t start;
+	unsigned int i;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		perror("Failed to create socket pair");
+		return false;
+	}
+
+	rsp = malloc(USHRT_MAX);
+	if (!rsp) {
+		close(sv[0]);
+		close(sv[1]);
+		return false;
+	}
+
+	start = get_usec();
+
+	for (i = 0; i < iterations; i++) {
+		ssize_t len;
+
+		put_be16(i, req + 1);
+
+		/* The request buffer is consumed by the server */
+		pdu = malloc(sizeof(req));
+		if (!pdu)
+			break;
+
+		memcpy(pdu, req, sizeof(req));
+		handle_internal_request(sv[0], USHRT_MAX, pdu, sizeof(req));
+
+		len = recv(sv[1], rsp, USHRT_MAX, 0);
+		if (len <= (ssize_t) sizeof(sdp_pdu_hdr_t) ||
+					rsp[0] != SDP_SVC_SEARCH_ATTR_RSP) {
+			fprintf(stderr, "Invalid response\n");
+			break;
+		}
+	}
+
+	print_rate(name, i, start);
+
+	free(rsp);
+	close(sv[0]);
+	close(sv[1]);
+
+	return i == iterations;
+}
+
+/*
+ * Service Search Attribute Request throughput against a database of
+ * several hundred records, for a UUID matching a single record and for
+ * one matching most of them.
+ */
+static bool bench_sdp(void)
+{
+	unsigned int i;
+	bool result;
+
+	register_public_browse_group();
+	register_server_service();
+
+	for (i = 0; i < 100; i++) {
+		sdp_add_record(SERIAL_PORT_SVCLASS_ID);
+		sdp_add_record(OBEX_OBJPUSH_SVCLASS_ID);
+		sdp_add_record(OBEX_FILETRANS_SVCLASS_ID);
+	}
+
+	sdp_add_record(HID_SVCLASS_ID);
+
+	result = sdp_search("sdp/search/single", HID_SVCLASS_ID,
+							10000 * scale) &&
+			sdp_search("sdp/search/browse", PUBLIC_BROWSE_GROUP,
+							200 * scale);
+
+	sdp_svcdb_reset();
+
+	return result;
+}
+
+static bool match_uint(const void *a, const void *b)
+{
+	return PTR_TO_UINT(a) == PTR_TO_UINT(b);
+}
+
+static bool queue_fifo(const char *name, unsigned int depth,
+						unsigned int iterations)
+{
+	struct queue *queue;
+	unsigned int n, i;
+	uint64_t start;
+
+	queue = queue_new();
+
+	start = get_usec();
+
+	for (n = 0; n < iterations; n++) {
+		for (i = 1; i <= depth; i++)
+			queue_push_tail(queue, UINT_TO_PTR(i));
+
+		for (i = 1; i <= depth; i++)
+			queue_pop_head(queue);
+	}
+
+	print_rate(name, iterations * depth * 2, start);
+
+	queue_destroy(queue, NULL);
+
+	return true;
+}
+
+static bool queue_lookup(const char *name, unsigned int depth,
+						unsigned int iterations)
+{
+	struct queue *queue;
+	unsigned int n, i;
+	uint64_t start;
+	bool result = true;
+
+	queue = queue_new();
+
+	for (i = 1; i <= depth; i++)
+		queue_push_tail(queue, UINT_TO_PTR(i));
+
+	start = get_usec();
+
+	for (n = 0; n < iterations; n++) {
+		i = n % depth + 1;
+
+		if (!queue_find(queue, match_uint, UINT_TO_PTR(i)))
+			result = false;
+	}
+
+	print_rate(name, iterations, start);
+
+	queue_destroy(queue, NULL);
+
+	return result;
+}
+
+static bool queue_requeue(const char *name, unsigned int depth,
+						unsigned int iterations)
+{
+	struct queue *queue;
+	unsigned int n, i;
+	uint64_t start;
+	bool result = true;
+
+	queue = queue_new();
+
+	for (i = 1; i <= depth; i++)
+		queue_push_tail(queue, UINT_TO_PTR(i));
+
+	start = get_usec();
+
+	/* Take entries out from all over and put them back at the end */
+	for (n = 0; n < iterations; n++) {
+		i = (n * 37) % depth + 1;
+
+		if (!queue_remove(queue, UINT_TO_PTR(i)))
+			result = false;
+
+		queue_push_tail(queue, UINT_TO_PTR(i));
+	}
+
+	print_rate(name, iterations * 2, start);
+
+	queue_destroy(queue, NULL);
+
+	return result;
+}
+
+/*
+ * Entry allocation through push and pop, and the linear walks of find
+ * and remove, for short and long queues.
+ */
+static bool bench_queue(void)
+{
+	return queue_fifo("queue/push_pop/8", 8, 500000 * scale) &&
+		queue_fifo("queue/push_pop/1024", 1024, 2000 * scale) &&
+		queue_lookup("queue/find/16", 16, 1000000 * scale) &&
+		queue_lookup("queue/find/1024", 1024, 20000 * scale) &&
+		queue_requeue("queue/remove/16", 16, 1000000 * scale) &&
+		queue_requeue("queue/remove/1024", 1024, 20000 * scale);
+}
+
+/*
+ * P-256 key generation, which uses the fixed base tables, and ECDH
+ * against a remote public key.
+ */
+static bool bench_ecc(void)
+{
+	uint8_t public1[64], public2[64];
+	uint8_t private1[32], private2[32];
+	uint8_t shared1[32], shared2[32];
+	unsigned int i, count = 1000 * scale;
+	uint64_t start;
+
+	start = get_usec();
+
+	for (i = 0; i < count; i++) {
+		if (!ecc_make_key(public1, private1))
+			return false;
+	}
+
+	print_rate("ecc/keygen", count, start);
+
+	if (!ecc_make_key(public2, private2))
+		return false;
+
+	start = get_usec();
+
+	for (i = 0; i < count; i++) {
+		if (!ecdh_shared_secret(public2, private1, shared1))
+			return false;
+	}
+
+	print_rate("ecc/shared_secret", count, start);
+
+	if (!ecdh_shared_secret(public1, private2, shared2))
+		return false;
+
+	return !memcmp(shared1, shared2, sizeof(shared1));
+}
+
+static void textfile_key(char *key, unsigned int i)
+{
+	sprintf(key, "00:00:00:%02X:%02X:%02X", (i >> 16) & 0xff,
+						(i >> 8) & 0xff, i & 0xff);
+}
+
+static bool textfile_create(const char *pathname, unsigned int count)
+{
+	char key[18];
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(pathname, "w");
+	if (!fp)
+		return false;
+
+	for (i = 0; i < count; i++) {
+		textfile_key(key, i);
+		fprintf(fp, "%s %u\n", key, i);
+	}
+
+	fclose(fp);
+
+	return true;
+}
+
+/*
+ * Per key textfile_get() and textfile_put() against the handle based
+ * lookup and staged commit, on a file with many keys.
+ */
+static bool bench_textfile(void)
+{
+	char pathname[] = "/tmp/perf-bench-textfile.XXXXXX";
+	unsigned int i, keys = 20000, count;
+	struct textfile *file;
+	char key[18], value[16], *str;
+	uint64_t start;
+	bool result = false;
+	int fd;
+
+	fd = mkstemp(pathname);
+	if (fd < 0) {
+		perror("Failed to create file");
+		return false;
+	}
+
+	close(fd);
+
+	if (!textfile_create(pathname, keys))
+		goto done;
+
+	count = 500 * scale;
+	start = get_usec();
+
+	for (i = 0; i < count; i++) {
+		textfile_key(key, (i * 7919) % keys);
+		str = textfile_get(pathname, key);
+		if (!str)
+			goto done;
+		free(str);
+	}
+
+	print_rate("textfile/get", count, start);
+
+	start = get_usec();
+
+	file = textfile_open(pathname);
+	if (!file)
+		goto done;
+
+	for (i = 0; i < keys; i++) {
+		textfile_key(key, (i * 7919) % keys);
+		if (!textfile_lookup(file, key))
+			break;
+	}
+
+	textfile_close(file);
+
+	if (i < keys)
+		goto done;
+
+	print_rate("textfile/open/lookup", keys, start);
+
+	count = 100 * scale;
+	start = get_usec();
+
+	for (i = 0; i < count; i++) {
+		textfile_key(key, (i * 7919) % keys);
+		sprintf(value, "put%u", i);
+		if (textfile_put(pathname, key, value) < 0)
+			goto done;
+	}
+
+	print_rate("textfile/put", count, start);
+
+	start = get_usec();
+
+	file = textfile_open(pathname);
+	if (!file)
+		goto done;
+
+	for (i = 0; i < keys; i++) {
+		textfile_key(key, i);
+		sprintf(value, "set%u", i);
+		textfile_set(file, key, value);
+	}
+
+	result = textfile_commit(file) == 0;
+	textfile_close(file);
+
+	print_rate("textfile/open/set/commit", keys, start);
+
+done:
+	unlink(pathname);
+
+	return result;
+}
+
+static const struct {
+	const char *name;
+	bool (*func)(void);
+} bench_table[] = {
+	{ "sdp",	bench_sdp	},
+	{ "queue",	bench_queue	},
+	{ "ecc",		bench_ecc	},
+	{ "textfile",	bench_textfile	},
+	{ }
+};
+
+static void usage(void)
+{
+	unsigned int i;
+
+	printf("perf-bench - Data structure benchmarks\n"
+		"Usage:\n");
+	printf("\tperf-bench [options] [benchmark...]\n");
+	printf("options:\n"
+		"\t-s, --scale <num>      Multiply iteration counts\n"
+		"\t-h, --help             Show help options\n");
+	printf("benchmarks:\n");
+
+	for (i = 0; bench_table[i].name; i++)
+		printf("\t%s\n", bench_table[i].name);
+}
+
+static const struct option main_options[] = {
+	{ "scale",   required_argument, NULL, 's' },
+	{ "version", no_argument,       NULL, 'v' },
+	{ "help",    no_argument,       NULL, 'h' },
+	{ }
+};
+
+static bool bench_selected(const char *name, int argc, char *argv[])
+{
+	int i;
+
+	if (argc - optind <= 0)
+		return true;
+
+	for (i = optind; i < argc; i++) {
+		if (!strcmp(argv[i], name))
+			return true;
+	}
+
+	return false;
+}
+
+static bool bench_exists(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; bench_table[i].name; i++) {
+		if (!strcmp(bench_table[i].name, name))
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	int exit_status = EXIT_SUCCESS;
+	unsigned int i;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "s:vh", main_options, NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 's':
+			scale = atoi(optarg);
+			break;
+		case 'v':
+			printf("%s\n", VERSION);
+			return EXIT_SUCCESS;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!scale) {
+		fprintf(stderr, "Invalid scale\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = optind; i < (unsigned int) argc; i++) {
+		if (!bench_exists(argv[i])) {
+			fprintf(stderr, "Unknown benchmark: %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; bench_table[i].name; i++) {
+		if (!bench_selected(bench_table[i].name, argc, argv))
+			continue;
+
+		if (!bench_table[i].func())
+			exit_status = EXIT_FAILURE;
+	}
+
+	return exit_status;
+}
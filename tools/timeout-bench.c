@@ -0,0 +1,269 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "src/shared/mainloop.h"
+
+struct bench_timeout {
+	int id;
+	uint64_t expected;
+	bool fired;
+};
+
+static struct bench_timeout *timeouts;
+static unsigned int num_timeouts = 10000;
+static unsigned int max_msec = 1000;
+static unsigned int fire_count;
+static uint64_t total_late;
+static uint64_t max_late;
+static unsigned int early_count;
+
+static uint64_t get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t get_cpu_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_rate(const char *name, uint64_t start)
+{
+	uint64_t elapsed = get_cpu_usec() - start;
+
+	printf("%-8s %8u timeouts in %8llu us CPU: %8.1f ns/op\n", name,
+				num_timeouts, (unsigned long long) elapsed,
+				elapsed * 1000.0 / num_timeouts);
+}
+
+static void idle_callback(int id, void *user_data)
+{
+	fprintf(stderr, "Timeout %d fired unexpectedly\n", id);
+	mainloop_exit_failure();
+}
+
+static void fire_callback(int id, void *user_data)
+{
+	struct bench_timeout *t = user_data;
+	uint64_t now = get_usec();
+
+	if (t->fired) {
+		fprintf(stderr, "Timeout %d fired twice\n", id);
+		mainloop_exit_failure();
+		return;
+	}
+
+	t->fired = true;
+
+	/* Timeouts have millisecond resolution */
+	if (now + 1000 < t->expected)
+		early_count++;
+	else if (now > t->expected) {
+		total_late += now - t->expected;
+		if (now - t->expected > max_late)
+			max_late = now - t->expected;
+	}
+
+	mainloop_remove_timeout(id);
+
+	if (++fire_count == num_timeouts)
+		mainloop_exit_success();
+}
+
+static bool bench_add_modify_remove(void)
+{
+	uint64_t start;
+	unsigned int i;
+
+	start = get_cpu_usec();
+
+	for (i = 0; i < num_timeouts; i++) {
+		timeouts[i].id = mainloop_add_timeout(60000 + rand() % 60000,
+						idle_callback, NULL, NULL);
+		if (timeouts[i].id < 0) {
+			fprintf(stderr, "Failed to add timeout %u\n", i);
+			return false;
+		}
+	}
+
+	print_rate("add", start);
+
+	start = get_cpu_usec();
+
+	for (i = 0; i < num_timeouts; i++) {
+		if (mainloop_modify_timeout(timeouts[i].id,
+					60000 + rand() % 60000) < 0) {
+			fprintf(stderr, "Failed to modify timeout %u\n", i);
+			return false;
+		}
+	}
+
+	print_rate("modify", start);
+
+	start = get_cpu_usec();
+
+	for (i = 0; i < num_timeouts; i++) {
+		if (mainloop_remove_timeout(timeouts[i].id) < 0) {
+			fprintf(stderr, "Failed to remove timeout %u\n", i);
+			return false;
+		}
+	}
+
+	print_rate("remove", start);
+
+	return true;
+}
+
+static bool bench_fire_start(void)
+{
+	unsigned int i;
+
+	memset(timeouts, 0, num_timeouts * sizeof(*timeouts));
+
+	for (i = 0; i < num_timeouts; i++) {
+		unsigned int msec = 1 + rand() % max_msec;
+
+		timeouts[i].expected = get_usec() + msec * 1000;
+		timeouts[i].id = mainloop_add_timeout(msec, fire_callback,
+							&timeouts[i], NULL);
+		if (timeouts[i].id < 0) {
+			fprintf(stderr, "Failed to add timeout %u\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void usage(void)
+{
+	printf("timeout-bench - Mainloop timeout benchmark\n"
+		"Usage:\n");
+	printf("\ttimeout-bench [options]\n");
+	printf("options:\n"
+		"\t-n, --count <num>      Number of concurrent timeouts\n"
+		"\t-t, --time <msec>      Longest timeout when firing\n"
+		"\t-h, --help             Show help options\n");
+}
+
+static const struct option main_options[] = {
+	{ "count",   required_argument, NULL, 'n' },
+	{ "time",    required_argument, NULL, 't' },
+	{ "version", no_argument,       NULL, 'v' },
+	{ "help",    no_argument,       NULL, 'h' },
+	{ }
+};
+
+int main(int argc, char *argv[])
+{
+	uint64_t start;
+	int exit_status;
+
+	for (;;) {
+		int opt;
+
+		opt = getopt_long(argc, argv, "n:t:vh", main_options, NULL);
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'n':
+			num_timeouts = atoi(optarg);
+			break;
+		case 't':
+			max_msec = atoi(optarg);
+			break;
+		case 'v':
+			printf("%s\n", VERSION);
+			return EXIT_SUCCESS;
+		case 'h':
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind > 0) {
+		fprintf(stderr, "Invalid command line parameters\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!num_timeouts || !max_msec) {
+		fprintf(stderr, "Invalid timeout count or time\n");
+		return EXIT_FAILURE;
+	}
+
+	timeouts = calloc(num_timeouts, sizeof(*timeouts));
+	if (!timeouts)
+		return EXIT_FAILURE;
+
+	srand(time(NULL));
+
+	mainloop_init();
+
+	if (!bench_add_modify_remove() || !bench_fire_start()) {
+		free(timeouts);
+		return EXIT_FAILURE;
+	}
+
+	start = get_cpu_usec();
+
+	exit_status = mainloop_run();
+
+	print_rate("fire", start);
+
+	if (fire_count)
+		printf("late     %8llu us average, %8llu us max\n",
+				(unsigned long long) (total_late / fire_count),
+				(unsigned long long) max_late);
+
+	if (early_count) {
+		fprintf(stderr, "%u timeouts fired early\n", early_count);
+		exit_status = EXIT_FAILURE;
+	}
+
+	free(timeouts);
+
+	return exit_status;
+}
@@ -0,0 +1,232 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "lib/bluetooth.h"
+#include "src/shared/util.h"
+#include "src/shared/io.h"
+#include "src/shared/att.h"
+#include "src/shared/tester.h"
+
+struct test_data {
+	struct bt_att *att;
+	struct io *io;
+	unsigned int count;
+};
+
+static const uint8_t nfy_pdu[] = { 0x1b, 0x2a, 0x00, 0x01, 0x02, 0x03 };
+
+static void print_debug(const char *str, void *user_data)
+{
+	const char *prefix = user_data;
+
+	if (tester_use_debug())
+		tester_debug("%s%s", prefix, str);
+}
+
+static void test_setup(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	int sv[2];
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC,
+								0, sv) == 0);
+
+	data->att = bt_att_new(sv[0], false);
+	g_assert(data->att);
+
+	bt_att_set_close_on_unref(data->att, true);
+	bt_att_set_debug(data->att, print_debug, "bt_att:", NULL);
+
+	data->io = io_new(sv[1]);
+	g_assert(data->io);
+
+	io_set_close_on_destroy(data->io, true);
+
+	tester_setup_complete();
+}
+
+static void test_teardown(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	io_destroy(data->io);
+	bt_att_unref(data->att);
+
+	tester_teardown_complete();
+}
+
+static ssize_t peer_read(struct io *io, uint8_t *buf, size_t len)
+{
+	ssize_t bytes_read;
+
+	bytes_read = read(io_get_fd(io), buf, len);
+	g_assert(bytes_read > 0);
+
+	return bytes_read;
+}
+
+static bool sendv_read(struct io *io, void *user_data)
+{
+	uint8_t buf[512];
+	ssize_t len;
+
+	len = peer_read(io, buf, sizeof(buf));
+
+	g_assert(len == sizeof(nfy_pdu));
+	g_assert(!memcmp(buf, nfy_pdu, sizeof(nfy_pdu)));
+
+	tester_test_passed();
+
+	return false;
+}
+
+static void test_sendv(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	uint8_t value[BT_ATT_DEFAULT_LE_MTU];
+	struct iovec iov[3];
+
+	g_assert(io_set_read_handler(data->io, sendv_read, data, NULL));
+
+	/* Larger than the MTU once the opcode is added */
+	iov[0].iov_base = value;
+	iov[0].iov_len = sizeof(value);
+	g_assert(!bt_att_sendv(data->att, BT_ATT_OP_HANDLE_NFY, iov, 1,
+							NULL, NULL, NULL));
+
+	/* Empty entries are skipped over */
+	iov[0].iov_base = (void *) nfy_pdu + 1;
+	iov[0].iov_len = 2;
+	iov[1].iov_base = NULL;
+	iov[1].iov_len = 0;
+	iov[2].iov_base = (void *) nfy_pdu + 3;
+	iov[2].iov_len = sizeof(nfy_pdu) - 3;
+	g_assert(bt_att_sendv(data->att, BT_ATT_OP_HANDLE_NFY, iov, 3,
+							NULL, NULL, NULL));
+}
+
+static void send_nfy(struct test_data *data, uint16_t len)
+{
+	uint8_t value[300];
+
+	memset(value, data->count, len);
+	g_assert(bt_att_send(data->att, BT_ATT_OP_HANDLE_NFY, value, len,
+							NULL, NULL, NULL));
+}
+
+static void check_pool(struct test_data *data, unsigned int alloc,
+							unsigned int reuse)
+{
+	unsigned int pool_alloc, pool_reuse;
+
+	g_assert(bt_att_get_pool_stats(data->att, &pool_alloc, &pool_reuse));
+
+	tester_debug("alloc %u reuse %u", pool_alloc, pool_reuse);
+
+	g_assert_cmpuint(pool_alloc, ==, alloc);
+	g_assert_cmpuint(pool_reuse, ==, reuse);
+}
+
+static bool pool_read(struct io *io, void *user_data)
+{
+	struct test_data *data = user_data;
+	uint8_t buf[512];
+	ssize_t len;
+
+	len = peer_read(io, buf, sizeof(buf));
+	g_assert(buf[0] == BT_ATT_OP_HANDLE_NFY);
+	g_assert(buf[1] == data->count);
+
+	data->count++;
+
+	switch (data->count) {
+	case 8:
+		/* One op sent at a time, the first one is recycled */
+		g_assert(len == 4);
+		check_pool(data, 1, 7);
+
+		/* PDUs above the default MTU come from the large pool */
+		g_assert(bt_att_set_mtu(data->att, 200));
+		send_nfy(data, 100);
+		break;
+	case 12:
+		g_assert(len == 101);
+		check_pool(data, 2, 10);
+
+		/* Ops sized for the old MTU are too small now */
+		g_assert(bt_att_set_mtu(data->att, 300));
+		send_nfy(data, 250);
+		break;
+	case 14:
+		g_assert(len == 251);
+		check_pool(data, 3, 11);
+
+		tester_test_passed();
+		return false;
+	default:
+		send_nfy(data, len - 1);
+		break;
+	}
+
+	return true;
+}
+
+static void test_pool(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	g_assert(io_set_read_handler(data->io, pool_read, data, NULL));
+
+	send_nfy(data, 3);
+}
+
+#define define_test(name, function)					\
+	do {								\
+		struct test_data *data;					\
+		data = new0(struct test_data, 1);			\
+		tester_add_full(name, NULL, NULL, test_setup, function,	\
+				test_teardown, NULL, 2, data, free);	\
+	} while (0)
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	define_test("/att/sendv", test_sendv);
+	define_test("/att/pool", test_pool);
+
+	return tester_run();
+}
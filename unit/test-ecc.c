@@ -280,6 +280,66 @@ static void test_invalid_pub(const void *data)
 	tester_test_passed();
 }
 
+static void test_public_edge(const void *data)
+{
+	uint8_t priv_one[32] = { 0x01 };
+	uint8_t priv_n1[32] = {	0x50, 0x25, 0x63, 0xfc, 0xc2, 0xca, 0xb9, 0xf3,
+				0x84, 0x9e, 0x17, 0xa7, 0xad, 0xfa, 0xe6, 0xbc,
+				0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+				0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+	};
+	uint8_t g[64] = {	0x96, 0xc2, 0x98, 0xd8, 0x45, 0x39, 0xa1, 0xf4,
+				0xa0, 0x33, 0xeb, 0x2d, 0x81, 0x7d, 0x03, 0x77,
+				0xf2, 0x40, 0xa4, 0x63, 0xe5, 0xe6, 0xbc, 0xf8,
+				0x47, 0x42, 0x2c, 0xe1, 0xf2, 0xd1, 0x17, 0x6b,
+
+				0xf5, 0x51, 0xbf, 0x37, 0x68, 0x40, 0xb6, 0xcb,
+				0xce, 0x5e, 0x31, 0x6b, 0x57, 0x33, 0xce, 0x2b,
+				0x16, 0x9e, 0x0f, 0x7c, 0x4a, 0xeb, 0xe7, 0x8e,
+				0x9b, 0x7f, 0x1a, 0xfe, 0xe2, 0x42, 0xe3, 0x4f,
+	};
+	uint8_t neg_g[64] = {	0x96, 0xc2, 0x98, 0xd8, 0x45, 0x39, 0xa1, 0xf4,
+				0xa0, 0x33, 0xeb, 0x2d, 0x81, 0x7d, 0x03, 0x77,
+				0xf2, 0x40, 0xa4, 0x63, 0xe5, 0xe6, 0xbc, 0xf8,
+				0x47, 0x42, 0x2c, 0xe1, 0xf2, 0xd1, 0x17, 0x6b,
+
+				0x0a, 0xae, 0x40, 0xc8, 0x97, 0xbf, 0x49, 0x34,
+				0x31, 0xa1, 0xce, 0x94, 0xa9, 0xcc, 0x31, 0xd4,
+				0xe9, 0x61, 0xf0, 0x83, 0xb5, 0x14, 0x18, 0x71,
+				0x65, 0x80, 0xe5, 0x01, 0x1c, 0xbd, 0x1c, 0xb0,
+	};
+	uint8_t priv_n2[32] = {	0x4f, 0x25, 0x63, 0xfc, 0xc2, 0xca, 0xb9, 0xf3,
+				0x84, 0x9e, 0x17, 0xa7, 0xad, 0xfa, 0xe6, 0xbc,
+				0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+				0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff,
+	};
+	uint8_t g2_x[32] = {	0x78, 0x99, 0x66, 0x47, 0xfc, 0x48, 0x0b, 0xa6,
+				0x35, 0x1b, 0xf2, 0x77, 0xe2, 0x69, 0x89, 0xc0,
+				0xc3, 0x1a, 0xb5, 0x04, 0x03, 0x38, 0x52, 0x8a,
+				0x7e, 0x4f, 0x03, 0x8d, 0x18, 0x7b, 0xf2, 0x7c,
+	};
+	uint8_t public_key[64], shared[32];
+
+	g_assert(ecc_make_public_key(priv_one, public_key));
+	g_assert(memcmp(public_key, g, sizeof(g)) == 0);
+
+	g_assert(ecc_make_public_key(priv_n1, public_key));
+	g_assert(memcmp(public_key, neg_g, sizeof(neg_g)) == 0);
+
+	/* G and -G share the x coordinate */
+	g_assert(ecdh_shared_secret(g, priv_one, shared));
+	g_assert(memcmp(shared, g, sizeof(shared)) == 0);
+
+	g_assert(ecdh_shared_secret(g, priv_n1, shared));
+	g_assert(memcmp(shared, g, sizeof(shared)) == 0);
+
+	/* The last addition of (n - 2) * G adds G to itself */
+	g_assert(ecdh_shared_secret(g, priv_n2, shared));
+	g_assert(memcmp(shared, g2_x, sizeof(shared)) == 0);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -292,5 +352,7 @@ int main(int argc, char *argv[])
 
 	tester_add("/ecdh/invalid", NULL, NULL, test_invalid_pub, NULL);
 
+	tester_add("/ecdh/public/edge", NULL, NULL, test_public_edge, NULL);
+
 	return tester_run();
 }
@@ -64,6 +64,7 @@ struct test_data {
 	enum context_type context_type;
 	bt_uuid_t *uuid;
 	struct gatt_db *source_db;
+	struct gatt_db *cache_db;
 	const void *step;
 };
 
@@ -95,7 +96,7 @@ struct context {
 		.valid = false,					\
 	}
 
-#define define_test(name, function, type, bt_uuid, db,			\
+#define define_test(name, function, type, bt_uuid, cache, db,		\
 		test_step, args...)					\
 	do {								\
 		const struct test_pdu pdus[] = {			\
@@ -107,18 +108,26 @@ struct context {
 		data.uuid = bt_uuid;					\
 		data.step = test_step;					\
 		data.source_db = db;					\
+		data.cache_db = cache;					\
 		data.pdu_list = g_memdup(pdus, sizeof(pdus));		\
 		tester_add(name, &data, NULL, function, NULL);		\
 	} while (0)
 
 #define define_test_att(name, function, bt_uuid, test_step, args...)	\
-	define_test(name, function, ATT, bt_uuid, NULL, test_step, args)
+	define_test(name, function, ATT, bt_uuid, NULL, NULL, test_step, args)
 
 #define define_test_client(name, function, source_db, test_step, args...)\
-	define_test(name, function, CLIENT, NULL, source_db, test_step, args)
+	define_test(name, function, CLIENT, NULL, NULL, source_db, test_step, \
+									args)
+
+#define define_test_client_cache(name, function, cache_db, source_db,	\
+						test_step, args...)	\
+	define_test(name, function, CLIENT, NULL, cache_db, source_db,	\
+							test_step, args)
 
 #define define_test_server(name, function, source_db, test_step, args...)\
-	define_test(name, function, SERVER, NULL, source_db, test_step, args)
+	define_test(name, function, SERVER, NULL, NULL, source_db, test_step, \
+									args)
 
 #define MTU_EXCHANGE_CLIENT_PDUS					\
 		raw_pdu(0x02, 0x00, 0x02),				\
@@ -335,6 +344,10 @@ struct test_step {
 	uint8_t expected_att_ecode;
 	const uint8_t *value;
 	uint16_t length;
+	unsigned int count;
+	uint8_t expected_ready_ecode;
+	unsigned int reused;
+	unsigned int discovered;
 };
 
 static void destroy_context(struct context *context)
@@ -628,6 +641,14 @@ static void match_services(struct gatt_db_attribute *client_serv_attr,
 static void client_ready_cb(bool success, uint8_t att_ecode, void *user_data)
 {
 	struct context *context = user_data;
+	const struct test_step *step = context->data->step;
+
+	if (step && step->expected_ready_ecode) {
+		g_assert(!success);
+		g_assert_cmpint(att_ecode, ==, step->expected_ready_ecode);
+		step->func(context);
+		return;
+	}
 
 	g_assert(success);
 
@@ -642,9 +663,7 @@ static void client_ready_cb(bool success, uint8_t att_ecode, void *user_data)
 	gatt_db_foreach_service(context->client_db, NULL, match_services,
 						context->data->source_db);
 
-	if (context->data->step) {
-		const struct test_step *step = context->data->step;
-
+	if (step) {
 		/* Auto elevate security for test that don't expect error */
 		if (!step->expected_att_ecode)
 			bt_att_set_security(context->att, BT_ATT_SECURITY_AUTO);
@@ -687,7 +706,10 @@ static struct context *create_context(uint16_t mtu, gconstpointer data)
 						"bt_gatt_server:", NULL);
 		break;
 	case CLIENT:
-		context->client_db = gatt_db_new();
+		if (test_data->cache_db)
+			context->client_db = gatt_db_ref(test_data->cache_db);
+		else
+			context->client_db = gatt_db_new();
 		g_assert(context->client_db);
 
 		context->client = bt_gatt_client_new(context->client_db,
@@ -1908,6 +1930,39 @@ static struct gatt_db *make_test_spec_large_db_1(void)
 	return make_db(specs);
 }
 
+#define CACHE_HASH_1	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, \
+			0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10
+#define CACHE_HASH_2	0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, \
+			0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20
+
+/*
+ * Database left in the client cache by a previous connection, with the
+ * properties of the Battery Level characteristic as given.
+ */
+static struct gatt_db *make_cache_db(uint8_t battery_props)
+{
+	const struct att_handle_spec specs[] = {
+		PRIMARY_SERVICE(0x0001, GATT_UUID, 6),
+		CHARACTERISTIC(GATT_CHARAC_DB_HASH, BT_ATT_PERM_READ,
+					BT_GATT_CHRC_PROP_READ, CACHE_HASH_1),
+		CHARACTERISTIC(GATT_CHARAC_SERVICE_CHANGED, BT_ATT_PERM_READ,
+					BT_GATT_CHRC_PROP_INDICATE,
+					0x00, 0x00, 0x00, 0x00),
+		DESCRIPTOR(GATT_CLIENT_CHARAC_CFG_UUID, BT_ATT_PERM_READ |
+						BT_ATT_PERM_WRITE, 0x00, 0x00),
+		PRIMARY_SERVICE(0x0007, BATTERY_UUID, 3),
+		CHARACTERISTIC(GATT_CHARAC_BATTERY_LEVEL, BT_ATT_PERM_READ,
+							battery_props, 0x64),
+		PRIMARY_SERVICE(0x000a, DEVICE_INFORMATION_UUID, 3),
+		CHARACTERISTIC_STR(GATT_CHARAC_MANUFACTURER_NAME_STRING,
+						BT_ATT_PERM_READ,
+						BT_GATT_CHRC_PROP_READ, "BlueZ"),
+		{ }
+	};
+
+	return make_db(specs);
+}
+
 static void test_client(gconstpointer data)
 {
 	create_context(512, data);
@@ -2345,10 +2400,260 @@ static const struct test_step test_indication_server_1 = {
 	.length = 0x03,
 };
 
+/* Limits of the batching done by bt_gatt_client_register_notify_batch */
+#define NFY_BATCH_TIMEOUT	10
+#define NFY_BATCH_MAX		32
+#define NFY_BATCH_SIZE		4096
+
+static unsigned int batch_received;
+static gint64 batch_start;
+
+static void notification_batch_cb(uint16_t value_handle,
+					const struct iovec *values,
+					unsigned int count, void *user_data)
+{
+	struct context *context = user_data;
+	const struct test_step *step = context->data->step;
+	unsigned int expected, i;
+
+	g_assert_cmpint(value_handle, ==, step->handle);
+
+	/* Flushed as soon as either limit is reached, the rest on timeout */
+	expected = MIN(NFY_BATCH_MAX, NFY_BATCH_SIZE / step->length);
+	if (step->count - batch_received < expected) {
+		expected = step->count - batch_received;
+		g_assert(g_get_monotonic_time() - batch_start >=
+						NFY_BATCH_TIMEOUT * 1000);
+	}
+
+	g_assert_cmpint(count, ==, expected);
+
+	for (i = 0; i < count; i++) {
+		const uint8_t *value = values[i].iov_base;
+
+		g_assert_cmpint(values[i].iov_len, ==, step->length);
+		g_assert_cmpint(value[0], ==, batch_received + i);
+	}
+
+	batch_received += count;
+
+	if (batch_received == step->count)
+		context_quit(context);
+}
+
+static void notification_batch_register_cb(uint16_t att_ecode,
+							void *user_data)
+{
+	struct context *context = user_data;
+	const struct test_step *step = context->data->step;
+	uint8_t pdu[512];
+	unsigned int i;
+
+	g_assert(!att_ecode);
+
+	batch_start = g_get_monotonic_time();
+
+	pdu[0] = BT_ATT_OP_HANDLE_NFY;
+	put_le16(step->handle, pdu + 1);
+
+	for (i = 0; i < step->count; i++) {
+		memset(pdu + 3, i, step->length);
+
+		g_assert_cmpint(write(context->fd, pdu, step->length + 3), ==,
+							step->length + 3);
+	}
+}
+
+static void test_notification_batch(struct context *context)
+{
+	const struct test_step *step = context->data->step;
+
+	batch_received = 0;
+
+	g_assert(bt_gatt_client_register_notify_batch(context->client,
+					step->handle,
+					notification_batch_register_cb,
+					notification_batch_cb, context,
+					NULL));
+}
+
+static unsigned int batch_id;
+
+static void notification_batch_unregister_cb(uint16_t value_handle,
+					const struct iovec *values,
+					unsigned int count, void *user_data)
+{
+	struct context *context = user_data;
+
+	g_assert_cmpint(count, ==, NFY_BATCH_MAX);
+
+	/* Unregister from a flush caused by a full batch */
+	g_assert(bt_gatt_client_unregister_notify(context->client, batch_id));
+	batch_id = 0;
+}
+
+static void test_notification_batch_unreg(struct context *context)
+{
+	const struct test_step *step = context->data->step;
+
+	batch_id = bt_gatt_client_register_notify_batch(context->client,
+					step->handle,
+					notification_batch_register_cb,
+					notification_batch_unregister_cb,
+					context, NULL);
+	g_assert(batch_id);
+}
+
+static const struct test_step test_notification_batch_count = {
+	.handle = 0x0003,
+	.func = test_notification_batch,
+	.length = 3,
+	.count = 40,
+};
+
+static const struct test_step test_notification_batch_size = {
+	.handle = 0x0003,
+	.func = test_notification_batch,
+	.length = 500,
+	.count = 10,
+};
+
+static const struct test_step test_notification_batch_timeout = {
+	.handle = 0x0003,
+	.func = test_notification_batch,
+	.length = 3,
+	.count = 3,
+};
+
+static const struct test_step test_notification_batch_unregister = {
+	.handle = 0x0003,
+	.func = test_notification_batch_unreg,
+	.length = 3,
+	.count = 40,
+};
+
+static const uint8_t cache_hash_1[] = { CACHE_HASH_1 };
+static const uint8_t cache_hash_2[] = { CACHE_HASH_2 };
+
+static bool cache_checked;
+
+static void cache_hash_read_cb(struct gatt_db_attribute *attrib, int err,
+					const uint8_t *value, size_t length,
+					void *user_data)
+{
+	const struct test_step *step = user_data;
+
+	g_assert(!err);
+	g_assert_cmpint(length, ==, step->length);
+	g_assert(memcmp(value, step->value, length) == 0);
+}
+
+static void check_cache(struct context *context)
+{
+	const struct test_step *step = context->data->step;
+	struct gatt_db_attribute *attr;
+	unsigned int reused, discovered;
+
+	g_assert(bt_gatt_client_get_cache_stats(context->client, &reused,
+								&discovered));
+	g_assert_cmpuint(reused, ==, step->reused);
+	g_assert_cmpuint(discovered, ==, step->discovered);
+
+	cache_checked = true;
+
+	/* The stored hash must be the one the cache is in sync with */
+	attr = gatt_db_get_attribute(context->client_db, 0x0003);
+	g_assert(attr);
+	g_assert(gatt_db_attribute_read(attr, 0, BT_ATT_OP_READ_REQ, NULL,
+						cache_hash_read_cb,
+						(void *) step));
+}
+
+static void check_cache_done(struct context *context)
+{
+	g_assert(cache_checked);
+
+	cache_checked = false;
+}
+
+static void test_cache(struct context *context)
+{
+	check_cache(context);
+	context_quit(context);
+}
+
+static void cache_service_changed_cb(uint16_t start_handle,
+					uint16_t end_handle, void *user_data)
+{
+	struct context *context = user_data;
+
+	g_assert_cmpint(start_handle, ==, 0x0007);
+	g_assert_cmpint(end_handle, ==, 0x0009);
+
+	check_cache(context);
+
+	/* The client is still in use once the callback returns */
+	g_idle_add(context_quit, context);
+}
+
+/*
+ * Also run once the confirmation is received, as the client sends the hash
+ * read right after it.
+ */
+static void test_cache_service_changed(struct context *context)
+{
+	g_assert(bt_gatt_client_set_service_changed(context->client,
+						cache_service_changed_cb,
+						context, NULL));
+}
+
+/*
+ * Ready is reported before the Service Changed CCC is written, the tests
+ * end with that write.
+ */
+static const struct test_step test_cache_match = {
+	.func = check_cache,
+	.post_func = check_cache_done,
+	.value = cache_hash_1,
+	.length = sizeof(cache_hash_1),
+	.reused = 12,
+};
+
+static const struct test_step test_cache_mismatch = {
+	.func = check_cache,
+	.post_func = check_cache_done,
+	.value = cache_hash_2,
+	.length = sizeof(cache_hash_2),
+	.reused = 9,
+	.discovered = 3,
+};
+
+/* The changed range is reused on top of the whole database on connection */
+static const struct test_step test_cache_hash_reverted = {
+	.func = test_cache_service_changed,
+	.post_func = check_cache_done,
+	.value = cache_hash_1,
+	.length = sizeof(cache_hash_1),
+	.reused = 15,
+};
+
+/*
+ * The cache is left as it was, the new hash is not stored so it is verified
+ * again on next connection.
+ */
+static const struct test_step test_cache_verify_error = {
+	.func = test_cache,
+	.post_func = check_cache_done,
+	.value = cache_hash_1,
+	.length = sizeof(cache_hash_1),
+	.expected_ready_ecode = BT_ATT_ERROR_UNLIKELY,
+};
+
 int main(int argc, char *argv[])
 {
 	struct gatt_db *service_db_1, *service_db_2, *service_db_3;
 	struct gatt_db *ts_small_db, *ts_large_db_1;
+	struct gatt_db *cache_db_1, *cache_db_2;
 
 	tester_init(&argc, &argv);
 
@@ -2357,6 +2662,9 @@ int main(int argc, char *argv[])
 	service_db_3 = make_service_data_3_db();
 	ts_small_db = make_test_spec_small_db();
 	ts_large_db_1 = make_test_spec_large_db_1();
+	cache_db_1 = make_cache_db(BT_GATT_CHRC_PROP_READ);
+	cache_db_2 = make_cache_db(BT_GATT_CHRC_PROP_READ |
+						BT_GATT_CHRC_PROP_WRITE);
 
 	/*
 	 * Server Configuration
@@ -3286,6 +3594,126 @@ int main(int argc, char *argv[])
 			raw_pdu(0x1D, 0x03, 0x00, 0x01, 0x02, 0x03),
 			raw_pdu(0x1E));
 
+	define_test_client("/gatt/notify-batch/count", test_client,
+			ts_small_db, &test_notification_batch_count,
+			CLIENT_INIT_PDUS,
+			SMALL_DB_DISCOVERY_PDUS,
+			raw_pdu(0x12, 0x04, 0x00, 0x03, 0x00),
+			raw_pdu(0x13));
+
+	define_test_client("/gatt/notify-batch/size", test_client,
+			ts_small_db, &test_notification_batch_size,
+			CLIENT_INIT_PDUS,
+			SMALL_DB_DISCOVERY_PDUS,
+			raw_pdu(0x12, 0x04, 0x00, 0x03, 0x00),
+			raw_pdu(0x13));
+
+	define_test_client("/gatt/notify-batch/timeout", test_client,
+			ts_small_db, &test_notification_batch_timeout,
+			CLIENT_INIT_PDUS,
+			SMALL_DB_DISCOVERY_PDUS,
+			raw_pdu(0x12, 0x04, 0x00, 0x03, 0x00),
+			raw_pdu(0x13));
+
+	define_test_client("/gatt/notify-batch/unregister", test_client,
+			ts_small_db, &test_notification_batch_unregister,
+			CLIENT_INIT_PDUS,
+			SMALL_DB_DISCOVERY_PDUS,
+			raw_pdu(0x12, 0x04, 0x00, 0x03, 0x00),
+			raw_pdu(0x13),
+			raw_pdu(0x12, 0x04, 0x00, 0x00, 0x00));
+
+	define_test_client_cache("/gatt/cache/hash-match", test_client,
+			make_cache_db(BT_GATT_CHRC_PROP_READ), cache_db_1,
+			&test_cache_match,
+			CLIENT_INIT_PDUS,
+			raw_pdu(0x08, 0x01, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x09, 0x12, 0x03, 0x00, CACHE_HASH_1),
+			raw_pdu(0x08, 0x04, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x01, 0x08, 0x04, 0x00, 0x0a),
+			raw_pdu(0x12, 0x06, 0x00, 0x02, 0x00));
+
+	define_test_client_cache("/gatt/cache/hash-mismatch", test_client,
+			make_cache_db(BT_GATT_CHRC_PROP_READ), cache_db_2,
+			&test_cache_mismatch,
+			CLIENT_INIT_PDUS,
+			raw_pdu(0x08, 0x01, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x09, 0x12, 0x03, 0x00, CACHE_HASH_2),
+			raw_pdu(0x08, 0x04, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x01, 0x08, 0x04, 0x00, 0x0a),
+			raw_pdu(0x10, 0x01, 0x00, 0xff, 0xff, 0x00, 0x28),
+			raw_pdu(0x11, 0x06, 0x01, 0x00, 0x06, 0x00, 0x01, 0x18,
+					0x07, 0x00, 0x09, 0x00, 0x0f, 0x18,
+					0x0a, 0x00, 0x0c, 0x00, 0x0a, 0x18),
+			raw_pdu(0x10, 0x0d, 0x00, 0xff, 0xff, 0x00, 0x28),
+			raw_pdu(0x01, 0x10, 0x0d, 0x00, 0x0a),
+			raw_pdu(0x08, 0x01, 0x00, 0x06, 0x00, 0x03, 0x28),
+			raw_pdu(0x09, 0x07, 0x02, 0x00, 0x02, 0x03, 0x00, 0x2a,
+					0x2b, 0x04, 0x00, 0x20, 0x05, 0x00,
+					0x05, 0x2a),
+			raw_pdu(0x08, 0x05, 0x00, 0x06, 0x00, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x05, 0x00, 0x0a),
+			raw_pdu(0x08, 0x07, 0x00, 0x09, 0x00, 0x03, 0x28),
+			raw_pdu(0x09, 0x07, 0x08, 0x00, 0x0a, 0x09, 0x00, 0x19,
+					0x2a),
+			raw_pdu(0x08, 0x09, 0x00, 0x09, 0x00, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x09, 0x00, 0x0a),
+			raw_pdu(0x08, 0x0a, 0x00, 0x0c, 0x00, 0x03, 0x28),
+			raw_pdu(0x09, 0x07, 0x0b, 0x00, 0x02, 0x0c, 0x00, 0x29,
+					0x2a),
+			raw_pdu(0x08, 0x0c, 0x00, 0x0c, 0x00, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x0c, 0x00, 0x0a),
+			raw_pdu(0x10, 0x01, 0x00, 0xff, 0xff, 0x01, 0x28),
+			raw_pdu(0x01, 0x10, 0x01, 0x00, 0x0a),
+			raw_pdu(0x08, 0x07, 0x00, 0x09, 0x00, 0x02, 0x28),
+			raw_pdu(0x01, 0x08, 0x07, 0x00, 0x0a),
+			raw_pdu(0x08, 0x07, 0x00, 0x09, 0x00, 0x03, 0x28),
+			raw_pdu(0x09, 0x07, 0x08, 0x00, 0x0a, 0x09, 0x00, 0x19,
+					0x2a),
+			raw_pdu(0x08, 0x09, 0x00, 0x09, 0x00, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x09, 0x00, 0x0a),
+			raw_pdu(0x08, 0x0d, 0x00, 0xff, 0xff, 0x02, 0x28),
+			raw_pdu(0x01, 0x08, 0x0d, 0x00, 0x0a),
+			raw_pdu(0x08, 0x0d, 0x00, 0xff, 0xff, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x0d, 0x00, 0x0a),
+			raw_pdu(0x12, 0x06, 0x00, 0x02, 0x00));
+
+	define_test_client_cache("/gatt/cache/hash-reverted", test_client,
+			make_cache_db(BT_GATT_CHRC_PROP_READ), cache_db_1,
+			&test_cache_hash_reverted,
+			CLIENT_INIT_PDUS,
+			raw_pdu(0x08, 0x01, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x09, 0x12, 0x03, 0x00, CACHE_HASH_1),
+			raw_pdu(0x08, 0x04, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x01, 0x08, 0x04, 0x00, 0x0a),
+			raw_pdu(0x12, 0x06, 0x00, 0x02, 0x00),
+			raw_pdu(0x13),
+			raw_pdu(),
+			raw_pdu(0x1d, 0x05, 0x00, 0x07, 0x00, 0x09, 0x00),
+			raw_pdu(0x1e),
+			raw_pdu(),
+			raw_pdu(0x08, 0x01, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x09, 0x12, 0x03, 0x00, CACHE_HASH_1),
+			raw_pdu(0x08, 0x04, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x01, 0x08, 0x04, 0x00, 0x0a));
+
+	define_test_client_cache("/gatt/cache/verify-error", test_client,
+			make_cache_db(BT_GATT_CHRC_PROP_READ), NULL,
+			&test_cache_verify_error,
+			CLIENT_INIT_PDUS,
+			raw_pdu(0x08, 0x01, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x09, 0x12, 0x03, 0x00, CACHE_HASH_2),
+			raw_pdu(0x08, 0x04, 0x00, 0xff, 0xff, 0x2a, 0x2b),
+			raw_pdu(0x01, 0x08, 0x04, 0x00, 0x0a),
+			raw_pdu(0x10, 0x01, 0x00, 0xff, 0xff, 0x00, 0x28),
+			raw_pdu(0x11, 0x06, 0x01, 0x00, 0x06, 0x00, 0x01, 0x18,
+					0x07, 0x00, 0x09, 0x00, 0x0f, 0x18,
+					0x0a, 0x00, 0x0c, 0x00, 0x0a, 0x18),
+			raw_pdu(0x10, 0x0d, 0x00, 0xff, 0xff, 0x00, 0x28),
+			raw_pdu(0x01, 0x10, 0x0d, 0x00, 0x0a),
+			raw_pdu(0x08, 0x01, 0x00, 0x06, 0x00, 0x03, 0x28),
+			raw_pdu(0x01, 0x08, 0x01, 0x00, 0x0e));
+
 	define_test_client("/TP/GAR/CL/BV-06-C", test_client, service_db_1,
 			&test_read_7,
 			SERVICE_DATA_1_PDUS,
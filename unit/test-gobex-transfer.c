@@ -1262,6 +1262,172 @@ static void test_packet_put_req(void)
 	g_assert_no_error(d.err);
 }
 
+static gssize provide_fd(gsize len, gpointer user_data)
+{
+	struct test_data *d = user_data;
+	gsize size;
+
+	size = MIN(len, sizeof(body_data) - d->total);
+	d->total += size;
+
+	return size;
+}
+
+static int create_body_file(void)
+{
+	char path[] = "/tmp/gobex-test-XXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -1;
+
+	unlink(path);
+
+	if (write(fd, body_data, sizeof(body_data)) != sizeof(body_data) ||
+					lseek(fd, 0, SEEK_SET) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void test_put_req_fd(int sock_type, struct test_data *d)
+{
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	GObexPacket *req;
+	int fd;
+
+	fd = create_body_file();
+	g_assert(fd >= 0);
+
+	create_endpoints(&obex, &io, sock_type);
+	d->obex = obex;
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, test_io_cb, d);
+
+	d->mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, d);
+
+	req = g_obex_packet_new(G_OBEX_OP_PUT, FALSE,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "file.txt",
+				G_OBEX_HDR_INVALID);
+
+	g_obex_put_req_pkt_fd(obex, req, fd, provide_fd, transfer_complete,
+								d, &d->err);
+	g_assert_no_error(d->err);
+
+	g_main_loop_run(d->mainloop);
+
+	g_assert_cmpuint(d->count, ==, 2);
+	g_assert_cmpuint(d->total, ==, sizeof(body_data));
+
+	g_main_loop_unref(d->mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_source_remove(io_id);
+	g_obex_unref(obex);
+	close(fd);
+
+	g_assert_no_error(d->err);
+}
+
+static void test_stream_put_req_fd(void)
+{
+	struct test_data d = { 0, NULL, {
+				{ put_req_first, sizeof(put_req_first) },
+				{ put_req_last, sizeof(put_req_last) } }, {
+				{ put_rsp_first, sizeof(put_rsp_first) },
+				{ put_rsp_last, sizeof(put_rsp_last) } } };
+
+	test_put_req_fd(SOCK_STREAM, &d);
+}
+
+static void test_packet_put_req_fd(void)
+{
+	struct test_data d = { 0, NULL, {
+			{ NULL, 0 },
+			{ put_req_last, sizeof(put_req_last) } }, {
+			{ put_rsp_first_srm, sizeof(put_rsp_first_srm) },
+			{ put_rsp_last, sizeof(put_rsp_last) } } };
+
+	test_put_req_fd(SOCK_SEQPACKET, &d);
+}
+
+static gboolean drain_io_cb(GIOChannel *io, GIOCondition cond,
+							gpointer user_data)
+{
+	struct test_data *d = user_data;
+	char buf[1024];
+	gsize rbytes;
+
+	if ((cond & G_IO_IN) && g_io_channel_read_chars(io, buf, sizeof(buf),
+				&rbytes, NULL) == G_IO_STATUS_NORMAL)
+		return TRUE;
+
+	d->io_completed = TRUE;
+
+	return FALSE;
+}
+
+static void test_stream_put_req_fd_short(void)
+{
+	struct test_data d = { 0, NULL, { { NULL, 0 } }, { { NULL, 0 } } };
+	GIOChannel *io;
+	GIOCondition cond;
+	guint io_id, timer_id;
+	GObex *obex;
+	GObexPacket *req;
+	int fd;
+
+	/* The producer announces more data than the file holds */
+	fd = create_body_file();
+	g_assert(fd >= 0);
+	g_assert(ftruncate(fd, 4) == 0);
+
+	create_endpoints(&obex, &io, SOCK_STREAM);
+	d.obex = obex;
+
+	cond = G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL;
+	io_id = g_io_add_watch(io, cond, drain_io_cb, &d);
+
+	d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(1, test_timeout, &d);
+
+	req = g_obex_packet_new(G_OBEX_OP_PUT, FALSE,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "file.txt",
+				G_OBEX_HDR_INVALID);
+
+	g_obex_put_req_pkt_fd(obex, req, fd, provide_fd, transfer_complete,
+								&d, &d.err);
+	g_assert_no_error(d.err);
+
+	g_main_loop_run(d.mainloop);
+
+	/* The half written packet must take the transport down */
+	g_assert_error(d.err, G_OBEX_ERROR, G_OBEX_ERROR_DISCONNECTED);
+	g_error_free(d.err);
+
+	g_main_loop_unref(d.mainloop);
+
+	g_source_remove(timer_id);
+	if (!d.io_completed)
+		g_source_remove(io_id);
+	g_io_channel_unref(io);
+	g_obex_unref(obex);
+	close(fd);
+}
+
 static void test_put_req_eagain(void)
 {
 	GIOChannel *io;
@@ -2334,6 +2500,139 @@ static void test_conn_put_req_seq_srm(void)
 	g_assert_no_error(d.err);
 }
 
+#define BENCH_TRANSFER_SIZE	(8 * 1024 * 1024)
+
+struct bench_data {
+	struct test_data d;
+	GObex *server;
+	gsize sent;
+	gsize received;
+	guint packets;
+	gint64 start;
+};
+
+static gssize bench_provide(void *buf, gsize len, gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	if (b->sent >= BENCH_TRANSFER_SIZE)
+		return 0;
+
+	len = MIN(len, BENCH_TRANSFER_SIZE - b->sent);
+	memset(buf, b->sent & 0xff, len);
+	b->sent += len;
+
+	return len;
+}
+
+static gboolean bench_consume(const void *buf, gsize len,
+							gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	b->received += len;
+	b->packets++;
+
+	return TRUE;
+}
+
+static void bench_put_complete(GObex *obex, GError *err,
+							gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	if (err != NULL && b->d.err == NULL)
+		b->d.err = g_error_copy(err);
+}
+
+static void bench_handle_put(GObex *obex, GObexPacket *req,
+							gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	g_obex_put_rsp(obex, req, bench_consume, bench_put_complete, b,
+					&b->d.err, G_OBEX_HDR_INVALID);
+}
+
+static void bench_handle_connect(GObex *obex, GObexPacket *req,
+							gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	g_obex_send_rsp(obex, G_OBEX_RSP_SUCCESS, &b->d.err,
+							G_OBEX_HDR_INVALID);
+}
+
+static void bench_conn_complete(GObex *obex, GError *err, GObexPacket *rsp,
+							gpointer user_data)
+{
+	struct bench_data *b = user_data;
+
+	if (err != NULL) {
+		b->d.err = g_error_copy(err);
+		g_main_loop_quit(b->d.mainloop);
+		return;
+	}
+
+	b->start = g_get_monotonic_time();
+
+	g_obex_put_req(obex, bench_provide, transfer_complete, &b->d,
+				&b->d.err,
+				G_OBEX_HDR_TYPE, hdr_type, sizeof(hdr_type),
+				G_OBEX_HDR_NAME, "bench.bin",
+				G_OBEX_HDR_INVALID);
+}
+
+static void test_perf_packet_put_req(void)
+{
+	struct bench_data b;
+	GIOChannel *io;
+	guint timer_id;
+	GObex *obex;
+	gdouble secs;
+
+	memset(&b, 0, sizeof(b));
+
+	create_endpoints(&obex, &io, SOCK_SEQPACKET);
+	b.d.obex = obex;
+
+	b.server = g_obex_new(io, G_OBEX_TRANSPORT_PACKET, -1, -1);
+	g_assert(b.server != NULL);
+
+	g_obex_add_request_function(b.server, G_OBEX_OP_CONNECT,
+						bench_handle_connect, &b);
+	g_obex_add_request_function(b.server, G_OBEX_OP_PUT,
+						bench_handle_put, &b);
+
+	b.d.mainloop = g_main_loop_new(NULL, FALSE);
+
+	timer_id = g_timeout_add_seconds(30, test_timeout, &b.d);
+
+	g_obex_connect(obex, bench_conn_complete, &b, &b.d.err,
+					G_OBEX_HDR_SRM, G_OBEX_SRM_INDICATE,
+					G_OBEX_HDR_INVALID);
+	g_assert_no_error(b.d.err);
+
+	g_main_loop_run(b.d.mainloop);
+
+	secs = (g_get_monotonic_time() - b.start) / 1000000.0;
+
+	g_main_loop_unref(b.d.mainloop);
+
+	g_source_remove(timer_id);
+	g_io_channel_unref(io);
+	g_obex_unref(b.server);
+	g_obex_unref(obex);
+
+	g_assert_no_error(b.d.err);
+	g_assert_cmpuint(b.received, ==, BENCH_TRANSFER_SIZE);
+
+	g_test_message("%u packets, %zu bytes in %.3f s", b.packets,
+							b.received, secs);
+	g_test_maximized_result(b.packets / secs, "%.0f packets/s",
+							b.packets / secs);
+}
+
 int main(int argc, char *argv[])
 {
 	g_test_init(&argc, &argv, NULL);
@@ -2387,6 +2686,13 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_packet_put_req_suspend_resume",
 					test_packet_put_req_suspend_resume);
 
+	g_test_add_func("/gobex/test_stream_put_req_fd",
+						test_stream_put_req_fd);
+	g_test_add_func("/gobex/test_packet_put_req_fd",
+						test_packet_put_req_fd);
+	g_test_add_func("/gobex/test_stream_put_req_fd_short",
+					test_stream_put_req_fd_short);
+
 	g_test_add_func("/gobex/test_packet_put_rsp", test_packet_put_rsp);
 	g_test_add_func("/gobex/test_packet_put_rsp_wait",
 						test_packet_put_rsp_wait);
@@ -2407,5 +2713,9 @@ int main(int argc, char *argv[])
 	g_test_add_func("/gobex/test_conn_put_req_seq_srm",
 						test_conn_put_req_seq_srm);
 
+	if (g_test_perf())
+		g_test_add_func("/gobex/test_perf_packet_put_req",
+						test_perf_packet_put_req);
+
 	return g_test_run();
 }
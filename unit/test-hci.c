@@ -0,0 +1,364 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <glib.h>
+
+#include "monitor/bt.h"
+#include "emulator/btdev.h"
+#include "src/shared/util.h"
+#include "src/shared/io.h"
+#include "src/shared/hci.h"
+#include "src/shared/tester.h"
+
+#define ACL_START	0x02
+#define ACL_CONT	0x01
+
+struct test_data {
+	uint16_t size;
+	unsigned int count;
+};
+
+struct host {
+	struct btdev *dev;
+	struct io *io;
+	struct bt_hci *hci;
+};
+
+struct context {
+	const struct test_data *data;
+	struct host host[2];
+	uint16_t handle;
+	uint8_t *pdu;
+	unsigned int sent;
+	unsigned int received;
+	unsigned int fragments;
+	unsigned int offset;
+	unsigned int dropped;
+};
+
+#define define_test(name, _size, _count)				\
+	do {								\
+		static struct test_data data = {			\
+			.size = _size,					\
+			.count = _count,				\
+		};							\
+		struct context *context = new0(struct context, 1);	\
+		tester_add_full(name, &data, NULL, NULL,		\
+					test_data_path, test_teardown,	\
+					NULL, 2, context, free);	\
+	} while (0)
+
+#define define_test_raw(name, _size, _count)				\
+	do {								\
+		static struct test_data data = {			\
+			.size = _size,					\
+			.count = _count,				\
+		};							\
+		struct context *context = new0(struct context, 1);	\
+		tester_add_full(name, &data, NULL, NULL,		\
+					test_data_raw, test_teardown,	\
+					NULL, 2, context, free);	\
+	} while (0)
+
+static void dev_send(const struct iovec *iov, int iovlen, void *user_data)
+{
+	struct host *host = user_data;
+
+	g_assert(io_send(host->io, iov, iovlen) >= 0);
+}
+
+static bool dev_read(struct io *io, void *user_data)
+{
+	struct host *host = user_data;
+	uint8_t buf[2048];
+	ssize_t len;
+
+	len = read(io_get_fd(io), buf, sizeof(buf));
+	if (len <= 0)
+		return false;
+
+	btdev_receive_h4(host->dev, buf, len);
+
+	return true;
+}
+
+static void host_init(struct host *host, uint16_t id)
+{
+	int sv[2];
+
+	g_assert(!socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC |
+						SOCK_NONBLOCK, 0, sv));
+
+	host->dev = btdev_create(BTDEV_TYPE_BREDR, id);
+	g_assert(host->dev);
+
+	host->io = io_new(sv[0]);
+	io_set_close_on_destroy(host->io, true);
+	io_set_read_handler(host->io, dev_read, host, NULL);
+
+	btdev_set_send_handler(host->dev, dev_send, host);
+
+	host->hci = bt_hci_new(sv[1]);
+	g_assert(host->hci);
+
+	bt_hci_set_close_on_unref(host->hci, true);
+}
+
+static void host_cleanup(struct host *host)
+{
+	bt_hci_unref(host->hci);
+	io_destroy(host->io);
+	btdev_destroy(host->dev);
+}
+
+static void test_teardown(const void *test_data)
+{
+	struct context *context = tester_get_data();
+
+	host_cleanup(&context->host[0]);
+	host_cleanup(&context->host[1]);
+
+	free(context->pdu);
+	context->pdu = NULL;
+
+	tester_teardown_complete();
+}
+
+static void send_pdu(struct context *context)
+{
+	const struct test_data *data = context->data;
+
+	g_assert(bt_hci_send_data(context->host[0].hci, BT_H4_ACL_PKT,
+					context->handle, ACL_START,
+					context->pdu, data->size));
+
+	context->sent++;
+}
+
+static void data_received(uint16_t handle, uint8_t flags, const void *buf,
+					uint16_t size, void *user_data)
+{
+	struct context *context = user_data;
+	const struct test_data *data = context->data;
+
+	g_assert(handle == context->handle);
+	g_assert(flags == (context->offset ? ACL_CONT : ACL_START));
+	g_assert(context->offset + size <= data->size);
+	g_assert(!memcmp(buf, context->pdu + context->offset, size));
+
+	context->fragments++;
+	context->offset += size;
+
+	if (context->offset < data->size)
+		return;
+
+	context->offset = 0;
+
+	if (++context->received == data->count) {
+		tester_debug("%u PDUs in %u fragments, %u dropped",
+					context->received, context->fragments,
+					context->dropped);
+		tester_test_passed();
+	}
+}
+
+static void conn_complete(const void *buf, uint8_t size, void *user_data)
+{
+	const struct bt_hci_evt_conn_complete *evt = buf;
+	struct context *context = user_data;
+	const struct test_data *data = context->data;
+	unsigned int i;
+
+	g_assert(size >= sizeof(*evt));
+	g_assert(!evt->status);
+
+	context->handle = le16_to_cpu(evt->handle);
+
+	/* Queue everything at once, sending has to follow the credits */
+	for (i = 0; i < data->count; i++)
+		send_pdu(context);
+}
+
+static void conn_request(const void *buf, uint8_t size, void *user_data)
+{
+	const struct bt_hci_evt_conn_request *evt = buf;
+	struct context *context = user_data;
+	struct bt_hci_cmd_accept_conn_request cmd;
+
+	memcpy(cmd.bdaddr, evt->bdaddr, 6);
+	cmd.role = 0x01;
+
+	bt_hci_send(context->host[1].hci, BT_HCI_CMD_ACCEPT_CONN_REQUEST,
+					&cmd, sizeof(cmd), NULL, NULL, NULL);
+}
+
+static void read_buffer_size(const void *buf, uint8_t size, void *user_data)
+{
+	const struct bt_hci_rsp_read_buffer_size *rsp = buf;
+	struct context *context = user_data;
+	struct bt_hci_cmd_create_conn cmd;
+
+	g_assert(!rsp->status);
+
+	memset(&cmd, 0, sizeof(cmd));
+	memcpy(cmd.bdaddr, btdev_get_bdaddr(context->host[1].dev), 6);
+
+	bt_hci_send(context->host[0].hci, BT_HCI_CMD_CREATE_CONN,
+					&cmd, sizeof(cmd), NULL, NULL, NULL);
+}
+
+static void test_data_path(const void *test_data)
+{
+	const struct test_data *data = test_data;
+	struct context *context = tester_get_data();
+	uint8_t scan = 0x02;
+	unsigned int i;
+
+	context->data = data;
+
+	context->pdu = malloc(data->size);
+	for (i = 0; i < data->size; i++)
+		context->pdu[i] = i;
+
+	host_init(&context->host[0], 0);
+	host_init(&context->host[1], 1);
+
+	bt_hci_register(context->host[0].hci, BT_HCI_EVT_CONN_COMPLETE,
+					conn_complete, context, NULL);
+	bt_hci_register(context->host[1].hci, BT_HCI_EVT_CONN_REQUEST,
+					conn_request, context, NULL);
+	bt_hci_register_data(context->host[1].hci, BT_H4_ACL_PKT,
+					data_received, context, NULL);
+
+	bt_hci_send(context->host[1].hci, BT_HCI_CMD_WRITE_SCAN_ENABLE,
+					&scan, sizeof(scan), NULL, NULL, NULL);
+
+	/* The buffer size is picked up from the response on its way */
+	bt_hci_send(context->host[0].hci, BT_HCI_CMD_READ_BUFFER_SIZE,
+				NULL, 0, read_buffer_size, context, NULL);
+}
+
+static void raw_send(struct context *context, uint16_t dlen,
+					const void *pdu, size_t size)
+{
+	struct bt_hci_acl_hdr hdr;
+	uint8_t type = BT_H4_ACL_PKT;
+	struct iovec iov[3];
+
+	hdr.handle = cpu_to_le16(context->handle | ACL_START << 12);
+	hdr.dlen = cpu_to_le16(dlen);
+
+	iov[0].iov_base = &type;
+	iov[0].iov_len = sizeof(type);
+	iov[1].iov_base = &hdr;
+	iov[1].iov_len = sizeof(hdr);
+	iov[2].iov_base = (void *) pdu;
+	iov[2].iov_len = size;
+
+	g_assert(io_send(context->host[0].io, iov, 3) >= 0);
+}
+
+static void raw_debug(const char *str, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("hci: %s", str);
+
+	context->dropped++;
+}
+
+static void raw_received(uint16_t handle, uint8_t flags, const void *buf,
+					uint16_t size, void *user_data)
+{
+	struct context *context = user_data;
+
+	/* Each PDU follows an oversized packet that has to be dropped */
+	g_assert(context->dropped == context->received + 1);
+
+	data_received(handle, flags, buf, size, user_data);
+}
+
+static void test_data_raw(const void *test_data)
+{
+	const struct test_data *data = test_data;
+	struct context *context = tester_get_data();
+	struct host *host = &context->host[0];
+	uint8_t *oversized;
+	unsigned int i;
+	int sv[2];
+
+	context->data = data;
+	context->handle = 0x0001;
+
+	context->pdu = malloc(data->size);
+	for (i = 0; i < data->size; i++)
+		context->pdu[i] = i;
+
+	g_assert(!socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC |
+						SOCK_NONBLOCK, 0, sv));
+
+	host->io = io_new(sv[0]);
+	io_set_close_on_destroy(host->io, true);
+
+	context->host[1].hci = bt_hci_new(sv[1]);
+	g_assert(context->host[1].hci);
+
+	bt_hci_set_close_on_unref(context->host[1].hci, true);
+	bt_hci_set_debug(context->host[1].hci, raw_debug, context, NULL);
+	bt_hci_register_data(context->host[1].hci, BT_H4_ACL_PKT,
+					raw_received, context, NULL);
+
+	/* Past the largest length an ACL header can carry */
+	oversized = new0(uint8_t, UINT16_MAX + 1);
+
+	for (i = 0; i < data->count; i++) {
+		raw_send(context, UINT16_MAX, oversized, UINT16_MAX + 1);
+		raw_send(context, data->size, context->pdu, data->size);
+	}
+
+	free(oversized);
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	define_test("/hci/data/single", 100, 1);
+	define_test("/hci/data/fragment", 1000, 1);
+	define_test("/hci/data/credits", 1000, 64);
+	define_test_raw("/hci/data/large", 4000, 2);
+
+	return tester_run();
+}
@@ -0,0 +1,349 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "src/shared/util.h"
+#include "src/shared/uring.h"
+#include "src/shared/io.h"
+#include "src/shared/tester.h"
+
+struct test_data {
+	bool uring;
+	struct io *client;
+	struct io *server;
+	unsigned int count;
+};
+
+struct ring_result {
+	unsigned int count;
+	uint64_t data;
+	int32_t res;
+	uint32_t flags;
+};
+
+static const uint8_t pdu[] = { 0x1b, 0x2a, 0x00, 0x01, 0x02, 0x03 };
+
+static void ring_complete(uint64_t data, int32_t res, uint32_t flags,
+							void *user_data)
+{
+	struct ring_result *result = user_data;
+
+	result->count++;
+	result->data = data;
+	result->res = res;
+	result->flags = flags;
+}
+
+static void ring_wait(struct uring *ring, struct ring_result *result)
+{
+	struct pollfd pfd;
+
+	memset(result, 0, sizeof(*result));
+
+	pfd.fd = uring_get_fd(ring);
+	pfd.events = POLLIN;
+
+	g_assert(poll(&pfd, 1, 1000) == 1);
+	g_assert(uring_process(ring, ring_complete, result) > 0);
+}
+
+static void test_uring_nop(const void *test_data)
+{
+	struct ring_result result;
+	struct uring *ring;
+
+	ring = uring_new(8, 4);
+	if (!ring) {
+		tester_test_abort();
+		return;
+	}
+
+	g_assert(uring_sq_space(ring) == 8);
+	g_assert(uring_nop(ring, 0x1234) == 0);
+	g_assert(uring_sq_space(ring) == 7);
+	g_assert(uring_submit(ring) == 1);
+
+	ring_wait(ring, &result);
+	g_assert(result.count == 1);
+	g_assert(result.data == 0x1234);
+	g_assert(result.res == 0);
+
+	/* Nothing queued means nothing to submit */
+	g_assert(uring_submit(ring) == 0);
+
+	uring_free(ring);
+
+	tester_test_passed();
+}
+
+static void test_uring_send_recv(const void *test_data)
+{
+	struct ring_result result;
+	struct uring *ring;
+	int sv[2], tx, rx, bid;
+
+	ring = uring_new(8, 4);
+	if (!ring) {
+		tester_test_abort();
+		return;
+	}
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK |
+						SOCK_CLOEXEC, 0, sv) == 0);
+
+	tx = uring_file_register(ring, sv[0]);
+	rx = uring_file_register(ring, sv[1]);
+	g_assert(tx >= 0 && rx >= 0 && tx != rx);
+
+	g_assert(uring_send(ring, tx, pdu, sizeof(pdu), false, 1) == 0);
+	g_assert(uring_submit(ring) == 1);
+
+	ring_wait(ring, &result);
+	g_assert(result.data == 1);
+	g_assert(result.res == sizeof(pdu));
+
+	/* Provided buffers need a recent kernel, keep to the send then */
+	if (!uring_buf_setup(ring, 4, 64))
+		goto done;
+
+	g_assert(uring_buf_size(ring) == 64);
+
+	g_assert(uring_recv(ring, rx, 2) == 0);
+	g_assert(uring_submit(ring) == 1);
+
+	ring_wait(ring, &result);
+	g_assert(result.data == 2);
+
+	/* Kernels without multishot receive reject the request */
+	if (result.res == -EINVAL || result.res == -EOPNOTSUPP)
+		goto done;
+
+	g_assert(result.res == sizeof(pdu));
+	g_assert(uring_cqe_more(result.flags));
+
+	bid = uring_cqe_buffer(result.flags);
+	g_assert(bid >= 0);
+	g_assert(memcmp(uring_buf_get(ring, bid), pdu, sizeof(pdu)) == 0);
+	uring_buf_put(ring, bid);
+
+	/* Cancelling ends the multishot receive */
+	g_assert(uring_cancel(ring, 2) == 0);
+	g_assert(uring_submit(ring) == 1);
+
+	memset(&result, 0, sizeof(result));
+
+	while (!result.count || uring_cqe_more(result.flags) ||
+							result.data != 2) {
+		struct ring_result next;
+
+		ring_wait(ring, &next);
+
+		if (next.data == 2)
+			result = next;
+	}
+
+	g_assert(result.res == -ECANCELED);
+
+done:
+	uring_file_unregister(ring, tx);
+	uring_file_unregister(ring, rx);
+	uring_free(ring);
+
+	close(sv[0]);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
+static void test_done(struct test_data *data)
+{
+	io_destroy(data->client);
+	io_destroy(data->server);
+	data->client = NULL;
+	data->server = NULL;
+
+	io_set_uring(false);
+
+	tester_test_passed();
+}
+
+static bool echo_read(struct io *io, void *user_data)
+{
+	struct test_data *data = user_data;
+	uint8_t buf[64];
+	ssize_t len;
+
+	len = io_recv(io, buf, sizeof(buf));
+	if (len == -EAGAIN)
+		return true;
+
+	g_assert(len == sizeof(pdu));
+	g_assert(buf[0] == data->count);
+	g_assert(memcmp(buf + 1, pdu + 1, sizeof(pdu) - 1) == 0);
+
+	if (++data->count == 100)
+		test_done(data);
+
+	return true;
+}
+
+static void test_echo(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	uint8_t buf[sizeof(pdu)];
+	struct iovec iov[2];
+	int sv[2];
+	unsigned int i;
+
+	if (!io_set_uring(data->uring)) {
+		tester_test_abort();
+		return;
+	}
+
+	g_assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK |
+						SOCK_CLOEXEC, 0, sv) == 0);
+
+	data->client = io_new(sv[0]);
+	data->server = io_new(sv[1]);
+	g_assert(data->client && data->server);
+
+	io_set_close_on_destroy(data->client, true);
+	io_set_close_on_destroy(data->server, true);
+
+	g_assert(io_set_read_handler(data->server, echo_read, data, NULL));
+
+	memcpy(buf, pdu, sizeof(pdu));
+
+	/* Sends are gathered from the vector in order */
+	for (i = 0; i < 100; i++) {
+		buf[0] = i;
+
+		iov[0].iov_base = buf;
+		iov[0].iov_len = 2;
+		iov[1].iov_base = buf + 2;
+		iov[1].iov_len = sizeof(buf) - 2;
+
+		g_assert(io_send(data->client, iov, 2) == sizeof(buf));
+	}
+}
+
+static bool send_error_disconnect(struct io *io, void *user_data)
+{
+	struct test_data *data = user_data;
+	struct iovec iov;
+
+	/* Anything sent after the failure is refused straight away */
+	iov.iov_base = (void *) pdu;
+	iov.iov_len = sizeof(pdu);
+	g_assert(io_send(io, &iov, 1) == -EMSGSIZE);
+
+	data->count++;
+	test_done(data);
+
+	return false;
+}
+
+static void test_send_error(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	static uint8_t buf[16384];
+	struct iovec iov;
+	int sv[2], size = 4096;
+
+	if (!io_set_uring(true)) {
+		tester_test_abort();
+		return;
+	}
+
+	g_assert(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK |
+						SOCK_CLOEXEC, 0, sv) == 0);
+	g_assert(setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size,
+							sizeof(size)) == 0);
+
+	data->client = io_new(sv[0]);
+	data->server = io_new(sv[1]);
+	g_assert(data->client && data->server);
+
+	io_set_close_on_destroy(data->client, true);
+	io_set_close_on_destroy(data->server, true);
+
+	g_assert(io_set_disconnect_handler(data->client,
+					send_error_disconnect, data, NULL));
+
+	/*
+	 * Too large for the socket, the ring accepts it and the failure
+	 * can only come back as a disconnect.
+	 */
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	g_assert(io_send(data->client, &iov, 1) == sizeof(buf));
+}
+
+static void test_teardown(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	io_destroy(data->client);
+	io_destroy(data->server);
+	io_set_uring(false);
+
+	tester_teardown_complete();
+}
+
+#define define_test(name, function, use_uring)				\
+	do {								\
+		struct test_data *data;					\
+		data = new0(struct test_data, 1);			\
+		data->uring = use_uring;				\
+		tester_add_full(name, NULL, NULL, NULL, function,	\
+				test_teardown, NULL, 2, data, free);	\
+	} while (0)
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/uring/nop", NULL, NULL, test_uring_nop, NULL);
+	tester_add("/uring/send_recv", NULL, NULL, test_uring_send_recv,
+									NULL);
+
+	define_test("/io/epoll/echo", test_echo, false);
+	define_test("/io/uring/echo", test_echo, true);
+	define_test("/io/uring/send_error", test_send_error, true);
+
+	return tester_run();
+}
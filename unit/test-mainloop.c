@@ -0,0 +1,142 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "src/shared/mainloop.h"
+#include "src/shared/timeout.h"
+#include "src/shared/tester.h"
+
+#define TIMER_COUNT	400
+#define TIMER_PARALLEL	20
+#define TIMER_REPEAT	50
+
+struct timer {
+	uint64_t start;
+	unsigned int msec;
+	unsigned int count;
+};
+
+static struct timer timers[TIMER_PARALLEL];
+static unsigned int started;
+static unsigned int fired;
+
+static uint64_t now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void timer_start(struct timer *timer);
+
+static void timer_expired(int id, void *user_data)
+{
+	struct timer *timer = user_data;
+	uint64_t elapsed = now_usec() - timer->start;
+
+	mainloop_remove_timeout(id);
+
+	/* Expiring early is never fine, late is up to the scheduler */
+	g_assert_cmpuint(elapsed, >=, timer->msec * 1000);
+
+	fired++;
+
+	if (started < TIMER_COUNT)
+		timer_start(timer);
+	else if (fired == TIMER_COUNT)
+		tester_test_passed();
+}
+
+static void timer_start(struct timer *timer)
+{
+	/* Vary the period so timeouts start at any point within a tick */
+	timer->msec = 1 + started % 7;
+	timer->start = now_usec();
+
+	g_assert(mainloop_add_timeout(timer->msec, timer_expired, timer,
+								NULL) > 0);
+
+	started++;
+}
+
+static void test_timeout_add(const void *test_data)
+{
+	unsigned int i;
+
+	started = 0;
+	fired = 0;
+
+	for (i = 0; i < TIMER_PARALLEL; i++)
+		timer_start(&timers[i]);
+}
+
+static bool timer_repeat(void *user_data)
+{
+	struct timer *timer = user_data;
+	uint64_t now = now_usec();
+
+	g_assert_cmpuint(now - timer->start, >=, timer->msec * 1000);
+
+	timer->start = now;
+
+	if (++timer->count < TIMER_REPEAT)
+		return true;
+
+	tester_test_passed();
+
+	return false;
+}
+
+static void test_timeout_repeat(const void *test_data)
+{
+	struct timer *timer = &timers[0];
+
+	timer->msec = 3;
+	timer->count = 0;
+	timer->start = now_usec();
+
+	g_assert(timeout_add(timer->msec, timer_repeat, timer, NULL));
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/mainloop/timeout/add", NULL, NULL, test_timeout_add,
+									NULL);
+	tester_add("/mainloop/timeout/repeat", NULL, NULL,
+					test_timeout_repeat, NULL);
+
+	return tester_run();
+}
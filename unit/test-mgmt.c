@@ -242,6 +242,11 @@ static const struct command_test_data command_test_2 = {
 	.cmd_size = sizeof(read_info_command),
 };
 
+static const unsigned char read_info_index_0[] =
+				{ 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 };
+static const unsigned char read_info_index_1[] =
+				{ 0x04, 0x00, 0x01, 0x00, 0x00, 0x00 };
+
 static const unsigned char invalid_index_response[] =
 				{ 0x02, 0x00, 0xff, 0xff, 0x03, 0x00,
 				0x01, 0x00, 0x11 };
@@ -309,6 +314,29 @@ static void test_response(gconstpointer data)
 	execute_context(context);
 }
 
+static void test_pipeline(gconstpointer data)
+{
+	struct context *context = create_context();
+
+	/*
+	 * The first command is never answered, the second one must still
+	 * make it out since it is for a different controller index.
+	 */
+	add_action(context, read_info_index_0, sizeof(read_info_index_0),
+				NULL, 0, 0, false, ACTION_IGNORE);
+	add_action(context, read_info_index_1, sizeof(read_info_index_1),
+				NULL, 0, 0, false, ACTION_PASSED);
+
+	mgmt_send(context->mgmt_client, MGMT_OP_READ_INFO, 0, 0, NULL,
+							NULL, NULL, NULL);
+	mgmt_send(context->mgmt_client, MGMT_OP_READ_INFO, 0, 0, NULL,
+							NULL, NULL, NULL);
+	mgmt_send(context->mgmt_client, MGMT_OP_READ_INFO, 1, 0, NULL,
+							NULL, NULL, NULL);
+
+	execute_context(context);
+}
+
 static void event_cb(uint16_t index, uint16_t length, const void *param,
 							void *user_data)
 {
@@ -441,6 +469,8 @@ int main(int argc, char *argv[])
 	g_test_add_data_func("/mgmt/response/2", &command_test_3,
 								test_response);
 
+	g_test_add_data_func("/mgmt/pipeline/1", NULL, test_pipeline);
+
 	g_test_add_data_func("/mgmt/event/1", &event_test_1, test_event);
 	g_test_add_data_func("/mgmt/event/2", &event_test_1, test_event2);
 
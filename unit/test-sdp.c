@@ -25,8 +25,11 @@
 #include <config.h>
 #endif
 
+#define _GNU_SOURCE
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
@@ -706,6 +709,143 @@ static void test_sdp(gconstpointer data)
 	g_idle_add(send_pdu, context);
 }
 
+static sdp_record_t *register_cache_record(uint32_t handle, uint16_t svclass,
+							const char *name)
+{
+	sdp_list_t *svclass_id, *root;
+	uuid_t root_uuid, svclass_uuid;
+	sdp_record_t *record = sdp_record_alloc();
+	sdp_data_t *sdp_data;
+
+	record->handle = handle;
+
+	sdp_record_add(BDADDR_ANY, record);
+	sdp_data = sdp_data_alloc(SDP_UINT32, &record->handle);
+	sdp_attr_add(record, SDP_ATTR_RECORD_HANDLE, sdp_data);
+
+	sdp_uuid16_create(&root_uuid, PUBLIC_BROWSE_GROUP);
+	root = sdp_list_append(0, &root_uuid);
+	sdp_set_browse_groups(record, root);
+	sdp_list_free(root, 0);
+
+	sdp_uuid16_create(&svclass_uuid, svclass);
+	svclass_id = sdp_list_append(0, &svclass_uuid);
+	sdp_set_service_classes(record, svclass_id);
+	sdp_list_free(svclass_id, 0);
+
+	sdp_set_info_attr(record, name, NULL, NULL);
+
+	return record;
+}
+
+static ssize_t cache_request(int *sv, uint8_t *rsp)
+{
+	/* Every attribute of every record in the public browse group */
+	static const uint8_t req[] = { SDP_SVC_SEARCH_ATTR_REQ, 0x00, 0x01,
+					0x00, 0x0f, 0x35, 0x03, 0x19, 0x10,
+					0x02, 0xff, 0xff, 0x35, 0x05, 0x0a,
+					0x00, 0x00, 0xff, 0xff, 0x00 };
+	ssize_t len;
+
+	handle_internal_request(sv[0], USHRT_MAX, g_memdup(req, sizeof(req)),
+								sizeof(req));
+
+	len = recv(sv[1], rsp, USHRT_MAX, 0);
+	g_assert(len > (ssize_t) sizeof(sdp_pdu_hdr_t));
+	g_assert(rsp[0] == SDP_SVC_SEARCH_ATTR_RSP);
+
+	/* Everything has to fit without continuation state */
+	g_assert(rsp[len - 1] == 0x00);
+
+	return len;
+}
+
+static bool rsp_has_pdu(const uint8_t *rsp, ssize_t len, const sdp_buf_t *pdu)
+{
+	return memmem(rsp, len, pdu->data, pdu->data_size) != NULL;
+}
+
+/* The response must carry exactly what a fresh serialization gives */
+static void check_record(const uint8_t *rsp, ssize_t len, sdp_record_t *rec,
+							sdp_buf_t *pdu)
+{
+	g_assert(sdp_gen_record_pdu(rec, pdu) == 0);
+	g_assert(rsp_has_pdu(rsp, len, pdu));
+}
+
+static void test_sdp_cache(gconstpointer data)
+{
+	sdp_record_t *low, *high;
+	sdp_buf_t low_pdu, high_pdu, pdu;
+	uint8_t *rsp;
+	ssize_t len;
+	int err, sv[2];
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	rsp = g_malloc(USHRT_MAX);
+
+	set_fixed_db_timestamp(0x496f0654);
+
+	register_public_browse_group();
+	register_server_service();
+
+	/* Handles on both sides of 0x80000000 */
+	low = register_cache_record(0x00010100, SERIAL_PORT_SVCLASS_ID,
+								"Low");
+	high = register_cache_record(0x90000000, OBEX_OBJPUSH_SVCLASS_ID,
+								"High");
+
+	len = cache_request(sv, rsp);
+	check_record(rsp, len, low, &low_pdu);
+	check_record(rsp, len, high, &high_pdu);
+
+	/* Served again from the cache */
+	len = cache_request(sv, rsp);
+	g_assert(rsp_has_pdu(rsp, len, &low_pdu));
+	g_assert(rsp_has_pdu(rsp, len, &high_pdu));
+
+	/* Modified in place */
+	sdp_attr_replace(low, SDP_ATTR_SVCNAME_PRIMARY,
+				sdp_data_alloc(SDP_TEXT_STR8, "Updated"));
+	sdp_record_changed(low->handle);
+
+	len = cache_request(sv, rsp);
+	g_assert(!rsp_has_pdu(rsp, len, &low_pdu));
+	check_record(rsp, len, low, &pdu);
+	g_assert(rsp_has_pdu(rsp, len, &high_pdu));
+	free(pdu.data);
+
+	/* Removed, then the handle is reused for a different record */
+	g_assert(remove_record_from_server(high->handle) == 0);
+
+	len = cache_request(sv, rsp);
+	g_assert(!rsp_has_pdu(rsp, len, &high_pdu));
+	check_record(rsp, len, low, &pdu);
+	free(pdu.data);
+
+	high = register_cache_record(0x90000000, OBEX_FILETRANS_SVCLASS_ID,
+								"Reused");
+	sdp_record_changed(high->handle);
+
+	len = cache_request(sv, rsp);
+	g_assert(!rsp_has_pdu(rsp, len, &high_pdu));
+	check_record(rsp, len, high, &pdu);
+	free(pdu.data);
+
+	free(low_pdu.data);
+	free(high_pdu.data);
+
+	sdp_svcdb_reset();
+
+	g_free(rsp);
+	close(sv[0]);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
 static void test_sdp_de_attr(gconstpointer data)
 {
 	const struct test_data_de *test = data;
@@ -2824,5 +2964,8 @@ int main(int argc, char *argv[])
 				0x00, 0x09, 0x00, 0x01, 0x08),
 		raw_pdu(0x01, 0x00, 0x02, 0x00, 0x02, 0x00, 0x05));
 
+	tester_add("/sdp/CACHE/update_remove", NULL, NULL, test_sdp_cache,
+									NULL);
+
 	return tester_run();
 }
@@ -0,0 +1,296 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <glib.h>
+
+#include "src/shared/shm-ring.h"
+#include "src/shared/tester.h"
+
+static void fill(uint8_t *buf, uint16_t len, unsigned int seq)
+{
+	uint16_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = seq + i;
+}
+
+static void test_basic(const void *data)
+{
+	struct shm_ring *ring;
+	struct shm_ring_stats stats;
+	uint8_t buf[64], out[64];
+	int len;
+
+	ring = shm_ring_new(0);
+	g_assert(ring != NULL);
+	g_assert(shm_ring_get_size(ring) == 1024);
+	g_assert(shm_ring_get_mem_fd(ring) >= 0);
+	g_assert(shm_ring_get_event_fd(ring) >= 0);
+
+	g_assert(shm_ring_pop(ring, out, sizeof(out)) == -EAGAIN);
+
+	fill(buf, 23, 1);
+	g_assert(shm_ring_push(ring, buf, 23));
+
+	len = shm_ring_pop(ring, out, sizeof(out));
+	g_assert(len == 23);
+	g_assert(memcmp(buf, out, len) == 0);
+	g_assert(shm_ring_pop(ring, out, sizeof(out)) == -EAGAIN);
+
+	/* Empty records are valid */
+	g_assert(shm_ring_push(ring, buf, 0));
+	g_assert(shm_ring_pop(ring, out, sizeof(out)) == 0);
+	g_assert(shm_ring_pop(ring, out, sizeof(out)) == -EAGAIN);
+
+	/* Records larger than the buffer are consumed and reported */
+	g_assert(shm_ring_push(ring, buf, 40));
+	g_assert(shm_ring_push(ring, buf, 8));
+	g_assert(shm_ring_pop(ring, out, 16) == -EMSGSIZE);
+	g_assert(shm_ring_pop(ring, out, 16) == 8);
+
+	shm_ring_get_stats(ring, &stats);
+	g_assert(stats.pushed == 4);
+	g_assert(stats.dropped == 0);
+
+	shm_ring_free(ring);
+	tester_test_passed();
+}
+
+static void test_wrap(const void *data)
+{
+	struct shm_ring *ring;
+	uint8_t buf[300], out[300];
+	unsigned int i;
+
+	ring = shm_ring_new(1024);
+	g_assert(ring != NULL);
+
+	for (i = 0; i < 10000; i++) {
+		uint16_t len = (i * 37) % sizeof(buf);
+		int ret;
+
+		tester_debug("Iteration %u len %u\n", i, len);
+
+		fill(buf, len, i);
+		g_assert(shm_ring_push(ring, buf, len));
+
+		/* Keep a couple of records in flight across the wrap */
+		if (i % 3 == 0)
+			continue;
+
+		while ((ret = shm_ring_pop(ring, out, sizeof(out))) >= 0)
+			;
+
+		g_assert(ret == -EAGAIN);
+	}
+
+	shm_ring_free(ring);
+	tester_test_passed();
+}
+
+static void test_full(const void *data)
+{
+	struct shm_ring *ring;
+	struct shm_ring_stats stats;
+	struct iovec iov[64];
+	uint8_t buf[60], out[60];
+	unsigned int i, pushed;
+	int len;
+
+	ring = shm_ring_new(1024);
+	g_assert(ring != NULL);
+
+	for (i = 0; i < G_N_ELEMENTS(iov); i++) {
+		iov[i].iov_base = buf;
+		iov[i].iov_len = sizeof(buf);
+	}
+
+	fill(buf, sizeof(buf), 0);
+
+	/* 1024 / (4 + 60) records fit, the rest is dropped */
+	pushed = shm_ring_pushv(ring, iov, G_N_ELEMENTS(iov));
+	g_assert(pushed == 16);
+
+	shm_ring_get_stats(ring, &stats);
+	g_assert(stats.pushed == 16);
+	g_assert(stats.dropped == G_N_ELEMENTS(iov) - 16);
+	g_assert(stats.max_used == 1024);
+
+	/* Oversized records never fit */
+	g_assert(!shm_ring_push(ring, buf, UINT16_MAX));
+
+	for (i = 0; i < pushed; i++) {
+		len = shm_ring_pop(ring, out, sizeof(out));
+		g_assert(len == sizeof(buf));
+		g_assert(memcmp(buf, out, len) == 0);
+	}
+
+	g_assert(shm_ring_pop(ring, out, sizeof(out)) == -EAGAIN);
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+
+	shm_ring_free(ring);
+	tester_test_passed();
+}
+
+static void test_doorbell(const void *data)
+{
+	struct shm_ring *ring;
+	struct shm_ring_stats stats;
+	uint8_t buf[16] = { 0 };
+	uint64_t val;
+	int fd;
+
+	ring = shm_ring_new(1024);
+	g_assert(ring != NULL);
+
+	fd = shm_ring_get_event_fd(ring);
+
+	/* Nothing pending, nothing to ring */
+	g_assert(!shm_ring_kick(ring));
+
+	/* Consumer is busy, the batch is published silently */
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+	g_assert(!shm_ring_kick(ring));
+	g_assert(read(fd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+
+	/* Pending data must be drained before waiting */
+	g_assert(!shm_ring_prepare_wait(ring));
+	g_assert(shm_ring_pop(ring, buf, sizeof(buf)) == sizeof(buf));
+	g_assert(shm_ring_pop(ring, buf, sizeof(buf)) == sizeof(buf));
+	g_assert(shm_ring_prepare_wait(ring));
+
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+	g_assert(shm_ring_kick(ring));
+	g_assert(read(fd, &val, sizeof(val)) == sizeof(val));
+	g_assert(val == 1);
+
+	/* The doorbell is one shot until the consumer waits again */
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+	g_assert(!shm_ring_kick(ring));
+
+	/* A consumer stopping early wakes itself up for the rest */
+	g_assert(read(fd, &val, sizeof(val)) < 0 && errno == EAGAIN);
+	shm_ring_rearm(ring);
+	g_assert(read(fd, &val, sizeof(val)) == sizeof(val));
+	g_assert(val == 1);
+
+	shm_ring_get_stats(ring, &stats);
+	g_assert(stats.doorbells == 1);
+
+	shm_ring_free(ring);
+	tester_test_passed();
+}
+
+static void test_attach(const void *data)
+{
+	struct shm_ring *producer, *consumer;
+	uint8_t buf[100], out[100];
+	unsigned int i;
+	int len;
+
+	producer = shm_ring_new(4096);
+	g_assert(producer != NULL);
+
+	g_assert(shm_ring_push(producer, buf, 10));
+
+	consumer = shm_ring_attach(dup(shm_ring_get_mem_fd(producer)),
+				dup(shm_ring_get_event_fd(producer)));
+	g_assert(consumer != NULL);
+	g_assert(shm_ring_get_size(consumer) == 4096);
+
+	/* Attaching picks up records already in flight */
+	g_assert(shm_ring_pop(consumer, out, sizeof(out)) == 10);
+
+	for (i = 0; i < 1000; i++) {
+		fill(buf, i % sizeof(buf), i);
+		g_assert(shm_ring_push(producer, buf, i % sizeof(buf)));
+
+		len = shm_ring_pop(consumer, out, sizeof(out));
+		g_assert(len == (int) (i % sizeof(buf)));
+		g_assert(memcmp(buf, out, len) == 0);
+	}
+
+	shm_ring_free(consumer);
+	shm_ring_free(producer);
+	tester_test_passed();
+}
+
+static void test_invalid(const void *data)
+{
+	struct shm_ring *ring, *peer;
+	uint32_t head = 0x12345678;
+	uint8_t buf[16] = { 0 };
+	int fd;
+
+	/* Only sealed memfds are accepted */
+	fd = memfd_create("test", MFD_CLOEXEC);
+	g_assert(fd >= 0);
+	g_assert(ftruncate(fd, 8192) == 0);
+	g_assert(shm_ring_attach(fd, -1) == NULL);
+	close(fd);
+
+	ring = shm_ring_new(1024);
+	g_assert(ring != NULL);
+
+	peer = shm_ring_attach(dup(shm_ring_get_mem_fd(ring)), -1);
+	g_assert(peer != NULL);
+
+	g_assert(shm_ring_push(ring, buf, sizeof(buf)));
+
+	/* A producer publishing a bogus index is caught */
+	g_assert(pwrite(shm_ring_get_mem_fd(ring), &head, sizeof(head),
+								64) == 4);
+	g_assert(shm_ring_pop(peer, buf, sizeof(buf)) == -EBADMSG);
+
+	shm_ring_free(peer);
+	shm_ring_free(ring);
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/shm-ring/basic", NULL, NULL, test_basic, NULL);
+	tester_add("/shm-ring/wrap", NULL, NULL, test_wrap, NULL);
+	tester_add("/shm-ring/full", NULL, NULL, test_full, NULL);
+	tester_add("/shm-ring/doorbell", NULL, NULL, test_doorbell, NULL);
+	tester_add("/shm-ring/attach", NULL, NULL, test_attach, NULL);
+	tester_add("/shm-ring/invalid", NULL, NULL, test_invalid, NULL);
+
+	return tester_run();
+}
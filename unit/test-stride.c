@@ -0,0 +1,222 @@
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  agent <agent@local>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "src/shared/util.h"
+#include "src/shared/queue.h"
+#include "src/shared/stride.h"
+#include "src/shared/tester.h"
+
+struct user {
+	struct stride_entry entry;
+	bool skip;
+	bool loaded;
+	unsigned int airtime;
+};
+
+static struct stride_entry *user_entry(void *data)
+{
+	struct user *user = data;
+
+	return user->skip ? NULL : &user->entry;
+}
+
+static struct stride_entry *waiting_entry(void *data)
+{
+	struct user *user = data;
+
+	return user->loaded ? NULL : user_entry(user);
+}
+
+static struct queue *create_users(struct user *users, unsigned int count,
+						const unsigned int *weights)
+{
+	struct queue *queue = queue_new();
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		memset(&users[i], 0, sizeof(users[i]));
+		users[i].entry.weight = weights[i];
+		queue_push_tail(queue, &users[i]);
+	}
+
+	return queue;
+}
+
+static void test_advance(const void *data)
+{
+	struct stride_entry entry = { .pass = 10, .weight = 1 };
+
+	stride_advance(&entry, 2);
+	g_assert(entry.pass == 10 + 2 * STRIDE_ONE);
+
+	/* Heavier entries advance slower */
+	entry.pass = 0;
+	entry.weight = 4;
+	stride_advance(&entry, 2);
+	g_assert(entry.pass == STRIDE_ONE / 2);
+
+	entry.weight = 0;
+	stride_advance(&entry, 2);
+	g_assert(entry.pass == STRIDE_ONE / 2);
+
+	tester_test_passed();
+}
+
+static void test_next(const void *data)
+{
+	static const unsigned int weights[] = { 1, 1, 1, 1 };
+	struct user users[4];
+	struct queue *queue;
+
+	queue = queue_new();
+	g_assert(!stride_next(queue, user_entry));
+	g_assert(stride_min_pass(queue, user_entry) == 0);
+	queue_destroy(queue, NULL);
+
+	queue = create_users(users, 4, weights);
+
+	users[0].entry.pass = 30;
+	users[1].entry.pass = 20;
+	users[2].entry.pass = 10;
+	users[3].entry.pass = 10;
+
+	/* Lowest pass first, ties go to the first queued */
+	g_assert(stride_next(queue, user_entry) == &users[2]);
+	g_assert(stride_min_pass(queue, user_entry) == 10);
+
+	users[2].skip = true;
+	g_assert(stride_next(queue, user_entry) == &users[3]);
+
+	users[3].skip = true;
+	g_assert(stride_next(queue, user_entry) == &users[1]);
+	g_assert(stride_min_pass(queue, user_entry) == 20);
+
+	queue_destroy(queue, NULL);
+
+	tester_test_passed();
+}
+
+static void test_share(const void *data)
+{
+	static const unsigned int weights[] = { 1, 1, 2, 4, 12 };
+	struct user users[5];
+	struct queue *queue;
+
+	queue = create_users(users, 5, weights);
+
+	/* Everybody fits */
+	g_assert(stride_share(queue, user_entry, &users[0].entry, 5) == 1000);
+
+	/* Skipped entries don't count */
+	users[3].skip = true;
+	users[4].skip = true;
+	g_assert(stride_share(queue, user_entry, &users[0].entry, 2) == 500);
+	g_assert(stride_share(queue, user_entry, &users[2].entry, 2) == 1000);
+	g_assert(stride_share(queue, user_entry, &users[0].entry, 3) == 1000);
+
+	users[3].skip = false;
+	g_assert(stride_share(queue, user_entry, &users[0].entry, 2) == 250);
+	g_assert(stride_share(queue, user_entry, &users[2].entry, 2) == 500);
+	g_assert(stride_share(queue, user_entry, &users[3].entry, 2) == 1000);
+
+	/* An entry can't hold more than a slot however heavy */
+	users[4].skip = false;
+	g_assert(stride_share(queue, user_entry, &users[4].entry, 2) == 1000);
+	g_assert(stride_share(queue, user_entry, &users[0].entry, 2) == 100);
+
+	queue_destroy(queue, NULL);
+
+	tester_test_passed();
+}
+
+/*
+ * Hand slots over the way the advertising manager does: when a slice ends
+ * the holder keeps its slot unless a waiting entry has a lower pass.
+ */
+static void test_airtime(const void *data)
+{
+	static const unsigned int weights[] = { 1, 1, 2, 4 };
+	struct user users[4], *slots[2];
+	struct queue *queue;
+	unsigned int i, t;
+
+	queue = create_users(users, 4, weights);
+
+	for (i = 0; i < 2; i++) {
+		slots[i] = stride_next(queue, waiting_entry);
+		slots[i]->loaded = true;
+	}
+
+	for (t = 0; t < 1000; t++) {
+		for (i = 0; i < 2; i++) {
+			struct user *next;
+
+			slots[i]->airtime++;
+			stride_advance(&slots[i]->entry, 1);
+
+			next = stride_next(queue, waiting_entry);
+			if (!next || next->entry.pass > slots[i]->entry.pass)
+				continue;
+
+			slots[i]->loaded = false;
+			slots[i] = next;
+			next->loaded = true;
+		}
+	}
+
+	for (i = 0; i < 4; i++) {
+		unsigned int share;
+
+		share = stride_share(queue, user_entry, &users[i].entry, 2);
+
+		tester_debug("weight %u share %u airtime %u", weights[i],
+						share, users[i].airtime);
+
+		g_assert(abs((int) users[i].airtime - (int) share) <= 10);
+	}
+
+	queue_destroy(queue, NULL);
+
+	tester_test_passed();
+}
+
+int main(int argc, char *argv[])
+{
+	tester_init(&argc, &argv);
+
+	tester_add("/stride/advance", NULL, NULL, test_advance, NULL);
+	tester_add("/stride/next", NULL, NULL, test_next, NULL);
+	tester_add("/stride/share", NULL, NULL, test_share, NULL);
+	tester_add("/stride/airtime", NULL, NULL, test_airtime, NULL);
+
+	return tester_run();
+}
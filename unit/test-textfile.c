@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 
@@ -262,6 +263,119 @@ static void test_multiple(const void *data)
 	tester_test_passed();
 }
 
+static void collect_key(char *key, char *value, void *data)
+{
+	GString *keys = data;
+
+	g_string_append_printf(keys, "%s=%s;", key, value);
+}
+
+static void test_handle(const void *data)
+{
+	struct textfile *file;
+	GString *keys;
+	char *str;
+
+	util_create_empty();
+
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:01", "a") == 0);
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:02", "b") == 0);
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:03", "c") == 0);
+
+	file = textfile_open(test_pathname);
+	g_assert(file != NULL);
+
+	g_assert_cmpstr(textfile_lookup(file, "00:00:00:00:00:02"), ==, "b");
+	g_assert(textfile_lookup(file, "00:00:00:00:00:04") == NULL);
+	g_assert(textfile_lookup(file, "00:00:00:00:00") == NULL);
+
+	g_assert(textfile_set(file, "00:00:00:00:00:02", "bb") == 0);
+	g_assert(textfile_set(file, "00:00:00:00:00:01", NULL) == 0);
+	g_assert(textfile_set(file, "00:00:00:00:00:04", "d") == 0);
+	g_assert(textfile_set(file, "00:00:00:00:00:05", "e\n") < 0);
+
+	g_assert_cmpstr(textfile_lookup(file, "00:00:00:00:00:02"), ==, "bb");
+	g_assert(textfile_lookup(file, "00:00:00:00:00:01") == NULL);
+
+	/* Nothing hits the file before the commit */
+	str = textfile_get(test_pathname, "00:00:00:00:00:01");
+	g_assert_cmpstr(str, ==, "a");
+	free(str);
+
+	g_assert(textfile_commit(file) == 0);
+	textfile_close(file);
+
+	str = textfile_get(test_pathname, "00:00:00:00:00:01");
+	g_assert(str == NULL);
+
+	str = textfile_get(test_pathname, "00:00:00:00:00:02");
+	g_assert_cmpstr(str, ==, "bb");
+	free(str);
+
+	keys = g_string_new(NULL);
+	textfile_foreach(test_pathname, collect_key, keys);
+	g_assert_cmpstr(keys->str, ==, "00:00:00:00:00:02=bb;"
+					"00:00:00:00:00:03=c;"
+					"00:00:00:00:00:04=d;");
+	g_string_free(keys, TRUE);
+
+	tester_test_passed();
+}
+
+static void test_handle_merge(const void *data)
+{
+	struct textfile *file;
+	struct stat st;
+	GString *keys;
+	ino_t ino;
+
+	util_create_empty();
+
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:01", "a") == 0);
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:02", "b") == 0);
+
+	file = textfile_open(test_pathname);
+	g_assert(file != NULL);
+
+	/* Written behind the handle's back after it was opened */
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:03", "c") == 0);
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:02", "x") == 0);
+
+	g_assert(textfile_set(file, "00:00:00:00:00:02", "bb") == 0);
+	g_assert(textfile_set(file, "00:00:00:00:00:01", NULL) == 0);
+
+	g_assert(textfile_lookup(file, "00:00:00:00:00:03") == NULL);
+
+	g_assert(stat(test_pathname, &st) == 0);
+	ino = st.st_ino;
+
+	g_assert(textfile_commit(file) == 0);
+
+	/* Rewritten in place, so a concurrent textfile_put() can't end up
+	 * writing to a file that was renamed over.
+	 */
+	g_assert(stat(test_pathname, &st) == 0);
+	g_assert(st.st_ino == ino);
+
+	g_assert_cmpstr(textfile_lookup(file, "00:00:00:00:00:03"), ==, "c");
+	g_assert_cmpstr(textfile_lookup(file, "00:00:00:00:00:02"), ==, "bb");
+	g_assert(textfile_lookup(file, "00:00:00:00:00:01") == NULL);
+
+	/* Nothing staged any more */
+	g_assert(textfile_put(test_pathname, "00:00:00:00:00:04", "d") == 0);
+	g_assert(textfile_commit(file) == 0);
+	textfile_close(file);
+
+	keys = g_string_new(NULL);
+	textfile_foreach(test_pathname, collect_key, keys);
+	g_assert_cmpstr(keys->str, ==, "00:00:00:00:00:02=bb;"
+					"00:00:00:00:00:03=c;"
+					"00:00:00:00:00:04=d;");
+	g_string_free(keys, TRUE);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -270,6 +384,9 @@ int main(int argc, char *argv[])
 	tester_add("/textfile/delete", NULL, NULL, test_delete, NULL);
 	tester_add("/textfile/overwrite", NULL, NULL, test_overwrite, NULL);
 	tester_add("/textfile/multiple", NULL, NULL, test_multiple, NULL);
+	tester_add("/textfile/handle", NULL, NULL, test_handle, NULL);
+	tester_add("/textfile/handle_merge", NULL, NULL, test_handle_merge,
+									NULL);
 
 	return tester_run();
 }
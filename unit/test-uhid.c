@@ -230,6 +230,14 @@ static const struct uhid_event ev_input = {
 	.type = UHID_INPUT,
 };
 
+static const uint8_t ev_input2[] = {
+	UHID_INPUT2, 0x00, 0x00, 0x00,		/* type */
+	0x03, 0x00,				/* size */
+	0x01, 0xaa, 0xbb,			/* report 1 */
+};
+
+static const uint8_t input2_data[] = { 0xaa, 0xbb };
+
 static const struct uhid_event ev_output = {
 	.type = UHID_OUTPUT,
 };
@@ -255,6 +263,10 @@ static void test_client(gconstpointer data)
 	if (g_str_equal(context->data->test_name, "/uhid/command/input"))
 		bt_uhid_send(context->uhid, &ev_input);
 
+	if (g_str_equal(context->data->test_name, "/uhid/command/input2"))
+		bt_uhid_input(context->uhid, 0x01, input2_data,
+							sizeof(input2_data));
+
 	context_quit(context);
 }
 
@@ -291,6 +303,7 @@ int main(int argc, char *argv[])
 	define_test("/uhid/command/feature_answer", test_client,
 						event(&ev_feature_answer));
 	define_test("/uhid/command/input", test_client, event(&ev_input));
+	define_test("/uhid/command/input2", test_client, event(&ev_input2));
 
 	define_test("/uhid/event/output", test_server, event(&ev_output));
 	define_test("/uhid/event/feature", test_server, event(&ev_feature));